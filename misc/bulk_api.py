@@ -0,0 +1,197 @@
+#!/usr/bin/python3
+
+# Client for the DeskHop bulk config API (vendor interface, config mode only),
+# see the "Bulk Config API" section in src/include/protocol.h.
+#
+#   Read everything from a board (needs pyusb):
+#     bulk_api.py --fields src/include/api_fields.h
+#
+#   Same, from the mocked device built with the host tests:
+#     bulk_api.py --mock build-test/mock_device --fields src/include/api_fields.h
+#
+#   Set a field by index and save:
+#     bulk_api.py --set 12=400 --save --fields src/include/api_fields.h
+
+import argparse
+import re
+import struct
+import subprocess
+import sys
+
+START = b"\xaa\x55"
+
+# Vendor interface, same as in the web config
+USB_VID, USB_PID = 0x2E8A, 0x107C
+BULK_IFACE, BULK_EP_OUT, BULK_EP_IN = 4, 0x07, 0x87
+BULK_BUFFER_SIZE = 512
+BULK_HEADER = struct.Struct("<2sBBHIHI")  # start, cmd, status, length, version, offset, arg
+
+# enum bulk_cmd_e
+BULK_GET_CMD, BULK_WRITE_CMD, BULK_WRITE_SAVE_CMD = 1, 2, 3
+BULK_TYPE_TEXT_CMD = 7
+
+# enum bulk_status_e
+STATUS = {0: "OK", 1: "bad command", 2: "bad length", 3: "no such field", 4: "field is read-only",
+          5: "flash write failed"}
+
+# type_e, as used in api_fields.h
+FORMATS = {"UINT8": "B", "UINT16": "H", "UINT32": "I", "UINT64": "Q", "INT8": "b", "INT16": "h", "INT32": "i",
+           "INT64": "q"}
+
+
+class BulkError(Exception):
+    def __init__(self, status):
+        super().__init__(STATUS.get(status, f"status {status}"))
+        self.status = status
+
+
+class UsbTransport:
+    """A board in config mode, over pyusb."""
+
+    def __init__(self):
+        import usb.core
+        import usb.util
+
+        self.dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+        if self.dev is None:
+            raise IOError("Device not found, is it in config mode?")
+
+        usb.util.claim_interface(self.dev, BULK_IFACE)
+
+    def transfer(self, request):
+        self.dev.write(BULK_EP_OUT, request)
+        return bytes(self.dev.read(BULK_EP_IN, BULK_BUFFER_SIZE))
+
+    def close(self):
+        import usb.util
+        usb.util.release_interface(self.dev, BULK_IFACE)
+
+
+class PipeTransport:
+    """The mocked device from the host tests (test/mock_device.c), transfers are length prefixed."""
+
+    def __init__(self, command):
+        self.process = subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+    def transfer(self, request):
+        self.process.stdin.write(struct.pack("<H", len(request)) + request)
+        self.process.stdin.flush()
+
+        length, = struct.unpack("<H", self.process.stdout.read(2))
+        return self.process.stdout.read(length)
+
+    def close(self):
+        self.process.stdin.close()
+        self.process.wait()
+
+
+class Field:
+    def __init__(self, idx, readonly, type_name, length, member):
+        self.idx, self.readonly, self.type, self.len, self.member = idx, readonly, type_name, length, member
+
+    def decode(self, value):
+        fmt = FORMATS.get(self.type)
+        if fmt is None or struct.calcsize(fmt) != len(value):
+            return value
+        return struct.unpack("<" + fmt, value)[0]
+
+    def encode(self, value):
+        fmt = FORMATS.get(self.type)
+        if fmt is None or struct.calcsize(fmt) != self.len:
+            return bytes(value)
+        return struct.pack("<" + fmt, value)
+
+
+def load_fields(path):
+    """Field list from the generated api_fields.h, {index: Field}."""
+    entry = re.compile(r"X\((\d+),\s*(true|false),\s*(\w+),\s*(\d+),\s*([^)]+)\)")
+
+    with open(path) as f:
+        return {int(m[1]): Field(int(m[1]), m[2] == "true", m[3], int(m[4]), m[5].strip())
+                for m in entry.finditer(f.read())}
+
+
+class BulkClient:
+    def __init__(self, transport):
+        self.transport = transport
+        self.transfers = 0  # Round trips so far
+        self.bytes = 0      # Bytes sent and received so far
+
+    def request(self, cmd, payload=b"", version=0, offset=0, arg=0):
+        """One round trip, returns the reply's version, offset and payload. Raises BulkError unless the status is OK."""
+        request = BULK_HEADER.pack(START, cmd, 0, len(payload), version, offset, arg) + payload
+        reply = self.transport.transfer(request)
+
+        self.transfers += 1
+        self.bytes += len(request) + len(reply)
+
+        if len(reply) < BULK_HEADER.size or reply[:2] != START:
+            raise IOError("No valid reply")
+
+        _, _, status, length, version, offset, _ = BULK_HEADER.unpack_from(reply)
+        if status != 0:
+            raise BulkError(status)
+
+        return version, offset, reply[BULK_HEADER.size:BULK_HEADER.size + length]
+
+    def get(self, fields=None, since=0):
+        """Read the listed field indexes (all of them if none), page by page. Only fields changed after
+           version `since` come back. Returns the version to pass next time and {index: raw value}."""
+        payload, values, offset, first_version = bytes(fields or []), {}, 0, None
+
+        while True:
+            version, offset, data = self.request(BULK_GET_CMD, payload, since, offset)
+
+            pos = 0
+            while pos + 2 <= len(data):
+                idx, length = data[pos], data[pos + 1]
+                values[idx] = data[pos + 2:pos + 2 + length]
+                pos += 2 + length
+
+            # Fields changing while the later pages are read come again next time
+            if first_version is None:
+                first_version = version
+
+            if not offset:
+                return first_version, values
+
+    def write(self, values, save=False):
+        """Set fields from {index: raw value}, all at once. Nothing changes if any of them is rejected."""
+        payload = b"".join(bytes([idx, len(value)]) + value for idx, value in values.items())
+        self.request(BULK_WRITE_SAVE_CMD if save else BULK_WRITE_CMD, payload)
+
+    def type_text(self, text, output):
+        """Queue UTF-8 text to be typed on the output (>= number of screens types on the active one)."""
+        self.request(BULK_TYPE_TEXT_CMD, text.encode(), arg=output)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Read and write DeskHop settings over the bulk config API")
+    parser.add_argument("--mock", help="talk to this mocked device binary instead of a board")
+    parser.add_argument("--fields", help="api_fields.h, to name and decode the fields")
+    parser.add_argument("--set", action="append", default=[], metavar="INDEX=VALUE", help="set a field")
+    parser.add_argument("--save", action="store_true", help="save the config to flash after setting")
+    args = parser.parse_args()
+
+    fields = load_fields(args.fields) if args.fields else {}
+    client = BulkClient(PipeTransport([args.mock]) if args.mock else UsbTransport())
+
+    try:
+        if args.set:
+            values = {}
+            for item in args.set:
+                idx, value = (int(part, 0) for part in item.split("="))
+                values[idx] = fields[idx].encode(value) if idx in fields else value.to_bytes(4, "little")
+            client.write(values, args.save)
+
+        version, values = client.get()
+    except (BulkError, IOError) as error:
+        sys.exit(f"Request failed: {error}")
+    finally:
+        client.transport.close()
+
+    for idx, value in sorted(values.items()):
+        field = fields.get(idx)
+        print(f"{idx:3} {field.member if field else '':40} {field.decode(value) if field else value.hex()}")
+
+    print(f"version {version}, {client.transfers} transfers, {client.bytes} bytes", file=sys.stderr)
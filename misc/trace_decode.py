@@ -0,0 +1,217 @@
+#!/usr/bin/python3
+
+# Turns DeskHop trace records (firmware built with -DDH_TRACE) into Chrome trace JSON,
+# open the result in chrome://tracing or https://ui.perfetto.dev
+#
+#   Read over the vendor interface (config mode, needs pyusb):
+#     trace_decode.py --usb --seconds 10 -o trace.json --elf build/deskhop.elf
+#
+#   Decode a CDC capture (debug builds), e.g. cat /dev/ttyACM0 > capture.bin:
+#     trace_decode.py --cdc capture.bin -o trace.json
+#
+#   Decode raw records, e.g. saved with --dump:
+#     trace_decode.py records.bin -o trace.json
+
+import argparse
+import json
+import struct
+import subprocess
+import sys
+import time
+
+START = b"\xaa\x55"
+RECORD = struct.Struct("<IBBHI")  # trace_record_t: time, core, event, arg0, arg1
+
+# Vendor interface, same as in the web config
+USB_VID, USB_PID = 0x2E8A, 0x107C
+BULK_IFACE, BULK_EP_OUT, BULK_EP_IN = 4, 0x07, 0x87
+BULK_BUFFER_SIZE = 512
+BULK_HEADER = struct.Struct("<2sBBHIHI")
+BULK_TRACE_READ_CMD = 8
+
+# enum trace_event_e
+EVENTS = {
+    0: "Dropped",
+    1: "Task",
+    2: "Host Mount",
+    3: "Host Unmount",
+    4: "Host Report",
+    5: "KBD Queued",
+    6: "KBD Sent",
+    7: "Mouse Queued",
+    8: "Mouse Sent",
+    9: "UART Queued",
+    10: "UART TX",
+    11: "UART RX",
+}
+
+TRACE_DROPPED, TRACE_TASK = 0, 1
+
+# Events carrying a queue level, shown as counter tracks (event: (queue name, argument holding the level))
+QUEUE_LEVELS = {5: ("kbd_queue", 0), 6: ("kbd_queue", 0), 7: ("mouse_queue", 0), 8: ("mouse_queue", 0),
+                9: ("uart_tx_queue", 1), 10: ("uart_tx_queue", 1)}
+
+# enum packet_type_e, for UART events
+PACKET_TYPES = {
+    1: "KEYBOARD_REPORT", 2: "MOUSE_REPORT", 3: "OUTPUT_SELECT", 4: "FIRMWARE_UPGRADE", 5: "MOUSE_ZOOM",
+    6: "KBD_SET_REPORT", 7: "SWITCH_LOCK", 8: "SYNC_BORDERS", 9: "FLASH_LED", 10: "WIPE_CONFIG",
+    11: "SCREENSAVER", 12: "HEARTBEAT", 13: "GAMING_MODE", 14: "CONSUMER_CONTROL", 15: "SYSTEM_CONTROL",
+    18: "SAVE_CONFIG", 19: "REBOOT", 20: "GET_VAL", 21: "SET_VAL", 22: "GET_ALL_VALS", 23: "PROXY_PACKET",
+    24: "REQUEST_BYTE", 25: "RESPONSE_BYTE", 26: "LINK",
+}
+
+
+def checksum(data):
+    result = 0
+    for byte in data:
+        result ^= byte
+    return result
+
+
+def parse_raw(data):
+    usable = len(data) - len(data) % RECORD.size
+    return [RECORD.unpack_from(data, pos) for pos in range(0, usable, RECORD.size)]
+
+
+def parse_cdc(data):
+    """Records are framed with a preamble and checksum, anything else (debug text) is skipped."""
+    records, pos, frame = [], 0, len(START) + RECORD.size + 1
+
+    while (pos := data.find(START, pos)) >= 0 and pos + frame <= len(data):
+        payload = data[pos + len(START):pos + frame - 1]
+
+        if checksum(payload) == data[pos + frame - 1]:
+            records.append(RECORD.unpack(payload))
+            pos += frame
+        else:
+            pos += 1
+
+    return records
+
+
+def read_usb(seconds, interval):
+    import usb.core
+    import usb.util
+
+    dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+    if dev is None:
+        sys.exit("Device not found, is it in config mode?")
+
+    usb.util.claim_interface(dev, BULK_IFACE)
+    request = BULK_HEADER.pack(START, BULK_TRACE_READ_CMD, 0, 0, 0, 0, 0)
+    data, end = bytearray(), time.monotonic() + seconds
+
+    while time.monotonic() < end:
+        dev.write(BULK_EP_OUT, request)
+        reply = bytes(dev.read(BULK_EP_IN, BULK_BUFFER_SIZE))
+        _, _, status, length, _, _, _ = BULK_HEADER.unpack_from(reply)
+
+        if status != 0:
+            sys.exit(f"Trace read failed, status {status}")
+
+        data += reply[BULK_HEADER.size:BULK_HEADER.size + length]
+
+        # Ring is empty, give it some time to fill up
+        if length < BULK_BUFFER_SIZE // 2:
+            time.sleep(interval)
+
+    usb.util.release_interface(dev, BULK_IFACE)
+    return bytes(data)
+
+
+def load_symbols(elf, nm):
+    """Task events carry the function address, map them back to names."""
+    output = subprocess.run([nm, elf], capture_output=True, text=True, check=True).stdout
+    symbols = {}
+
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1] in "tT":
+            symbols[int(parts[0], 16) & ~1] = parts[2]
+
+    return symbols
+
+
+def unwrap(records):
+    """time_us_32() wraps every ~71 minutes, make time stamps monotonic for each core."""
+    last, offset, result = {}, {}, []
+
+    for time_us, core, event, arg0, arg1 in records:
+        if core in last and time_us < last[core] and last[core] - time_us > 1 << 31:
+            offset[core] = offset.get(core, 0) + (1 << 32)
+
+        last[core] = time_us
+        result.append((time_us + offset.get(core, 0), core, event, arg0, arg1))
+
+    return result
+
+
+def to_chrome(records, symbols):
+    events = [{"name": "thread_name", "ph": "M", "pid": 0, "tid": core, "args": {"name": f"core{core}"}}
+              for core in sorted({r[1] for r in records})]
+
+    for time_us, core, event, arg0, arg1 in unwrap(records):
+        name = EVENTS.get(event, f"Event {event}")
+        base = {"pid": 0, "tid": core}
+
+        if event == TRACE_TASK:
+            task = symbols.get(arg1 & ~1, f"0x{arg1:08x}")
+            events.append(base | {"name": task, "ph": "X", "ts": time_us - arg0, "dur": arg0, "cat": "task"})
+            continue
+
+        args = {"arg0": arg0, "arg1": arg1}
+
+        if event == TRACE_DROPPED:
+            args = {"count": arg1}
+        elif event in (2, 3, 4):
+            args = {"dev_addr": arg0 >> 8, "instance": arg0 & 0xFF, ("length" if event == 4 else "protocol"): arg1}
+        elif event in (9, 10, 11):
+            args = {"type": PACKET_TYPES.get(arg0 & 0x1F, arg0 & 0x1F)}
+
+            # Packets for boards further along a chain carry the destination in the upper bits
+            if arg0 >> 5:
+                args["dst"] = "all" if arg0 >> 5 == 7 else chr(ord("A") + (arg0 >> 5) - 1)
+
+        events.append(base | {"name": name, "ph": "i", "s": "t", "ts": time_us, "args": args})
+
+        if event in QUEUE_LEVELS:
+            queue, arg = QUEUE_LEVELS[event]
+            events.append({"pid": 0, "name": queue, "ph": "C", "ts": time_us, "args": {"level": (arg0, arg1)[arg]}})
+
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Convert DeskHop trace records to Chrome trace JSON")
+    parser.add_argument("input", nargs="?", help="file with raw records, or a CDC capture with --cdc")
+    parser.add_argument("--cdc", action="store_true", help="input is a CDC capture")
+    parser.add_argument("--usb", action="store_true", help="read from the device over the vendor interface")
+    parser.add_argument("--seconds", type=float, default=5, help="how long to read over USB")
+    parser.add_argument("--interval", type=float, default=0.01, help="USB poll interval when idle (s)")
+    parser.add_argument("--dump", help="also save the raw records read over USB")
+    parser.add_argument("--elf", help="firmware ELF, to name tasks")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm used to read the ELF symbols")
+    parser.add_argument("-o", "--output", default="-", help="output JSON file")
+    args = parser.parse_args()
+
+    if args.usb:
+        raw = read_usb(args.seconds, args.interval)
+        if args.dump:
+            with open(args.dump, "wb") as f:
+                f.write(raw)
+        records = parse_raw(raw)
+    elif args.input:
+        with open(args.input, "rb") as f:
+            data = f.read()
+        records = parse_cdc(data) if args.cdc else parse_raw(data)
+    else:
+        parser.error("either an input file or --usb is needed")
+
+    symbols = load_symbols(args.elf, args.nm) if args.elf else {}
+    trace = json.dumps(to_chrome(records, symbols))
+
+    if args.output == "-":
+        print(trace)
+    else:
+        with open(args.output, "w") as f:
+            f.write(trace)
@@ -73,6 +73,7 @@ target_sources(tinyusb_device_base INTERFACE
 		${TOP}/src/class/cdc/cdc_device.c
 		${TOP}/src/class/hid/hid_device.c
 		${TOP}/src/class/msc/msc_device.c
+		${TOP}/src/class/vendor/vendor_device.c
 		)
 
 #------------------------------------
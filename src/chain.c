@@ -0,0 +1,191 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+/* ==================================================== *
+ * Routing table
+ * ==================================================== */
+
+/* B sides have the chain port towards higher addresses, A sides towards lower ones */
+static uint8_t chain_route(uint8_t address, uint8_t board, bool next_port) {
+    bool up = board > address, next_leads_up = address & 1;
+
+    if (board == address)
+        return CHAIN_LOCAL;
+
+    if (board == (address ^ 1))
+        return CHAIN_PORT_PEER;
+
+    if (up != next_leads_up)
+        return CHAIN_PORT_PEER;
+
+    return next_port ? CHAIN_PORT_NEXT : CHAIN_LOCAL;
+}
+
+void chain_init(chain_t *chain, uint8_t address, uint8_t boards) {
+    chain->address   = address;
+    chain->boards    = boards;
+    chain->next_port = (address & 1) ? address + 1 < boards : address > 0;
+
+    for (uint8_t board = 0; board < boards; board++)
+        chain->route[board] = chain_route(address, board, chain->next_port);
+}
+
+/* Board on the other end of a port */
+uint8_t chain_neighbour(const chain_t *chain, uint8_t port) {
+    if (port == CHAIN_PORT_PEER)
+        return chain->address ^ 1;
+
+    return (chain->address & 1) ? chain->address + 1 : chain->address - 1;
+}
+
+/* Destination to put in the type byte when sending to 'dst' over 'port'. The board on the other end
+   gets packets without an address, just like a pair of boards always did. */
+uint8_t chain_dst_field(const chain_t *chain, uint8_t port, uint8_t dst) {
+    if (dst == CHAIN_ALL)
+        return chain->boards > 2 ? PACKET_DST_ALL : PACKET_DST_PEER;
+
+    if (dst == chain_neighbour(chain, port))
+        return PACKET_DST_PEER;
+
+    return dst + 1;
+}
+
+/* Port a received packet continues on, CHAIN_LOCAL if it stops here. Nothing goes back where it came from. */
+uint8_t chain_forward_port(const chain_t *chain, uint8_t dst, uint8_t from) {
+    uint8_t port;
+
+    if (dst == PACKET_DST_PEER)
+        return CHAIN_LOCAL;
+
+    if (dst == PACKET_DST_ALL)
+        port = (from == CHAIN_PORT_PEER) ? CHAIN_PORT_NEXT : CHAIN_PORT_PEER;
+    else if (dst - 1 < chain->boards)
+        port = chain->route[dst - 1];
+    else
+        return CHAIN_LOCAL;
+
+    if (port == from || (port == CHAIN_PORT_NEXT && !chain->next_port))
+        return CHAIN_LOCAL;
+
+    return port;
+}
+
+/* True if a packet with this destination is handled here */
+bool chain_is_local(const chain_t *chain, uint8_t dst) {
+    return dst == PACKET_DST_PEER || dst == PACKET_DST_ALL || dst - 1 == chain->address;
+}
+
+/* ==================================================== *
+ * Sending and passing on
+ * ==================================================== */
+
+static void chain_queue(uart_packet_t *packet, uint8_t port, device_t *state) {
+    if (port == CHAIN_PORT_PEER) {
+        queue_add_counted(&state->uart_tx_queue, packet, STATS_UART_QUEUE);
+        TRACE(TRACE_UART_QUEUED, packet->type, queue_get_level_unsafe(&state->uart_tx_queue));
+    } else
+        queue_try_add(&state->chain.tx_queue, packet);
+}
+
+/* Send to the board driving output 'dst', or to every other board with CHAIN_ALL */
+void chain_send(uart_packet_t *packet, uint8_t dst, device_t *state) {
+    chain_t *chain = &state->chain;
+    uint8_t type   = packet->type;
+
+    for (uint8_t port = 0; port < CHAIN_NUM_PORTS; port++) {
+        bool wanted = (dst == CHAIN_ALL) || (dst < chain->boards && chain->route[dst] == port);
+
+        if (!wanted || (port == CHAIN_PORT_NEXT && !chain->next_port))
+            continue;
+
+        packet->type = type | (chain_dst_field(chain, port, dst) << PACKET_DST_SHIFT);
+        chain_queue(packet, port, state);
+    }
+}
+
+/* True while packets for the board driving 'output' are still waiting for their port */
+bool chain_tx_pending(uint8_t output, device_t *state) {
+    chain_t *chain = &state->chain;
+
+    if (output < chain->boards && chain->route[output] == CHAIN_PORT_NEXT && chain->next_port)
+        return !queue_is_empty(&chain->tx_queue);
+
+    return !queue_is_empty(&state->uart_tx_queue);
+}
+
+/* Called for each valid packet received on 'port'. Packets for other boards are passed on untouched,
+   the ones for us get the address stripped. Returns true if the packet is to be handled here. */
+bool chain_accept(uart_packet_t *packet, uint8_t port, device_t *state) {
+    chain_t *chain = &state->chain;
+    uint8_t dst    = PACKET_DST(packet->type);
+    uint8_t next   = chain_forward_port(chain, dst, port);
+
+    if (next != CHAIN_LOCAL) {
+        chain_queue(packet, next, state);
+        chain->forwarded++;
+    }
+
+    if (!chain_is_local(chain, dst))
+        return false;
+
+    packet->type = PACKET_TYPE(packet->type);
+    return true;
+}
+
+/* ==================================================== *
+ * Chain port
+ * ==================================================== */
+
+/* Same framing as the peer port, packets found go through the same routing */
+void chain_receiver_task(device_t *state) {
+    chain_t *chain = &state->chain;
+
+    if (!chain->next_port)
+        return;
+
+    uint32_t current_pointer
+        = (uint32_t)DMA_RX_BUFFER_SIZE - dma_channel_hw_addr(chain->dma_rx_channel)->transfer_count;
+    uint32_t delta = get_ptr_delta(current_pointer, chain->dma_ptr);
+
+    while (delta >= RAW_PACKET_LENGTH) {
+        if (is_start_of_packet(chain_rxbuf, chain->dma_ptr)) {
+            fetch_packet(chain_rxbuf, &chain->dma_ptr, &chain->in_packet);
+
+            if (!verify_checksum(&chain->in_packet)) {
+                chain->checksum_errors++;
+                return;
+            }
+
+            chain->rx_packets++;
+            route_packet(&chain->in_packet, CHAIN_PORT_NEXT, state);
+            return;
+        }
+
+        chain->dma_ptr = NEXT_RING_IDX(chain->dma_ptr);
+        delta--;
+    }
+}
+
+void process_chain_tx_task(device_t *state) {
+    chain_t *chain       = &state->chain;
+    uart_packet_t packet = {0};
+
+    if (!chain->next_port || dma_channel_is_busy(chain->dma_tx_channel))
+        return;
+
+    if (!queue_try_remove(&chain->tx_queue, &packet))
+        return;
+
+    write_raw_packet(chain_txbuf, &packet);
+    dma_channel_transfer_from_buffer_now(chain->dma_tx_channel, chain_txbuf, RAW_PACKET_LENGTH);
+}
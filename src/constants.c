@@ -45,3 +45,112 @@ const uint32_t crc32_lookup_table[] = {
     0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
     0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
+
+/* Keystrokes of the ASCII characters on a US keyboard layout, the ones missing have no key */
+#define SHIFT KEYBOARD_MODIFIER_LEFTSHIFT
+
+const keystroke_t us_ascii_keystrokes[128] = {
+    ['\b'] = {HID_KEY_BACKSPACE},
+    ['\t'] = {HID_KEY_TAB},
+    ['\n'] = {HID_KEY_ENTER},
+    ['\r'] = {HID_KEY_ENTER},
+    [0x1B] = {HID_KEY_ESCAPE},
+    [' '] = {HID_KEY_SPACE},
+    ['!'] = {HID_KEY_1, SHIFT},
+    ['"'] = {HID_KEY_APOSTROPHE, SHIFT},
+    ['#'] = {HID_KEY_3, SHIFT},
+    ['$'] = {HID_KEY_4, SHIFT},
+    ['%'] = {HID_KEY_5, SHIFT},
+    ['&'] = {HID_KEY_7, SHIFT},
+    ['\''] = {HID_KEY_APOSTROPHE},
+    ['('] = {HID_KEY_9, SHIFT},
+    [')'] = {HID_KEY_0, SHIFT},
+    ['*'] = {HID_KEY_8, SHIFT},
+    ['+'] = {HID_KEY_EQUAL, SHIFT},
+    [','] = {HID_KEY_COMMA},
+    ['-'] = {HID_KEY_MINUS},
+    ['.'] = {HID_KEY_PERIOD},
+    ['/'] = {HID_KEY_SLASH},
+    ['0'] = {HID_KEY_0},
+    ['1'] = {HID_KEY_1},
+    ['2'] = {HID_KEY_2},
+    ['3'] = {HID_KEY_3},
+    ['4'] = {HID_KEY_4},
+    ['5'] = {HID_KEY_5},
+    ['6'] = {HID_KEY_6},
+    ['7'] = {HID_KEY_7},
+    ['8'] = {HID_KEY_8},
+    ['9'] = {HID_KEY_9},
+    [':'] = {HID_KEY_SEMICOLON, SHIFT},
+    [';'] = {HID_KEY_SEMICOLON},
+    ['<'] = {HID_KEY_COMMA, SHIFT},
+    ['='] = {HID_KEY_EQUAL},
+    ['>'] = {HID_KEY_PERIOD, SHIFT},
+    ['?'] = {HID_KEY_SLASH, SHIFT},
+    ['@'] = {HID_KEY_2, SHIFT},
+    ['A'] = {HID_KEY_A, SHIFT},
+    ['B'] = {HID_KEY_B, SHIFT},
+    ['C'] = {HID_KEY_C, SHIFT},
+    ['D'] = {HID_KEY_D, SHIFT},
+    ['E'] = {HID_KEY_E, SHIFT},
+    ['F'] = {HID_KEY_F, SHIFT},
+    ['G'] = {HID_KEY_G, SHIFT},
+    ['H'] = {HID_KEY_H, SHIFT},
+    ['I'] = {HID_KEY_I, SHIFT},
+    ['J'] = {HID_KEY_J, SHIFT},
+    ['K'] = {HID_KEY_K, SHIFT},
+    ['L'] = {HID_KEY_L, SHIFT},
+    ['M'] = {HID_KEY_M, SHIFT},
+    ['N'] = {HID_KEY_N, SHIFT},
+    ['O'] = {HID_KEY_O, SHIFT},
+    ['P'] = {HID_KEY_P, SHIFT},
+    ['Q'] = {HID_KEY_Q, SHIFT},
+    ['R'] = {HID_KEY_R, SHIFT},
+    ['S'] = {HID_KEY_S, SHIFT},
+    ['T'] = {HID_KEY_T, SHIFT},
+    ['U'] = {HID_KEY_U, SHIFT},
+    ['V'] = {HID_KEY_V, SHIFT},
+    ['W'] = {HID_KEY_W, SHIFT},
+    ['X'] = {HID_KEY_X, SHIFT},
+    ['Y'] = {HID_KEY_Y, SHIFT},
+    ['Z'] = {HID_KEY_Z, SHIFT},
+    ['['] = {HID_KEY_BRACKET_LEFT},
+    ['\\'] = {HID_KEY_BACKSLASH},
+    [']'] = {HID_KEY_BRACKET_RIGHT},
+    ['^'] = {HID_KEY_6, SHIFT},
+    ['_'] = {HID_KEY_MINUS, SHIFT},
+    ['`'] = {HID_KEY_GRAVE},
+    ['a'] = {HID_KEY_A},
+    ['b'] = {HID_KEY_B},
+    ['c'] = {HID_KEY_C},
+    ['d'] = {HID_KEY_D},
+    ['e'] = {HID_KEY_E},
+    ['f'] = {HID_KEY_F},
+    ['g'] = {HID_KEY_G},
+    ['h'] = {HID_KEY_H},
+    ['i'] = {HID_KEY_I},
+    ['j'] = {HID_KEY_J},
+    ['k'] = {HID_KEY_K},
+    ['l'] = {HID_KEY_L},
+    ['m'] = {HID_KEY_M},
+    ['n'] = {HID_KEY_N},
+    ['o'] = {HID_KEY_O},
+    ['p'] = {HID_KEY_P},
+    ['q'] = {HID_KEY_Q},
+    ['r'] = {HID_KEY_R},
+    ['s'] = {HID_KEY_S},
+    ['t'] = {HID_KEY_T},
+    ['u'] = {HID_KEY_U},
+    ['v'] = {HID_KEY_V},
+    ['w'] = {HID_KEY_W},
+    ['x'] = {HID_KEY_X},
+    ['y'] = {HID_KEY_Y},
+    ['z'] = {HID_KEY_Z},
+    ['{'] = {HID_KEY_BRACKET_LEFT, SHIFT},
+    ['|'] = {HID_KEY_BACKSLASH, SHIFT},
+    ['}'] = {HID_KEY_BRACKET_RIGHT, SHIFT},
+    ['~'] = {HID_KEY_GRAVE, SHIFT},
+    [0x7F] = {HID_KEY_DELETE},
+};
+
+#undef SHIFT
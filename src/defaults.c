@@ -27,6 +27,7 @@ const config_t default_config = {
             .screen_index = 1,
             .os = OUTPUT_A_OS,
             .pos = RIGHT,
+            .pointer_mode = ABSOLUTE,
             .screensaver = {
                 .mode = SCREENSAVER_A_MODE,
                 .only_if_inactive = SCREENSAVER_A_ONLY_IF_INACTIVE,
@@ -47,6 +48,7 @@ const config_t default_config = {
             .screen_index = 1,
             .os = OUTPUT_B_OS,
             .pos = LEFT,
+            .pointer_mode = ABSOLUTE,
             .screensaver = {
                 .mode = SCREENSAVER_B_MODE,
                 .only_if_inactive = SCREENSAVER_B_ONLY_IF_INACTIVE,
@@ -54,6 +56,51 @@ const config_t default_config = {
                 .max_time_us = (uint64_t)SCREENSAVER_B_MAX_TIME_SEC * 1000000,
             }
         },
+#ifdef DH_CHAIN
+    /* Outputs of the second DeskHop in a chain (C and D) are set up like B, to the right of A */
+    .output[2] =
+        {
+            .number = 2,
+            .speed_x = MOUSE_SPEED_B_FACTOR_X,
+            .speed_y = MOUSE_SPEED_B_FACTOR_Y,
+            .border = {
+                .top = 0,
+                .bottom = MAX_SCREEN_COORD,
+            },
+            .screen_count = 1,
+            .screen_index = 1,
+            .os = OUTPUT_B_OS,
+            .pos = RIGHT,
+            .pointer_mode = ABSOLUTE,
+            .screensaver = {
+                .mode = SCREENSAVER_B_MODE,
+                .only_if_inactive = SCREENSAVER_B_ONLY_IF_INACTIVE,
+                .idle_time_us = (uint64_t)SCREENSAVER_B_IDLE_TIME_SEC * 1000000,
+                .max_time_us = (uint64_t)SCREENSAVER_B_MAX_TIME_SEC * 1000000,
+            }
+        },
+    .output[3] =
+        {
+            .number = 3,
+            .speed_x = MOUSE_SPEED_B_FACTOR_X,
+            .speed_y = MOUSE_SPEED_B_FACTOR_Y,
+            .border = {
+                .top = 0,
+                .bottom = MAX_SCREEN_COORD,
+            },
+            .screen_count = 1,
+            .screen_index = 1,
+            .os = OUTPUT_B_OS,
+            .pos = RIGHT,
+            .pointer_mode = ABSOLUTE,
+            .screensaver = {
+                .mode = SCREENSAVER_B_MODE,
+                .only_if_inactive = SCREENSAVER_B_ONLY_IF_INACTIVE,
+                .idle_time_us = (uint64_t)SCREENSAVER_B_IDLE_TIME_SEC * 1000000,
+                .max_time_us = (uint64_t)SCREENSAVER_B_MAX_TIME_SEC * 1000000,
+            }
+        },
+#endif
     .enforce_ports = ENFORCE_PORTS,
     .force_kbd_boot_protocol = ENFORCE_KEYBOARD_BOOT_PROTOCOL,
     .force_mouse_boot_mode = false,
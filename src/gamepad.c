@@ -0,0 +1,235 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+/* ==================================================== *
+ * Decoding
+ * ==================================================== */
+
+/* Bits of a field, false if the report is too short to have it */
+static bool read_field(const uint8_t *data, int len, const gamepad_field_t *field, int32_t *value) {
+    int first = field->offset >> 3, last = (field->offset + field->size - 1) >> 3;
+    uint64_t bits = 0;
+
+    if (last >= len)
+        return false;
+
+    for (int i = last; i >= first; i--)
+        bits = bits << 8 | data[i];
+
+    bits = (bits >> (field->offset & 7)) & ((1ull << field->size) - 1);
+
+    if (field->is_signed && (bits >> (field->size - 1)) & 1)
+        bits |= ~0ull << field->size;
+
+    *value = (int32_t)bits;
+    return true;
+}
+
+/* Apply a report (without the report ID) to the gamepad's state. Returns true if the state changed. */
+bool gamepad_decode(gamepad_t *gamepad, const uint8_t *report, int len, uint8_t report_id) {
+    hid_gamepad_report_t *out = &gamepad->state;
+    hid_gamepad_report_t before = *out;
+    int8_t *axes = (int8_t *)out;
+
+    for (const gamepad_field_t *field = gamepad->fields; field != &gamepad->fields[gamepad->num_fields]; field++) {
+        int32_t value;
+
+        if (field->report_id != report_id || !read_field(report, len, field, &value))
+            continue;
+
+        switch (field->target) {
+            case GAMEPAD_BUTTONS: {
+                uint32_t mask = (field->size == 32 ? 0xFFFFFFFF : (1u << field->size) - 1) << field->shift;
+                out->buttons  = (out->buttons & ~mask) | (((uint32_t)value << field->shift) & mask);
+                break;
+            }
+
+            /* Anything outside the range is the hat's null state, it's not pressed */
+            case GAMEPAD_HAT: {
+                int32_t position = (value - field->min) * field->scale;
+                out->hat = (value >= field->min && position < 8) ? position + 1 : GAMEPAD_HAT_CENTERED;
+                break;
+            }
+
+            default: {
+                int32_t axis = (((int64_t)value - field->min) * field->scale >> 16) - 127;
+                axes[field->target] = MAX(-127, MIN(axis, 127));
+            }
+        }
+    }
+
+    return memcmp(&before, out, sizeof(before)) != 0;
+}
+
+/* ==================================================== *
+ * Link encoding
+ * ==================================================== */
+
+static inline uint8_t field_size(int field) {
+    return field == GAMEPAD_BUTTONS ? sizeof(uint32_t) : sizeof(uint8_t);
+}
+
+/* Put the fields that differ between 'from' and 'to' (all of them if 'full') in frames, returns how many */
+uint8_t gamepad_delta_encode(const hid_gamepad_report_t *from, const hid_gamepad_report_t *to, bool full,
+                             uint8_t frames[][PACKET_DATA_LENGTH]) {
+    const uint8_t *before = (const uint8_t *)from, *after = (const uint8_t *)to;
+    uint8_t count = 0, used = PACKET_DATA_LENGTH;
+
+    for (int i = 0; i < GAMEPAD_FIELDS; i++) {
+        uint8_t size = field_size(i);
+
+        if (!full && !memcmp(&before[i], &after[i], size))
+            continue;
+
+        if (used + size > PACKET_DATA_LENGTH) {
+            memset(frames[count++], 0, PACKET_DATA_LENGTH);
+            used = 1;
+        }
+
+        frames[count - 1][0] |= 1 << i;
+        memcpy(&frames[count - 1][used], &after[i], size);
+        used += size;
+    }
+
+    return count;
+}
+
+void gamepad_delta_apply(hid_gamepad_report_t *state, const uint8_t *frame) {
+    uint8_t *dst = (uint8_t *)state, used = 1;
+
+    for (int i = 0; i < GAMEPAD_FIELDS; i++) {
+        uint8_t size = field_size(i);
+
+        if (!(frame[0] & (1 << i)))
+            continue;
+
+        if (used + size > PACKET_DATA_LENGTH)
+            return;
+
+        memcpy(&dst[i], &frame[used], size);
+        used += size;
+    }
+}
+
+/* ==================================================== *
+ * Routing
+ * ==================================================== */
+
+/* Every board offers the gamepad to its host once one shows up anywhere */
+static void gamepad_present(device_t *state) {
+    if (state->gamepad.present)
+        return;
+
+    state->gamepad.present = true;
+
+    if (!state->gamepad_active)
+        state->descriptors_changed = true;
+}
+
+static void gamepad_to_host(const hid_gamepad_report_t *report, device_t *state) {
+    gamepad_link_t *link = &state->gamepad;
+
+    if (!state->gamepad_active || !state->tud_connected || !memcmp(report, &link->host, sizeof(*report)))
+        return;
+
+    link->host = *report;
+    queue_gamepad_packet((uint8_t *)report, state);
+}
+
+static void gamepad_send(const hid_gamepad_report_t *from, const hid_gamepad_report_t *to, bool full, uint8_t output) {
+    uint8_t frames[GAMEPAD_MAX_FRAMES][PACKET_DATA_LENGTH];
+    uint8_t count = gamepad_delta_encode(from, to, full, frames);
+
+    for (int i = 0; i < count; i++)
+        queue_packet_to(frames[i], GAMEPAD_MSG, PACKET_DATA_LENGTH, output);
+}
+
+/* State of our gamepad goes to the active output, locally or over the link */
+static void gamepad_route(const hid_gamepad_report_t *report, device_t *state) {
+    gamepad_link_t *link = &state->gamepad;
+    const hid_gamepad_report_t released = {0};
+
+    /* The output we leave shouldn't keep anything pressed */
+    if (state->active_output != link->output) {
+        if (link->output == BOARD_ROLE)
+            gamepad_to_host(&released, state);
+        else if (link->synced)
+            gamepad_send(&released, &released, true, link->output);
+
+        link->output  = state->active_output;
+        link->synced  = false;
+        link->pending = false;
+    }
+
+    if (link->output == BOARD_ROLE) {
+        gamepad_to_host(report, state);
+        return;
+    }
+
+    link->latest  = *report;
+    link->pending = true;
+    gamepad_link_task(state);
+}
+
+void process_gamepad_report(uint8_t *raw_report, int length, uint8_t itf, hid_interface_t *iface) {
+    uint8_t offset    = iface->uses_report_id ? 1 : 0;
+    uint8_t report_id = iface->uses_report_id ? raw_report[0] : 0;
+
+    if (length <= offset || !gamepad_decode(&iface->gamepad, &raw_report[offset], length - offset, report_id))
+        return;
+
+    gamepad_route(&iface->gamepad.state, &global_state);
+}
+
+/* Called after parsing the descriptor of a new interface, tells the others there's a gamepad */
+void gamepad_mount(hid_interface_t *iface, device_t *state) {
+    uint8_t announce[PACKET_DATA_LENGTH] = {0};
+
+    if (!iface->gamepad.is_found)
+        return;
+
+    gamepad_present(state);
+    queue_packet_to(announce, GAMEPAD_MSG, PACKET_DATA_LENGTH, CHAIN_ALL);
+}
+
+/* Called with the data of each GAMEPAD_MSG received. One without any fields just says a gamepad exists. */
+void gamepad_message(const uint8_t *frame, device_t *state) {
+    gamepad_link_t *link = &state->gamepad;
+
+    gamepad_present(state);
+
+    if (!frame[0])
+        return;
+
+    gamepad_delta_apply(&link->remote, frame);
+    gamepad_to_host(&link->remote, state);
+}
+
+/* Changes since the last frame go out as soon as the link has room, they add up while it doesn't */
+void gamepad_link_task(device_t *state) {
+    gamepad_link_t *link = &state->gamepad;
+    uint64_t now = time_us_64();
+
+    if (!link->pending || chain_tx_pending(link->output, state))
+        return;
+
+    bool full = !link->synced || now >= link->next_keyframe;
+    gamepad_send(&link->sent, &link->latest, full, link->output);
+
+    if (full)
+        link->next_keyframe = now + GAMEPAD_KEYFRAME_US;
+
+    link->sent    = link->latest;
+    link->synced  = true;
+    link->pending = false;
+}
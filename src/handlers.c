@@ -21,8 +21,7 @@ void output_toggle_hotkey_handler(device_t *state, hid_keyboard_report_t *report
     if (state->switch_lock)
         return;
 
-    state->active_output ^= 1;
-    set_active_output(state, state->active_output);
+    set_active_output(state, (state->active_output + 1) % NUM_SCREENS);
 };
 
 void _get_border_position(device_t *state, border_size_t *border) {
@@ -37,7 +36,7 @@ void _screensaver_set(device_t *state, uint8_t value) {
     if (CURRENT_BOARD_IS_ACTIVE_OUTPUT)
         state->config.output[BOARD_ROLE].screensaver.mode = value;
     else
-        send_value(value, SCREENSAVER_MSG);
+        send_value_to(value, SCREENSAVER_MSG, state->active_output);
 };
 
 /* This key combo records switch y top coordinate for different-size monitors  */
@@ -45,10 +44,11 @@ void screen_border_hotkey_handler(device_t *state, hid_keyboard_report_t *report
     border_size_t *border = &state->config.output[state->active_output].border;
     if (CURRENT_BOARD_IS_ACTIVE_OUTPUT) {
         _get_border_position(state, border);
+        build_screen_layout(state);
         save_config(state);
     }
 
-    queue_packet((uint8_t *)border, SYNC_BORDERS_MSG, sizeof(border_size_t));
+    queue_packet_to((uint8_t *)border, SYNC_BORDERS_MSG, sizeof(border_size_t), CHAIN_ALL);
 };
 
 /* This key combo puts board A in firmware upgrade mode */
@@ -64,13 +64,13 @@ void fw_upgrade_hotkey_handler_B(device_t *state, hid_keyboard_report_t *report)
 /* This key combo prevents mouse from switching outputs */
 void switchlock_hotkey_handler(device_t *state, hid_keyboard_report_t *report) {
     state->switch_lock ^= 1;
-    send_value(state->switch_lock, SWITCH_LOCK_MSG);
+    send_value_to(state->switch_lock, SWITCH_LOCK_MSG, CHAIN_ALL);
 }
 
 /* This key combo toggles gaming mode */
 void toggle_gaming_mode_handler(device_t *state, hid_keyboard_report_t *report) {
     state->gaming_mode ^= 1;
-    send_value(state->gaming_mode, GAMING_MODE_MSG);
+    send_value_to(state->gaming_mode, GAMING_MODE_MSG, CHAIN_ALL);
 };
 
 /* This key combo locks both outputs simultaneously */
@@ -96,8 +96,8 @@ void screenlock_hotkey_handler(device_t *state, hid_keyboard_report_t *report) {
             queue_kbd_report(&lock_report, state);
             release_all_keys(state);
         } else {
-            queue_packet((uint8_t *)&lock_report, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH);
-            queue_packet((uint8_t *)&release_keys, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH);
+            queue_packet_to((uint8_t *)&lock_report, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH, out);
+            queue_packet_to((uint8_t *)&release_keys, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH, out);
         }
     }
 }
@@ -106,13 +106,13 @@ void screenlock_hotkey_handler(device_t *state, hid_keyboard_report_t *report) {
 void wipe_config_hotkey_handler(device_t *state, hid_keyboard_report_t *report) {
     wipe_config();
     load_config(state);
-    send_value(ENABLE, WIPE_CONFIG_MSG);
+    send_value_to(ENABLE, WIPE_CONFIG_MSG, CHAIN_ALL);
 }
 
 /* When pressed, toggles the current mouse zoom mode state */
 void mouse_zoom_hotkey_handler(device_t *state, hid_keyboard_report_t *report) {
     state->mouse_zoom ^= 1;
-    send_value(state->mouse_zoom, MOUSE_ZOOM_MSG);
+    send_value_to(state->mouse_zoom, MOUSE_ZOOM_MSG, CHAIN_ALL);
 };
 
 /* When pressed, enables the pong screensaver on active output */
@@ -164,6 +164,9 @@ void handle_keyboard_uart_msg(uart_packet_t *packet, device_t *state) {
     hid_keyboard_report_t *report = (hid_keyboard_report_t *)packet->data;
     hid_keyboard_report_t combined_report;
 
+    /* Reserved byte carries the time stamp when the other board received it */
+    latency_remote_received(report->reserved, state);
+
     /* Update the keyboard state for the remote device  */
     update_remote_kbd_state(state, report);
 
@@ -175,9 +178,7 @@ void handle_keyboard_uart_msg(uart_packet_t *packet, device_t *state) {
     state->last_activity[BOARD_ROLE] = time_us_64();
 }
 
-/* Function handles received mouse moves from the other board */
-void handle_mouse_abs_uart_msg(uart_packet_t *packet, device_t *state) {
-    mouse_report_t *mouse_report = (mouse_report_t *)packet->data;
+static void remote_mouse_report(mouse_report_t *mouse_report, device_t *state) {
     queue_mouse_report(mouse_report, state);
 
     state->pointer_x       = mouse_report->x;
@@ -187,8 +188,26 @@ void handle_mouse_abs_uart_msg(uart_packet_t *packet, device_t *state) {
     state->last_activity[BOARD_ROLE] = time_us_64();
 }
 
+/* Function handles received mouse moves from the other board */
+void handle_mouse_abs_uart_msg(uart_packet_t *packet, device_t *state) {
+    remote_mouse_report((mouse_report_t *)packet->data, state);
+}
+
+/* Compact mouse moves, relative to the last position the other board sent */
+void handle_mouse_delta_uart_msg(uart_packet_t *packet, device_t *state) {
+    mouse_report_t reports[MOUSE_DELTA_EVENTS];
+    uint8_t count = mouse_delta_decode(packet->data, state->pointer_x, state->pointer_y, reports);
+
+    for (int i = 0; i < count; i++)
+        remote_mouse_report(&reports[i], state);
+}
+
 /* Function handles request to switch output  */
 void handle_output_select_msg(uart_packet_t *packet, device_t *state) {
+    /* Boards built for fewer outputs can't follow, better to stay where we are */
+    if (packet->data[0] >= NUM_SCREENS)
+        return;
+
     state->active_output = packet->data[0];
     if (state->tud_connected)
         release_all_keys(state);
@@ -208,8 +227,13 @@ void handle_mouse_zoom_msg(uart_packet_t *packet, device_t *state) {
 
 /* Process request to update keyboard LEDs */
 void handle_set_report_msg(uart_packet_t *packet, device_t *state) {
-    /* We got this via serial, so it's stored to the opposite of our board role */
-    state->keyboard_leds_desired[OTHER_ROLE] = packet->data[0];
+    /* Sender's output comes along. Older firmware leaves it at 0, then it's the other side of the isolator. */
+    uint8_t output = packet->data[1];
+
+    if (output >= NUM_SCREENS || output == BOARD_ROLE)
+        output = OTHER_ROLE;
+
+    state->keyboard_leds_desired[output] = packet->data[0];
 
     /* If we have a keyboard we can control leds on, restore state if active */
     if (global_state.keyboard_connected && !CURRENT_BOARD_IS_ACTIVE_OUTPUT)
@@ -227,10 +251,11 @@ void handle_sync_borders_msg(uart_packet_t *packet, device_t *state) {
 
     if (CURRENT_BOARD_IS_ACTIVE_OUTPUT) {
         _get_border_position(state, border);
-        queue_packet((uint8_t *)border, SYNC_BORDERS_MSG, sizeof(border_size_t));
+        queue_packet_to((uint8_t *)border, SYNC_BORDERS_MSG, sizeof(border_size_t), CHAIN_ALL);
     } else
         memcpy(border, packet->data, sizeof(border_size_t));
 
+    build_screen_layout(state);
     save_config(state);
 }
 
@@ -255,6 +280,16 @@ void handle_consumer_control_msg(uart_packet_t *packet, device_t *state) {
     queue_cc_packet(packet->data, state);
 }
 
+/* Frame of a report or descriptor from a device we pass through */
+void handle_passthrough_msg(uart_packet_t *packet, device_t *state) {
+    passthrough_message(packet->data, state);
+}
+
+/* Changed fields of the gamepad on another board */
+void handle_gamepad_msg(uart_packet_t *packet, device_t *state) {
+    gamepad_message(packet->data, state);
+}
+
 /* Process request to store config to flash */
 void handle_save_config_msg(uart_packet_t *packet, device_t *state) {
     save_config(state);
@@ -287,16 +322,21 @@ void handle_api_msgs(uart_packet_t *packet, device_t *state) {
     /* Create a pointer to the offset into the structure we need to access */
     uint8_t *ptr = (((uint8_t *)&global_state) + map->offset);
 
+    /* Payload is only 7 bytes after the index, wider fields are clamped (bulk API has no such limit) */
+    uint32_t len = MIN(map->len, PACKET_DATA_LENGTH - 1);
+
     if (packet->type == SET_VAL_MSG) {
         /* Not allowing writes to objects defined as read-only */
         if (map->readonly)
             return;
 
-        memcpy(ptr, &packet->data[1], map->len);
+        memcpy(ptr, &packet->data[1], len);
+        build_keyboard_tables(state);
+        build_screen_layout(state);
     }
     else if (packet->type == GET_VAL_MSG) {
         uart_packet_t response = {.type=GET_VAL_MSG, .data={[0] = value_idx}};
-        memcpy(&response.data[1], ptr, map->len);
+        memcpy(&response.data[1], ptr, len);
         queue_cfg_packet(&response, state);
     }
 
@@ -304,16 +344,158 @@ void handle_api_msgs(uart_packet_t *packet, device_t *state) {
     reset_config_timer(state);
 }
 
-/* Handle the "read all" message by calling our "read one" handler for each type */
+/* Handle the "read all" message. There are more fields than the outgoing queue holds, so they are
+   sent bit by bit from process_hid_queue_task, see send_read_all_fields. */
 void handle_api_read_all_msg(uart_packet_t *packet, device_t *state) {
+    state->read_all_left = get_field_map_length();
+}
+
+/* Call our "read one" handler for the fields a "read all" still has to send, as long as at least
+   half of hid_queue_out stays free for other reports. */
+void send_read_all_fields(device_t *state) {
     uart_packet_t result = {.type=GET_VAL_MSG};
 
-    for (int i = 0; i < get_field_map_length(); i++) {
-        result.data[0] = get_field_map_index(i)->idx;
+    while (state->read_all_left && queue_get_level(&state->hid_queue_out) < HID_QUEUE_LENGTH / 2) {
+        result.data[0] = get_field_map_index(get_field_map_length() - state->read_all_left--)->idx;
         handle_api_msgs(&result, state);
     }
 }
 
+/* Walk the bulk write records, checking each one. Only once all of them pass is apply set,
+   so a bad record anywhere in the request leaves the config untouched. */
+static uint8_t process_bulk_records(const uint8_t *records, uint16_t length, device_t *state, bool apply) {
+    for (uint16_t pos = 0; pos < length;) {
+        if (pos + 2 > length)
+            return BULK_ERR_LENGTH;
+
+        const field_map_t *map = get_field_map_entry(records[pos++]);
+        uint8_t value_len      = records[pos++];
+
+        if (map == NULL)
+            return BULK_ERR_FIELD;
+
+        if (map->readonly)
+            return BULK_ERR_READONLY;
+
+        if (value_len != map->len || pos + value_len > length)
+            return BULK_ERR_LENGTH;
+
+        if (apply)
+            memcpy(((uint8_t *)state) + map->offset, &records[pos], map->len);
+
+        pos += map->len;
+    }
+
+    return BULK_OK;
+}
+
+/* Process a complete bulk API request, fill the reply and return its total length */
+uint16_t handle_bulk_api_msg(const uint8_t *request, uint8_t *reply, device_t *state) {
+    const bulk_header_t *header = (const bulk_header_t *)request;
+    const uint8_t *records      = request + sizeof(bulk_header_t);
+    uint8_t *data               = reply + sizeof(bulk_header_t);
+    uint8_t status              = BULK_OK;
+    uint16_t length             = 0;
+    uint16_t next               = 0;
+    uint32_t since              = header->version;
+
+    switch (header->cmd) {
+        case BULK_GET_CMD: {
+            /* Requested fields are listed by index, an empty list means all of them */
+            uint32_t count = header->length ? header->length : get_field_map_length();
+
+            update_field_versions(state);
+
+            for (uint32_t i = header->offset; i < count; i++) {
+                const field_map_t *map = header->length ? get_field_map_entry(records[i]) : get_field_map_index(i);
+
+                if (map == NULL) {
+                    status = BULK_ERR_FIELD;
+                    break;
+                }
+
+                /* Client already has the current value */
+                if (since && get_field_version(map) <= since)
+                    continue;
+
+                /* Last byte of the buffer is kept free, the reply might need padding (see tud_vendor_rx_cb).
+                   Whatever doesn't fit goes in the next page. */
+                if (length + 2 + map->len > BULK_BUFFER_SIZE - sizeof(bulk_header_t) - 1) {
+                    next = i;
+                    break;
+                }
+
+                data[length++] = map->idx;
+                data[length++] = map->len;
+                memcpy(&data[length], ((uint8_t *)state) + map->offset, map->len);
+                length += map->len;
+            }
+            break;
+        }
+
+        case BULK_WRITE_CMD:
+        case BULK_WRITE_SAVE_CMD:
+            status = process_bulk_records(records, header->length, state, false);
+
+            if (status != BULK_OK)
+                break;
+
+            process_bulk_records(records, header->length, state, true);
+            build_keyboard_tables(state);
+            build_screen_layout(state);
+
+            if (header->cmd == BULK_WRITE_SAVE_CMD && !save_config(state))
+                status = BULK_ERR_FLASH;
+            break;
+
+        case BULK_MACRO_WRITE_CMD:
+            if (!write_macro_storage(header->arg, records, header->length))
+                status = BULK_ERR_LENGTH;
+            break;
+
+        case BULK_MACRO_READ_CMD:
+            /* Same as with GET, the last byte of the buffer is kept free */
+            length = read_macro_storage(header->arg, data, BULK_BUFFER_SIZE - sizeof(bulk_header_t) - 1);
+            break;
+
+        case BULK_MACRO_SAVE_CMD:
+            if (!save_macros())
+                status = BULK_ERR_FLASH;
+            break;
+
+        case BULK_TYPE_TEXT_CMD:
+            /* Text queue is full, the host should retry later */
+            if (!type_text(records, header->length, MIN(header->arg, NUM_SCREENS), state))
+                status = BULK_ERR_LENGTH;
+            break;
+
+        case BULK_TRACE_READ_CMD:
+#ifdef DH_TRACE
+            length = read_trace(data, BULK_BUFFER_SIZE - sizeof(bulk_header_t) - 1);
+#endif
+            break;
+
+        default:
+            status = BULK_ERR_COMMAND;
+    }
+
+    *(bulk_header_t *)reply = (bulk_header_t){
+        .start   = {START1, START2},
+        .cmd     = header->cmd,
+        .status  = status,
+        .length  = length,
+        .version = update_field_versions(state),
+        .offset  = next,
+    };
+
+    /* Same as with the HID API, requests keep the config mode alive. Polling for changes
+       doesn't count, otherwise an open web config page would never let the device leave. */
+    if (header->cmd != BULK_GET_CMD || !since)
+        reset_config_timer(state);
+
+    return sizeof(bulk_header_t) + length;
+}
+
 /* Process request packet and create a response */
 void handle_request_byte_msg(uart_packet_t *packet, device_t *state) {
     uint32_t address = packet->data32[0];
@@ -347,8 +529,7 @@ void handle_response_byte_msg(uart_packet_t *packet, device_t *state) {
 
     /* Update checksum as we receive each byte */
     if (address < STAGING_IMAGE_SIZE - FLASH_SECTOR_SIZE)
-        for (int i=0; i<4; i++)
-            state->fw.checksum = crc32_iter(state->fw.checksum, packet->data[4 + i]);
+        state->fw.checksum = crc32_update(state->fw.checksum, &packet->data[4], sizeof(uint32_t));
 
     memcpy(state->page_buffer + offset, &packet->data32[1], sizeof(uint32_t));
 
@@ -360,6 +541,8 @@ void handle_response_byte_msg(uart_packet_t *packet, device_t *state) {
 /* Process a request to read a firmware package from flash */
 void handle_heartbeat_msg(uart_packet_t *packet, device_t *state) {
     uint16_t other_running_version = packet->data16[0];
+    latency_sync_clock(packet->data16[1], state);
+    link_heartbeat(&state->link, packet->data16[3]);
 
     if (state->fw.upgrade_in_progress)
         return;
@@ -373,10 +556,14 @@ void handle_heartbeat_msg(uart_packet_t *packet, device_t *state) {
         .upgrade_in_progress = true,
         .byte_done = true,
         .address = 0,
-        .checksum = 0xffffffff,
+        .checksum = CRC32_INIT,
     };
 }
 
+/* Rate negotiation, handled by link_task on the other core */
+void handle_link_msg(uart_packet_t *packet, device_t *state) {
+    link_received(&state->link, (link_msg_t *)packet->data);
+}
 
 /* ==================================================== *
  * ==============  Output Switch Routines  ============ *
@@ -386,7 +573,7 @@ void handle_heartbeat_msg(uart_packet_t *packet, device_t *state) {
 void set_active_output(device_t *state, uint8_t new_output) {
     state->active_output = new_output;
     restore_leds(state);
-    send_value(new_output, OUTPUT_SELECT_MSG);
+    send_value_to(new_output, OUTPUT_SELECT_MSG, CHAIN_ALL);
 
     /* If we were holding a key down and drag the mouse to another screen, the key gets stuck.
        Changing outputs = no more keypresses on the previous system. */
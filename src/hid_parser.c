@@ -33,22 +33,26 @@ uint32_t get_descriptor_value(uint8_t const *report, int size) {
     }
 }
 
-uint32_t *get_or_create_report_offset(parser_state_t *parser, uint8_t report_id) {
-    for (int i = 0; i < parser->num_report_offsets; i++) {
-        if (parser->report_offsets[i].report_id == report_id) {
-            return &parser->report_offsets[i].offset_in_bits;
+static uint32_t *get_or_create_offset(report_offset_map_t *map, uint8_t *num_offsets, uint8_t report_id) {
+    for (int i = 0; i < *num_offsets; i++) {
+        if (map[i].report_id == report_id) {
+            return &map[i].offset_in_bits;
         }
     }
 
-    if (parser->num_report_offsets < MAX_REPORTS) {
-        parser->report_offsets[parser->num_report_offsets].report_id = report_id;
-        parser->report_offsets[parser->num_report_offsets].offset_in_bits = 0;
-        return &parser->report_offsets[parser->num_report_offsets++].offset_in_bits;
+    if (*num_offsets < MAX_REPORTS) {
+        map[*num_offsets].report_id = report_id;
+        map[*num_offsets].offset_in_bits = 0;
+        return &map[(*num_offsets)++].offset_in_bits;
     }
 
     return NULL;
 }
 
+uint32_t *get_or_create_report_offset(parser_state_t *parser, uint8_t report_id) {
+    return get_or_create_offset(parser->report_offsets, &parser->num_report_offsets, report_id);
+}
+
 uint32_t get_current_offset(parser_state_t *parser) {
     uint32_t *offset = get_or_create_report_offset(parser, parser->report_id);
     return offset ? *offset : 0;
@@ -60,8 +64,24 @@ void update_usage(parser_state_t *parser, int i) {
         *(parser->p_usage + i) = *(parser->p_usage + i - 1);
 }
 
+/* Logical limits can be negative, the descriptor has them in as few bytes as they fit */
+static int32_t signed_value(item_t *item) {
+    uint8_t bits = SIZE_LOOKUP[item->hdr.size] * 8;
+
+    if (bits && bits < 32 && (item->val & (1u << (bits - 1))))
+        return (int32_t)(item->val | (0xFFFFFFFFu << bits));
+
+    return item->val;
+}
+
 void store_element(parser_state_t *parser, report_val_t *val, int i, uint32_t data, uint16_t size, hid_interface_t *iface) {
     uint32_t current_offset = get_current_offset(parser);
+    int32_t logical_min = signed_value(&parser->globals[RI_GLOBAL_LOGICAL_MIN]);
+    int32_t logical_max = signed_value(&parser->globals[RI_GLOBAL_LOGICAL_MAX]);
+
+    /* Plenty of devices say 0..255 with a one byte maximum, which is really -1 */
+    if (logical_max < logical_min)
+        logical_max = parser->globals[RI_GLOBAL_LOGICAL_MAX].val;
 
     *val = (report_val_t){
         .offset     = current_offset,
@@ -77,7 +97,12 @@ void store_element(parser_state_t *parser, report_val_t *val, int i, uint32_t da
         .usage        = *(parser->p_usage + i),
         .usage_page   = parser->globals[RI_GLOBAL_USAGE_PAGE].val,
         .global_usage = parser->global_usage,
-        .report_id    = parser->report_id
+        .report_id    = parser->report_id,
+
+        .logical_min = logical_min,
+        .logical_max = logical_max,
+
+        .collection = parser->current_collection,
     };
 
     iface->uses_report_id |= (parser->report_id != 0);
@@ -105,6 +130,14 @@ void handle_local_item(parser_state_t *parser, item_t *item) {
     }
 }
 
+/* Advance the usage array pointer by global report count and reset the count variable */
+static void next_usages(parser_state_t *parser) {
+    parser->p_usage += parser->usage_count;
+
+    /* Carry the last usage to the new location */
+    *parser->p_usage = *(parser->p_usage - parser->usage_count);
+}
+
 void handle_main_input(parser_state_t *parser, item_t *item, hid_interface_t *iface) {
     uint32_t size  = parser->globals[RI_GLOBAL_REPORT_SIZE].val;
     uint32_t count = parser->globals[RI_GLOBAL_REPORT_COUNT].val;
@@ -134,26 +167,76 @@ void handle_main_input(parser_state_t *parser, item_t *item, hid_interface_t *if
         *current_offset += size;
     }
 
-    /* Advance the usage array pointer by global report count and reset the count variable */
-    parser->p_usage += parser->usage_count;
+    next_usages(parser);
+}
 
-    /* Carry the last usage to the new location */
-    *parser->p_usage = *(parser->p_usage - parser->usage_count);
+/* The only feature we look for is the mouse Resolution Multiplier, the rest just takes up space */
+void handle_main_feature(parser_state_t *parser, item_t *item, hid_interface_t *iface) {
+    uint32_t size  = parser->globals[RI_GLOBAL_REPORT_SIZE].val;
+    uint32_t count = parser->globals[RI_GLOBAL_REPORT_COUNT].val;
+    mouse_t *mouse = &iface->mouse;
+
+    uint32_t *current_offset
+        = get_or_create_offset(parser->feature_offsets, &parser->num_feature_offsets, parser->report_id);
+    if (!current_offset)
+        return;
+
+    for (int i = 0; i < count; i++) {
+        update_usage(parser, i);
+
+        bool is_multiplier = !(item->val & 0x01)
+                             && parser->global_usage == HID_USAGE_DESKTOP_MOUSE
+                             && parser->globals[RI_GLOBAL_USAGE_PAGE].val == HID_USAGE_PAGE_DESKTOP
+                             && *(parser->p_usage + i) == HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER;
+
+        /* Multipliers have to be in the same report and fit in the buffer we send it from */
+        if (is_multiplier && mouse->num_multipliers < MAX_MULTIPLIERS
+            && (!mouse->num_multipliers || mouse->feature_id == parser->report_id)
+            && *current_offset + size <= MAX_FEATURE_LENGTH * 8) {
+            int32_t logical_max  = parser->globals[RI_GLOBAL_LOGICAL_MAX].val;
+            int32_t physical_min = parser->globals[RI_GLOBAL_PHYSICAL_MIN].val;
+            int32_t physical_max = parser->globals[RI_GLOBAL_PHYSICAL_MAX].val;
+
+            mouse->multiplier[mouse->num_multipliers++] = (multiplier_t){
+                .val         = {.offset     = *current_offset,
+                                .offset_idx = *current_offset >> 3,
+                                .size       = size,
+                                .collection = parser->current_collection},
+                .logical_max = logical_max,
+                .resolution  = (physical_max > physical_min) ? physical_max : logical_max,
+            };
+            mouse->feature_id = parser->report_id;
+        }
+
+        *current_offset += size;
+
+        if (mouse->num_multipliers && mouse->feature_id == parser->report_id)
+            mouse->feature_len = MIN((*current_offset + 7) >> 3, MAX_FEATURE_LENGTH);
+    }
+
+    next_usages(parser);
 }
 
 void handle_main_item(parser_state_t *parser, item_t *item, hid_interface_t *iface) {
     switch (item->hdr.tag) {
         case RI_MAIN_COLLECTION:
             parser->collection.start++;
+            parser->collection_parent[parser->collection.start] = parser->current_collection;
+            parser->current_collection = parser->collection.start;
             break;
 
         case RI_MAIN_COLLECTION_END:
             parser->collection.end++;
+            parser->current_collection = parser->collection_parent[parser->current_collection];
             break;
 
         case RI_MAIN_INPUT:
             handle_main_input(parser, item, iface);
             break;
+
+        case RI_MAIN_FEATURE:
+            handle_main_feature(parser, item, iface);
+            break;
     }
 
     parser->usage_count = 0;
@@ -163,6 +246,28 @@ void handle_main_item(parser_state_t *parser, item_t *item, hid_interface_t *ifa
 }
 
 
+/* A control is in a collection if it's in there directly or in one of the collections inside */
+static bool in_collection(parser_state_t *parser, report_val_t *control, uint8_t collection) {
+    if (!control->size)
+        return false;
+
+    for (uint8_t c = control->collection; c; c = parser->collection_parent[c])
+        if (c == collection)
+            return true;
+
+    return false;
+}
+
+/* Each Resolution Multiplier applies to the wheel and pan in its collection, if they are in there */
+static void link_multipliers(parser_state_t *parser, mouse_t *mouse) {
+    for (int i = 0; i < mouse->num_multipliers; i++) {
+        multiplier_t *multiplier = &mouse->multiplier[i];
+
+        multiplier->wheel = in_collection(parser, &mouse->wheel, multiplier->val.collection);
+        multiplier->pan   = in_collection(parser, &mouse->pan, multiplier->val.collection);
+    }
+}
+
 /* This method is sub-optimal and far from a generalized HID descriptor parsing, but should
  * hopefully work well enough to find the basic values we care about to move the mouse around.
  * Your descriptor for a mouse with 2 wheels and 264 buttons might not parse correctly.
@@ -200,4 +305,6 @@ void parse_report_descriptor(hid_interface_t *iface,
         report += SIZE_LOOKUP[item.hdr.size];
         desc_len -= (SIZE_LOOKUP[item.hdr.size] + 1);
     }
+
+    link_multipliers(&parser_state, &iface->mouse);
 }
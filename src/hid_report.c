@@ -50,6 +50,21 @@ int32_t get_report_value(uint8_t *report, int len, report_val_t *val) {
     return result;
 }
 
+/* The opposite of get_report_value, put 'value' where 'val' says it goes in the report */
+void set_report_value(uint8_t *report, int len, report_val_t *val, int32_t value) {
+    for (int bit = 0; bit < val->size; bit++) {
+        int position = val->offset + bit;
+
+        if ((position >> 3) >= len)
+            return;
+
+        if (value & (1u << bit))
+            report[position >> 3] |= 1 << (position & 7);
+        else
+            report[position >> 3] &= ~(1 << (position & 7));
+    }
+}
+
 /* After processing the descriptor, assign the values so we can later use them to interpret reports */
 void handle_consumer_control_values(report_val_t *src, report_val_t *dst, hid_interface_t *iface) {
     keyboard_t *keyboard = get_keyboard(iface, src->report_id);
@@ -82,10 +97,19 @@ void handle_system_control_values(report_val_t *src, report_val_t *dst, hid_inte
     iface->system.is_array |= (src->data_type == ARRAY);
 }
 
+/* Keyboard found earlier with this report ID, or the next one if it's new. Unlike get_keyboard,
+   a second report ID on the interface doesn't end up in the first keyboard. */
+static keyboard_t *find_keyboard(hid_interface_t *iface, uint8_t report_id) {
+    for (int i = 0; i < iface->num_keyboards; i++)
+        if (iface->keyboards[i].report_id == report_id)
+            return &iface->keyboards[i];
+
+    return &iface->keyboards[iface->num_keyboards];
+}
+
 /* After processing the descriptor, assign the values so we can later use them to interpret reports */
 void handle_keyboard_descriptor_values(report_val_t *src, report_val_t *dst, hid_interface_t *iface) {
     const int LEFT_CTRL = 0xE0;
-    keyboard_t *keyboard = get_keyboard(iface, src->report_id);
 
     /* Constants are normally used for padding, so skip'em */
     if (src->item_type == CONSTANT)
@@ -95,6 +119,8 @@ void handle_keyboard_descriptor_values(report_val_t *src, report_val_t *dst, hid
     if (iface->num_keyboards >= MAX_KEYBOARDS)
         return;
 
+    keyboard_t *keyboard = find_keyboard(iface, src->report_id);
+
     /* Detect and handle modifier keys. <= if modifier is less + constant padding? */
     if (src->size <= MODIFIER_BIT_LENGTH && src->data_type == VARIABLE) {
         /* To make sure this really is the modifier key, we expect e.g. left control to be
@@ -134,6 +160,70 @@ void handle_buttons(report_val_t *src, report_val_t *dst, hid_interface_t *iface
     iface->mouse.is_found = true;
 }
 
+/* Axis a desktop usage goes to, -1 if it's none of ours */
+static int gamepad_axis(uint16_t usage) {
+    switch (usage) {
+        case HID_USAGE_DESKTOP_X:  return GAMEPAD_X;
+        case HID_USAGE_DESKTOP_Y:  return GAMEPAD_Y;
+        case HID_USAGE_DESKTOP_Z:  return GAMEPAD_Z;
+        case HID_USAGE_DESKTOP_RZ: return GAMEPAD_RZ;
+        case HID_USAGE_DESKTOP_RX: return GAMEPAD_RX;
+        case HID_USAGE_DESKTOP_RY: return GAMEPAD_RY;
+        default:                   return -1;
+    }
+}
+
+/* Work out once how each gamepad field is decoded, reports then just follow the plan */
+void handle_gamepad_values(report_val_t *src, report_val_t *dst, hid_interface_t *iface) {
+    gamepad_t *gamepad = &iface->gamepad;
+    int32_t range = src->logical_max - src->logical_min;
+
+    gamepad_field_t field = {
+        .offset    = src->offset,
+        .size      = src->size,
+        .report_id = src->report_id,
+        .is_signed = src->logical_min < 0,
+        .min       = src->logical_min,
+    };
+
+    if (src->item_type == CONSTANT || src->data_type != VARIABLE || !src->size || src->size > 32
+        || gamepad->num_fields >= MAX_GAMEPAD_FIELDS)
+        return;
+
+    if (src->usage_page == HID_USAGE_PAGE_BUTTON) {
+        /* A run of buttons comes in one piece with a usage range, a lone one with its own usage */
+        int first = (src->usage_min ? src->usage_min : src->usage) - 1;
+
+        if (first < 0 || first >= 32)
+            return;
+
+        field.target = GAMEPAD_BUTTONS;
+        field.shift  = first;
+        field.size   = MIN(src->size, 32 - first);
+    }
+    else if (src->usage == HID_USAGE_DESKTOP_HAT_SWITCH) {
+        /* Eight directions, or four that land on every other one */
+        if (range != 7 && range != 3)
+            return;
+
+        field.target = GAMEPAD_HAT;
+        field.scale  = 8 / (range + 1);
+    }
+    else {
+        int axis = gamepad_axis(src->usage);
+
+        if (axis < 0 || range <= 0)
+            return;
+
+        /* Rounded up so both ends of the range still make it to -127 and 127 */
+        field.target = axis;
+        field.scale  = (((int64_t)254 << 16) + range - 1) / range;
+    }
+
+    gamepad->fields[gamepad->num_fields++] = field;
+    gamepad->is_found = true;
+}
+
 void _store(report_val_t *src, report_val_t *dst, hid_interface_t *iface) {
     if (src->item_type != CONSTANT)
         *dst = *src;
@@ -151,6 +241,10 @@ static uint8_t *get_system_id(hid_interface_t *iface) {
     return &iface->system.report_id;
 }
 
+static uint8_t *get_gamepad_id(hid_interface_t *iface) {
+    return &iface->gamepad.report_id;
+}
+
 static uint8_t *get_next_keyboard_id(hid_interface_t *iface) {
     if (iface->num_keyboards < MAX_KEYBOARDS)
         return &iface->keyboards[iface->num_keyboards].report_id;
@@ -220,6 +314,30 @@ void extract_data(hid_interface_t *iface, report_val_t *val) {
          .receiver     = process_system_report,
          .dst          = &iface->system.val,
          .get_id       = get_system_id},
+
+        {.usage_page   = HID_USAGE_PAGE_DESKTOP,
+         .global_usage = HID_USAGE_DESKTOP_GAMEPAD,
+         .handler      = handle_gamepad_values,
+         .receiver     = process_gamepad_report,
+         .get_id       = get_gamepad_id},
+
+        {.usage_page   = HID_USAGE_PAGE_BUTTON,
+         .global_usage = HID_USAGE_DESKTOP_GAMEPAD,
+         .handler      = handle_gamepad_values,
+         .receiver     = process_gamepad_report,
+         .get_id       = get_gamepad_id},
+
+        {.usage_page   = HID_USAGE_PAGE_DESKTOP,
+         .global_usage = HID_USAGE_DESKTOP_JOYSTICK,
+         .handler      = handle_gamepad_values,
+         .receiver     = process_gamepad_report,
+         .get_id       = get_gamepad_id},
+
+        {.usage_page   = HID_USAGE_PAGE_BUTTON,
+         .global_usage = HID_USAGE_DESKTOP_JOYSTICK,
+         .handler      = handle_gamepad_values,
+         .receiver     = process_gamepad_report,
+         .get_id       = get_gamepad_id},
     };
 
     /* We extracted all we could find in the descriptor to report_values, now go through them and
@@ -0,0 +1,249 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+/* Generated by webconfig/render.py from webconfig/form.py, do not edit by hand. */
+
+#pragma once
+
+/*==============================================================================
+ *  API Fields
+ *  X(index, readonly, type, length, device_t member)
+ *==============================================================================*/
+
+#define API_FIELDS(X) \
+    X(0,  true,  UINT8,  1, active_output) \
+    X(1,  true,  INT16,  2, pointer_x) \
+    X(2,  true,  INT16,  2, pointer_y) \
+    X(3,  true,  INT16,  2, mouse_buttons) \
+    X(10, false, UINT32, 4, config.output[0].number) \
+    X(11, false, UINT32, 4, config.output[0].screen_count) \
+    X(12, false, INT32,  4, config.output[0].speed_x) \
+    X(13, false, INT32,  4, config.output[0].speed_y) \
+    X(14, false, INT32,  4, config.output[0].border.top) \
+    X(15, false, INT32,  4, config.output[0].border.bottom) \
+    X(16, false, UINT8,  1, config.output[0].os) \
+    X(17, false, UINT8,  1, config.output[0].pos) \
+    X(18, false, UINT8,  1, config.output[0].mouse_park_pos) \
+    X(19, false, UINT8,  1, config.output[0].screensaver.mode) \
+    X(20, false, UINT8,  1, config.output[0].screensaver.only_if_inactive) \
+    X(21, false, UINT64, 8, config.output[0].screensaver.idle_time_us) \
+    X(22, false, UINT64, 8, config.output[0].screensaver.max_time_us) \
+    X(23, false, INT16,  2, config.output[0].layout[0].x) \
+    X(24, false, INT16,  2, config.output[0].layout[0].y) \
+    X(25, false, INT16,  2, config.output[0].layout[0].w) \
+    X(26, false, INT16,  2, config.output[0].layout[0].h) \
+    X(27, false, INT16,  2, config.output[0].layout[1].x) \
+    X(28, false, INT16,  2, config.output[0].layout[1].y) \
+    X(29, false, INT16,  2, config.output[0].layout[1].w) \
+    X(30, false, INT16,  2, config.output[0].layout[1].h) \
+    X(31, false, INT16,  2, config.output[0].layout[2].x) \
+    X(32, false, INT16,  2, config.output[0].layout[2].y) \
+    X(33, false, INT16,  2, config.output[0].layout[2].w) \
+    X(34, false, INT16,  2, config.output[0].layout[2].h) \
+    X(35, false, UINT8,  1, config.output[0].pointer_mode) \
+    X(40, false, UINT32, 4, config.output[1].number) \
+    X(41, false, UINT32, 4, config.output[1].screen_count) \
+    X(42, false, INT32,  4, config.output[1].speed_x) \
+    X(43, false, INT32,  4, config.output[1].speed_y) \
+    X(44, false, INT32,  4, config.output[1].border.top) \
+    X(45, false, INT32,  4, config.output[1].border.bottom) \
+    X(46, false, UINT8,  1, config.output[1].os) \
+    X(47, false, UINT8,  1, config.output[1].pos) \
+    X(48, false, UINT8,  1, config.output[1].mouse_park_pos) \
+    X(49, false, UINT8,  1, config.output[1].screensaver.mode) \
+    X(50, false, UINT8,  1, config.output[1].screensaver.only_if_inactive) \
+    X(51, false, UINT64, 8, config.output[1].screensaver.idle_time_us) \
+    X(52, false, UINT64, 8, config.output[1].screensaver.max_time_us) \
+    X(53, false, INT16,  2, config.output[1].layout[0].x) \
+    X(54, false, INT16,  2, config.output[1].layout[0].y) \
+    X(55, false, INT16,  2, config.output[1].layout[0].w) \
+    X(56, false, INT16,  2, config.output[1].layout[0].h) \
+    X(57, false, INT16,  2, config.output[1].layout[1].x) \
+    X(58, false, INT16,  2, config.output[1].layout[1].y) \
+    X(59, false, INT16,  2, config.output[1].layout[1].w) \
+    X(60, false, INT16,  2, config.output[1].layout[1].h) \
+    X(61, false, INT16,  2, config.output[1].layout[2].x) \
+    X(62, false, INT16,  2, config.output[1].layout[2].y) \
+    X(63, false, INT16,  2, config.output[1].layout[2].w) \
+    X(64, false, INT16,  2, config.output[1].layout[2].h) \
+    X(65, false, UINT8,  1, config.output[1].pointer_mode) \
+    X(70, false, UINT32, 4, config.version) \
+    X(71, false, UINT8,  1, config.force_mouse_boot_mode) \
+    X(72, false, UINT8,  1, config.force_kbd_boot_protocol) \
+    X(73, false, UINT8,  1, config.kbd_led_as_indicator) \
+    X(74, false, UINT8,  1, config.hotkey_toggle) \
+    X(75, false, UINT8,  1, config.enable_acceleration) \
+    X(76, false, UINT8,  1, config.enforce_ports) \
+    X(77, false, UINT16, 2, config.jump_threshold) \
+    X(78, true,  UINT16, 2, _running_fw.version) \
+    X(79, true,  UINT32, 4, _running_fw.checksum) \
+    X(80, true,  UINT8,  1, keyboard_connected) \
+    X(81, true,  UINT8,  1, switch_lock) \
+    X(82, true,  UINT8,  1, relative_mouse) \
+    X(83, true,  UINT32, 4, stats.kbd_duplicates) \
+    X(84, true,  UINT32, 4, stats.kbd_coalesced) \
+    X(85, true,  UINT32, 4, stats.queue_drops[0]) \
+    X(86, true,  UINT32, 4, stats.queue_drops[1]) \
+    X(87, true,  UINT32, 4, stats.queue_drops[2]) \
+    X(88, true,  UINT32, 4, stats.queue_drops[3]) \
+    X(89, true,  UINT16, 2, stats.queue_peak_level[0]) \
+    X(90, true,  UINT16, 2, stats.queue_peak_level[1]) \
+    X(91, true,  UINT16, 2, stats.queue_peak_level[2]) \
+    X(92, true,  UINT16, 2, stats.queue_peak_level[3]) \
+    X(93, true,  UINT32, 4, stats.uart_checksum_errors) \
+    X(94, true,  UINT32, 4, stats.uart_skipped_bytes) \
+    X(95, true,  UINT32, 4, stats.uart_rx_rate) \
+    X(96, true,  UINT32, 4, stats.loop_rate[0]) \
+    X(97, true,  UINT32, 4, stats.loop_rate[1]) \
+    X(98, true,  UINT32, 4, stats.host_report_rate[0]) \
+    X(99, true,  UINT32, 4, stats.host_report_rate[1]) \
+    X(100, false, UINT8,  1, config.user_hotkeys[0].modifier) \
+    X(101, false, UINT8,  1, config.user_hotkeys[0].keys[0]) \
+    X(102, false, UINT8,  1, config.user_hotkeys[0].keys[1]) \
+    X(103, false, UINT8,  1, config.user_hotkeys[0].action) \
+    X(104, false, UINT8,  1, config.user_hotkeys[1].modifier) \
+    X(105, false, UINT8,  1, config.user_hotkeys[1].keys[0]) \
+    X(106, false, UINT8,  1, config.user_hotkeys[1].keys[1]) \
+    X(107, false, UINT8,  1, config.user_hotkeys[1].action) \
+    X(108, false, UINT8,  1, config.user_hotkeys[2].modifier) \
+    X(109, false, UINT8,  1, config.user_hotkeys[2].keys[0]) \
+    X(110, false, UINT8,  1, config.user_hotkeys[2].keys[1]) \
+    X(111, false, UINT8,  1, config.user_hotkeys[2].action) \
+    X(112, false, UINT8,  1, config.user_hotkeys[3].modifier) \
+    X(113, false, UINT8,  1, config.user_hotkeys[3].keys[0]) \
+    X(114, false, UINT8,  1, config.user_hotkeys[3].keys[1]) \
+    X(115, false, UINT8,  1, config.user_hotkeys[3].action) \
+    X(116, false, UINT8,  1, config.user_hotkeys[4].modifier) \
+    X(117, false, UINT8,  1, config.user_hotkeys[4].keys[0]) \
+    X(118, false, UINT8,  1, config.user_hotkeys[4].keys[1]) \
+    X(119, false, UINT8,  1, config.user_hotkeys[4].action) \
+    X(120, false, UINT8,  1, config.user_hotkeys[5].modifier) \
+    X(121, false, UINT8,  1, config.user_hotkeys[5].keys[0]) \
+    X(122, false, UINT8,  1, config.user_hotkeys[5].keys[1]) \
+    X(123, false, UINT8,  1, config.user_hotkeys[5].action) \
+    X(124, false, UINT8,  1, config.user_hotkeys[6].modifier) \
+    X(125, false, UINT8,  1, config.user_hotkeys[6].keys[0]) \
+    X(126, false, UINT8,  1, config.user_hotkeys[6].keys[1]) \
+    X(127, false, UINT8,  1, config.user_hotkeys[6].action) \
+    X(128, false, UINT8,  1, config.user_hotkeys[7].modifier) \
+    X(129, false, UINT8,  1, config.user_hotkeys[7].keys[0]) \
+    X(130, false, UINT8,  1, config.user_hotkeys[7].keys[1]) \
+    X(131, false, UINT8,  1, config.user_hotkeys[7].action) \
+    X(140, false, UINT8,  1, config.output[0].keymap.modifier_map[0]) \
+    X(141, false, UINT8,  1, config.output[0].keymap.modifier_map[1]) \
+    X(142, false, UINT8,  1, config.output[0].keymap.modifier_map[2]) \
+    X(143, false, UINT8,  1, config.output[0].keymap.modifier_map[3]) \
+    X(144, false, UINT8,  1, config.output[0].keymap.modifier_map[4]) \
+    X(145, false, UINT8,  1, config.output[0].keymap.modifier_map[5]) \
+    X(146, false, UINT8,  1, config.output[0].keymap.modifier_map[6]) \
+    X(147, false, UINT8,  1, config.output[0].keymap.modifier_map[7]) \
+    X(148, false, UINT8,  1, config.output[0].keymap.remap[0].from) \
+    X(149, false, UINT8,  1, config.output[0].keymap.remap[0].to) \
+    X(150, false, UINT8,  1, config.output[0].keymap.remap[1].from) \
+    X(151, false, UINT8,  1, config.output[0].keymap.remap[1].to) \
+    X(152, false, UINT8,  1, config.output[0].keymap.remap[2].from) \
+    X(153, false, UINT8,  1, config.output[0].keymap.remap[2].to) \
+    X(154, false, UINT8,  1, config.output[0].keymap.remap[3].from) \
+    X(155, false, UINT8,  1, config.output[0].keymap.remap[3].to) \
+    X(156, false, UINT8,  1, config.output[0].keymap.remap[4].from) \
+    X(157, false, UINT8,  1, config.output[0].keymap.remap[4].to) \
+    X(158, false, UINT8,  1, config.output[0].keymap.remap[5].from) \
+    X(159, false, UINT8,  1, config.output[0].keymap.remap[5].to) \
+    X(160, false, UINT8,  1, config.output[0].keymap.remap[6].from) \
+    X(161, false, UINT8,  1, config.output[0].keymap.remap[6].to) \
+    X(162, false, UINT8,  1, config.output[0].keymap.remap[7].from) \
+    X(163, false, UINT8,  1, config.output[0].keymap.remap[7].to) \
+    X(170, false, UINT8,  1, config.output[1].keymap.modifier_map[0]) \
+    X(171, false, UINT8,  1, config.output[1].keymap.modifier_map[1]) \
+    X(172, false, UINT8,  1, config.output[1].keymap.modifier_map[2]) \
+    X(173, false, UINT8,  1, config.output[1].keymap.modifier_map[3]) \
+    X(174, false, UINT8,  1, config.output[1].keymap.modifier_map[4]) \
+    X(175, false, UINT8,  1, config.output[1].keymap.modifier_map[5]) \
+    X(176, false, UINT8,  1, config.output[1].keymap.modifier_map[6]) \
+    X(177, false, UINT8,  1, config.output[1].keymap.modifier_map[7]) \
+    X(178, false, UINT8,  1, config.output[1].keymap.remap[0].from) \
+    X(179, false, UINT8,  1, config.output[1].keymap.remap[0].to) \
+    X(180, false, UINT8,  1, config.output[1].keymap.remap[1].from) \
+    X(181, false, UINT8,  1, config.output[1].keymap.remap[1].to) \
+    X(182, false, UINT8,  1, config.output[1].keymap.remap[2].from) \
+    X(183, false, UINT8,  1, config.output[1].keymap.remap[2].to) \
+    X(184, false, UINT8,  1, config.output[1].keymap.remap[3].from) \
+    X(185, false, UINT8,  1, config.output[1].keymap.remap[3].to) \
+    X(186, false, UINT8,  1, config.output[1].keymap.remap[4].from) \
+    X(187, false, UINT8,  1, config.output[1].keymap.remap[4].to) \
+    X(188, false, UINT8,  1, config.output[1].keymap.remap[5].from) \
+    X(189, false, UINT8,  1, config.output[1].keymap.remap[5].to) \
+    X(190, false, UINT8,  1, config.output[1].keymap.remap[6].from) \
+    X(191, false, UINT8,  1, config.output[1].keymap.remap[6].to) \
+    X(192, false, UINT8,  1, config.output[1].keymap.remap[7].from) \
+    X(193, false, UINT8,  1, config.output[1].keymap.remap[7].to) \
+    X(194, true,  UINT32, 4, latency.hist[0][0]) \
+    X(195, true,  UINT32, 4, latency.hist[0][1]) \
+    X(196, true,  UINT32, 4, latency.hist[0][2]) \
+    X(197, true,  UINT32, 4, latency.hist[0][3]) \
+    X(198, true,  UINT32, 4, latency.hist[0][4]) \
+    X(199, true,  UINT32, 4, latency.hist[0][5]) \
+    X(200, true,  UINT32, 4, latency.hist[0][6]) \
+    X(201, true,  UINT32, 4, latency.hist[0][7]) \
+    X(202, true,  UINT32, 4, latency.hist[1][0]) \
+    X(203, true,  UINT32, 4, latency.hist[1][1]) \
+    X(204, true,  UINT32, 4, latency.hist[1][2]) \
+    X(205, true,  UINT32, 4, latency.hist[1][3]) \
+    X(206, true,  UINT32, 4, latency.hist[1][4]) \
+    X(207, true,  UINT32, 4, latency.hist[1][5]) \
+    X(208, true,  UINT32, 4, latency.hist[1][6]) \
+    X(209, true,  UINT32, 4, latency.hist[1][7]) \
+    X(210, true,  UINT32, 4, latency.hist[2][0]) \
+    X(211, true,  UINT32, 4, latency.hist[2][1]) \
+    X(212, true,  UINT32, 4, latency.hist[2][2]) \
+    X(213, true,  UINT32, 4, latency.hist[2][3]) \
+    X(214, true,  UINT32, 4, latency.hist[2][4]) \
+    X(215, true,  UINT32, 4, latency.hist[2][5]) \
+    X(216, true,  UINT32, 4, latency.hist[2][6]) \
+    X(217, true,  UINT32, 4, latency.hist[2][7]) \
+    X(218, true,  UINT32, 4, latency.hist[3][0]) \
+    X(219, true,  UINT32, 4, latency.hist[3][1]) \
+    X(220, true,  UINT32, 4, latency.hist[3][2]) \
+    X(221, true,  UINT32, 4, latency.hist[3][3]) \
+    X(222, true,  UINT32, 4, latency.hist[3][4]) \
+    X(223, true,  UINT32, 4, latency.hist[3][5]) \
+    X(224, true,  UINT32, 4, latency.hist[3][6]) \
+    X(225, true,  UINT32, 4, latency.hist[3][7]) \
+    X(226, true,  UINT32, 4, latency.hist[4][0]) \
+    X(227, true,  UINT32, 4, latency.hist[4][1]) \
+    X(228, true,  UINT32, 4, latency.hist[4][2]) \
+    X(229, true,  UINT32, 4, latency.hist[4][3]) \
+    X(230, true,  UINT32, 4, latency.hist[4][4]) \
+    X(231, true,  UINT32, 4, latency.hist[4][5]) \
+    X(232, true,  UINT32, 4, latency.hist[4][6]) \
+    X(233, true,  UINT32, 4, latency.hist[4][7]) \
+    X(234, true,  UINT32, 4, latency.hist[5][0]) \
+    X(235, true,  UINT32, 4, latency.hist[5][1]) \
+    X(236, true,  UINT32, 4, latency.hist[5][2]) \
+    X(237, true,  UINT32, 4, latency.hist[5][3]) \
+    X(238, true,  UINT32, 4, latency.hist[5][4]) \
+    X(239, true,  UINT32, 4, latency.hist[5][5]) \
+    X(240, true,  UINT32, 4, latency.hist[5][6]) \
+    X(241, true,  UINT32, 4, latency.hist[5][7]) \
+    X(242, true,  UINT32, 4, stats.host_report_rate[2]) \
+    X(243, true,  UINT32, 4, link.baud) \
+    X(244, true,  UINT32, 4, link.rate_changes) \
+    X(245, true,  UINT32, 4, link.rollbacks) \
+    X(246, false, UINT8,  1, config.chain_pair) \
+    X(247, true,  UINT32, 4, chain.forwarded) \
+    X(248, true,  UINT32, 4, chain.rx_packets) \
+    X(249, true,  UINT32, 4, chain.checksum_errors) \
+    X(250, true,  UINT32, 4, mouse_link.reports) \
+    X(251, true,  UINT32, 4, mouse_link.frames) \
+    X(252, true,  UINT32, 4, stats.mouse_merged) \
+    X(253, true,  UINT32, 4, stats.flash_errors)
+
+#define API_FIELD_MAX_INDEX 253
@@ -0,0 +1,60 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Board Chain
+ *  Each board drives one output, its address along the chain is the output
+ *  number. Two boards on the same DeskHop (A/B, C/D, ...) talk over the
+ *  isolated UART as before. Neighbouring DeskHops are joined by a second UART
+ *  (the chain port) between the B side of one and the A side of the next:
+ *
+ *      A(0) --peer-- B(1) --chain-- C(2) --peer-- D(3)
+ *
+ *  Packets carry the destination in the upper bits of the type byte, see
+ *  PACKET_DST_*. A board handles packets addressed to it or to everyone and
+ *  passes the rest on, as they are, towards the destination. Messages meant
+ *  for the board on the other end of the wire are sent with no address, so
+ *  a pair of boards sees the same packets as it always did.
+ *
+ *  Only built with -DDH_CHAIN=ON, otherwise there's just the peer port.
+ *==============================================================================*/
+
+#define CHAIN_PORT_PEER  0    // UART to the other side of the isolator
+#define CHAIN_PORT_NEXT  1    // UART to the neighbouring DeskHop
+#define CHAIN_NUM_PORTS  2
+#define CHAIN_LOCAL      0xFF // Route to ourselves, also used for unreachable boards
+
+#define CHAIN_ALL        0xFF // Destination meaning every other board
+
+#define CHAIN_UART       uart1
+#define CHAIN_QUEUE_LENGTH 256
+
+/*==============================================================================
+ *  Chain Functions
+ *==============================================================================*/
+
+void    chain_init(chain_t *, uint8_t, uint8_t);
+uint8_t chain_neighbour(const chain_t *, uint8_t);
+uint8_t chain_dst_field(const chain_t *, uint8_t, uint8_t);
+uint8_t chain_forward_port(const chain_t *, uint8_t, uint8_t);
+bool    chain_is_local(const chain_t *, uint8_t);
+
+void chain_send(uart_packet_t *, uint8_t, device_t *);
+bool chain_accept(uart_packet_t *, uint8_t, device_t *);
+bool chain_tx_pending(uint8_t, device_t *);
+void chain_serial_init(device_t *);
+
+void chain_receiver_task(device_t *);
+void process_chain_tx_task(device_t *);
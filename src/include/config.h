@@ -15,7 +15,7 @@
 #include "misc.h"
 #include "screen.h"
 
-#define CURRENT_CONFIG_VERSION 8
+#define CURRENT_CONFIG_VERSION 12
 
 /*==============================================================================
  *  Configuration Data
@@ -33,6 +33,8 @@ extern const field_map_t api_field_map[];
 const field_map_t* get_field_map_entry(uint32_t);
 const field_map_t* get_field_map_index(uint32_t);
 size_t             get_field_map_length(void);
+uint32_t           get_field_version(const field_map_t *);
+uint32_t           update_field_versions(device_t *);
 
 /*==============================================================================
  *  Configuration Management and Packet Processing
@@ -42,6 +44,6 @@ size_t             get_field_map_length(void);
 void load_config(device_t *);
 void queue_cfg_packet(uart_packet_t *, device_t *);
 void reset_config_timer(device_t *);
-void save_config(device_t *);
+bool save_config(device_t *);
 bool validate_packet(uart_packet_t *);
 void wipe_config(void);
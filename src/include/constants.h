@@ -26,6 +26,9 @@
 #define ITF_NUM_HID_REL_M  1
 #define ITF_NUM_HID_VENDOR 2
 #define ITF_NUM_MSC        3
+#define ITF_NUM_VENDOR     4
+
+#define ITF_NUM_HID_PASS   2 // HID instance of a mirrored device (normal mode), its interface comes last
 
 /*==============================================================================
  *  Mouse Modes
@@ -50,7 +53,17 @@
 #define JITTER_DISTANCE 2
 #define MOUSE_BOOT_REPORT_LEN 4
 #define MOUSE_ZOOM_SCALING_FACTOR 2
+#define MOUSE_POLL_US 1000 // Host polling interval of our mouse endpoint
+#define MOUSE_SCROLL_RESOLUTION 8 // Wheel and pan units per detent, internally and for hosts with the multiplier on
+#define MOUSE_SCROLL_LIMIT 127    // Most scrolling a single report carries, in those units
+#define USB_RECONNECT_US 100000 // Time our host gets to notice we're gone before enumerating again
+
+/* Outputs, one per board. Chained builds drive two DeskHops, the addressing has room for up to 6. */
+#ifdef DH_CHAIN
+#define NUM_SCREENS 4
+#else
 #define NUM_SCREENS 2
+#endif
 
 /*==============================================================================
  *  Utility Macros
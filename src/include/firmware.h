@@ -19,15 +19,18 @@
 
  uint32_t calculate_firmware_crc32(void);
  void     reboot(void);
- void     write_flash_page(uint32_t, uint8_t *);
+ bool     write_flash_page(uint32_t, uint8_t *);
+ bool     erase_flash_range(uint32_t, size_t);
+ bool     program_flash_page(uint32_t, const uint8_t *);
+ void     reject_firmware_image(void);
 
  /*==============================================================================
   *  UART Packet Fetching
   *  Functions to handle incoming UART packets, especially for firmware updates.
   *==============================================================================*/
- void     fetch_packet(device_t *);
- uint32_t get_ptr_delta(uint32_t, device_t *);
- bool     is_start_of_packet(device_t *);
+ void     fetch_packet(const uint8_t *, uint32_t *, uart_packet_t *);
+ uint32_t get_ptr_delta(uint32_t, uint32_t);
+ bool     is_start_of_packet(const uint8_t *, uint32_t);
  void     request_byte(device_t *, uint32_t);
 
  /*==============================================================================
@@ -12,6 +12,7 @@
 #pragma once
 #include <stdint.h>
 #include <hardware/flash.h>
+#include <pico/flash.h>
 
 /*==============================================================================
  *  Firmware Metadata
@@ -49,6 +50,12 @@ typedef struct {
 #define STAGING_PAGES_CNT         1024
 #define STAGING_IMAGE_SIZE        (STAGING_PAGES_CNT * FLASH_PAGE_SIZE)
 
+/* How long to wait for the other core to get off the flash before giving up on a write */
+#define FLASH_SAFE_TIMEOUT_MS     100
+
+/* Wiping stage 2 of a bad image is tried this many times before dropping to the ROM bootloader anyway */
+#define FLASH_WIPE_ATTEMPTS       10
+
 /*==============================================================================
 *  Lookup Tables
 *==============================================================================*/
@@ -74,3 +81,52 @@ typedef struct {
 #define UF2_MAGIC_START0 0x0A324655
 #define UF2_MAGIC_START1 0x9E5D5157
 #define UF2_MAGIC_END    0x0AB16F30
+
+/*==============================================================================
+ *  Synthesized FAT12 Disk Structures
+ *==============================================================================*/
+typedef struct {
+    uint8_t jump[3];
+    char oem_name[8];
+    uint16_t bytes_per_sector;
+    uint8_t sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t num_fats;
+    uint16_t root_dir_entries;
+    uint16_t total_sectors;
+    uint8_t media_descriptor;
+    uint16_t sectors_per_fat;
+    uint16_t sectors_per_track;
+    uint16_t num_heads;
+    uint32_t hidden_sectors;
+    uint32_t total_sectors_32;
+    uint8_t drive_number;
+    uint8_t _reserved;
+    uint8_t boot_signature;
+    uint32_t volume_id;
+    char volume_label[11];
+    char fs_type[8];
+} __attribute__((packed)) fat_boot_sector_t;
+
+typedef struct {
+    char name[11];      // 8.3 name, space padded
+    uint8_t attr;
+    uint8_t nt_flags;   // Lowercase name/extension flags
+    uint8_t create_time_fine;
+    uint16_t create_time;
+    uint16_t create_date;
+    uint16_t access_date;
+    uint16_t cluster_high;
+    uint16_t modify_time;
+    uint16_t modify_date;
+    uint16_t cluster_low;
+    uint32_t size;
+} __attribute__((packed)) fat_dir_entry_t;
+
+#define FAT_ATTR_READ_ONLY    0x01
+#define FAT_ATTR_VOLUME_LABEL 0x08
+#define FAT_NT_LOWERCASE      0x18
+
+/* Web config page, linked from disk/disk.S */
+extern const uint8_t _config_page_start[];
+extern const uint8_t _config_page_end[];
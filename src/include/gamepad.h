@@ -0,0 +1,49 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Gamepad
+ *  Gamepads and joysticks follow the active output. Whatever the device
+ *  looks like, the host gets the standard TinyUSB gamepad (6 axes, a hat
+ *  and 32 buttons) on the mouse helper interface. It's only offered once a
+ *  gamepad shows up on any of the boards, that costs one re-enumeration.
+ *
+ *  Towards another board, a GAMEPAD_MSG carries only the fields that
+ *  changed: a mask in the first byte, then their values in order. The whole
+ *  state goes out after switching outputs and at least every
+ *  GAMEPAD_KEYFRAME_US while it's moving, so a lost frame doesn't leave a
+ *  stick off for long. The output we switch away from gets a released
+ *  gamepad, nothing stays pressed there.
+ *==============================================================================*/
+
+#define GAMEPAD_FIELDS      8      // x, y, z, rz, rx, ry, hat, buttons - same order as hid_gamepad_report_t
+#define GAMEPAD_MAX_FRAMES  2      // The whole state fits in this many frames
+#define GAMEPAD_KEYFRAME_US 100000 // Longest time between full states while the gamepad is used
+
+/*==============================================================================
+ *  Gamepad Functions
+ *==============================================================================*/
+
+bool    gamepad_decode(gamepad_t *, const uint8_t *, int, uint8_t);
+uint8_t gamepad_delta_encode(const hid_gamepad_report_t *, const hid_gamepad_report_t *, bool,
+                             uint8_t[][PACKET_DATA_LENGTH]);
+void    gamepad_delta_apply(hid_gamepad_report_t *, const uint8_t *);
+
+void gamepad_mount(hid_interface_t *, device_t *);
+void gamepad_message(const uint8_t *, device_t *);
+void process_gamepad_report(uint8_t *, int, uint8_t, hid_interface_t *);
+void queue_gamepad_packet(uint8_t *, device_t *);
+
+void gamepad_link_task(device_t *);
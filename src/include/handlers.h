@@ -40,13 +40,19 @@ void wipe_config_hotkey_handler(device_t *, hid_keyboard_report_t *);
 
 void handle_api_msgs(uart_packet_t *, device_t *);
 void handle_api_read_all_msg(uart_packet_t *, device_t *);
+void send_read_all_fields(device_t *);
+uint16_t handle_bulk_api_msg(const uint8_t *, uint8_t *, device_t *);
 void handle_consumer_control_msg(uart_packet_t *, device_t *);
+void handle_passthrough_msg(uart_packet_t *, device_t *);
+void handle_gamepad_msg(uart_packet_t *, device_t *);
 void handle_flash_led_msg(uart_packet_t *, device_t *);
 void handle_fw_upgrade_msg(uart_packet_t *, device_t *);
 void handle_toggle_gaming_msg(uart_packet_t *, device_t *);
 void handle_heartbeat_msg(uart_packet_t *, device_t *);
 void handle_keyboard_uart_msg(uart_packet_t *, device_t *);
+void handle_link_msg(uart_packet_t *, device_t *);
 void handle_mouse_abs_uart_msg(uart_packet_t *, device_t *);
+void handle_mouse_delta_uart_msg(uart_packet_t *, device_t *);
 void handle_mouse_zoom_msg(uart_packet_t *, device_t *);
 void handle_output_select_msg(uart_packet_t *, device_t *);
 void handle_proxy_msg(uart_packet_t *, device_t *);
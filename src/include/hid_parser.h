@@ -24,7 +24,12 @@
 #define MAX_INTERFACES              12  // Per device; allows for complex devices like QMK
 #define MAX_KEYS                    32
 #define MAX_REPORTS                 24
+#define MAX_FEATURE_LENGTH          8   // Longest feature report we'll send, without the report ID
+#define MAX_MULTIPLIERS             2   // Resolution Multipliers per mouse, wheel and pan
 #define MAX_KEYBOARDS               5
+#define MAX_KBD_SLOTS               16  // Keyboards across all devices, one per report ID (fits kbd_slots_used)
+#define KBD_SLOT_NONE               0xFF
+#define MAX_GAMEPAD_FIELDS          12  // Axes, hats and button groups of one gamepad interface
 #define MAX_SYS_BUTTONS             8
 #define PRIMARY_KEYBOARD            0
 /*==============================================================================
@@ -96,8 +101,23 @@ typedef struct TU_ATTR_PACKED {
     uint16_t global_usage;
     uint16_t usage_page;
     uint16_t usage;
+
+    int32_t logical_min;
+    int32_t logical_max;
+
+    uint8_t collection; // Innermost collection it's in, numbered from 1 in descriptor order
 } report_val_t;
 
+/* Resolution Multiplier feature. Set to its logical max, the wheel reports 'resolution' counts per detent.
+   It applies to the controls in its collection, the parser finds out if those are the wheel or pan. */
+typedef struct {
+    report_val_t val;
+    int32_t logical_max;
+    int32_t resolution;
+    bool wheel;
+    bool pan;
+} multiplier_t;
+
 /* Defines information about HID report format for the mouse. */
 typedef struct {
     report_val_t buttons;
@@ -110,8 +130,54 @@ typedef struct {
 
     bool is_found;
     bool uses_report_id;
+
+    /* High resolution scrolling, if the mouse has a Resolution Multiplier */
+    multiplier_t multiplier[MAX_MULTIPLIERS];
+    uint8_t num_multipliers;
+    uint8_t feature_id;                         // Report ID of the feature report they're in
+    uint8_t feature_len;                        // Its length in bytes, without the report ID
+    uint8_t feature[MAX_FEATURE_LENGTH + 1];    // Buffer for setting it, has to outlive the transfer
+    bool hires_requested;                       // Turn it on once the control pipe is free
+
+    int32_t wheel_resolution; // Counts per detent the mouse sends right now, 0 is the same as 1
+    int32_t pan_resolution;
+    int32_t wheel_rest;       // What didn't divide evenly into our units yet
+    int32_t pan_rest;
 } mouse_t;
 
+/* Gamepad and joystick fields are turned into a plan while parsing the descriptor. Each entry
+   says where a field is and how it becomes part of hid_gamepad_report_t, so a report is decoded
+   by just walking the list. */
+enum gamepad_target_e {
+    GAMEPAD_X       = 0, // Axes are in the order hid_gamepad_report_t has them
+    GAMEPAD_Y       = 1,
+    GAMEPAD_Z       = 2,
+    GAMEPAD_RZ      = 3,
+    GAMEPAD_RX      = 4,
+    GAMEPAD_RY      = 5,
+    GAMEPAD_HAT     = 6,
+    GAMEPAD_BUTTONS = 7,
+};
+
+typedef struct {
+    uint16_t offset;    // In bits, after the report ID
+    uint8_t size;       // In bits, up to 32
+    uint8_t report_id;
+    uint8_t target;     // enum gamepad_target_e
+    uint8_t shift;      // Buttons: bit of the first one in the output
+    bool is_signed;
+    int32_t min;        // Logical minimum
+    int32_t scale;      // Axes: 16.16 factor taking the logical range to -127..127, hat: 4 or 8 positions
+} gamepad_field_t;
+
+typedef struct {
+    gamepad_field_t fields[MAX_GAMEPAD_FIELDS];
+    uint8_t num_fields;
+    uint8_t report_id;
+    bool is_found;
+    hid_gamepad_report_t state; // Fields not in a report keep their value
+} gamepad_t;
+
 typedef struct hid_interface_t hid_interface_t;
 typedef void (*process_report_f)(uint8_t *, int, uint8_t, hid_interface_t *);
 
@@ -125,6 +191,7 @@ typedef struct {
 
     uint8_t report_id;
     uint8_t key_array_idx;
+    uint8_t slot; // In kbd_slots, KBD_SLOT_NONE if they were all taken
 
     bool uses_report_id;
     bool is_found;
@@ -142,11 +209,13 @@ struct hid_interface_t {
     keyboard_t keyboards[MAX_KEYBOARDS];
     uint8_t num_keyboards;
     mouse_t mouse;
+    gamepad_t gamepad;
     report_t consumer;
     report_t system;
     process_report_f report_handler[MAX_REPORTS];
     uint8_t protocol;
     bool uses_report_id;
+    bool passthrough; // Nothing we understand, reports go to the host as they are
 };
 
 typedef struct {
@@ -160,10 +229,15 @@ typedef struct {
     uint16_t global_usage;
 
     collection_t collection;
+    uint8_t current_collection;     // Innermost open collection, 0 outside of any
+    uint8_t collection_parent[256]; // Collection each one is in, by number
 
     report_offset_map_t report_offsets[MAX_REPORTS];
     uint8_t num_report_offsets;
 
+    report_offset_map_t feature_offsets[MAX_REPORTS]; // Feature reports have their own layout
+    uint8_t num_feature_offsets;
+
     /* as tag is 4 bits, there can be 16 different tags in global header type */
     item_t globals[16];
 
@@ -26,14 +26,23 @@ keyboard_t *get_keyboard(hid_interface_t *iface, uint8_t report_id);
  *  Hotkey Handling
  *==============================================================================*/
 
-bool check_specific_hotkey(hotkey_combo_t, const hid_keyboard_report_t *);
+extern const hotkey_combo_t hotkeys[]; // Built-in hotkeys, in priority order
+extern const int builtin_hotkey_count;
+
+void build_keyboard_tables(device_t *);
+bool check_specific_hotkey(const hotkey_combo_t *, const hid_keyboard_report_t *);
+const hotkey_combo_t *check_all_hotkeys(hid_keyboard_report_t *, device_t *);
 
 /*==============================================================================
  *  Keyboard State Management
  *==============================================================================*/
 void     update_kbd_state(device_t *, hid_keyboard_report_t *, uint8_t);
 void     update_remote_kbd_state(device_t *, hid_keyboard_report_t *);
+void     keyboard_mount(uint8_t, uint8_t, hid_interface_t *, device_t *);
+void     keyboard_umount(uint8_t, uint8_t, device_t *);
 void     combine_kbd_states(device_t *, hid_keyboard_report_t *);
+void     inject_keys(device_t *, uint8_t, hid_keyboard_report_t *, uint8_t);
+bool     kbd_report_skippable(const hid_keyboard_report_t *, const hid_keyboard_report_t *, const hid_keyboard_report_t *);
 
 /*==============================================================================
  *  Keyboard Report Processing
@@ -0,0 +1,70 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Latency Instrumentation
+ *  One report at a time is followed through the pipeline, the time it spends
+ *  in each hop goes to that hop's histogram. Queues are FIFO, so the report
+ *  is out once the consumer removed as many entries as were ahead of it.
+ *
+ *  Keyboard reports for the other board carry the receive time in the
+ *  reserved byte, in 64 us units. The other board maps it to its own clock
+ *  using the offset measured from heartbeats, which are time stamped when
+ *  the UART transfer starts.
+ *==============================================================================*/
+
+#define LAT_BUCKET_SHIFT    6      // First bucket is < 64 us
+#define LAT_STAMP_SHIFT     6      // Time stamp in a keyboard report has 64 us resolution ...
+#define LAT_STAMP_RANGE     (256 << LAT_STAMP_SHIFT) // ... so it wraps after ~16 ms
+#define LAT_PROBE_TIMEOUT   100000 // Probe that hasn't finished within 100 ms is abandoned (us)
+#define LAT_UART_WIRE_US(baud) (RAW_PACKET_LENGTH * 10 * 1000000 / (baud)) // Time on the wire
+
+enum latency_queue_e {
+    LAT_QUEUE_KBD   = 0,
+    LAT_QUEUE_MOUSE = 1,
+    LAT_QUEUE_UART  = 2,
+    LAT_NUM_QUEUES,
+};
+
+enum latency_stage_e {
+    LAT_STAGE_IDLE   = 0, // No report is being followed
+    LAT_STAGE_PARSED = 1, // Report parsed, waiting to be queued
+    LAT_STAGE_QUEUED = 2, // Report queued, waiting to be sent
+};
+
+typedef struct {
+    volatile uint8_t stage; // One of latency_stage_e, written last
+    uint8_t queue;          // Queue the report went to, see latency_queue_e
+    bool remote;            // Report came from the other board
+    uint32_t seq;           // Queue removals after which the report is out
+    uint32_t received;      // When the report was received from the device (us)
+    uint32_t parsed;        // When the report was parsed (us)
+    uint32_t queued;        // When the report was queued (us)
+} latency_probe_t;
+
+/*==============================================================================
+ *  Latency Functions
+ *==============================================================================*/
+
+void    latency_add(latency_t *, enum latency_hop_e, uint32_t);
+uint8_t latency_bucket(uint32_t);
+void    latency_parsed(device_t *);
+void    latency_queued(enum latency_queue_e, queue_t *, device_t *);
+void    latency_received(void);
+void    latency_remote_received(uint8_t, device_t *);
+void    latency_removed(enum latency_queue_e);
+void    latency_sent(enum latency_queue_e, device_t *);
+void    latency_sync_clock(uint16_t, device_t *);
+uint8_t latency_tag(void);
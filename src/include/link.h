@@ -0,0 +1,85 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Link Management
+ *  Both boards start at SERIAL_BAUDRATE. Board A watches the frame error rate
+ *  (checksum failures on both ends, heartbeats that never arrived) and moves
+ *  along the rate ladder: down when the link is noisy, up after it has been
+ *  clean for a while.
+ *
+ *  A rate change is negotiated: A requests it, B acknowledges and both
+ *  switch once their pending output is on the wire. A then probes the link
+ *  at the new rate and commits only if enough probes get through without
+ *  errors on either side, otherwise both go back to the previous rate.
+ *  Whenever nothing valid comes in for a while (e.g. the other board
+ *  rebooted), both fall back to the default rate.
+ *
+ *  Time and the UART are passed in, so the logic doesn't depend on the
+ *  hardware.
+ *==============================================================================*/
+
+#define LINK_NUM_RATES       6
+#define LINK_DEFAULT_RUNG    4        // link_rates[] entry equal to SERIAL_BAUDRATE
+
+#define LINK_WINDOW_US       2000000  // Error rate is evaluated over 2 s, so each window sees a heartbeat
+#define LINK_MAX_FER         5        // Window is bad above this many frame errors per 1000 frames ...
+#define LINK_MIN_ERRORS      2        // ... and with at least this many errors
+#define LINK_BAD_WINDOWS     2        // Consecutive bad windows before stepping down
+#define LINK_STEP_UP_WINDOWS 15       // Clean windows before trying a faster rate (30 s) ...
+#define LINK_MAX_UP_WINDOWS  960      // ... doubled after each failure, up to ~30 min
+
+#define LINK_REPLY_US        100000   // How long to wait for the request to be acknowledged
+#define LINK_SWITCH_US       20000    // Longest wait for pending output before switching anyway
+#define LINK_TRIAL_US        300000   // Probing has to succeed within this time ...
+#define LINK_PROBE_US        20000    // ... sending a probe this often ...
+#define LINK_TRIAL_ACKS      5        // ... and getting this many answered without errors
+#define LINK_COMMIT_REPEAT   3        // Commit is sent a few times, losing it costs a fallback
+#define LINK_DEAD_US         3500000  // Nothing valid for this long means we're out of sync
+
+enum link_op_e {
+    LINK_REQUEST   = 1, // A -> B, switch to rung
+    LINK_ACK       = 2, // B -> A, switching
+    LINK_PROBE     = 3, // A -> B, at the new rate
+    LINK_PROBE_ACK = 4, // B -> A, arg = checksum errors B saw since the first probe
+    LINK_COMMIT    = 5, // A -> B, keep the new rate
+    LINK_ABORT     = 6, // A -> B, go back to the previous rate
+};
+
+enum link_state_e {
+    LINK_IDLE      = 0, // Running at a settled rate
+    LINK_REQUESTED = 1, // A: waiting for B to acknowledge
+    LINK_SWITCHING = 2, // Waiting for pending output to go out before switching
+    LINK_TRIAL     = 3, // Running at the new rate, not committed yet
+    LINK_REVERTING = 4, // Waiting for pending output to go out before going back
+};
+
+typedef struct {
+    void (*send)(const link_msg_t *, device_t *); // Queue a negotiation message
+    void (*set_rate)(uint32_t baud, device_t *);  // Change the UART baud rate
+    bool (*tx_idle)(device_t *);                  // True when nothing is waiting to be sent
+    void (*settled)(device_t *);                  // Rate changed for good, resend state that might be lost
+} link_io_t;
+
+extern const uint32_t link_rates[LINK_NUM_RATES];
+
+/*==============================================================================
+ *  Link Functions
+ *==============================================================================*/
+
+void link_init(link_t *, bool, uint64_t);
+void link_heartbeat(link_t *, uint16_t);
+void link_received(link_t *, const link_msg_t *);
+void link_step(link_t *, const link_io_t *, uint64_t, device_t *);
@@ -0,0 +1,133 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Macro Storage
+ *  Macros are kept in their own flash sector, next to the config. Each macro
+ *  is a run of steps in steps[], starting at start[n] and ending with a
+ *  MACRO_END step. A RAM copy is used for playback and uploads.
+ *==============================================================================*/
+
+#define MACRO_MAGIC        0x4D414352 // "MACR"
+#define MACRO_UNUSED       0xFFFF     // start[] value of an empty macro slot
+#define MACRO_HEADER_SIZE  (2 * sizeof(uint32_t) + MAX_MACROS * sizeof(uint16_t))
+#define MAX_MACRO_STEPS    ((FLASH_SECTOR_SIZE - MACRO_HEADER_SIZE) / sizeof(macro_step_t))
+
+#define MACRO_QUEUE_LIMIT    4 // No more reports are added once the destination queue holds this many
+#define MACRO_STEPS_PER_PASS 8 // Upper bound of steps executed per task pass
+
+enum macro_step_e {
+    MACRO_END           = 0, // End of macro, anything still held by the macro is released
+    MACRO_KEY_DOWN      = 1, // arg = key usage, modifier usages (0xE0 - 0xE7) set the modifier bit
+    MACRO_KEY_UP        = 2, // arg = key usage
+    MACRO_MOUSE_MOVE    = 3, // x, y = absolute pointer position (0 - MAX_SCREEN_COORD)
+    MACRO_MOUSE_BUTTONS = 4, // arg = mouse button state
+    MACRO_DELAY         = 5, // x = delay in ms (unsigned)
+    MACRO_OUTPUT        = 6, // arg = output the following steps are sent to
+    MACRO_TEXT          = 7, // arg = text length, UTF-8 text is stored in the following steps
+};
+
+typedef struct {
+    uint8_t type; // One of macro_step_e
+    uint8_t arg;  // Key usage, buttons or output, depending on type
+    int16_t x;
+    int16_t y;
+} __attribute__((packed)) macro_step_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum;                    // CRC32 of everything after this field
+    uint16_t start[MAX_MACROS];           // First step of each macro, MACRO_UNUSED if empty
+    macro_step_t steps[MAX_MACRO_STEPS];
+} macro_storage_t;
+
+/*==============================================================================
+ *  Macro Playback
+ *  The player runs steps until it hits a delay or the destination queue is
+ *  full, so a macro never occupies more than MACRO_QUEUE_LIMIT queue slots.
+ *  Time and the report sink are passed in, so playback doesn't depend on
+ *  the hardware.
+ *==============================================================================*/
+
+typedef struct {
+    bool (*ready)(uint8_t output, device_t *);                             // True if there's room for a report
+    void (*keyboard)(hid_keyboard_report_t *, uint8_t output, device_t *); // Send a keyboard report
+    void (*mouse)(mouse_report_t *, uint8_t output, device_t *);           // Send a mouse report
+    bool (*text)(const uint8_t *, uint16_t, uint8_t output, device_t *);   // Queue text to be typed
+} macro_sink_t;
+
+typedef struct {
+    const macro_step_t *step;   // Next step to execute, NULL if nothing is playing
+    const macro_step_t *end;    // End of the step storage, playback never goes past it
+    uint64_t resume_at;         // Time (us) when the current delay step is over
+    uint8_t output;             // Output steps are currently sent to
+    hid_keyboard_report_t keys; // Keys currently held by the macro
+    mouse_report_t mouse;       // Mouse state of the macro
+} macro_player_t;
+
+/*==============================================================================
+ *  Text Injection
+ *  Text is typed one keystroke per report. Keys stay pressed while the next
+ *  ones are added, a release is only sent when a key repeats. Once all six
+ *  slots are taken, the oldest key is let go in the same report. How a
+ *  character is typed depends on the OS of the output, see text_layouts[].
+ *==============================================================================*/
+
+#define TEXT_STEPS_PER_PASS 16 // Upper bound of characters/reports handled per task pass
+#define TEXT_PENDING_KEYS   8  // Longest keystroke sequence a character maps to
+
+typedef struct {
+    uint8_t output; // Output the character is typed on
+    uint8_t ch;     // Byte of UTF-8 text
+} text_char_t;
+
+typedef struct {
+    uint8_t key;      // Key usage, 0 lets go of everything held
+    uint8_t modifier;
+} keystroke_t;
+
+typedef struct text_typist_t text_typist_t;
+
+typedef struct {
+    const keystroke_t *ascii;                   // Keystrokes of the ASCII characters
+    void (*unicode)(text_typist_t *, uint32_t); // Keystrokes of a code point beyond ASCII, NULL if there's no way
+} text_layout_t;
+
+struct text_typist_t {
+    hid_keyboard_report_t report;           // Keys currently held, oldest first
+    keystroke_t pending[TEXT_PENDING_KEYS]; // Keystrokes of the character being typed
+    uint8_t pending_count;                  // How many keystrokes are in pending[]
+    uint8_t pending_pos;                    // Next keystroke to type
+    uint32_t codepoint;                     // UTF-8 decoder, code point so far
+    uint8_t utf8_left;                      // UTF-8 decoder, continuation bytes still expected
+    uint8_t output;                         // Output the held keys belong to
+    const text_layout_t *layout;            // Layout of the character being typed
+};
+
+extern const keystroke_t us_ascii_keystrokes[128];
+
+/*==============================================================================
+ *  Macro Functions
+ *==============================================================================*/
+
+void load_macros(void);
+void macro_player_start(macro_player_t *, const macro_storage_t *, uint8_t, device_t *);
+void macro_player_run(macro_player_t *, const macro_sink_t *, uint64_t, device_t *);
+uint16_t read_macro_storage(uint32_t, uint8_t *, uint16_t);
+bool save_macros(void);
+void start_macro(uint8_t, device_t *);
+void text_typist_run(text_typist_t *, const macro_sink_t *, device_t *);
+bool type_text(const uint8_t *, uint16_t, uint8_t, device_t *);
+bool write_macro_storage(uint32_t, const uint8_t *, uint16_t);
@@ -30,20 +30,29 @@
 #include "usb_descriptors.h"
 #include "user_config.h"
 #include "protocol.h"
+#include "api_fields.h"
 
 #include "dma.h"
 
+#include "chain.h"
 #include "firmware.h"
 #include "flash.h"
+#include "gamepad.h"
 #include "handlers.h"
 #include "keyboard.h"
+#include "latency.h"
+#include "link.h"
+#include "macro.h"
 #include "mouse.h"
+#include "mouse_link.h"
 #include "packet.h"
+#include "passthrough.h"
 #include "pinout.h"
 #include "screen.h"
 #include "serial.h"
 #include "setup.h"
 #include "tasks.h"
+#include "trace.h"
 #include "watchdog.h"
 
 
@@ -53,6 +62,7 @@
 #include <hardware/flash.h>
 #include <hardware/sync.h>
 #include <hardware/watchdog.h>
+#include <pico/bit_ops.h>
 #include <pico/bootrom.h>
 #include <pico/multicore.h>
 #include <pico/stdlib.h>
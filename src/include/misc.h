@@ -17,10 +17,20 @@
  *  Checksum Functions
  *==============================================================================*/
 
+#define CRC32_INIT 0xffffffff
+
 uint8_t  calc_checksum(const uint8_t *, int);
-uint32_t crc32_iter(uint32_t, const uint8_t);
+uint32_t calc_crc32(const uint8_t *, size_t);
+void     crc32_init(void);
+uint32_t crc32_update(uint32_t, const uint8_t *, size_t);
 bool     verify_checksum(const uart_packet_t *);
 
+/*==============================================================================
+ *  Runtime Counters
+ *==============================================================================*/
+
+bool queue_add_counted(queue_t *, const void *, enum stats_queue_e);
+
 /*==============================================================================
  *  Global State
  *==============================================================================*/
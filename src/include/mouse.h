@@ -18,12 +18,33 @@
  *==============================================================================*/
 void      extract_data(hid_interface_t *, report_val_t *);
 int32_t   get_report_value(uint8_t *, int, report_val_t *);
+void      set_report_value(uint8_t *, int, report_val_t *, int32_t);
 void      parse_report_descriptor(hid_interface_t *, uint8_t const *, int);
+void      extract_report_values(uint8_t *, int, device_t *, mouse_values_t *, hid_interface_t *);
 
 /*==============================================================================
  *  Mouse Report Handling
  *==============================================================================*/
 void process_mouse_report(uint8_t *, int, uint8_t, hid_interface_t *);
 void queue_mouse_report(mouse_report_t *, device_t *);
-bool tud_mouse_report(uint8_t mode, uint8_t buttons, int16_t x, int16_t y, int8_t wheel, int8_t pan);
+bool tud_mouse_report(uint8_t mode, uint8_t buttons, int16_t x, int16_t y, int16_t wheel, int16_t pan);
 void output_mouse_report(mouse_report_t *, device_t *);
+void mouse_pending_task(device_t *);
+void mouse_fast_init(void);
+
+/*==============================================================================
+ *  Scrolling
+ *==============================================================================*/
+int32_t scale_scroll(int32_t, int32_t, int32_t *);
+int16_t scroll_to_host(int32_t, bool, int16_t *);
+void    mouse_enable_hires(uint8_t, uint8_t, hid_interface_t *);
+void    mouse_hires_enabled(hid_interface_t *, uint8_t, uint16_t);
+
+/*==============================================================================
+ *  Screen Layout
+ *==============================================================================*/
+void build_screen_layout(device_t *);
+void compile_screen_layout(screen_layout_t *, const output_t *);
+const screen_transition_t *find_screen_transition(const screen_layout_t *, uint8_t, uint8_t, enum screen_pos_e, int, int16_t *);
+const screen_transition_t *screen_transition(device_t *, enum screen_pos_e, int, int16_t *);
+void desktop_position(device_t *, int16_t *, int16_t *);
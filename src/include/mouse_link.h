@@ -0,0 +1,58 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Mouse Link
+ *  Mouse reports for another board go out as soon as the link has nothing
+ *  else waiting. While it's behind (slow rate, fast mouse), reports are held
+ *  back and folded together: the latest absolute position wins, wheel and
+ *  pan add up. Button changes are never folded, so no click gets lost.
+ *
+ *  Small moves are sent as MOUSE_DELTA_MSG, up to MOUSE_DELTA_EVENTS reports
+ *  per frame, each relative to the previous one. The full absolute report
+ *  (MOUSE_REPORT_MSG) is the keyframe: it goes out first after switching
+ *  outputs, for moves too big for a delta and at least every
+ *  MOUSE_KEYFRAME_US, so a lost frame can't leave the pointer off for long.
+ *
+ *  Wheel and pan get 4 bits each in a delta, a sign and one of
+ *  MOUSE_SCROLL_STEPS amounts: the small steps a high resolution wheel makes
+ *  and up to 3 whole detents (MOUSE_SCROLL_RESOLUTION each). Any other
+ *  amount goes out as a keyframe.
+ *
+ *  Time and the queue are passed in, so the logic doesn't depend on the
+ *  hardware.
+ *==============================================================================*/
+
+#define MOUSE_KEYFRAME_US 100000 // Longest time between absolute positions
+#define MOUSE_DELTA_MIN   INT8_MIN
+#define MOUSE_DELTA_MAX   INT8_MAX
+#define MOUSE_SCROLL_STEPS 8     // Scroll amounts a delta can carry, not counting the sign
+
+typedef struct {
+    void (*send)(const uint8_t *, enum packet_type_e, uint8_t, device_t *); // Queue a frame for an output
+    bool (*busy)(uint8_t, device_t *);                                      // Frames for this output still waiting
+} mouse_link_io_t;
+
+/*==============================================================================
+ *  Mouse Link Functions
+ *==============================================================================*/
+
+void    mouse_link_report(mouse_link_t *, const mouse_link_io_t *, const mouse_report_t *, uint8_t, uint64_t, device_t *);
+void    mouse_link_flush(mouse_link_t *, const mouse_link_io_t *, uint64_t, device_t *);
+uint8_t mouse_delta_decode(const uint8_t *, int16_t, int16_t, mouse_report_t *);
+
+void mouse_link_send(mouse_report_t *, uint8_t, device_t *);
+void mouse_link_sync(device_t *);
+void mouse_link_task(device_t *);
@@ -23,11 +23,24 @@
 #define START2        0x55
 #define START_LENGTH  2
 
+/* Type byte, destination board in the upper bits (packet types have to stay below 32) */
+#define PACKET_TYPE_MASK   0x1F
+#define PACKET_DST_SHIFT   5
+#define PACKET_DST_PEER    0 // Board on the other end of the wire, never passed on
+#define PACKET_DST_ALL     7 // Every board, 1-6 is the board's output + 1
+#define PACKET_DST(type)   ((type) >> PACKET_DST_SHIFT)
+#define PACKET_TYPE(type)  ((type) & PACKET_TYPE_MASK)
+
+_Static_assert(PACKET_TYPE_END - 1 <= PACKET_TYPE_MASK, "Packet types must fit below the destination bits");
+_Static_assert(PACKET_TYPE_MASK >> PACKET_DST_SHIFT == 0, "Packet type and destination bits overlap");
+
 /* Packet Queue Definitions  */
 #define UART_QUEUE_LENGTH  256
 #define HID_QUEUE_LENGTH   128
 #define KBD_QUEUE_LENGTH   128
 #define MOUSE_QUEUE_LENGTH 512
+#define FW_QUEUE_LENGTH    32
+#define TEXT_QUEUE_LENGTH  1024
 
 /* Packet Lengths and Offsets */
 #define PACKET_LENGTH          (TYPE_LENGTH + PACKET_DATA_LENGTH + CHECKSUM_LENGTH)
@@ -41,8 +54,12 @@
 #define KEYS_IN_USB_REPORT      6
 #define KBD_REPORT_LENGTH       8
 #define MOUSE_REPORT_LENGTH     8
+#define MOUSE_DELTA_EVENTS      2 // Reports carried by one MOUSE_DELTA_MSG
 #define CONSUMER_CONTROL_LENGTH 4
 #define SYSTEM_CONTROL_LENGTH   1
+#define PASSTHROUGH_REPORT_MAX  64  // Longest report from a mirrored device, same as the host endpoint
+#define PASSTHROUGH_DESC_MAX    256 // Longest report descriptor we mirror
+#define HID_GENERIC_LENGTH      PASSTHROUGH_REPORT_MAX
 #define MODIFIER_BIT_LENGTH     8
 
 /*==============================================================================
@@ -0,0 +1,54 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Pass-through
+ *  An input device interface we don't understand (a presenter, a headset's
+ *  call buttons, a drawing pad's keys...) is handed to the host as it is.
+ *  Its report descriptor is copied once, when it's mounted, and offered to
+ *  our host as an extra HID interface (ITF_NUM_HID_PASS). Every board gets
+ *  the copy, so whichever output is active has it. A board re-enumerates
+ *  when the copy changes, it stays until a different device replaces it.
+ *
+ *  Reports are forwarded byte for byte. They don't fit a link frame, so
+ *  they travel as PASSTHROUGH_MSG frames: the first one has the total
+ *  length, the rest just continue the data. A report waiting for a busy
+ *  link is replaced by a newer one, like the mouse, only the latest state
+ *  matters. A board getting reports for a descriptor it never received
+ *  asks for it.
+ *==============================================================================*/
+
+#define PASS_FRAME_DESCRIPTOR 0x80 // Frame belongs to a report descriptor, not a report
+#define PASS_FRAME_REQUEST    0x40 // Asks the board with the device for its descriptor, no data
+#define PASS_FRAME_INDEX      0x3F // Frame number within the message
+#define PASS_FIRST_DATA       5    // Data bytes in the first frame, after the header and length
+#define PASS_NEXT_DATA        7    // Data bytes in the frames following it
+#define PASS_MAX_FRAMES       (1 + (PASSTHROUGH_DESC_MAX - PASS_FIRST_DATA + PASS_NEXT_DATA - 1) / PASS_NEXT_DATA)
+
+/*==============================================================================
+ *  Pass-through Functions
+ *==============================================================================*/
+
+uint8_t passthrough_split(uint8_t, const uint8_t *, uint16_t, uint8_t[][PACKET_DATA_LENGTH]);
+bool    passthrough_join(passthrough_rx_t *, const uint8_t *);
+bool    passthrough_usable(const hid_interface_t *, const uint8_t *, uint16_t);
+
+bool passthrough_mount(uint8_t, uint8_t, hid_interface_t *, const uint8_t *, uint16_t, device_t *);
+void passthrough_umount(uint8_t, uint8_t, device_t *);
+void passthrough_message(const uint8_t *, device_t *);
+void process_passthrough_report(uint8_t *, int, uint8_t, hid_interface_t *);
+void queue_passthrough_packet(uint8_t *, uint8_t, uint8_t, device_t *);
+
+void passthrough_link_task(device_t *);
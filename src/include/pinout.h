@@ -14,8 +14,9 @@
  *  Board Roles
  *==============================================================================*/
 
-#define BOARD_ROLE (global_state.board_role)
-#define OTHER_ROLE (BOARD_ROLE == OUTPUT_A ? OUTPUT_B : OUTPUT_A)
+#define BOARD_ROLE (global_state.board_role) // Output we drive, also our address along the chain
+#define BOARD_SIDE (BOARD_ROLE & 1)            // Side of the isolator we're on (OUTPUT_A or OUTPUT_B)
+#define OTHER_ROLE (BOARD_ROLE ^ 1)            // Board on the other side of the isolator
 
 /*==============================================================================
  *  GPIO Pins (LED, USB)
@@ -36,5 +37,9 @@
 #define BOARD_B_RX 17
 #define BOARD_B_TX 16
 
-#define SERIAL_RX_PIN (global_state.board_role == OUTPUT_A ? BOARD_A_RX : BOARD_B_RX)
-#define SERIAL_TX_PIN (global_state.board_role == OUTPUT_A ? BOARD_A_TX : BOARD_B_TX)
+#define SERIAL_RX_PIN (BOARD_SIDE == OUTPUT_A ? BOARD_A_RX : BOARD_B_RX)
+#define SERIAL_TX_PIN (BOARD_SIDE == OUTPUT_A ? BOARD_A_TX : BOARD_B_TX)
+
+/* GP8 / GP9, Pins 11 (TX), 12 (RX) on the Pico board, chain port to the neighbouring DeskHop (uart1) */
+#define CHAIN_TX_PIN 8
+#define CHAIN_RX_PIN 9
@@ -36,6 +36,12 @@ enum packet_type_e {
     PROXY_PACKET_MSG     = 23,
     REQUEST_BYTE_MSG     = 24,
     RESPONSE_BYTE_MSG    = 25,
+    LINK_MSG             = 26,
+    MOUSE_DELTA_MSG      = 27,
+    PASSTHROUGH_MSG      = 28,
+    GAMEPAD_MSG          = 29,
+    /* New messages go above. Types share the byte with the chain destination, see PACKET_TYPE_MASK */
+    PACKET_TYPE_END,
 };
 
 typedef enum {
@@ -62,3 +68,56 @@ typedef struct {
     uint32_t len;
     size_t offset;
 } field_map_t;
+
+/*==============================================================================
+ *  Bulk Config API (WebUSB vendor interface, config mode only)
+ *  Each transfer is a header followed by `length` bytes of payload. GET takes
+ *  a list of field indexes, other payloads are field records. A record is the
+ *  field index, value length (must match api_field_map) and the value itself.
+ *  Multi-byte values are little-endian.
+ *
+ *  Replies carry the current data version. Passing it back in a GET request
+ *  returns only the fields that changed since, 0 returns all of them.
+ *
+ *  A GET reply holds as many records as fit the buffer. If some are left, its
+ *  offset says where to continue, the client asks again with that offset and
+ *  the same version, until a reply comes back with offset 0. The version of
+ *  the first page is the one to poll with next, fields that changed while the
+ *  later pages were read then come back again.
+ *
+ *  Macro commands carry macro_storage_t contents (from start[] onwards), arg
+ *  is the byte offset. Text to type is sent in chunks, arg is the output
+ *  (>= NUM_SCREENS types on the active one).
+ *==============================================================================*/
+
+#define BULK_BUFFER_SIZE 512
+
+enum bulk_cmd_e {
+    BULK_GET_CMD         = 1, // Reply carries a record for each requested field
+    BULK_WRITE_CMD       = 2, // Validate all records, then apply them at once
+    BULK_WRITE_SAVE_CMD  = 3, // Same as above, then save config to flash
+    BULK_MACRO_WRITE_CMD = 4, // Payload is raw macro data, written at offset given in arg
+    BULK_MACRO_READ_CMD  = 5, // Reply carries macro data from offset given in arg
+    BULK_MACRO_SAVE_CMD  = 6, // Save macros to flash
+    BULK_TYPE_TEXT_CMD   = 7, // Payload is UTF-8 text to type on the output given in arg
+    BULK_TRACE_READ_CMD  = 8, // Reply carries recorded trace events, empty if none (or built without DH_TRACE)
+};
+
+enum bulk_status_e {
+    BULK_OK            = 0,
+    BULK_ERR_COMMAND   = 1,
+    BULK_ERR_LENGTH    = 2,
+    BULK_ERR_FIELD     = 3,
+    BULK_ERR_READONLY  = 4,
+    BULK_ERR_FLASH     = 5, // Saving to flash didn't go through, what's in flash can't be trusted
+};
+
+typedef struct {
+    uint8_t start[2];            // START1, START2
+    uint8_t cmd;                 // One of bulk_cmd_e
+    uint8_t status;              // One of bulk_status_e, replies only
+    uint16_t length;             // Length of the payload that follows
+    uint32_t version;            // Request: GET changes since this version, reply: current version
+    uint16_t offset;             // GET request: list position to start at, reply: where the next page starts, 0 if none
+    uint32_t arg;                // Request: command argument (macro offset, output to type on), 0 if unused
+} __attribute__((packed)) bulk_header_t;
@@ -20,6 +20,11 @@
 #define MAX_SCREEN_COORD 32767
 #define MIN_SCREEN_COORD 0
 
+#define MAX_OUTPUT_SCREENS 3                                 // Screens per output, screen_count goes up to this
+#define MAX_LAYOUT_SCREENS (NUM_SCREENS * MAX_OUTPUT_SCREENS) // Screens in the layout, all outputs together
+#define MAX_TRANSITIONS    (MAX_LAYOUT_SCREENS * 6)           // Each screen has few neighbours in a sane layout
+#define NUM_EDGES          4                                 // Left, right, top, bottom
+
 /*==============================================================================
  *  Data Structures
  *==============================================================================*/
@@ -30,6 +35,30 @@ typedef struct {
                 // height
 } border_size_t;
 
+typedef struct {
+    int16_t x; // Top left corner of the screen in the layout, in any unit as long as all screens use the same
+    int16_t y;
+    int16_t w; // Size of the screen, 0 if not set
+    int16_t h;
+} screen_rect_t;
+
+typedef struct {
+    uint16_t lo;    // Part of the edge this entry covers, in the screen's coordinates (lo <= pos < hi)
+    uint16_t hi;
+    uint8_t output; // Where the pointer goes, output ...
+    uint8_t index;  // ... and its screen (0 = main)
+    int64_t scale;  // Position on the target screen's edge = (pos * scale + offset) / 65536
+    int64_t offset;
+} screen_transition_t;
+
+typedef struct {
+    screen_transition_t entry[MAX_TRANSITIONS];     // Sorted by screen, edge and position along the edge
+    uint8_t first[MAX_LAYOUT_SCREENS][NUM_EDGES];   // Where entries for a screen and edge start ...
+    uint8_t count[MAX_LAYOUT_SCREENS][NUM_EDGES];   // ... and how many there are
+    uint8_t length;                                 // Entries used
+    screen_rect_t desktop[MAX_LAYOUT_SCREENS];      // Each screen on its output's whole desktop, 0 - MAX_SCREEN_COORD
+} screen_layout_t;
+
 typedef struct {
     uint8_t mode;
     uint8_t only_if_inactive;
@@ -37,6 +66,22 @@ typedef struct {
     uint64_t max_time_us;
 } screensaver_t;
 
+/* Config keeps remap pairs, the 256 entry tables are only built in RAM (see build_keymap). A full
+   table per output in config wouldn't be editable: config is read and written as API fields with a
+   one byte index, used by the HID API as well as bulk, and only 31 of them are still free. Pairs
+   take 2 fields each, the modifier permutation covers swaps like Cmd/Ctrl without any. */
+#define MAX_KEY_REMAPS 8
+
+typedef struct {
+    uint8_t from; // Key usage as it comes from the keyboard, 0 if unused
+    uint8_t to;   // Key usage sent to the output, modifier usages (0xE0 - 0xE7) set the modifier bit
+} key_remap_t;
+
+typedef struct {
+    uint8_t modifier_map[8];           // Per modifier bit: 0 = unchanged, n = becomes modifier bit n - 1
+    key_remap_t remap[MAX_KEY_REMAPS]; // Key remapping pairs
+} keymap_t;
+
 typedef struct {
     uint32_t number;           // Number of this output (e.g. OUTPUT_A = 0 etc)
     uint32_t screen_count;     // How many monitors per output (e.g. Output A is Windows with 3 monitors)
@@ -47,5 +92,8 @@ typedef struct {
     uint8_t os;                // Operating system on this output
     uint8_t pos;               // Screen position on this output
     uint8_t mouse_park_pos;    // Where the mouse goes after switch
+    uint8_t pointer_mode;      // ABSOLUTE (mouse) or TOUCH (pen digitizer covering all screens)
     screensaver_t screensaver; // Screensaver parameters for this output
+    keymap_t keymap;           // Key remapping applied to keys sent to this output
+    screen_rect_t layout[MAX_OUTPUT_SCREENS]; // Where the screens are, used once all screens of all outputs are set
 } output_t;
@@ -30,5 +30,8 @@
 bool get_packet_from_buffer(device_t *);
 void process_packet(uart_packet_t *, device_t *);
 void queue_packet(const uint8_t *, enum packet_type_e, int);
+void queue_packet_to(const uint8_t *, enum packet_type_e, int, uint8_t);
+void route_packet(uart_packet_t *, uint8_t, device_t *);
 void send_value(const uint8_t, enum packet_type_e);
+void send_value_to(const uint8_t, enum packet_type_e, uint8_t);
 void write_raw_packet(uint8_t *, uart_packet_t *);
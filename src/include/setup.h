@@ -17,5 +17,5 @@
  *==============================================================================*/
 
 void initial_setup(device_t *);
-void serial_init(void);
+void serial_init(uart_inst_t *, uint, uint);
 void core1_main(void);
@@ -29,8 +29,49 @@ typedef struct {
     action_handler_t action_handler;  // What to execute when the key combination is detected
     bool pass_to_os;                  // True if we are to pass the key to the OS too
     bool acknowledge;                 // True if we are to notify the user about registering keypress
+    uint8_t macro;                    // Macro to play instead of the handler (index + 1), 0 if none
 } hotkey_combo_t;
 
+#ifndef MAX_USER_HOTKEYS
+#define MAX_USER_HOTKEYS 8 // Host tests build with more, to benchmark the matcher on larger tables
+#endif
+#define MAX_MACROS       16
+
+typedef struct {
+    uint8_t modifier; // Modifiers that need to be held
+    uint8_t keys[2];  // Keys that need to be pressed, 0 if unused
+    uint8_t action;   // What to execute, see hotkey_action_e
+} user_hotkey_t;
+
+#define KBD_BITMAP_WORDS (256 / 32)
+
+typedef struct {
+    uint32_t keys[KBD_BITMAP_WORDS]; // One bit per key usage, set while the key is held
+    uint8_t modifier;                // Modifier byte, as in the HID report
+} kbd_state_t;
+
+/* Every keyboard we see (a device, interface and report ID) gets its own slot when it's mounted,
+   so keyboards never overwrite each other's keys */
+typedef struct {
+    kbd_state_t state;
+    uint8_t dev_addr;  // Owner, 0 while the slot is free
+    uint8_t instance;
+    uint8_t report_id;
+} kbd_slot_t;
+
+/* Keys the firmware presses on its own are merged like another keyboard, but only on one output */
+enum kbd_source_e {
+    KBD_SOURCE_MACRO = 0, // Macro playback
+    KBD_SOURCE_TEXT  = 1, // Typed text
+    KBD_SOURCES,
+};
+
+typedef struct {
+    kbd_state_t state;
+    uint8_t output; // Output these keys are pressed on
+} injected_kbd_t;
+
+/* Wheel and pan are in 1/MOUSE_SCROLL_RESOLUTION of a detent */
 typedef struct TU_ATTR_PACKED {
     uint8_t buttons;
     int16_t x;
@@ -40,31 +81,237 @@ typedef struct TU_ATTR_PACKED {
     uint8_t mode;
 } mouse_report_t;
 
+/* What our mouse endpoints send to the host, see TUD_HID_REPORT_DESC_MOUSE_COMMON */
+typedef struct TU_ATTR_PACKED {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int16_t wheel;
+    int16_t pan;
+} hid_mouse_out_t;
+
+/* Resolution Multiplier feature of a mouse endpoint, as set by the host */
+#define SCROLL_HIRES_WHEEL 0x03
+#define SCROLL_HIRES_PAN   0x0C
+
+/* Scrolling for a host that wants whole detents, what's left over waits for the next report */
 typedef struct {
+    uint8_t multiplier; // Feature byte the host set, 0 = whole detents
+    int16_t wheel;      // Less than a detent, in 1/MOUSE_SCROLL_RESOLUTION
+    int16_t pan;
+} host_scroll_t;
+
+/* One mouse report in a MOUSE_DELTA_MSG, relative to the one before */
+typedef struct TU_ATTR_PACKED {
+    uint8_t buttons;
+    int8_t x;       // Pointer movement in screen coordinates
+    int8_t y;
+    uint8_t scroll; // Wheel in the upper, pan in the lower 4 bits, see mouse_link.h
+} mouse_delta_t;
+
+typedef struct TU_ATTR_PACKED {
     uint8_t tip_pressure;
-    uint8_t buttons; // Digitizer buttons
+    uint8_t buttons; // Digitizer buttons (PEN_*)
     uint16_t x;      // X coordinate (0-32767)
     uint16_t y;      // Y coordinate (0-32767)
 } touch_report_t;
 
+/* Digitizer buttons, in the order TUD_HID_REPORT_DESC_DIGITIZER_PEN declares them */
+#define PEN_IN_RANGE 0x01
+#define PEN_TIP      0x02
+#define PEN_ERASER   0x04
+#define PEN_BARREL   0x08
+
 typedef struct {
     uint8_t instance;
     uint8_t report_id;
     uint8_t type;
     uint8_t len;
-    uint8_t data[RAW_PACKET_LENGTH];
+    uint8_t data[HID_GENERIC_LENGTH];
 } hid_generic_pkt_t;
 
 typedef enum { IDLE, READING_PACKET, PROCESSING_PACKET } receiver_state_t;
 
+enum latency_hop_e {
+    LAT_HOP_PARSE   = 0, // Report received from the device -> parsed
+    LAT_HOP_ENQUEUE = 1, // Parsed -> queued for output, locally or to the other board
+    LAT_HOP_UART_TX = 2, // Queued -> UART transfer started
+    LAT_HOP_LINK    = 3, // Received from the device on the other board -> UART receive here
+    LAT_HOP_DEVICE  = 4, // Queued -> report sent to the host
+    LAT_HOP_TOTAL   = 5, // Received from the device (on either board) -> report sent to the host
+    LAT_NUM_HOPS,
+};
+
+#define LAT_NUM_BUCKETS 8 // Bucket n counts samples below (64 us << n), the last one everything slower
+
+enum stats_queue_e {
+    STATS_KBD_QUEUE   = 0,
+    STATS_MOUSE_QUEUE = 1,
+    STATS_UART_QUEUE  = 2,
+    STATS_HID_QUEUE   = 3,
+    STATS_NUM_QUEUES,
+};
+
+enum stats_report_e {
+    STATS_KBD_REPORTS   = 0,
+    STATS_MOUSE_REPORTS = 1,
+    STATS_OTHER_REPORTS = 2, // Anything not using the keyboard or mouse interface protocol
+    STATS_NUM_REPORTS,
+};
+
+typedef struct {
+    /* Counted where it happens */
+    uint32_t kbd_duplicates;                       // Keyboard reports dropped, identical to the last one queued
+    uint32_t kbd_coalesced;                        // Queued keyboard reports skipped while the host was catching up
+    uint32_t mouse_merged;                         // Mouse reports added to the next one instead of going out alone
+    uint32_t queue_drops[STATS_NUM_QUEUES];        // Items lost because the queue was full
+    uint16_t queue_peak[STATS_NUM_QUEUES];         // Highest queue level since the last update
+    uint32_t uart_rx_packets;                      // Packets received from the other board
+    uint32_t uart_checksum_errors;                 // Packets received with a bad checksum
+    uint32_t uart_skipped_bytes;                   // Bytes skipped while looking for the start of a packet
+    uint32_t host_reports[STATS_NUM_REPORTS];      // Reports received from USB devices
+    uint32_t loops[2];                             // Main loop passes, per core
+    uint32_t flash_errors;                         // Flash erases or writes that didn't go through
+
+    /* Updated once a second by stats_task */
+    uint16_t queue_peak_level[STATS_NUM_QUEUES];   // Highest queue level during the last second
+    uint32_t uart_rx_rate;                         // Packets per second from the other board
+    uint32_t host_report_rate[STATS_NUM_REPORTS];  // Reports per second from USB devices
+    uint32_t loop_rate[2];                         // Main loop passes per second, per core
+} stats_t;
+
+typedef struct {
+    uint32_t hist[LAT_NUM_HOPS][LAT_NUM_BUCKETS]; // Sample count per hop and bucket
+    uint16_t clock_offset;                         // Our clock - other board's clock (us, low 16 bits)
+    bool clock_synced;                             // Offset is known, set on the first heartbeat
+} latency_t;
+
+typedef struct {
+    uint8_t op;    // One of link_op_e
+    uint8_t rung;  // Rate ladder rung the negotiation is about
+    uint8_t token; // Identifies the negotiation
+    uint8_t arg;   // Checksum errors seen during the trial (probe acks)
+} link_msg_t;
+
+typedef struct {
+    /* Written by the packet receiver (core1), picked up by link_task */
+    link_msg_t msg;                   // Last negotiation message received
+    volatile bool msg_pending;        // Set once msg is filled in
+    volatile uint16_t peer_errors;    // Checksum errors the other board reported in its last heartbeat
+    volatile uint32_t heartbeats;     // Heartbeats received from the other board
+
+    /* Owned by link_task (core0) */
+    uint8_t state;                    // One of link_state_e
+    uint8_t rung;                     // Current rung of the rate ladder
+    uint8_t target;                   // Rung being switched to
+    uint8_t prev_rung;                // Rung to go back to if the trial fails
+    uint8_t token;                    // Identifies the current negotiation
+    uint8_t acks;                     // Probes answered during the trial
+    bool master;                      // This board decides when to change the rate
+    uint8_t bad_windows;              // Consecutive windows with too many errors
+    uint16_t clean_windows;           // Consecutive windows without errors
+    uint16_t step_up_windows;         // Clean windows needed before trying a faster rate
+    uint32_t trial_errors;            // Checksum error count when the trial started
+    uint64_t deadline;                // When the current step of the negotiation times out (us)
+    uint64_t next_probe;              // When to send the next probe during a trial (us)
+    uint64_t next_window;             // When the current error window ends (us)
+    uint64_t last_rx;                 // Last time a valid packet came in (us)
+    uint32_t seen_rx_packets;         // Valid packets counted at the last check
+    uint32_t window_rx_packets;       // Counters at the start of the window
+    uint32_t window_errors;
+    uint32_t window_heartbeats;
+    uint16_t window_peer_errors;
+
+    /* Exposed through the API */
+    uint32_t baud;                    // Baud rate currently used
+    uint32_t rate_changes;            // Rate changes, negotiated or falling back to the default
+    uint32_t rollbacks;               // Negotiations that failed and went back to the previous rate
+} link_t;
+
+typedef struct {
+    uint8_t address;              // Our position along the chain, same as board_role
+    uint8_t boards;               // Boards in the chain (NUM_SCREENS)
+    uint8_t route[NUM_SCREENS];   // Port leading towards each board, CHAIN_LOCAL for ourselves
+    bool next_port;               // True if there's another DeskHop on the chain port
+
+    /* Chain port (second UART) */
+    queue_t tx_queue;             // Packets waiting to go out on the chain port
+    uart_packet_t in_packet;      // Packet being received on the chain port
+    uint32_t dma_ptr;             // Last checked position of the receive ring
+    uint32_t dma_rx_channel;
+    uint32_t dma_control_channel;
+    uint32_t dma_tx_channel;
+
+    /* Exposed through the API */
+    uint32_t forwarded;           // Packets passed on towards another board
+    uint32_t rx_packets;          // Packets received on the chain port
+    uint32_t checksum_errors;     // Packets received on the chain port with a bad checksum
+} chain_t;
+
+typedef struct {
+    mouse_report_t pending[MOUSE_DELTA_EVENTS]; // Reports held back while the link is behind, one per button state
+    uint8_t count;                              // How many of them
+    uint8_t output;                             // Output they are for
+    bool synced;                                // Other board has our last absolute position, deltas can follow
+    int16_t x;                                  // Position the other board is at once everything is sent
+    int16_t y;
+    uint64_t next_keyframe;                     // When to send the full absolute position again (us)
+
+    /* Exposed through the API */
+    uint32_t reports;                           // Mouse reports for other boards
+    uint32_t frames;                            // Link frames they went out in
+} mouse_link_t;
+
+typedef struct {
+    hid_gamepad_report_t latest; // Newest state of our gamepad, for another board
+    hid_gamepad_report_t sent;   // What that board was told so far
+    hid_gamepad_report_t host;   // Last state queued for our own host
+    hid_gamepad_report_t remote; // Put together from GAMEPAD_MSG frames
+    uint8_t output;              // Output our gamepad's state went to last
+    bool pending;                // 'latest' is waiting for the link
+    bool synced;                 // Board at 'output' has 'sent', changes can follow
+    uint64_t next_keyframe;      // When to send the full state again (us)
+    bool present;                // There's a gamepad on one of the boards
+} gamepad_link_t;
+
+/* PASSTHROUGH_MSG being put back together */
+typedef struct {
+    uint8_t data[PASSTHROUGH_DESC_MAX];
+    uint16_t len;      // Total length, from the first frame
+    uint16_t received; // Bytes collected so far
+    uint8_t kind;      // PASS_FRAME_DESCRIPTOR or 0 for a report
+    uint8_t next;      // Frame expected next, 0 while waiting for a first one
+} passthrough_rx_t;
+
+typedef struct {
+    uint8_t desc[PASSTHROUGH_DESC_MAX];          // Report descriptor offered to our host as ITF_NUM_HID_PASS
+    uint16_t desc_len;                           // 0 while there's nothing mirrored
+    bool offered;                                // Host enumerated with the descriptor, reports can go to it
+
+    uint8_t source_addr;                         // Device the descriptor came from, 0 if it's not plugged in here
+    uint8_t source_instance;
+    bool desc_requested;                         // Asked the other boards for the descriptor already
+
+    uint8_t pending[PASSTHROUGH_REPORT_MAX + 1]; // Report held back while the link is busy, report ID first
+    uint8_t pending_len;                         // 0 if there's none
+    uint8_t pending_output;                      // Output it's for
+    passthrough_rx_t rx;                         // Message arriving from the link
+} passthrough_t;
+
 typedef struct {
     uint32_t address;         // Address we're sending to the other box
     uint32_t checksum;
     uint16_t version;
     bool byte_done;           // Has the byte been successfully transferred
     bool upgrade_in_progress; // True if firmware transfer from the other box is in progress
+    uint32_t erased_until;    // Offset up to which the running image was erased (UF2 upload)
 } fw_upgrade_state_t;
 
+typedef struct {
+    uint32_t block_no;              // UF2 block number, maps to a flash page
+    uint8_t data[FLASH_PAGE_SIZE];  // Page contents to be programmed
+} fw_page_t;
+
 typedef struct {
     uint32_t magic_header;
     uint32_t version;
@@ -80,7 +327,9 @@ typedef struct {
     uint16_t jump_threshold;
 
     output_t output[NUM_SCREENS];
-    uint32_t _reserved;
+    user_hotkey_t user_hotkeys[MAX_USER_HOTKEYS];
+    uint8_t chain_pair;    // Which DeskHop along the chain this is (0 = outputs A/B, 1 = C/D, ...)
+    uint8_t _reserved[3];
 
     // Keep checksum at the end of the struct
     uint32_t checksum;
@@ -98,22 +347,31 @@ typedef struct {
     uint8_t keyboard_leds_actual[NUM_SCREENS];   // Actual state of keyboard LEDs
     uint64_t last_activity[NUM_SCREENS]; // Timestamp of the last input activity (-||-)
     uint32_t core1_last_loop_pass;       // Timestamp of last core1 loop execution
-    uint8_t active_output;               // Currently selected output (0 = A, 1 = B)
+    uint8_t active_output;               // Currently selected output (0 = A, 1 = B, etc.)
     uint8_t board_role;                  // Which board are we running on? (0 = A, 1 = B, etc.)
 
-    hid_keyboard_report_t local_kbd_states[MAX_DEVICES]; // Store keyboard states
-    hid_keyboard_report_t remote_kbd_state;              // Store combined remote keyboard state
-    uint8_t max_kbd_idx;                                 // Store largest kbd_idx seen
+    kbd_slot_t kbd_slots[MAX_KBD_SLOTS]; // State of each local keyboard
+    uint16_t kbd_slots_used;             // Bit per slot that has an owner, only these are combined
+    kbd_state_t remote_kbd_state;        // Store combined remote keyboard state
+    uint8_t combined_keys[KEYS_IN_USB_REPORT]; // Keys in the last combined report, see combine_kbd_states
+    injected_kbd_t injected_kbd[KBD_SOURCES];  // Keys held by the firmware itself, see inject_keys
 
     int16_t pointer_x; // Store and update the location of our mouse pointer
     int16_t pointer_y;
     int16_t mouse_buttons; // Store and update the state of mouse buttons
 
+    mouse_values_t mouse_pending; // Mouse movement added up until the host can take another report
+    bool mouse_has_pending;       // There is some
+    uint64_t mouse_last_output;   // When the last mouse report was output (us)
+    host_scroll_t host_scroll[2]; // Per mouse endpoint, indexed by ABSOLUTE / RELATIVE
+
     config_t config;       // Device configuration, loaded from flash or defaults used
     queue_t hid_queue_out; // Queue that stores outgoing hid messages
     queue_t kbd_queue;     // Queue that stores keyboard reports
     queue_t mouse_queue;   // Queue that stores mouse reports
     queue_t uart_tx_queue; // Queue that stores outgoing packets
+    queue_t fw_queue;      // Queue that stores received UF2 pages waiting to be flashed
+    queue_t text_queue;    // Queue that stores text waiting to be typed
 
     hid_interface_t iface[MAX_DEVICES][MAX_INTERFACES]; // Store info about HID interfaces
     uart_packet_t in_packet;
@@ -129,6 +387,7 @@ typedef struct {
     firmware_metadata_t _running_fw; // RAM copy of running fw metadata
     bool reboot_requested;           // If set, stop updating watchdog
     uint64_t config_mode_timer;      // Counts how long are we to remain in config mode
+    uint16_t read_all_left;          // Fields a "read all" request still has to send
 
     uint8_t page_buffer[FLASH_PAGE_SIZE]; // For firmware-over-serial upgrades
 
@@ -144,7 +403,19 @@ typedef struct {
     bool relative_mouse;     // True when relative mouse mode is used
     bool gaming_mode;        // True when gaming mode is on (relative passthru + lock)
     bool config_mode_active; // True when config mode is active
-    bool digitizer_active;   // True when digitizer Win/Mac workaround is active
+    bool digitizer_active;   // True when our host was offered the pen digitizer, see TOUCH
+    bool gamepad_active;     // True when our host was offered the gamepad, see gamepad.h
+    bool descriptors_changed; // We offer something new, our host has to enumerate again
+    uint64_t reconnect_at;   // Connecting to our host again at this time, 0 if not (core0 only)
+
+    /* Statistics */
+    stats_t stats;           // Runtime counters
+    latency_t latency;       // Input latency histograms
+    link_t link;             // Health and baud rate of the link to the other board
+    chain_t chain;           // Routing to boards further along the chain
+    mouse_link_t mouse_link; // Mouse reports on their way to other boards
+    passthrough_t passthrough; // Device we don't understand, mirrored to the host
+    gamepad_link_t gamepad;  // Gamepad state on its way to the active output
 
     /* Onboard LED blinky (provide feedback when e.g. mouse connected) */
     int32_t  blinks_left;     // How many blink transitions are left
@@ -173,6 +444,8 @@ enum screen_pos_e {
     LEFT   = 1,
     RIGHT  = 2,
     MIDDLE = 3,
+    TOP    = 4,
+    BOTTOM = 5,
 };
 
 enum screensaver_mode_e {
@@ -182,9 +455,30 @@ enum screensaver_mode_e {
     MAX_SS_VAL = JITTER,
 };
 
+enum hotkey_action_e {
+    HOTKEY_ACTION_NONE               = 0,
+    HOTKEY_ACTION_OUTPUT_TOGGLE      = 1,
+    HOTKEY_ACTION_SWITCH_LOCK        = 2,
+    HOTKEY_ACTION_SCREEN_LOCK        = 3,
+    HOTKEY_ACTION_GAMING_MODE        = 4,
+    HOTKEY_ACTION_MOUSE_ZOOM         = 5,
+    HOTKEY_ACTION_SCREENSAVER_PONG   = 6,
+    HOTKEY_ACTION_SCREENSAVER_JITTER = 7,
+    HOTKEY_ACTION_SCREENSAVER_OFF    = 8,
+    HOTKEY_ACTION_SCREEN_BORDER      = 9,
+    HOTKEY_ACTION_CONFIG_MODE        = 10,
+    HOTKEY_ACTION_WIPE_CONFIG        = 11,
+    HOTKEY_ACTION_FW_UPGRADE_A       = 12,
+    HOTKEY_ACTION_FW_UPGRADE_B       = 13,
+    MAX_HOTKEY_ACTION                = HOTKEY_ACTION_FW_UPGRADE_B,
+
+    /* Actions from here on play macro (action - HOTKEY_ACTION_MACRO) */
+    HOTKEY_ACTION_MACRO              = 32,
+};
+
 extern const config_t default_config;
 extern const config_t ADDR_CONFIG[];
+extern const uint8_t ADDR_MACROS[];
 extern const uint8_t ADDR_FW_METADATA[];
 extern const uint8_t ADDR_FW_RUNNING[];
 extern const uint8_t ADDR_FW_STAGING[];
-extern const uint8_t ADDR_DISK_IMAGE[];
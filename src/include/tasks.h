@@ -27,11 +27,17 @@ void heartbeat_output_task(device_t *);
 void kick_watchdog_task(device_t *);
 void led_blinking_task(device_t *);
 void led_sync_task(device_t *);
+void link_task(device_t *);
 void packet_receiver_task(device_t *);
 void process_hid_queue_task(device_t *);
 void process_kbd_queue_task(device_t *);
+void process_macro_task(device_t *);
+void process_fw_queue_task(device_t *);
 void process_mouse_queue_task(device_t *);
+void process_text_task(device_t *);
 void process_uart_tx_task(device_t *);
 void screensaver_task(device_t *);
+void stats_task(device_t *);
 void usb_device_task(device_t *);
 void usb_host_task(device_t *);
+void usb_reconnect_task(device_t *);
@@ -0,0 +1,101 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include "structs.h"
+
+/*==============================================================================
+ *  Event Trace (built with -DDH_TRACE)
+ *  Each core records fixed-size binary events into its own ring. The core is
+ *  the only writer of its head and the reader the only writer of the tail,
+ *  so no locks are needed. When a ring is full, new events are counted as
+ *  dropped instead. Rings are drained lazily over the vendor interface (config
+ *  mode) or CDC (debug builds), misc/trace_decode.py turns them into Chrome
+ *  trace JSON.
+ *==============================================================================*/
+
+#define TRACE_RING_SIZE   512 // Records per core, must be a power of two
+#define TRACE_NUM_CORES   2
+#define TRACE_TASK_MIN_US 5   // Shorter task passes aren't recorded, idle polling would flood the ring
+#define TRACE_CDC_LENGTH  (START_LENGTH + sizeof(trace_record_t) + CHECKSUM_LENGTH)
+
+enum trace_event_e {
+    TRACE_DROPPED         = 0,  // arg1 = records lost because the ring was full
+    TRACE_TASK            = 1,  // Task finished, arg0 = duration (us), arg1 = task function
+    TRACE_HOST_MOUNT      = 2,  // arg0 = dev_addr << 8 | instance, arg1 = interface protocol
+    TRACE_HOST_UMOUNT     = 3,  // arg0 = dev_addr << 8 | instance, arg1 = interface protocol
+    TRACE_HOST_REPORT     = 4,  // arg0 = dev_addr << 8 | instance, arg1 = report length
+    TRACE_KBD_QUEUED      = 5,  // arg0 = queue level
+    TRACE_KBD_SENT        = 6,  // arg0 = queue level
+    TRACE_MOUSE_QUEUED    = 7,  // arg0 = queue level
+    TRACE_MOUSE_SENT      = 8,  // arg0 = queue level
+    TRACE_UART_QUEUED     = 9,  // arg0 = packet type, arg1 = queue level
+    TRACE_UART_TX         = 10, // arg0 = packet type, arg1 = queue level
+    TRACE_UART_RX         = 11, // arg0 = packet type
+};
+
+typedef struct {
+    uint32_t time;  // time_us_32() when the event happened
+    uint8_t core;   // Core that recorded it
+    uint8_t event;  // One of trace_event_e
+    uint16_t arg0;
+    uint32_t arg1;
+} trace_record_t;
+
+typedef struct {
+    trace_record_t records[TRACE_RING_SIZE];
+    volatile uint32_t head;    // Next record to write, only the owning core changes it
+    volatile uint32_t tail;    // Next record to read, only the reader changes it
+    volatile uint32_t dropped; // Events lost since the last read
+} trace_ring_t;
+
+/*==============================================================================
+ *  Trace Functions
+ *==============================================================================*/
+
+#ifdef DH_TRACE
+
+extern trace_ring_t trace_rings[TRACE_NUM_CORES];
+
+/* Interrupts are held off only while the slot is claimed, so an IRQ handler can trace too */
+static inline void trace_event(uint8_t event, uint16_t arg0, uint32_t arg1) {
+    uint8_t core       = get_core_num();
+    trace_ring_t *ring = &trace_rings[core];
+    uint32_t irq       = save_and_disable_interrupts();
+    uint32_t head      = ring->head;
+
+    if (head - ring->tail < TRACE_RING_SIZE) {
+        ring->records[head & (TRACE_RING_SIZE - 1)] = (trace_record_t){time_us_32(), core, event, arg0, arg1};
+        __dmb();
+        ring->head = head + 1;
+    } else {
+        ring->dropped++;
+    }
+
+    restore_interrupts(irq);
+}
+
+#define TRACE(event, arg0, arg1) trace_event((event), (arg0), (arg1))
+
+uint16_t read_trace(uint8_t *, uint16_t);
+
+#ifdef DH_DEBUG
+void     trace_cdc_task(device_t *);
+#endif
+
+#else
+
+#define TRACE(event, arg0, arg1) ((void)0)
+
+#endif
@@ -121,17 +121,25 @@ extern int dh_debug_printf(const char *__restrict __format, ...);
 // Enable MSC (Mass Storage Class) class.
 #define CFG_TUD_MSC    1
 
+// Enable vendor class (WebUSB bulk config API, config mode only).
+#define CFG_TUD_VENDOR 1
+
 /*==============================================================================
  *  Device: Endpoint Buffer Sizes
  *  Configuration for endpoint buffer sizes for different classes.
  *==============================================================================*/
 
 // HID endpoint buffer size (must be large enough for report ID + data).
-#define CFG_TUD_HID_EP_BUFSIZE 32
+#define CFG_TUD_HID_EP_BUFSIZE 64
 
 // MSC endpoint buffer size.
 #define CFG_TUD_MSC_EP_BUFSIZE 512
 
+// Vendor FIFO sizes, a complete bulk API response must fit in the TX FIFO.
+#define CFG_TUD_VENDOR_EPSIZE     64
+#define CFG_TUD_VENDOR_RX_BUFSIZE 64
+#define CFG_TUD_VENDOR_TX_BUFSIZE 512
+
 /*==============================================================================
  *  Host: Enumeration Buffer Size
  *  Configuration for the buffer used during device enumeration.
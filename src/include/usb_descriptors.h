@@ -21,15 +21,21 @@
 // Interface 1
 #define REPORT_ID_RELMOUSE  5
 #define REPORT_ID_DIGITIZER 7
+#define REPORT_ID_GAMEPAD   8
 
 // Interface 2
 #define REPORT_ID_VENDOR 6
 
+// Interface 4 (WebUSB bulk config API), vendor control request codes
+#define VENDOR_REQUEST_WEBUSB    1
+#define VENDOR_REQUEST_MICROSOFT 2
 
-#define DEVICE_DESCRIPTOR(vid, pid) \
+
+/* USB 2.1 (bcd 0x0210) makes the host ask for the BOS descriptor */
+#define DEVICE_DESCRIPTOR(vid, pid, bcd) \
 {.bLength         = sizeof(tusb_desc_device_t),\
   .bDescriptorType = TUSB_DESC_DEVICE,\
-  .bcdUSB          = 0x0200,\
+  .bcdUSB          = bcd,\
   .bDeviceClass    = 0x00,\
   .bDeviceSubClass = 0x00,\
   .bDeviceProtocol = 0x00,\
@@ -73,27 +79,49 @@
         HID_REPORT_COUNT ( 2                                     ) ,\
         HID_INPUT       ( HID_DATA | HID_VARIABLE | ABS_OR_REL   ) ,\
         \
-        /* Vertical wheel scroll [-127, 127] */ \
-        HID_USAGE       ( HID_USAGE_DESKTOP_WHEEL                ) ,\
-        HID_LOGICAL_MIN ( 0x81                                   ) ,\
-        HID_LOGICAL_MAX ( 0x7f                                   ) ,\
-        HID_REPORT_COUNT( 1                                      ) ,\
-        HID_REPORT_SIZE ( 8                                      ) ,\
-        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE ) ,\
+        /* Vertical wheel [-32767, 32767], MOUSE_SCROLL_RESOLUTION per detent with the multiplier on */ \
+        HID_COLLECTION  ( HID_COLLECTION_LOGICAL                 ) ,\
+          HID_USAGE       ( HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER ),\
+          HID_LOGICAL_MIN ( 0                                      ) ,\
+          HID_LOGICAL_MAX ( 1                                      ) ,\
+          HID_PHYSICAL_MIN( 1                                      ) ,\
+          HID_PHYSICAL_MAX( MOUSE_SCROLL_RESOLUTION                ) ,\
+          HID_REPORT_COUNT( 1                                      ) ,\
+          HID_REPORT_SIZE ( 2                                      ) ,\
+          HID_FEATURE     ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+          HID_PHYSICAL_MIN( 0                                      ) ,\
+          HID_PHYSICAL_MAX( 0                                      ) ,\
+          \
+          HID_USAGE       ( HID_USAGE_DESKTOP_WHEEL                ) ,\
+          HID_LOGICAL_MIN_N( -32767, 2                             ) ,\
+          HID_LOGICAL_MAX_N( 32767, 2                              ) ,\
+          HID_REPORT_SIZE ( 16                                     ) ,\
+          HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE ) ,\
+        HID_COLLECTION_END                                         ,\
         \
-        /* Horizontal wheel (AC Pan) */ \
-        HID_USAGE_PAGE  ( HID_USAGE_PAGE_CONSUMER                ) ,\
-        HID_LOGICAL_MIN ( 0x81                                   ) ,\
-        HID_LOGICAL_MAX ( 0x7f                                   ) ,\
-        HID_REPORT_COUNT( 1                                      ) ,\
-        HID_REPORT_SIZE ( 8                                      ) ,\
-        HID_USAGE_N     ( HID_USAGE_CONSUMER_AC_PAN, 2           ) ,\
-        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE ) ,\
+        /* Horizontal wheel (AC Pan), same as above */ \
+        HID_COLLECTION  ( HID_COLLECTION_LOGICAL                 ) ,\
+          HID_USAGE       ( HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER ),\
+          HID_LOGICAL_MIN ( 0                                      ) ,\
+          HID_LOGICAL_MAX ( 1                                      ) ,\
+          HID_PHYSICAL_MIN( 1                                      ) ,\
+          HID_PHYSICAL_MAX( MOUSE_SCROLL_RESOLUTION                ) ,\
+          HID_REPORT_SIZE ( 2                                      ) ,\
+          HID_FEATURE     ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+          HID_PHYSICAL_MIN( 0                                      ) ,\
+          HID_PHYSICAL_MAX( 0                                      ) ,\
+          \
+          HID_USAGE_PAGE  ( HID_USAGE_PAGE_CONSUMER                ) ,\
+          HID_USAGE_N     ( HID_USAGE_CONSUMER_AC_PAN, 2           ) ,\
+          HID_LOGICAL_MIN_N( -32767, 2                             ) ,\
+          HID_LOGICAL_MAX_N( 32767, 2                              ) ,\
+          HID_REPORT_SIZE ( 16                                     ) ,\
+          HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE ) ,\
+        HID_COLLECTION_END                                         ,\
         \
-        /* Mouse mode (0 = absolute, 1 = relative) */ \
-        HID_REPORT_COUNT( 1                                      ), \
-        HID_REPORT_SIZE ( 8                                      ), \
-        HID_INPUT       ( HID_CONSTANT                           ), \
+        /* Pad the multipliers to a full byte */ \
+        HID_REPORT_SIZE ( 4                                      ) ,\
+        HID_FEATURE     ( HID_CONSTANT                           ) ,\
     HID_COLLECTION_END                                            , \
   HID_COLLECTION_END \
 
@@ -11,11 +11,13 @@
 
 #include "main.h"
 
+_Static_assert(MAX_KBD_SLOTS <= 16, "kbd_slots_used has a bit per keyboard slot");
+
 /* ==================================================== *
  * Hotkeys to trigger actions via the keyboard.
  * ==================================================== */
 
-hotkey_combo_t hotkeys[] = {
+const hotkey_combo_t hotkeys[] = {
     /* Main keyboard switching hotkey */
     {.modifier       = HOTKEY_MODIFIER,
      .keys           = {HOTKEY_TOGGLE},
@@ -124,13 +126,13 @@ bool key_in_report(uint8_t key, const hid_keyboard_report_t *report) {
 }
 
 /* Check if the current report matches a specific hotkey passed on */
-bool check_specific_hotkey(hotkey_combo_t keypress, const hid_keyboard_report_t *report) {
+bool check_specific_hotkey(const hotkey_combo_t *keypress, const hid_keyboard_report_t *report) {
     /* We expect all modifiers specified to be detected in the report */
-    if (keypress.modifier != (report->modifier & keypress.modifier))
+    if (keypress->modifier != (report->modifier & keypress->modifier))
         return false;
 
-    for (int n = 0; n < keypress.key_count; n++) {
-        if (!key_in_report(keypress.keys[n], report)) {
+    for (int n = 0; n < keypress->key_count; n++) {
+        if (!key_in_report(keypress->keys[n], report)) {
             return false;
         }
     }
@@ -139,93 +141,431 @@ bool check_specific_hotkey(hotkey_combo_t keypress, const hid_keyboard_report_t
     return true;
 }
 
-/* Go through the list of hotkeys, check if any of them match. */
-hotkey_combo_t *check_all_hotkeys(hid_keyboard_report_t *report, device_t *state) {
-    for (int n = 0; n < ARRAY_SIZE(hotkeys); n++) {
-        if (check_specific_hotkey(hotkeys[n], report)) {
-            return &hotkeys[n];
+/* ==================================================== *
+ * Hotkey matcher, built from the table above and the
+ * user defined hotkeys in config. Hotkeys are bucketed by
+ * their first key, so a report only checks the hotkeys
+ * starting with one of its keys (and the modifier-only
+ * ones). Most reports don't hit any bucket at all.
+ *
+ * The modifier isn't part of the bucket key. A hotkey
+ * only needs its own modifiers held, others may be held
+ * too (Right Ctrl + K still locks with Shift down). With
+ * (modifier, key) buckets, a report would have to look up
+ * every subset of its modifier byte, up to 256 of them
+ * per key. Modifiers are checked within the bucket instead.
+ * ==================================================== */
+
+#define MAX_HOTKEYS (ARRAY_SIZE(hotkeys) + MAX_USER_HOTKEYS)
+
+const int builtin_hotkey_count = ARRAY_SIZE(hotkeys);
+
+typedef struct {
+    hotkey_combo_t combo[MAX_HOTKEYS]; // All hotkeys, in priority order
+    uint8_t next[MAX_HOTKEYS];         // Next hotkey in the same bucket (index + 1), 0 = end
+    uint8_t bucket[256];               // First hotkey (index + 1) per first key, [0] = modifier only
+    uint8_t count;                     // How many hotkeys are in use
+} hotkey_matcher_t;
+
+/* ==================================================== *
+ * Per-output key remapping. The keymaps from config are
+ * expanded into full lookup tables, so remapping a report
+ * costs one table lookup per key plus one for modifiers.
+ * ==================================================== */
+
+typedef struct {
+    uint8_t keys[256];     // Key usage -> key usage sent to the output
+    uint8_t modifier[256]; // Modifier byte -> modifier byte sent to the output
+} keymap_table_t;
+
+/* Config is changed on core0, while core1 keeps matching and remapping reports. So the tables
+   are built in a spare copy, then switched to with a single pointer write once complete. The
+   copy core1 was using is only rebuilt on the next config change, by then it's long done with
+   the report it was processing. */
+typedef struct {
+    hotkey_matcher_t matcher;
+    keymap_table_t keymaps[NUM_SCREENS];
+} keyboard_tables_t;
+
+static keyboard_tables_t tables[2];
+static keyboard_tables_t *volatile active_tables = &tables[0];
+
+static const keyboard_tables_t *get_keyboard_tables(void) {
+    const keyboard_tables_t *current = active_tables;
+    __dmb();
+    return current;
+}
+
+/* Actions a user defined hotkey can be bound to */
+static const action_handler_t hotkey_actions[] = {
+    [HOTKEY_ACTION_OUTPUT_TOGGLE]      = &output_toggle_hotkey_handler,
+    [HOTKEY_ACTION_SWITCH_LOCK]        = &switchlock_hotkey_handler,
+    [HOTKEY_ACTION_SCREEN_LOCK]        = &screenlock_hotkey_handler,
+    [HOTKEY_ACTION_GAMING_MODE]        = &toggle_gaming_mode_handler,
+    [HOTKEY_ACTION_MOUSE_ZOOM]         = &mouse_zoom_hotkey_handler,
+    [HOTKEY_ACTION_SCREENSAVER_PONG]   = &enable_screensaver_pong_hotkey_handler,
+    [HOTKEY_ACTION_SCREENSAVER_JITTER] = &enable_screensaver_jitter_hotkey_handler,
+    [HOTKEY_ACTION_SCREENSAVER_OFF]    = &disable_screensaver_hotkey_handler,
+    [HOTKEY_ACTION_SCREEN_BORDER]      = &screen_border_hotkey_handler,
+    [HOTKEY_ACTION_CONFIG_MODE]        = &config_enable_hotkey_handler,
+    [HOTKEY_ACTION_WIPE_CONFIG]        = &wipe_config_hotkey_handler,
+    [HOTKEY_ACTION_FW_UPGRADE_A]       = &fw_upgrade_hotkey_handler_A,
+    [HOTKEY_ACTION_FW_UPGRADE_B]       = &fw_upgrade_hotkey_handler_B,
+};
+
+/* Convert a user hotkey from config, returns false if it's unused or invalid */
+static bool load_user_hotkey(const user_hotkey_t *config, hotkey_combo_t *hotkey) {
+    bool is_macro = config->action >= HOTKEY_ACTION_MACRO && config->action < HOTKEY_ACTION_MACRO + MAX_MACROS;
+
+    if (config->action == HOTKEY_ACTION_NONE || (config->action > MAX_HOTKEY_ACTION && !is_macro))
+        return false;
+
+    *hotkey = (hotkey_combo_t){
+        .modifier       = config->modifier,
+        .action_handler = is_macro ? NULL : hotkey_actions[config->action],
+        .macro          = is_macro ? config->action - HOTKEY_ACTION_MACRO + 1 : 0,
+        .acknowledge    = true,
+    };
+
+    for (int i = 0; i < ARRAY_SIZE(config->keys); i++)
+        if (config->keys[i] != 0)
+            hotkey->keys[hotkey->key_count++] = config->keys[i];
+
+    /* A hotkey without any keys or modifiers would match every report */
+    return hotkey->key_count || hotkey->modifier;
+}
+
+/* Build the matcher from the hotkey config */
+static void build_hotkey_matcher(device_t *state, hotkey_matcher_t *matcher) {
+    memset(matcher, 0, sizeof(hotkey_matcher_t));
+
+    /* Built-in hotkeys take priority over the user defined ones */
+    for (int n = 0; n < ARRAY_SIZE(hotkeys); n++)
+        matcher->combo[matcher->count++] = hotkeys[n];
+
+    /* Main toggle key is configurable, the compile time one is the default */
+    if (state->config.hotkey_toggle)
+        matcher->combo[0].keys[0] = state->config.hotkey_toggle;
+
+    for (int n = 0; n < MAX_USER_HOTKEYS; n++)
+        if (load_user_hotkey(&state->config.user_hotkeys[n], &matcher->combo[matcher->count]))
+            matcher->count++;
+
+    /* Going backwards and prepending keeps each bucket sorted by priority */
+    for (int n = matcher->count - 1; n >= 0; n--) {
+        const hotkey_combo_t *hotkey = &matcher->combo[n];
+        uint8_t first_key            = hotkey->key_count ? hotkey->keys[0] : 0;
+
+        matcher->next[n]           = matcher->bucket[first_key];
+        matcher->bucket[first_key] = n + 1;
+    }
+}
+
+/* Look for a match in a bucket with a higher priority than the best one found so far */
+static int match_bucket(const hotkey_matcher_t *matcher, uint8_t key, const hid_keyboard_report_t *report, int best) {
+    for (int n = matcher->bucket[key]; n && n - 1 < best; n = matcher->next[n - 1]) {
+        if (check_specific_hotkey(&matcher->combo[n - 1], report))
+            return n - 1;
+    }
+
+    return best;
+}
+
+/* Check the buckets of all keys in the report, if any hotkeys match, the first one defined wins. */
+const hotkey_combo_t *check_all_hotkeys(hid_keyboard_report_t *report, device_t *state) {
+    const hotkey_matcher_t *matcher = &get_keyboard_tables()->matcher;
+    int best = match_bucket(matcher, 0, report, MAX_HOTKEYS);
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++) {
+        if (report->keycode[i] != 0)
+            best = match_bucket(matcher, report->keycode[i], report, best);
+    }
+
+    return best < matcher->count ? &matcher->combo[best] : NULL;
+}
+
+static void build_keymap(const keymap_t *keymap, keymap_table_t *table) {
+    for (int i = 0; i < 256; i++)
+        table->keys[i] = i;
+
+    for (int n = 0; n < MAX_KEY_REMAPS; n++)
+        if (keymap->remap[n].from != 0)
+            table->keys[keymap->remap[n].from] = keymap->remap[n].to;
+
+    /* Each modifier bit is moved to its new position, all 256 combinations are precomputed */
+    for (int mods = 0; mods < 256; mods++) {
+        table->modifier[mods] = 0;
+
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t target = keymap->modifier_map[bit] ? keymap->modifier_map[bit] - 1 : bit;
+
+            if (mods & (1 << bit))
+                table->modifier[mods] |= 1 << (target & 7);
+        }
+    }
+}
+
+/* Remap a report with the keymap of the output it's going to */
+static void apply_keymap(const hid_keyboard_report_t *report, hid_keyboard_report_t *mapped, uint8_t output) {
+    const keymap_table_t *table = &get_keyboard_tables()->keymaps[output];
+
+    mapped->modifier = table->modifier[report->modifier];
+    mapped->reserved = report->reserved;
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++) {
+        uint8_t key = table->keys[report->keycode[i]];
+
+        /* Keys remapped to a modifier (e.g. Caps Lock -> Ctrl) set the modifier bit instead */
+        if (key >= HID_KEY_CONTROL_LEFT && key <= HID_KEY_GUI_RIGHT) {
+            mapped->modifier |= 1 << (key - HID_KEY_CONTROL_LEFT);
+            key = 0;
         }
+
+        mapped->keycode[i] = key;
     }
+}
 
-    return NULL;
+/* Rebuild the hotkey matcher and keymaps, needs to be called whenever the config changes */
+void build_keyboard_tables(device_t *state) {
+    keyboard_tables_t *spare = active_tables == &tables[0] ? &tables[1] : &tables[0];
+
+    build_hotkey_matcher(state, &spare->matcher);
+
+    for (int out = 0; out < NUM_SCREENS; out++)
+        build_keymap(&state->config.output[out].keymap, &spare->keymaps[out]);
+
+    /* All of it has to be in memory before the other core can pick it up */
+    __dmb();
+    active_tables = spare;
 }
 
 /* ==================================================== *
  * Keyboard State Management
  * ==================================================== */
 
-/* Update the keyboard state for a specific device */
-void update_kbd_state(device_t *state, hid_keyboard_report_t *report, uint8_t device_idx) {
-    /* Ensure device_idx is within bounds */
-    if (device_idx >= MAX_DEVICES)
-        return;
+/* Keep the keys of each source as a bitmap, so merging sources is just OR-ing them together */
+static void report_to_kbd_state(kbd_state_t *kbd_state, const hid_keyboard_report_t *report) {
+    memset(kbd_state, 0, sizeof(kbd_state_t));
+    kbd_state->modifier = report->modifier;
 
-    /* Update the keyboard state for this device */
-    memcpy(&state->local_kbd_states[device_idx], report, sizeof(hid_keyboard_report_t));
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++) {
+        uint8_t key = report->keycode[i];
 
-    /* Track the largest keyboard index we have */
-    if (state->max_kbd_idx < device_idx)
-        state->max_kbd_idx = device_idx;
+        if (key != 0)
+            kbd_state->keys[key >> 5] |= 1u << (key & 31);
+    }
 }
 
-/* Update the struct storing the state of the keyboard(s) connected to the other board */
-void update_remote_kbd_state(device_t *state, hid_keyboard_report_t *report) {
-    memcpy(&state->remote_kbd_state, report, sizeof(hid_keyboard_report_t));
+/* Update the keyboard state for a specific keyboard */
+void update_kbd_state(device_t *state, hid_keyboard_report_t *report, uint8_t slot) {
+    /* Ensure slot is within bounds */
+    if (slot >= MAX_KBD_SLOTS)
+        return;
+
+    report_to_kbd_state(&state->kbd_slots[slot].state, report);
 }
 
-/* Add keys from source to destination, avoiding duplicates */
-static void add_keys(hid_keyboard_report_t *dest, const hid_keyboard_report_t *src) {
-    for (uint8_t i = 0; i < KEYS_IN_USB_REPORT; i++) {
-        uint8_t key = src->keycode[i];
-        
-        if (key == 0 || key_in_report(key, dest))
+/* Give each keyboard of a newly mounted interface a slot of its own, the lowest free one */
+void keyboard_mount(uint8_t dev_addr, uint8_t instance, hid_interface_t *iface, device_t *state) {
+    /* A boot keyboard we found nothing about in the descriptor still sends reports as the first one */
+    int count = MIN(MAX(iface->num_keyboards, 1), MAX_KEYBOARDS);
+
+    for (int i = 0; i < count; i++) {
+        keyboard_t *keyboard = &iface->keyboards[i];
+        uint16_t free        = ~state->kbd_slots_used;
+
+        if (!free) {
+            keyboard->slot = KBD_SLOT_NONE;
             continue;
-            
-        uint8_t *empty_slot = memchr(dest->keycode, 0, KEYS_IN_USB_REPORT);
-        if (empty_slot)
-            *empty_slot = key;
+        }
+
+        keyboard->slot        = __builtin_ctz(free);
+        state->kbd_slots_used |= 1u << keyboard->slot;
+        state->kbd_slots[keyboard->slot] = (kbd_slot_t){
+            .dev_addr  = dev_addr,
+            .instance  = instance,
+            .report_id = keyboard->report_id,
+        };
     }
 }
 
+/* Free the slots of an interface that went away, releasing whatever its keyboards still held */
+void keyboard_umount(uint8_t dev_addr, uint8_t instance, device_t *state) {
+    static const kbd_state_t released = {0};
+    bool was_held = false;
+
+    for (uint16_t used = state->kbd_slots_used; used; used &= used - 1) {
+        uint8_t slot_idx = __builtin_ctz(used);
+        kbd_slot_t *slot = &state->kbd_slots[slot_idx];
+
+        if (slot->dev_addr != dev_addr || slot->instance != instance)
+            continue;
+
+        was_held |= memcmp(&slot->state, &released, sizeof(released)) != 0;
+        state->kbd_slots_used &= ~(1u << slot_idx);
+        memset(slot, 0, sizeof(kbd_slot_t));
+    }
+
+    /* Otherwise the host would keep those keys pressed */
+    if (was_held) {
+        hid_keyboard_report_t empty_report = {0};
+        send_key(&empty_report, state);
+    }
+}
+
+/* Update the struct storing the state of the keyboard(s) connected to the other board */
+void update_remote_kbd_state(device_t *state, hid_keyboard_report_t *report) {
+    report_to_kbd_state(&state->remote_kbd_state, report);
+}
+
 /* Release all keys */
 void release_all_keys(device_t *state) {
-    memset(state->local_kbd_states, 0, sizeof(state->local_kbd_states));
-    memset(&state->remote_kbd_state, 0, sizeof(hid_keyboard_report_t));
+    for (int i = 0; i < MAX_KBD_SLOTS; i++)
+        memset(&state->kbd_slots[i].state, 0, sizeof(kbd_state_t));
+
+    memset(&state->remote_kbd_state, 0, sizeof(kbd_state_t));
     
     static hid_keyboard_report_t empty_report = {0};
     queue_kbd_report(&empty_report, state);
 }
 
 
-/* Combine all keyboard states into a single report */
+/* Add the keys the firmware itself holds on this output (macros, typed text) */
+static void merge_injected_keys(device_t *state, uint8_t output, kbd_state_t *merged) {
+    for (int i = 0; i < KBD_SOURCES; i++) {
+        const injected_kbd_t *injected = &state->injected_kbd[i];
+
+        if (injected->output != output)
+            continue;
+
+        merged->modifier |= injected->state.modifier;
+
+        for (int w = 0; w < KBD_BITMAP_WORDS; w++)
+            merged->keys[w] |= injected->state.keys[w];
+    }
+}
+
+/* Turn merged key bitmaps into a report, keys from reported[] that are still held come first */
+static void merged_to_report(kbd_state_t *merged, const uint8_t *reported, hid_keyboard_report_t *report) {
+    int slot = 0;
+
+    memset(report, 0, sizeof(hid_keyboard_report_t));
+    report->modifier = merged->modifier;
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++) {
+        uint8_t key = reported[i];
+
+        if (!key || !(merged->keys[key >> 5] & (1u << (key & 31))))
+            continue;
+
+        report->keycode[slot++] = key;
+        merged->keys[key >> 5] &= ~(1u << (key & 31));
+    }
+
+    for (int w = 0; w < KBD_BITMAP_WORDS && slot < KEYS_IN_USB_REPORT; w++) {
+        for (uint32_t bits = merged->keys[w]; bits && slot < KEYS_IN_USB_REPORT; bits &= bits - 1)
+            report->keycode[slot++] = (w << 5) | __builtin_ctz(bits);
+    }
+}
+
+/* Combine all keyboard states into a single report. Bitmaps of all local keyboards, the remote
+   one and the keys the firmware holds on the active output are OR-ed, then pressed keys are emitted
+   without duplicates. Keys from the previous combined report that are still held go first, in the
+   same order, new ones follow in ascending usage order. So with more than 6 keys held, a new press
+   never pushes out a key the host was already told about (it would see a release that never
+   happened), the new key is left out. */
 void combine_kbd_states(device_t *state, hid_keyboard_report_t *combined_report) {
-    memset(combined_report, 0, sizeof(hid_keyboard_report_t));
+    kbd_state_t merged = state->remote_kbd_state;
 
-    /* Combine all local keyboards up to max_kbd_idx */
-    for (uint8_t i = 0; i <= state->max_kbd_idx; i++) {
-        combined_report->modifier |= state->local_kbd_states[i].modifier;
-        add_keys(combined_report, &state->local_kbd_states[i]);
+    /* Combine the local keyboards, only the slots that have one */
+    for (uint16_t used = state->kbd_slots_used; used; used &= used - 1) {
+        const kbd_state_t *kbd = &state->kbd_slots[__builtin_ctz(used)].state;
+        merged.modifier |= kbd->modifier;
+
+        for (int w = 0; w < KBD_BITMAP_WORDS; w++)
+            merged.keys[w] |= kbd->keys[w];
     }
-    
-    /* Add remote keyboard */
-    combined_report->modifier |= state->remote_kbd_state.modifier;
-    add_keys(combined_report, &state->remote_kbd_state);
+
+    merge_injected_keys(state, state->active_output, &merged);
+    merged_to_report(&merged, state->combined_keys, combined_report);
+
+    memcpy(state->combined_keys, combined_report->keycode, KEYS_IN_USB_REPORT);
+}
+
+/* Keys held by the firmware (source is a kbd_source_e) changed. On the active output they are
+   merged with the keyboards. Nothing else goes to an inactive one, so they're sent there alone. */
+void inject_keys(device_t *state, uint8_t source, hid_keyboard_report_t *report, uint8_t output) {
+    static const uint8_t none_reported[KEYS_IN_USB_REPORT] = {0};
+    injected_kbd_t *injected = &state->injected_kbd[source];
+    kbd_state_t merged       = {0};
+    hid_keyboard_report_t injected_report;
+
+    report_to_kbd_state(&injected->state, report);
+    injected->output = output;
+
+    if (output == state->active_output) {
+        send_key(report, state);
+        return;
+    }
+
+    merge_injected_keys(state, output, &merged);
+    merged_to_report(&merged, none_reported, &injected_report);
+
+    if (output == BOARD_ROLE)
+        queue_kbd_report(&injected_report, state);
+    else
+        queue_packet_to((uint8_t *)&injected_report, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH, output);
 }
 
 /* ==================================================== *
  * Keyboard Queue Section
  * ==================================================== */
 
+/* A queued report can be skipped if going straight from prev to next still shows the host every
+   press and release edge it carries, in the same order. So none of its changes may be undone by
+   next, and if it presses a key, next may only release keys (a later press or modifier change
+   would otherwise be seen together with, or before, that key press). */
+bool kbd_report_skippable(const hid_keyboard_report_t *prev,
+                          const hid_keyboard_report_t *report,
+                          const hid_keyboard_report_t *next) {
+    kbd_state_t p, r, n;
+    bool presses_key = false, next_presses = false;
+
+    report_to_kbd_state(&p, prev);
+    report_to_kbd_state(&r, report);
+    report_to_kbd_state(&n, next);
+
+    if ((p.modifier ^ r.modifier) & (r.modifier ^ n.modifier))
+        return false;
+
+    for (int w = 0; w < KBD_BITMAP_WORDS; w++) {
+        if ((p.keys[w] ^ r.keys[w]) & (r.keys[w] ^ n.keys[w]))
+            return false;
+
+        presses_key |= (r.keys[w] & ~p.keys[w]) != 0;
+        next_presses |= (n.keys[w] & ~r.keys[w]) != 0;
+    }
+
+    return !presses_key || (!next_presses && r.modifier == n.modifier);
+}
+
 void process_kbd_queue_task(device_t *state) {
-    hid_keyboard_report_t report;
+    static hid_keyboard_report_t report, last_sent;
+    static bool pending = false; // Report was taken from the queue, but not sent yet
+    hid_keyboard_report_t next;
 
     /* If we're not connected, we have nowhere to send reports to. */
     if (!state->tud_connected)
         return;
 
-    /* Peek first, if there is anything there... */
-    if (!queue_try_peek(&state->kbd_queue, &report))
-        return;
+    /* Take the next report out, unless the previous one is still waiting to be sent */
+    if (!pending) {
+        if (!queue_try_remove(&state->kbd_queue, &report))
+            return;
+
+        latency_removed(LAT_QUEUE_KBD);
+        pending = true;
+    }
 
     /* If we are suspended, let's wake the host up */
     if (tud_suspended())
@@ -235,20 +575,42 @@ void process_kbd_queue_task(device_t *state) {
     if (!tud_hid_n_ready(ITF_NUM_HID))
         return;
 
-    /* ... try sending it to the host, if it's successful */
-    bool succeeded = tud_hid_keyboard_report(REPORT_ID_KEYBOARD, report.modifier, report.keycode);
-
-    /* ... then we can remove it from the queue. Race conditions shouldn't happen [tm] */
-    if (succeeded)
+    /* Reports piled up while the host was busy, skip the intermediate ones we can do without */
+    while (queue_try_peek(&state->kbd_queue, &next) && kbd_report_skippable(&last_sent, &report, &next)) {
         queue_try_remove(&state->kbd_queue, &report);
+        latency_removed(LAT_QUEUE_KBD);
+        state->stats.kbd_coalesced++;
+    }
+
+    /* ... try sending it to the host, if it's successful, we're done with it */
+    if (tud_hid_keyboard_report(REPORT_ID_KEYBOARD, report.modifier, report.keycode)) {
+        last_sent = report;
+        pending   = false;
+        latency_sent(LAT_QUEUE_KBD, state);
+        TRACE(TRACE_KBD_SENT, queue_get_level_unsafe(&state->kbd_queue), 0);
+    }
 }
 
 void queue_kbd_report(hid_keyboard_report_t *report, device_t *state) {
+    static hid_keyboard_report_t last_queued;
+
     /* It wouldn't be fun to queue up a bunch of messages and then dump them all on host */
-    if (!state->tud_connected)
+    if (!state->tud_connected) {
+        memset(&last_queued, 0, sizeof(hid_keyboard_report_t));
+        return;
+    }
+
+    /* Host already has this exact state (e.g. a second keyboard sent an idle report) */
+    if (!memcmp(report, &last_queued, sizeof(hid_keyboard_report_t))) {
+        state->stats.kbd_duplicates++;
         return;
+    }
 
-    queue_try_add(&state->kbd_queue, report);
+    if (queue_add_counted(&state->kbd_queue, report, STATS_KBD_QUEUE)) {
+        last_queued = *report;
+        latency_queued(LAT_QUEUE_KBD, &state->kbd_queue, state);
+        TRACE(TRACE_KBD_QUEUED, queue_get_level_unsafe(&state->kbd_queue), 0);
+    }
 }
 
 /* If keys need to go locally, queue packet to kbd queue, else send them through UART */
@@ -262,8 +624,10 @@ void send_key(hid_keyboard_report_t *report, device_t *state) {
         queue_kbd_report(&combined_report, state);
         state->last_activity[BOARD_ROLE] = time_us_64();
     } else {
-        /* Send the combined report to ensure all keys are included */
-        queue_packet((uint8_t *)&combined_report, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH);
+        /* Send the combined report to ensure all keys are included, reserved byte carries the time stamp */
+        combined_report.reserved = latency_tag();
+        queue_packet_to((uint8_t *)&combined_report, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH, state->active_output);
+        latency_queued(LAT_QUEUE_UART, &state->uart_tx_queue, state);
     }
 }
 
@@ -273,7 +637,7 @@ void send_consumer_control(uint8_t *raw_report, device_t *state) {
         queue_cc_packet(raw_report, state);
         state->last_activity[BOARD_ROLE] = time_us_64();
     } else {
-        queue_packet((uint8_t *)raw_report, CONSUMER_CONTROL_MSG, CONSUMER_CONTROL_LENGTH);
+        queue_packet_to((uint8_t *)raw_report, CONSUMER_CONTROL_MSG, CONSUMER_CONTROL_LENGTH, state->active_output);
     }
 }
 
@@ -283,7 +647,7 @@ void send_system_control(uint8_t *raw_report, device_t *state) {
         queue_system_packet(raw_report, state);
         state->last_activity[BOARD_ROLE] = time_us_64();
     } else {
-        queue_packet((uint8_t *)raw_report, SYSTEM_CONTROL_MSG, SYSTEM_CONTROL_LENGTH);
+        queue_packet_to((uint8_t *)raw_report, SYSTEM_CONTROL_MSG, SYSTEM_CONTROL_LENGTH, state->active_output);
     }
 }
 
@@ -292,9 +656,9 @@ void send_system_control(uint8_t *raw_report, device_t *state) {
  * ==================================================== */
 
 void process_keyboard_report(uint8_t *raw_report, int length, uint8_t itf, hid_interface_t *iface) {
-    hid_keyboard_report_t new_report = {0};
+    hid_keyboard_report_t new_report = {0}, mapped_report;
     device_t *state                  = &global_state;
-    hotkey_combo_t *hotkey           = NULL;
+    const hotkey_combo_t *hotkey     = NULL;
 
     if (length < KBD_REPORT_LENGTH)
         return;
@@ -305,8 +669,11 @@ void process_keyboard_report(uint8_t *raw_report, int length, uint8_t itf, hid_i
 
     extract_kbd_data(raw_report, length, itf, iface, &new_report);
 
-    /* Update the keyboard state for this device */
-    update_kbd_state(state, &new_report, itf);
+    /* Keys are remapped for the active output, hotkeys still match the keys as pressed */
+    apply_keymap(&new_report, &mapped_report, state->active_output);
+
+    /* Update the keyboard state for this keyboard */
+    update_kbd_state(state, &mapped_report, get_keyboard(iface, raw_report[0])->slot);
 
     /* Check if any hotkey was pressed */
     hotkey = check_all_hotkeys(&new_report, state);
@@ -317,8 +684,11 @@ void process_keyboard_report(uint8_t *raw_report, int length, uint8_t itf, hid_i
         if (hotkey->acknowledge)
             blink_led(state);
 
-        /* Execute the corresponding handler */
-        hotkey->action_handler(state, &new_report);
+        /* Execute the corresponding handler or start the macro bound to it */
+        if (hotkey->macro)
+            start_macro(hotkey->macro - 1, state);
+        else
+            hotkey->action_handler(state, &new_report);
 
         /* And pass the key to the output PC if configured to do so. */
         if (!hotkey->pass_to_os)
@@ -326,7 +696,8 @@ void process_keyboard_report(uint8_t *raw_report, int length, uint8_t itf, hid_i
     }
 
     /* This method will decide if the key gets queued locally or sent through UART */
-    send_key(&new_report, state);
+    latency_parsed(state);
+    send_key(&mapped_report, state);
 }
 
 void process_consumer_report(uint8_t *raw_report, int length, uint8_t itf, hid_interface_t *iface) {
@@ -355,7 +726,7 @@ void process_consumer_report(uint8_t *raw_report, int length, uint8_t itf, hid_i
     if (CURRENT_BOARD_IS_ACTIVE_OUTPUT) {
         send_consumer_control(new_report, state);
     } else {
-        queue_packet((uint8_t *)new_report, CONSUMER_CONTROL_MSG, CONSUMER_CONTROL_LENGTH);
+        queue_packet_to((uint8_t *)new_report, CONSUMER_CONTROL_MSG, CONSUMER_CONTROL_LENGTH, state->active_output);
     }
 }
 
@@ -370,7 +741,7 @@ void process_system_report(uint8_t *raw_report, int length, uint8_t itf, hid_int
     if (CURRENT_BOARD_IS_ACTIVE_OUTPUT) {
         send_system_control(report_ptr, state);
     } else {
-        queue_packet(report_ptr, SYSTEM_CONTROL_MSG, SYSTEM_CONTROL_LENGTH);
+        queue_packet_to(report_ptr, SYSTEM_CONTROL_MSG, SYSTEM_CONTROL_LENGTH, state->active_output);
     }
 }
 
@@ -0,0 +1,154 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+/* The report being followed. Stamps up to queueing are taken on core1, sending happens on core0.
+   Each hop is only ever recorded from one of the cores, so the histograms need no locking. */
+static latency_probe_t probe;
+
+/* When the last report came in from a device, becomes the probe's start if it gets parsed */
+static uint32_t last_received;
+
+/* Entries taken out of each queue so far, only the consumer (core0) updates these */
+static uint32_t removed[LAT_NUM_QUEUES];
+
+/* Stage is how the cores hand the probe over. The rest of the probe has to be written before a
+   new stage is visible to the other core, and must only be read after the stage was. */
+static inline uint8_t get_stage(void) {
+    uint8_t stage = probe.stage;
+    __dmb();
+    return stage;
+}
+
+static inline void set_stage(uint8_t stage) {
+    __dmb();
+    probe.stage = stage;
+}
+
+/* ==================================================== *
+ * Histograms
+ * ==================================================== */
+
+uint8_t latency_bucket(uint32_t us) {
+    if (us < (1u << LAT_BUCKET_SHIFT))
+        return 0;
+
+    uint8_t bucket = 32 - __builtin_clz(us) - LAT_BUCKET_SHIFT;
+    return MIN(bucket, LAT_NUM_BUCKETS - 1);
+}
+
+void latency_add(latency_t *latency, enum latency_hop_e hop, uint32_t us) {
+    latency->hist[hop][latency_bucket(us)]++;
+}
+
+/* ==================================================== *
+ * Following a report through the pipeline
+ * ==================================================== */
+
+void latency_received(void) {
+    last_received = time_us_32();
+}
+
+/* Report is parsed and about to be output. Start following it, unless we're already busy with one. */
+void latency_parsed(device_t *state) {
+    uint32_t now = time_us_32();
+
+    /* Busy, unless the queued one got lost. One that never got queued (e.g. a duplicate) is replaced. */
+    if (get_stage() == LAT_STAGE_QUEUED && now - probe.received < LAT_PROBE_TIMEOUT)
+        return;
+
+    probe.received = last_received;
+    probe.parsed   = now;
+    probe.remote   = false;
+    set_stage(LAT_STAGE_PARSED);
+
+    latency_add(&state->latency, LAT_HOP_PARSE, now - probe.received);
+}
+
+/* Report was added to the queue. Everything currently in there has to be removed before it's out. */
+void latency_queued(enum latency_queue_e queue, queue_t *q, device_t *state) {
+    if (get_stage() != LAT_STAGE_PARSED)
+        return;
+
+    probe.queued = time_us_32();
+    probe.queue  = queue;
+    probe.seq    = removed[queue] + queue_get_level(q);
+
+    if (!probe.remote)
+        latency_add(&state->latency, LAT_HOP_ENQUEUE, probe.queued - probe.parsed);
+
+    set_stage(LAT_STAGE_QUEUED);
+}
+
+void latency_removed(enum latency_queue_e queue) {
+    removed[queue]++;
+}
+
+/* A report from this queue was sent, if the probe has been removed by now, this was it (or one replacing it) */
+void latency_sent(enum latency_queue_e queue, device_t *state) {
+    if (get_stage() != LAT_STAGE_QUEUED || probe.queue != queue || (int32_t)(removed[queue] - probe.seq) < 0)
+        return;
+
+    uint32_t now = time_us_32();
+
+    if (queue == LAT_QUEUE_UART) {
+        latency_add(&state->latency, LAT_HOP_UART_TX, now - probe.queued);
+    } else {
+        latency_add(&state->latency, LAT_HOP_DEVICE, now - probe.queued);
+        latency_add(&state->latency, LAT_HOP_TOTAL, now - probe.received);
+    }
+
+    set_stage(LAT_STAGE_IDLE);
+}
+
+/* ==================================================== *
+ * Correlation with the other board
+ * ==================================================== */
+
+/* Time stamp for a keyboard report sent to the other board, 0 if it's not the one we follow */
+uint8_t latency_tag(void) {
+    if (get_stage() != LAT_STAGE_PARSED)
+        return 0;
+
+    uint8_t tag = probe.received >> LAT_STAMP_SHIFT;
+    return tag ? tag : 1;
+}
+
+/* Heartbeat carries the other board's clock when its transfer started */
+void latency_sync_clock(uint16_t remote_time, device_t *state) {
+    state->latency.clock_offset = time_us_32() - remote_time - LAT_UART_WIRE_US(state->link.baud);
+    state->latency.clock_synced = true;
+}
+
+/* Keyboard report from the other board, time stamped when that board received it from the device */
+void latency_remote_received(uint8_t tag, device_t *state) {
+    if (!tag || !state->latency.clock_synced)
+        return;
+
+    uint32_t now = time_us_32();
+
+    /* Their current time, minus the time stamp. It marks the start of a 64 us step, so take the middle. */
+    uint16_t remote_now = now - state->latency.clock_offset;
+    uint32_t link = (uint16_t)(remote_now - (tag << LAT_STAMP_SHIFT)) % LAT_STAMP_RANGE;
+    link = link > (1 << (LAT_STAMP_SHIFT - 1)) ? link - (1 << (LAT_STAMP_SHIFT - 1)) : 0;
+
+    latency_add(&state->latency, LAT_HOP_LINK, link);
+
+    /* Follow it to our host too, unless we're already busy with one */
+    if (get_stage() == LAT_STAGE_QUEUED && now - probe.received < LAT_PROBE_TIMEOUT)
+        return;
+
+    probe.received = now - link;
+    probe.parsed   = now;
+    probe.remote   = true;
+    set_stage(LAT_STAGE_PARSED);
+}
@@ -0,0 +1,294 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+/* Compiled from the config by build_screen_layout, used on every switch. Config can change from the
+   other core while a mouse report is being processed, so a new layout is compiled into the spare copy
+   and swapped in, the same way as the keyboard tables. */
+static screen_layout_t layouts[2];
+static screen_layout_t *volatile active_layout = &layouts[0];
+
+static const screen_layout_t *get_screen_layout(void) {
+    const screen_layout_t *current = active_layout;
+    __dmb();
+    return current;
+}
+
+/* A screen in layout coordinates. The legacy layout needs more range than the config's int16. */
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t w;
+    int32_t h;
+} layout_rect_t;
+
+static inline int edge_slot(enum screen_pos_e edge) {
+    switch (edge) {
+        case LEFT:   return 0;
+        case RIGHT:  return 1;
+        case TOP:    return 2;
+        default:     return 3;
+    }
+}
+
+static inline uint8_t screen_count(const output_t *output) {
+    return MAX(1, MIN(output->screen_count, MAX_OUTPUT_SCREENS));
+}
+
+/* ==================================================== *
+ * Screen rectangles
+ * ==================================================== */
+
+/* Configured layout is used only once every screen in use has a size */
+static bool layout_configured(const output_t *outputs) {
+    for (int out = 0; out < NUM_SCREENS; out++)
+        for (int i = 0; i < screen_count(&outputs[out]); i++)
+            if (outputs[out].layout[i].w <= 0 || outputs[out].layout[i].h <= 0)
+                return false;
+
+    return true;
+}
+
+/* Layout equivalent to pos, screen_count and border. Outputs are in a row, left ones first, each with its
+   main screen facing the others. Border is the part of a bigger screen a smaller one maps to, so it
+   becomes the vertical offset and size. */
+static void legacy_rects(const output_t *outputs, layout_rect_t rects[]) {
+    int32_t x = 0;
+
+    for (int left = 1; left >= 0; left--) {
+        for (int out = 0; out < NUM_SCREENS; out++) {
+            const output_t *output = &outputs[out];
+            int32_t top = output->border.top, bottom = output->border.bottom;
+
+            if ((output->pos == LEFT) != left)
+                continue;
+
+            if (top < MIN_SCREEN_COORD || bottom > MAX_SCREEN_COORD || bottom <= top) {
+                top    = MIN_SCREEN_COORD;
+                bottom = MAX_SCREEN_COORD;
+            }
+
+            for (int i = 0; i < screen_count(output); i++) {
+                int column = left ? screen_count(output) - 1 - i : i;
+
+                rects[out * MAX_OUTPUT_SCREENS + i] = (layout_rect_t){
+                    .x = x + column * MAX_SCREEN_COORD,
+                    .y = -((int64_t)top * MAX_SCREEN_COORD) / (bottom - top),
+                    .w = MAX_SCREEN_COORD,
+                    .h = ((int64_t)MAX_SCREEN_COORD * MAX_SCREEN_COORD) / (bottom - top),
+                };
+            }
+
+            x += screen_count(output) * MAX_SCREEN_COORD;
+        }
+    }
+}
+
+static void layout_rects(const output_t *outputs, layout_rect_t rects[]) {
+    memset(rects, 0, MAX_LAYOUT_SCREENS * sizeof(layout_rect_t));
+
+    if (!layout_configured(outputs)) {
+        legacy_rects(outputs, rects);
+        return;
+    }
+
+    for (int out = 0; out < NUM_SCREENS; out++) {
+        for (int i = 0; i < screen_count(&outputs[out]); i++) {
+            const screen_rect_t *rect = &outputs[out].layout[i];
+            rects[out * MAX_OUTPUT_SCREENS + i] = (layout_rect_t){rect->x, rect->y, rect->w, rect->h};
+        }
+    }
+}
+
+/* Digitizer coordinates cover all screens of an output. Place each one within the box around them. */
+static void desktop_rects(screen_layout_t *layout, const output_t *outputs, const layout_rect_t rects[]) {
+    for (int out = 0; out < NUM_SCREENS; out++) {
+        const layout_rect_t *first = &rects[out * MAX_OUTPUT_SCREENS];
+        int64_t left = first->x, top = first->y, right = first->x + first->w, bottom = first->y + first->h;
+
+        for (int i = 1; i < screen_count(&outputs[out]); i++) {
+            left   = MIN(left, first[i].x);
+            top    = MIN(top, first[i].y);
+            right  = MAX(right, first[i].x + first[i].w);
+            bottom = MAX(bottom, first[i].y + first[i].h);
+        }
+
+        if (right <= left || bottom <= top)
+            continue;
+
+        for (int i = 0; i < screen_count(&outputs[out]); i++) {
+            layout->desktop[out * MAX_OUTPUT_SCREENS + i] = (screen_rect_t){
+                .x = (first[i].x - left) * MAX_SCREEN_COORD / (right - left),
+                .y = (first[i].y - top) * MAX_SCREEN_COORD / (bottom - top),
+                .w = first[i].w * MAX_SCREEN_COORD / (right - left),
+                .h = first[i].h * MAX_SCREEN_COORD / (bottom - top),
+            };
+        }
+    }
+}
+
+/* ==================================================== *
+ * Compiling the transition table
+ * ==================================================== */
+
+/* If screen 'to' continues past 'edge' of screen 'from', add a transition for the part they share */
+static void add_transition(screen_layout_t *layout, const layout_rect_t *from, const layout_rect_t *to,
+                           enum screen_pos_e edge, uint8_t to_id) {
+    bool vertical = (edge == TOP || edge == BOTTOM);
+
+    bool touching = (edge == LEFT)  ? to->x + to->w == from->x
+                  : (edge == RIGHT) ? from->x + from->w == to->x
+                  : (edge == TOP)   ? to->y + to->h == from->y
+                                    : from->y + from->h == to->y;
+
+    /* Along the edge, positions and lengths of both screens */
+    int64_t from_pos = vertical ? from->x : from->y, from_len = vertical ? from->w : from->h;
+    int64_t to_pos   = vertical ? to->x : to->y, to_len = vertical ? to->w : to->h;
+
+    int64_t start = MAX(from_pos, to_pos);
+    int64_t end   = MIN(from_pos + from_len, to_pos + to_len);
+
+    if (!touching || end <= start || layout->length >= MAX_TRANSITIONS)
+        return;
+
+    /* Layout position on the edge is from_pos + pos * from_len / MAX, target one maps it back the same way */
+    layout->entry[layout->length++] = (screen_transition_t){
+        .lo     = ((start - from_pos) * MAX_SCREEN_COORD) / from_len,
+        .hi     = ((end - from_pos) * MAX_SCREEN_COORD) / from_len,
+        .output = to_id / MAX_OUTPUT_SCREENS,
+        .index  = to_id % MAX_OUTPUT_SCREENS,
+        .scale  = from_len * 65536 / to_len,
+        .offset = (from_pos - to_pos) * MAX_SCREEN_COORD * 65536 / to_len,
+    };
+}
+
+/* Entries of one edge sorted by position, then stretched so together they cover the whole edge.
+   A part without a neighbour goes to the closest one, the pointer is kept on its edge. */
+static void close_gaps(screen_transition_t *entry, int count) {
+    for (int i = 1; i < count; i++) {
+        screen_transition_t key = entry[i];
+        int j = i - 1;
+
+        for (; j >= 0 && entry[j].lo > key.lo; j--)
+            entry[j + 1] = entry[j];
+
+        entry[j + 1] = key;
+    }
+
+    for (int i = 0; i < count - 1; i++) {
+        uint16_t boundary = (entry[i].hi + entry[i + 1].lo) / 2;
+        entry[i].hi = entry[i + 1].lo = boundary;
+    }
+
+    if (count) {
+        entry[0].lo         = MIN_SCREEN_COORD;
+        entry[count - 1].hi = MAX_SCREEN_COORD + 1;
+    }
+}
+
+void compile_screen_layout(screen_layout_t *layout, const output_t *outputs) {
+    const enum screen_pos_e edges[NUM_EDGES] = {LEFT, RIGHT, TOP, BOTTOM};
+    layout_rect_t rects[MAX_LAYOUT_SCREENS];
+
+    layout_rects(outputs, rects);
+    memset(layout, 0, sizeof(screen_layout_t));
+
+    for (int from = 0; from < MAX_LAYOUT_SCREENS; from++) {
+        for (int e = 0; e < NUM_EDGES; e++) {
+            layout->first[from][e] = layout->length;
+
+            if (rects[from].w <= 0 || rects[from].h <= 0)
+                continue;
+
+            for (int to = 0; to < MAX_LAYOUT_SCREENS; to++)
+                if (to != from && rects[to].w > 0 && rects[to].h > 0)
+                    add_transition(layout, &rects[from], &rects[to], edges[e], to);
+
+            layout->count[from][e] = layout->length - layout->first[from][e];
+            close_gaps(&layout->entry[layout->first[from][e]], layout->count[from][e]);
+        }
+    }
+
+    desktop_rects(layout, outputs, rects);
+}
+
+/* ==================================================== *
+ * Lookup
+ * ==================================================== */
+
+/* Where the pointer goes when leaving the screen over 'edge' at 'pos' along it, NULL if nowhere.
+   Position on the target screen's edge is stored to 'mapped'. */
+const screen_transition_t *find_screen_transition(
+    const screen_layout_t *layout, uint8_t output, uint8_t index, enum screen_pos_e edge, int pos, int16_t *mapped) {
+    int screen = output * MAX_OUTPUT_SCREENS + index, slot = edge_slot(edge);
+
+    if (output >= NUM_SCREENS || index >= MAX_OUTPUT_SCREENS)
+        return NULL;
+
+    pos = MAX(MIN_SCREEN_COORD, MIN(pos, MAX_SCREEN_COORD));
+
+    const screen_transition_t *entry = &layout->entry[layout->first[screen][slot]];
+    int lo = 0, hi = layout->count[screen][slot] - 1;
+
+    /* Entries cover the edge without gaps, find the one containing pos */
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+
+        if (pos < entry[mid].lo)
+            hi = mid - 1;
+        else if (pos >= entry[mid].hi)
+            lo = mid + 1;
+        else {
+            int64_t target = ((int64_t)pos * entry[mid].scale + entry[mid].offset) / 65536;
+
+            if (mapped)
+                *mapped = MAX(MIN_SCREEN_COORD, MIN(target, MAX_SCREEN_COORD));
+
+            return &entry[mid];
+        }
+    }
+
+    return NULL;
+}
+
+/* Transition from the screen the pointer is on now */
+const screen_transition_t *screen_transition(device_t *state, enum screen_pos_e edge, int pos, int16_t *mapped) {
+    output_t *output = &state->config.output[state->active_output];
+    uint8_t index    = MIN(MAX(output->screen_index, 1), screen_count(output)) - 1;
+
+    return find_screen_transition(get_screen_layout(), state->active_output, index, edge, pos, mapped);
+}
+
+/* Position on the screen the pointer is on now, as the digitizer covering the output's whole desktop sees it */
+void desktop_position(device_t *state, int16_t *x, int16_t *y) {
+    output_t *output = &state->config.output[state->active_output];
+    uint8_t index    = MIN(MAX(output->screen_index, 1), screen_count(output)) - 1;
+    const screen_rect_t *screen = &get_screen_layout()->desktop[state->active_output * MAX_OUTPUT_SCREENS + index];
+
+    /* Not compiled yet, so there's just the one screen */
+    if (screen->w <= 0 || screen->h <= 0)
+        return;
+
+    *x = screen->x + (int32_t)*x * screen->w / MAX_SCREEN_COORD;
+    *y = screen->y + (int32_t)*y * screen->h / MAX_SCREEN_COORD;
+}
+
+/* Rebuild the transition table, needs to be called whenever the config changes */
+void build_screen_layout(device_t *state) {
+    screen_layout_t *spare = active_layout == &layouts[0] ? &layouts[1] : &layouts[0];
+
+    compile_screen_layout(spare, state->config.output);
+
+    /* All of it has to be in memory before the other core can pick it up */
+    __dmb();
+    active_layout = spare;
+}
@@ -0,0 +1,323 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+/* Rate ladder, slowest first. RP2040 UART tops out at clk_peri / 16, so 7.37 Mbaud is the last rung. */
+const uint32_t link_rates[LINK_NUM_RATES] = {115200, 460800, 921600, 1843200, SERIAL_BAUDRATE, 2 * SERIAL_BAUDRATE};
+
+/* ==================================================== *
+ * Messages from the other board (core1)
+ * ==================================================== */
+
+void link_received(link_t *link, const link_msg_t *msg) {
+    link->msg         = *msg;
+    link->msg_pending = true;
+}
+
+/* Heartbeats carry the other board's checksum error count */
+void link_heartbeat(link_t *link, uint16_t peer_errors) {
+    link->peer_errors = peer_errors;
+    link->heartbeats++;
+}
+
+/* ==================================================== *
+ * Error rate
+ * ==================================================== */
+
+static void link_reset_window(link_t *link, uint64_t now, device_t *state) {
+    link->window_rx_packets  = state->stats.uart_rx_packets;
+    link->window_errors      = state->stats.uart_checksum_errors;
+    link->window_peer_errors = link->peer_errors;
+    link->window_heartbeats  = link->heartbeats;
+    link->next_window        = now + LINK_WINDOW_US;
+}
+
+static void link_set_rung(link_t *link, const link_io_t *io, uint8_t rung, uint64_t now, device_t *state) {
+    link->rung = rung;
+    link->baud = link_rates[rung];
+    io->set_rate(link->baud, state);
+
+    /* Errors around the switch say nothing about the new rate, and it gets the full dead link timeout */
+    link_reset_window(link, now, state);
+    link->bad_windows   = 0;
+    link->clean_windows = 0;
+    link->last_rx       = now;
+}
+
+static void link_request(link_t *link, const link_io_t *io, uint8_t rung, uint64_t now, device_t *state) {
+    link_msg_t msg = {.op = LINK_REQUEST, .rung = rung, .token = ++link->token};
+
+    io->send(&msg, state);
+    link->target   = rung;
+    link->state    = LINK_REQUESTED;
+    link->deadline = now + LINK_REPLY_US;
+}
+
+/* Negotiation failed. A faster rate that didn't work out is tried again later each time. */
+static void link_failed(link_t *link, uint64_t now, device_t *state) {
+    if (link->target > link->prev_rung)
+        link->step_up_windows = MIN(link->step_up_windows * 2, LINK_MAX_UP_WINDOWS);
+
+    link->state = LINK_IDLE;
+    link_reset_window(link, now, state);
+}
+
+/* Board A, once per window: too many errors means stepping down, staying clean long enough means stepping up */
+static void link_evaluate(link_t *link, const link_io_t *io, uint64_t now, device_t *state) {
+    uint32_t packets = state->stats.uart_rx_packets - link->window_rx_packets;
+    uint32_t errors  = state->stats.uart_checksum_errors - link->window_errors;
+
+    errors += (uint16_t)(link->peer_errors - link->window_peer_errors);
+
+    /* A window is longer than the heartbeat period, so not getting any means it was lost */
+    if (link->heartbeats == link->window_heartbeats)
+        errors++;
+
+    link_reset_window(link, now, state);
+
+    if (errors >= LINK_MIN_ERRORS && errors * 1000 > (packets + errors) * LINK_MAX_FER) {
+        link->clean_windows = 0;
+
+        if (++link->bad_windows < LINK_BAD_WINDOWS || link->rung == 0)
+            return;
+
+        /* Slower rate is tried on the next faster one only after a longer clean period */
+        link->step_up_windows = MIN(link->step_up_windows * 2, LINK_MAX_UP_WINDOWS);
+        link->prev_rung       = link->rung;
+        link_request(link, io, link->rung - 1, now, state);
+        return;
+    }
+
+    link->bad_windows = 0;
+
+    if (errors)
+        link->clean_windows = 0;
+    else if (++link->clean_windows >= link->step_up_windows && link->rung < LINK_NUM_RATES - 1) {
+        link->prev_rung = link->rung;
+        link_request(link, io, link->rung + 1, now, state);
+    }
+}
+
+/* ==================================================== *
+ * Negotiation
+ * ==================================================== */
+
+static void link_revert(link_t *link, uint64_t now, device_t *state) {
+    link->rollbacks++;
+    link->state    = LINK_REVERTING;
+    link->deadline = now + LINK_SWITCH_US;
+}
+
+static void link_commit(link_t *link, const link_io_t *io, uint64_t now, device_t *state) {
+    link->rate_changes++;
+    link->state = LINK_IDLE;
+    link_reset_window(link, now, state);
+    io->settled(state);
+}
+
+/* Tell B, at the rate it's listening on, so it doesn't wait for its own timeout */
+static void link_abort(link_t *link, const link_io_t *io, uint64_t now, device_t *state) {
+    link_msg_t msg = {.op = LINK_ABORT, .rung = link->prev_rung, .token = link->token};
+
+    io->send(&msg, state);
+    link_revert(link, now, state);
+}
+
+static void link_trial_master(link_t *link, const link_io_t *io, const link_msg_t *msg, uint64_t now, device_t *state) {
+    if (msg && msg->op == LINK_PROBE_ACK && msg->token == link->token) {
+        /* Errors before the first answer come from the switch itself. After it, a faster rate has to stay
+           clean on both sides. A slower one only has to get through, it can't be worse than the old one. */
+        bool errors = msg->arg || state->stats.uart_checksum_errors != link->trial_errors;
+
+        if (link->acks++ == 0)
+            link->trial_errors = state->stats.uart_checksum_errors;
+        else if (errors && link->rung > link->prev_rung) {
+            link_abort(link, io, now, state);
+            return;
+        }
+
+        if (link->acks >= LINK_TRIAL_ACKS) {
+            link_msg_t commit = {.op = LINK_COMMIT, .rung = link->rung, .token = link->token};
+
+            for (int i = 0; i < LINK_COMMIT_REPEAT; i++)
+                io->send(&commit, state);
+
+            link_commit(link, io, now, state);
+            return;
+        }
+    }
+
+    if (now >= link->deadline) {
+        link_abort(link, io, now, state);
+        return;
+    }
+
+    if (now >= link->next_probe) {
+        link_msg_t probe = {.op = LINK_PROBE, .rung = link->rung, .token = link->token};
+        io->send(&probe, state);
+        link->next_probe = now + LINK_PROBE_US;
+    }
+}
+
+static void link_trial_slave(link_t *link, const link_io_t *io, const link_msg_t *msg, uint64_t now, device_t *state) {
+    if (msg && msg->token == link->token) {
+        if (msg->op == LINK_PROBE) {
+            if (link->acks++ == 0)
+                link->trial_errors = state->stats.uart_checksum_errors;
+
+            uint32_t errors = state->stats.uart_checksum_errors - link->trial_errors;
+            link_msg_t ack  = {.op = LINK_PROBE_ACK, .rung = link->rung, .token = link->token, .arg = MIN(errors, 255)};
+
+            io->send(&ack, state);
+        } else if (msg->op == LINK_COMMIT) {
+            link_commit(link, io, now, state);
+            return;
+        } else if (msg->op == LINK_ABORT) {
+            link_revert(link, now, state);
+            return;
+        }
+    }
+
+    /* B waits longer than A's trial takes, so a commit that's on its way isn't missed */
+    if (now >= link->deadline)
+        link_revert(link, now, state);
+}
+
+/* ==================================================== *
+ * Link state machine
+ * ==================================================== */
+
+void link_init(link_t *link, bool master, uint64_t now) {
+    *link = (link_t){
+        .master          = master,
+        .rung            = LINK_DEFAULT_RUNG,
+        .baud            = link_rates[LINK_DEFAULT_RUNG],
+        .step_up_windows = LINK_STEP_UP_WINDOWS,
+        .last_rx         = now,
+        .next_window     = now + LINK_WINDOW_US,
+    };
+}
+
+void link_step(link_t *link, const link_io_t *io, uint64_t now, device_t *state) {
+    link_msg_t received, *msg = NULL;
+
+    if (link->msg_pending) {
+        received          = link->msg;
+        link->msg_pending = false;
+        msg               = &received;
+    }
+
+    if (state->stats.uart_rx_packets != link->seen_rx_packets) {
+        link->seen_rx_packets = state->stats.uart_rx_packets;
+        link->last_rx         = now;
+    }
+
+    /* Nothing valid coming in, the other board is likely at another rate (e.g. it rebooted). Both end up at the default. */
+    if (now - link->last_rx > LINK_DEAD_US && link->rung != LINK_DEFAULT_RUNG) {
+        link->state = LINK_IDLE;
+        link->rate_changes++;
+        link_set_rung(link, io, LINK_DEFAULT_RUNG, now, state);
+        io->settled(state);
+        return;
+    }
+
+    switch (link->state) {
+        case LINK_IDLE:
+            if (!link->master && msg && msg->op == LINK_REQUEST && msg->rung < LINK_NUM_RATES) {
+                link_msg_t ack = {.op = LINK_ACK, .rung = msg->rung, .token = msg->token};
+                io->send(&ack, state);
+
+                link->token     = msg->token;
+                link->target    = msg->rung;
+                link->prev_rung = link->rung;
+                link->state     = LINK_SWITCHING;
+                link->deadline  = now + LINK_SWITCH_US;
+            } else if (link->master && now >= link->next_window)
+                link_evaluate(link, io, now, state);
+            break;
+
+        case LINK_REQUESTED:
+            if (msg && msg->op == LINK_ACK && msg->token == link->token) {
+                link->state    = LINK_SWITCHING;
+                link->deadline = now + LINK_SWITCH_US;
+            } else if (now >= link->deadline)
+                link_failed(link, now, state);
+            break;
+
+        case LINK_SWITCHING:
+            /* Whatever is still waiting goes out at the old rate first */
+            if (!io->tx_idle(state) && now < link->deadline)
+                break;
+
+            link_set_rung(link, io, link->target, now, state);
+            link->state      = LINK_TRIAL;
+            link->acks       = 0;
+            link->next_probe = now;
+            link->deadline   = now + (link->master ? LINK_TRIAL_US : 2 * LINK_TRIAL_US);
+            break;
+
+        case LINK_TRIAL:
+            if (link->master)
+                link_trial_master(link, io, msg, now, state);
+            else
+                link_trial_slave(link, io, msg, now, state);
+            break;
+
+        case LINK_REVERTING:
+            if (!io->tx_idle(state) && now < link->deadline)
+                break;
+
+            link_set_rung(link, io, link->prev_rung, now, state);
+            link_failed(link, now, state);
+            io->settled(state);
+            break;
+    }
+}
+
+/* ==================================================== *
+ * UART glue
+ * ==================================================== */
+
+static void link_send(const link_msg_t *msg, device_t *state) {
+    queue_packet((const uint8_t *)msg, LINK_MSG, sizeof(link_msg_t));
+}
+
+static void link_set_rate(uint32_t baud, device_t *state) {
+    uart_set_baudrate(SERIAL_UART, baud);
+}
+
+static bool link_tx_idle(device_t *state) {
+    return queue_is_empty(&state->uart_tx_queue) && !dma_channel_is_busy(state->dma_tx_channel)
+           && !(uart_get_hw(SERIAL_UART)->fr & UART_UARTFR_BUSY_BITS);
+}
+
+/* Keyboard reports sent while the rates didn't match are lost, make sure no key stays stuck on the other side */
+static void link_settled(device_t *state) {
+    hid_keyboard_report_t report;
+
+    if (CURRENT_BOARD_IS_ACTIVE_OUTPUT)
+        return;
+
+    combine_kbd_states(state, &report);
+    queue_packet_to((uint8_t *)&report, KEYBOARD_REPORT_MSG, KBD_REPORT_LENGTH, state->active_output);
+}
+
+static const link_io_t uart_link = {
+    .send     = &link_send,
+    .set_rate = &link_set_rate,
+    .tx_idle  = &link_tx_idle,
+    .settled  = &link_settled,
+};
+
+void link_task(device_t *state) {
+    link_step(&state->link, &uart_link, time_us_64(), state);
+}
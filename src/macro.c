@@ -0,0 +1,559 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+_Static_assert(sizeof(macro_storage_t) <= FLASH_SECTOR_SIZE,
+               "macro_storage_t must fit in a single flash sector");
+
+/* RAM copy of the macro sector, flash isn't touched during playback */
+static macro_storage_t macros;
+static macro_player_t player;
+static text_typist_t typist;
+
+/* ================================================== *
+ * Macro storage
+ * ================================================== */
+
+/* Everything from start[] onwards is macro data, uploaded by the host */
+#define MACRO_DATA_OFFSET offsetof(macro_storage_t, start)
+#define MACRO_DATA_SIZE   (sizeof(macro_storage_t) - MACRO_DATA_OFFSET)
+
+static uint32_t macro_checksum(const macro_storage_t *storage) {
+    return calc_crc32((const uint8_t *)storage + MACRO_DATA_OFFSET, MACRO_DATA_SIZE);
+}
+
+/* Copy macros from flash to RAM, if they don't check out, all slots are left empty */
+void load_macros(void) {
+    memcpy(&macros, ADDR_MACROS, sizeof(macro_storage_t));
+
+    if (macros.magic != MACRO_MAGIC || macros.checksum != macro_checksum(&macros)) {
+        memset(&macros, 0, sizeof(macro_storage_t));
+        memset(macros.start, 0xFF, sizeof(macros.start));
+    }
+}
+
+bool save_macros(void) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+
+    macros.magic    = MACRO_MAGIC;
+    macros.checksum = macro_checksum(&macros);
+
+    /* First page write erases the whole sector, the last one is padded with zeros. Stops at the first
+       page that didn't go through, same as save_config. */
+    for (uint32_t offset = 0; offset < sizeof(macro_storage_t); offset += FLASH_PAGE_SIZE) {
+        uint32_t len = MIN(FLASH_PAGE_SIZE, sizeof(macro_storage_t) - offset);
+
+        memset(page, 0, FLASH_PAGE_SIZE);
+        memcpy(page, (uint8_t *)&macros + offset, len);
+
+        if (!write_flash_page((uint32_t)ADDR_MACROS - XIP_BASE + offset, page))
+            return false;
+    }
+    return true;
+}
+
+/* Host uploads macros in chunks, offset is counted from the start[] table */
+bool write_macro_storage(uint32_t offset, const uint8_t *data, uint16_t len) {
+    if (offset > MACRO_DATA_SIZE || len > MACRO_DATA_SIZE - offset)
+        return false;
+
+    memcpy((uint8_t *)&macros + MACRO_DATA_OFFSET + offset, data, len);
+    return true;
+}
+
+/* Read back up to len bytes from offset, returns how many were copied */
+uint16_t read_macro_storage(uint32_t offset, uint8_t *data, uint16_t len) {
+    if (offset >= MACRO_DATA_SIZE)
+        return 0;
+
+    len = MIN(len, MACRO_DATA_SIZE - offset);
+    memcpy(data, (uint8_t *)&macros + MACRO_DATA_OFFSET + offset, len);
+    return len;
+}
+
+/* ================================================== *
+ * Macro playback
+ * ================================================== */
+
+/* Press or release a key, pressed keys are kept packed at the start of keycode[] */
+static void macro_key(hid_keyboard_report_t *keys, uint8_t key, bool down) {
+    int slot = 0;
+
+    if (key >= HID_KEY_CONTROL_LEFT && key <= HID_KEY_GUI_RIGHT) {
+        uint8_t bit = 1 << (key - HID_KEY_CONTROL_LEFT);
+        keys->modifier = down ? (keys->modifier | bit) : (keys->modifier & ~bit);
+        return;
+    }
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++)
+        if (keys->keycode[i] != key && keys->keycode[i] != 0)
+            keys->keycode[slot++] = keys->keycode[i];
+
+    /* Out of free slots, the key is dropped same as on a real 6KRO keyboard */
+    if (down && key != 0 && slot < KEYS_IN_USB_REPORT)
+        keys->keycode[slot++] = key;
+
+    while (slot < KEYS_IN_USB_REPORT)
+        keys->keycode[slot++] = 0;
+}
+
+static bool macro_holds_input(const macro_player_t *player) {
+    return player->keys.modifier || player->keys.keycode[0] || player->mouse.buttons;
+}
+
+/* Release whatever the macro is holding on the current output */
+static void macro_release(macro_player_t *player, const macro_sink_t *sink, device_t *state) {
+    if (player->keys.modifier || player->keys.keycode[0]) {
+        memset(&player->keys, 0, sizeof(hid_keyboard_report_t));
+        sink->keyboard(&player->keys, player->output, state);
+    }
+
+    if (player->mouse.buttons) {
+        player->mouse.buttons = 0;
+        sink->mouse(&player->mouse, player->output, state);
+    }
+}
+
+/* Steps that don't send anything never wait for queue space */
+static bool macro_step_sends(const macro_player_t *player, const macro_step_t *step) {
+    switch (step->type) {
+        case MACRO_DELAY:
+            return false;
+
+        case MACRO_END:
+        case MACRO_OUTPUT:
+            return macro_holds_input(player);
+
+        default:
+            return true;
+    }
+}
+
+void macro_player_start(macro_player_t *player, const macro_storage_t *storage, uint8_t index, device_t *state) {
+    /* A macro that is already playing has to finish first */
+    if (player->step != NULL)
+        return;
+
+    if (index >= MAX_MACROS || storage->start[index] >= MAX_MACRO_STEPS)
+        return;
+
+    *player = (macro_player_t){
+        .step   = &storage->steps[storage->start[index]],
+        .end    = &storage->steps[MAX_MACRO_STEPS],
+        .output = state->active_output,
+        .mouse  = {.x = state->pointer_x, .y = state->pointer_y, .mode = ABSOLUTE},
+    };
+}
+
+/* Run steps until a delay, a full destination queue or the per-pass step limit */
+void macro_player_run(macro_player_t *player, const macro_sink_t *sink, uint64_t now, device_t *state) {
+    for (int n = 0; n < MACRO_STEPS_PER_PASS && player->step != NULL; n++) {
+        const macro_step_t *step = player->step;
+
+        /* Still waiting for a delay step to pass */
+        if (now < player->resume_at)
+            return;
+
+        /* Running off the end of storage is treated as the end of the macro */
+        if (step >= player->end) {
+            static const macro_step_t end_step = {.type = MACRO_END};
+            step = &end_step;
+        }
+
+        /* Live input always has room, macros only use what's left */
+        if (macro_step_sends(player, step) && !sink->ready(player->output, state))
+            return;
+
+        switch (step->type) {
+            case MACRO_END:
+                macro_release(player, sink, state);
+                player->step = NULL;
+                return;
+
+            case MACRO_KEY_DOWN:
+            case MACRO_KEY_UP:
+                macro_key(&player->keys, step->arg, step->type == MACRO_KEY_DOWN);
+                sink->keyboard(&player->keys, player->output, state);
+                break;
+
+            case MACRO_MOUSE_MOVE:
+                player->mouse.x = MIN(MAX(step->x, MIN_SCREEN_COORD), MAX_SCREEN_COORD);
+                player->mouse.y = MIN(MAX(step->y, MIN_SCREEN_COORD), MAX_SCREEN_COORD);
+                sink->mouse(&player->mouse, player->output, state);
+                break;
+
+            case MACRO_MOUSE_BUTTONS:
+                player->mouse.buttons = step->arg;
+                sink->mouse(&player->mouse, player->output, state);
+                break;
+
+            case MACRO_DELAY:
+                player->resume_at = now + (uint16_t)step->x * 1000ull;
+                break;
+
+            case MACRO_OUTPUT:
+                /* Don't leave anything pressed on the output we're leaving */
+                macro_release(player, sink, state);
+
+                if (step->arg < NUM_SCREENS)
+                    player->output = step->arg;
+                break;
+
+            case MACRO_TEXT: {
+                /* Text is packed into the steps that follow, make sure it doesn't run past the end */
+                const macro_step_t *next = step + 1 + (step->arg + sizeof(macro_step_t) - 1) / sizeof(macro_step_t);
+
+                if (next > player->end) {
+                    player->step = player->end;
+                    continue;
+                }
+
+                /* Wait until the text queue has room for all of it */
+                if (!sink->text((const uint8_t *)(step + 1), step->arg, player->output, state))
+                    return;
+
+                player->step = next;
+                continue;
+            }
+        }
+
+        player->step++;
+    }
+}
+
+/* ================================================== *
+ * Text injection
+ * ================================================== */
+
+static void text_push_key(text_typist_t *typist, uint8_t key, uint8_t modifier) {
+    if (typist->pending_count < TEXT_PENDING_KEYS)
+        typist->pending[typist->pending_count++] = (keystroke_t){.key = key, .modifier = modifier};
+}
+
+/* ASCII character with extra modifiers held, characters that have no key are skipped */
+static void text_push_char(text_typist_t *typist, uint8_t ch, uint8_t modifier) {
+    const keystroke_t *stroke = &typist->layout->ascii[ch & 0x7F];
+
+    if (stroke->key)
+        text_push_key(typist, stroke->key, stroke->modifier | modifier);
+}
+
+/* Linux (GTK/IBus) types any code point with Ctrl+Shift+U, its hex digits and a space */
+static void text_unicode_linux(text_typist_t *typist, uint32_t codepoint) {
+    static const char hex[] = "0123456789abcdef";
+    bool leading = true;
+
+    if (codepoint > 0x10FFFF)
+        return;
+
+    text_push_char(typist, 'u', KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT);
+
+    for (int shift = 20; shift >= 0; shift -= 4) {
+        uint8_t digit = (codepoint >> shift) & 0xF;
+
+        if (leading && digit == 0 && shift)
+            continue;
+
+        leading = false;
+        text_push_char(typist, hex[digit], 0);
+    }
+
+    text_push_char(typist, ' ', 0);
+}
+
+/* Windows types Alt + 0 and the decimal code on the keypad in the ANSI code page, entered when Alt
+   goes up. Windows-1252 matches Latin-1 from 0xA0 up, the accented letters of western languages. */
+static void text_unicode_windows(text_typist_t *typist, uint32_t codepoint) {
+    if (codepoint < 0xA0 || codepoint > 0xFF)
+        return;
+
+    text_push_key(typist, HID_KEY_KEYPAD_0, KEYBOARD_MODIFIER_LEFTALT);
+
+    for (uint32_t div = 100; div; div /= 10) {
+        uint8_t digit = codepoint / div % 10;
+        text_push_key(typist, digit ? HID_KEY_KEYPAD_1 + digit - 1 : HID_KEY_KEYPAD_0, KEYBOARD_MODIFIER_LEFTALT);
+    }
+
+    text_push_key(typist, 0, 0);
+}
+
+/* macOS (US layout) has Latin-1 letters on Option + key, either directly or as an accent that goes
+   on the letter typed next. Lowercase only, uppercase ones are shifted. */
+static const struct {
+    uint8_t ch;         // Latin-1 code
+    uint8_t option_key; // Key pressed with Option
+    char letter;        // Letter the accent goes on, 0 if Option + key is the whole character
+} macos_latin1[] = {
+    {0xDF, HID_KEY_S, 0},   {0xE0, HID_KEY_GRAVE, 'a'}, {0xE1, HID_KEY_E, 'a'}, {0xE2, HID_KEY_I, 'a'},
+    {0xE3, HID_KEY_N, 'a'}, {0xE4, HID_KEY_U, 'a'},     {0xE5, HID_KEY_A, 0},   {0xE6, HID_KEY_APOSTROPHE, 0},
+    {0xE7, HID_KEY_C, 0},   {0xE8, HID_KEY_GRAVE, 'e'}, {0xE9, HID_KEY_E, 'e'}, {0xEA, HID_KEY_I, 'e'},
+    {0xEB, HID_KEY_U, 'e'}, {0xEC, HID_KEY_GRAVE, 'i'}, {0xED, HID_KEY_E, 'i'}, {0xEE, HID_KEY_I, 'i'},
+    {0xEF, HID_KEY_U, 'i'}, {0xF1, HID_KEY_N, 'n'},     {0xF2, HID_KEY_GRAVE, 'o'}, {0xF3, HID_KEY_E, 'o'},
+    {0xF4, HID_KEY_I, 'o'}, {0xF5, HID_KEY_N, 'o'},     {0xF6, HID_KEY_U, 'o'}, {0xF8, HID_KEY_O, 0},
+    {0xF9, HID_KEY_GRAVE, 'u'}, {0xFA, HID_KEY_E, 'u'}, {0xFB, HID_KEY_I, 'u'}, {0xFC, HID_KEY_U, 'u'},
+    {0xFD, HID_KEY_E, 'y'}, {0xFF, HID_KEY_U, 'y'},
+};
+
+static void text_unicode_macos(text_typist_t *typist, uint32_t codepoint) {
+    /* Uppercase Latin-1 letters are 0x20 below the lowercase ones, except the multiplication sign */
+    bool upper = codepoint >= 0xC0 && codepoint <= 0xDE && codepoint != 0xD7;
+    uint32_t lower = upper ? codepoint + 0x20 : codepoint;
+
+    for (int i = 0; i < ARRAY_SIZE(macos_latin1); i++) {
+        if (macos_latin1[i].ch != lower)
+            continue;
+
+        if (!macos_latin1[i].letter) {
+            text_push_key(typist, macos_latin1[i].option_key,
+                          KEYBOARD_MODIFIER_LEFTALT | (upper ? KEYBOARD_MODIFIER_LEFTSHIFT : 0));
+            return;
+        }
+
+        text_push_key(typist, macos_latin1[i].option_key, KEYBOARD_MODIFIER_LEFTALT);
+        text_push_char(typist, upper ? macos_latin1[i].letter - 'a' + 'A' : macos_latin1[i].letter, 0);
+        return;
+    }
+}
+
+/* How each OS types text, the host is taken to use a US layout. Others only get ASCII. */
+static const text_layout_t text_layouts[] = {
+    [LINUX]   = {.ascii = us_ascii_keystrokes, .unicode = &text_unicode_linux},
+    [MACOS]   = {.ascii = us_ascii_keystrokes, .unicode = &text_unicode_macos},
+    [WINDOWS] = {.ascii = us_ascii_keystrokes, .unicode = &text_unicode_windows},
+};
+
+static const text_layout_t ascii_layout = {.ascii = us_ascii_keystrokes};
+
+static const text_layout_t *get_text_layout(uint8_t os) {
+    if (os < ARRAY_SIZE(text_layouts) && text_layouts[os].ascii)
+        return &text_layouts[os];
+
+    return &ascii_layout;
+}
+
+/* Feed one byte of UTF-8, returns true once a whole code point was decoded */
+static bool text_decode_utf8(text_typist_t *typist, uint8_t byte, uint32_t *codepoint) {
+    if (byte < 0x80) {
+        typist->utf8_left = 0;
+        *codepoint        = byte;
+        return true;
+    }
+
+    /* Continuation byte, stray ones are dropped */
+    if ((byte & 0xC0) == 0x80) {
+        if (!typist->utf8_left)
+            return false;
+
+        typist->codepoint = (typist->codepoint << 6) | (byte & 0x3F);
+        *codepoint        = typist->codepoint;
+        return --typist->utf8_left == 0;
+    }
+
+    if ((byte & 0xE0) == 0xC0) {
+        typist->codepoint = byte & 0x1F;
+        typist->utf8_left = 1;
+    } else if ((byte & 0xF0) == 0xE0) {
+        typist->codepoint = byte & 0x0F;
+        typist->utf8_left = 2;
+    } else if ((byte & 0xF8) == 0xF0) {
+        typist->codepoint = byte & 0x07;
+        typist->utf8_left = 3;
+    } else
+        typist->utf8_left = 0;
+
+    return false;
+}
+
+/* Turn a code point into keystrokes, with the layout of the OS it's typed on */
+static void text_map_codepoint(text_typist_t *typist, uint32_t codepoint, uint8_t os) {
+    typist->pending_count = 0;
+    typist->pending_pos   = 0;
+    typist->layout        = get_text_layout(os);
+
+    /* CR LF would otherwise press Enter twice */
+    if (codepoint == '\r')
+        return;
+
+    if (codepoint < 128)
+        text_push_char(typist, codepoint, 0);
+    else if (typist->layout->unicode)
+        typist->layout->unicode(typist, codepoint);
+}
+
+static bool text_holds_keys(const text_typist_t *typist) {
+    return typist->report.modifier || typist->report.keycode[0];
+}
+
+/* Remove a key from the held keys, keeping the rest packed, oldest first */
+static void text_drop_key(hid_keyboard_report_t *report, int index) {
+    for (int i = index; i < KEYS_IN_USB_REPORT - 1; i++)
+        report->keycode[i] = report->keycode[i + 1];
+
+    report->keycode[KEYS_IN_USB_REPORT - 1] = 0;
+}
+
+/* Send the report for the next pending keystroke */
+static void text_type_key(text_typist_t *typist, const macro_sink_t *sink, device_t *state) {
+    const keystroke_t *stroke    = &typist->pending[typist->pending_pos];
+    hid_keyboard_report_t *report = &typist->report;
+    int slot                     = 0;
+
+    /* Let go of everything, e.g. Alt at the end of an Alt code */
+    if (!stroke->key) {
+        memset(report, 0, sizeof(hid_keyboard_report_t));
+        typist->pending_pos++;
+        sink->keyboard(report, typist->output, state);
+        return;
+    }
+
+    while (slot < KEYS_IN_USB_REPORT && report->keycode[slot] && report->keycode[slot] != stroke->key)
+        slot++;
+
+    /* Key is already held (repeated character), it has to be released before it's pressed again */
+    if (slot < KEYS_IN_USB_REPORT && report->keycode[slot] == stroke->key) {
+        text_drop_key(report, slot);
+        sink->keyboard(report, typist->output, state);
+        return;
+    }
+
+    /* All slots are taken, let go of the oldest key in the same report */
+    if (slot == KEYS_IN_USB_REPORT) {
+        text_drop_key(report, 0);
+        slot--;
+    }
+
+    report->keycode[slot] = stroke->key;
+    report->modifier      = stroke->modifier;
+    typist->pending_pos++;
+
+    sink->keyboard(report, typist->output, state);
+}
+
+void text_typist_run(text_typist_t *typist, const macro_sink_t *sink, device_t *state) {
+    text_char_t next;
+    uint32_t codepoint;
+
+    for (int n = 0; n < TEXT_STEPS_PER_PASS; n++) {
+        /* Keystrokes of the current character come first */
+        if (typist->pending_pos < typist->pending_count) {
+            if (!sink->ready(typist->output, state))
+                return;
+
+            text_type_key(typist, sink, state);
+            continue;
+        }
+
+        /* Out of text or switching outputs, let go of everything held so far */
+        bool has_next = queue_try_peek(&state->text_queue, &next);
+
+        if (text_holds_keys(typist) && (!has_next || next.output != typist->output)) {
+            if (!sink->ready(typist->output, state))
+                return;
+
+            memset(&typist->report, 0, sizeof(hid_keyboard_report_t));
+            sink->keyboard(&typist->report, typist->output, state);
+            continue;
+        }
+
+        if (!has_next)
+            return;
+
+        queue_try_remove(&state->text_queue, &next);
+        typist->output = next.output;
+
+        if (text_decode_utf8(typist, next.ch, &codepoint))
+            text_map_codepoint(typist, codepoint, state->config.output[next.output].os);
+    }
+}
+
+/* ================================================== *
+ * Report sink, local queues or the other board
+ * ================================================== */
+
+static bool macro_ready(uint8_t output, device_t *state) {
+    if (output == BOARD_ROLE)
+        return queue_get_level(&state->kbd_queue) < MACRO_QUEUE_LIMIT
+               && queue_get_level(&state->mouse_queue) < MACRO_QUEUE_LIMIT;
+
+    return queue_get_level(&state->uart_tx_queue) < MACRO_QUEUE_LIMIT;
+}
+
+/* Macro keys are merged with the keyboards, so keys held during playback aren't released */
+static void macro_keyboard(hid_keyboard_report_t *report, uint8_t output, device_t *state) {
+    inject_keys(state, KBD_SOURCE_MACRO, report, output);
+}
+
+/* So are the keys of typed text */
+static void text_keyboard(hid_keyboard_report_t *report, uint8_t output, device_t *state) {
+    inject_keys(state, KBD_SOURCE_TEXT, report, output);
+}
+
+static void macro_mouse(mouse_report_t *report, uint8_t output, device_t *state) {
+    if (output == BOARD_ROLE) {
+        queue_mouse_report(report, state);
+        state->pointer_x = report->x;
+        state->pointer_y = report->y;
+    } else
+        mouse_link_send(report, output, state);
+}
+
+/* Macros wait for any text they typed to finish, so their keys don't get mixed up */
+static bool macro_ready_after_text(uint8_t output, device_t *state) {
+    if (!queue_is_empty(&state->text_queue) || text_holds_keys(&typist))
+        return false;
+
+    return macro_ready(output, state);
+}
+
+/* Queue text to be typed on output, all of it or nothing. Outputs beyond NUM_SCREENS mean the active one. */
+bool type_text(const uint8_t *text, uint16_t len, uint8_t output, device_t *state) {
+    if (output >= NUM_SCREENS)
+        output = state->active_output;
+
+    if (TEXT_QUEUE_LENGTH - queue_get_level(&state->text_queue) < len)
+        return false;
+
+    for (uint16_t i = 0; i < len; i++) {
+        text_char_t ch = {.output = output, .ch = text[i]};
+        queue_try_add(&state->text_queue, &ch);
+    }
+
+    return true;
+}
+
+static const macro_sink_t hid_sink = {
+    .ready    = &macro_ready_after_text,
+    .keyboard = &macro_keyboard,
+    .mouse    = &macro_mouse,
+    .text     = &type_text,
+};
+
+static const macro_sink_t text_sink = {
+    .ready    = &macro_ready,
+    .keyboard = &text_keyboard,
+};
+
+/* Called from a hotkey, runs on the same core as the playback task */
+void start_macro(uint8_t index, device_t *state) {
+    macro_player_start(&player, &macros, index, state);
+}
+
+void process_macro_task(device_t *state) {
+    if (player.step == NULL)
+        return;
+
+    macro_player_run(&player, &hid_sink, time_us_64(), state);
+}
+
+void process_text_task(device_t *state) {
+    text_typist_run(&typist, &text_sink, state);
+}
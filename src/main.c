@@ -30,6 +30,12 @@ int main(void) {
         [3] = {.exec = &process_mouse_queue_task, .frequency = _HZ(2000)},   // | Check if there were any mouse movements and send them
         [4] = {.exec = &process_hid_queue_task,   .frequency = _HZ(1000)},   // | Check if there are any packets to send over vendor link
         [5] = {.exec = &process_uart_tx_task,     .frequency = _TOP()},      // | Check if there are any packets to send over UART
+        [6] = {.exec = &link_task,                .frequency = _HZ(1000)},   // | Watch link health, negotiate the baud rate
+        [7] = {.exec = &process_chain_tx_task,    .frequency = _TOP()},      // | Send packets to the neighbouring DeskHop, if chained
+        [8] = {.exec = &usb_reconnect_task,       .frequency = _HZ(100)},    // | Re-enumerate when we have something new to offer
+#if defined(DH_TRACE) && defined(DH_DEBUG)
+        [9] = {.exec = &trace_cdc_task,           .frequency = _HZ(1000)},   // | Send recorded trace events over CDC
+#endif
     };                                                                       // `----- then go back and repeat forever
     const int NUM_TASKS = ARRAY_SIZE(tasks_core0);
 
@@ -43,6 +49,8 @@ int main(void) {
     set_active_output(device, OUTPUT_A);
 
     while (true) {
+        device->stats.loops[0]++;
+
         for (int i = 0; i < NUM_TASKS; i++)
             task_scheduler(device, &tasks_core0[i]);
     }
@@ -57,12 +65,25 @@ void core1_main() {
         [4] = {.exec = &screensaver_task,        .frequency = _HZ(120)},     // | Handle "screensaver" movements
         [5] = {.exec = &firmware_upgrade_task,   .frequency = _HZ(4000)},    // | Send firmware to the other board if needed
         [6] = {.exec = &heartbeat_output_task,   .frequency = _HZ(1)},       // | Output periodic heartbeats
+        [7] = {.exec = &process_fw_queue_task,   .frequency = _TOP()},       // | Write received UF2 pages to flash
+        [8] = {.exec = &process_macro_task,      .frequency = _HZ(2000)},    // | Play back macros started by hotkeys
+        [9] = {.exec = &process_text_task,       .frequency = _HZ(2000)},    // | Type out text from the API or macros
+        [10] = {.exec = &stats_task,             .frequency = _HZ(1)},       // | Turn runtime counters into rates
+        [11] = {.exec = &chain_receiver_task,    .frequency = _TOP()},       // | Receive from the neighbouring DeskHop, if chained
+        [12] = {.exec = &mouse_link_task,        .frequency = _TOP()},       // | Send mouse reports held back while the link was busy
+        [13] = {.exec = &mouse_pending_task,     .frequency = _TOP()},       // | Send added up mouse movement once the host can take it
+        [14] = {.exec = &passthrough_link_task,  .frequency = _TOP()},       // | Send a pass-through report held back while the link was busy
+        [15] = {.exec = &gamepad_link_task,      .frequency = _TOP()},       // | Send gamepad changes held back while the link was busy
     };                                                                       // `----- then go back and repeat forever
     const int NUM_TASKS = ARRAY_SIZE(tasks_core1);
 
+    // Core0 writes flash too (config, macros), so this core has to get out of its way
+    flash_safe_execute_core_init();
+
     while (true) {
         // Update the timestamp, so core0 can figure out if we're dead
         device->core1_last_loop_pass = time_us_32();
+        device->stats.loops[1]++;
 
         for (int i = 0; i < NUM_TASKS; i++)
             task_scheduler(device, &tasks_core1[i]);
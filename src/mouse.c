@@ -11,44 +11,46 @@
 
 #include "main.h"
 #include <math.h>
+#include <pico/critical_section.h>
 
 #define MACOS_SWITCH_MOVE_X 10
 #define MACOS_SWITCH_MOVE_COUNT 5
 #define ACCEL_POINTS 7
 
-uint16_t get_jump_threshold(output_t *output, enum screen_pos_e direction) {
-    const uint16_t NO_JUMP_THRESHOLD = 0;
+/* Check if moving past 'edge' by 'overshoot' takes us to another screen. Local switches (virtual
+   desktop changes) have no gap, only cross-output jumps use the threshold. */
+static enum screen_pos_e edge_switch_needed(device_t *state, enum screen_pos_e edge, int overshoot, int pos) {
+    const screen_transition_t *to = screen_transition(state, edge, pos, NULL);
 
-    /* If on non-main local screen, every possible switch is local */
-    if (output->screen_index > 1)
-        return NO_JUMP_THRESHOLD;
-
-    /* If on main screen but going away from the border, switch is local */
-    if (output->pos == direction && output->screen_index == 1)
-        return NO_JUMP_THRESHOLD;
+    if (to == NULL)
+        return NONE;
 
-    /* ... in all other cases, switch is non-local (jump to another pc) */
-    return global_state.config.jump_threshold;
+    uint16_t threshold = (to->output != state->active_output) ? global_state.config.jump_threshold : 0;
+    return (overshoot > threshold) ? edge : NONE;
 }
 
-/* Check if our upcoming mouse movement would result in having to switch outputs */
-enum screen_pos_e is_screen_switch_needed(output_t *output, int position, int offset) {
-    enum screen_pos_e direction = (offset < 0) ? LEFT : RIGHT;
+/* Check if our upcoming mouse movement would result in having to switch screens */
+enum screen_pos_e is_screen_switch_needed(device_t *state, int offset_x, int offset_y) {
+    int x = state->pointer_x + offset_x;
+    int y = state->pointer_y + offset_y;
+    enum screen_pos_e direction = NONE;
 
-    /* No position offset implies no switch needed. */
-    if (offset == 0)
+    /* Still on screen, which is nearly always, so no need to look further */
+    if (x >= MIN_SCREEN_COORD && x <= MAX_SCREEN_COORD && y >= MIN_SCREEN_COORD && y <= MAX_SCREEN_COORD)
         return NONE;
 
-    /* Local switches (virtual desktop changes) have no gap, only cross-output jumps use threshold */
-    uint16_t threshold = get_jump_threshold(output, direction);
-
-    if (position + offset < MIN_SCREEN_COORD - threshold)
-        return LEFT;
+    if (x < MIN_SCREEN_COORD)
+        direction = edge_switch_needed(state, LEFT, MIN_SCREEN_COORD - x, y);
+    else if (x > MAX_SCREEN_COORD)
+        direction = edge_switch_needed(state, RIGHT, x - MAX_SCREEN_COORD, y);
 
-    if (position + offset > MAX_SCREEN_COORD + threshold)
-        return RIGHT;
+    /* In a corner, the side edge wins if there's somewhere to go */
+    if (direction == NONE && y < MIN_SCREEN_COORD)
+        direction = edge_switch_needed(state, TOP, MIN_SCREEN_COORD - y, x);
+    else if (direction == NONE && y > MAX_SCREEN_COORD)
+        direction = edge_switch_needed(state, BOTTOM, y - MAX_SCREEN_COORD, x);
 
-    return NONE;
+    return direction;
 }
 
 /* Move mouse coordinate 'position' by 'offset', but don't fall off the screen */
@@ -118,7 +120,7 @@ float calculate_mouse_acceleration_factor(int32_t offset_x, int32_t offset_y) {
     return lower->factor + interpolation_pos * (upper->factor - lower->factor);
 }
 
-/* Returns LEFT if need to jump left, RIGHT if right, NONE otherwise */
+/* Returns the edge we need to jump over (LEFT, RIGHT, TOP or BOTTOM), NONE otherwise */
 enum screen_pos_e update_mouse_position(device_t *state, mouse_values_t *values) {
     output_t *current    = &state->config.output[state->active_output];
     uint8_t reduce_speed = 0;
@@ -133,7 +135,7 @@ enum screen_pos_e update_mouse_position(device_t *state, mouse_values_t *values)
     int offset_y = round(values->move_y * acceleration_factor * (current->speed_y >> reduce_speed));
 
     /* Determine if our upcoming movement would stay within the screen */
-    enum screen_pos_e switch_direction = is_screen_switch_needed(current, state->pointer_x, offset_x);
+    enum screen_pos_e switch_direction = is_screen_switch_needed(state, offset_x, offset_y);
 
     /* Update movement */
     state->pointer_x = move_and_keep_on_screen(state->pointer_x, offset_x);
@@ -145,50 +147,51 @@ enum screen_pos_e update_mouse_position(device_t *state, mouse_values_t *values)
     return switch_direction;
 }
 
+/* Outputs set to TOUCH get the pointer from a pen digitizer spanning all of their screens. An absolute
+   mouse only covers the main screen on some systems, which needs the workarounds below. */
+static void to_pointer_mode(device_t *state, mouse_report_t *report) {
+    int16_t x = report->x, y = report->y;
+
+    if (state->config.output[state->active_output].pointer_mode != TOUCH)
+        return;
+
+    desktop_position(state, &x, &y);
+
+    report->x    = x;
+    report->y    = y;
+    report->mode = TOUCH;
+}
+
 /* If we are active output, queue packet to mouse queue, else send them through UART */
 void output_mouse_report(mouse_report_t *report, device_t *state) {
     if (CURRENT_BOARD_IS_ACTIVE_OUTPUT) {
         queue_mouse_report(report, state);
         state->last_activity[BOARD_ROLE] = time_us_64();
-    } else {
-        queue_packet((uint8_t *)report, MOUSE_REPORT_MSG, MOUSE_REPORT_LENGTH);
-    }
+    } else
+        mouse_link_send(report, state->active_output, state);
 }
 
-/* Calculate and return Y coordinate when moving from screen out_from to screen out_to */
-int16_t scale_y_coordinate(int screen_from, int screen_to, device_t *state) {
-    output_t *from = &state->config.output[screen_from];
-    output_t *to   = &state->config.output[screen_to];
-
-    int size_to   = to->border.bottom - to->border.top;
-    int size_from = from->border.bottom - from->border.top;
-
-    /* If sizes match, there is nothing to do */
-    if (size_from == size_to)
-        return state->pointer_y;
-
-    /* Moving from smaller ==> bigger screen
-       y_a = top + (((bottom - top) * y_b) / HEIGHT) */
+/* Put the pointer where it enters the new screen after crossing 'direction', at 'pos' along that edge */
+static void enter_screen(device_t *state, int direction, int16_t pos) {
+    switch (direction) {
+        case LEFT:
+        case RIGHT:
+            state->pointer_x = (direction == LEFT) ? MAX_SCREEN_COORD : MIN_SCREEN_COORD;
+            state->pointer_y = pos;
+            break;
 
-    if (size_from > size_to) {
-        return to->border.top + ((size_to * state->pointer_y) / MAX_SCREEN_COORD);
+        case TOP:
+        case BOTTOM:
+            state->pointer_x = pos;
+            state->pointer_y = (direction == TOP) ? MAX_SCREEN_COORD : MIN_SCREEN_COORD;
+            break;
     }
-
-    /* Moving from bigger ==> smaller screen
-       y_b = ((y_a - top) * HEIGHT) / (bottom - top) */
-
-    if (state->pointer_y < from->border.top)
-        return MIN_SCREEN_COORD;
-
-    if (state->pointer_y > from->border.bottom)
-        return MAX_SCREEN_COORD;
-
-    return ((state->pointer_y - from->border.top) * MAX_SCREEN_COORD) / size_from;
 }
 
 void switch_to_another_pc(
-    device_t *state, output_t *output, int output_to, int direction) {
+    device_t *state, output_t *output, const screen_transition_t *to, int direction, int16_t pos) {
     uint8_t *mouse_park_pos = &state->config.output[state->active_output].mouse_park_pos;
+    output_t *next          = &state->config.output[to->output];
 
     int16_t mouse_y = (*mouse_park_pos == 0) ? MIN_SCREEN_COORD : /* Top */
                       (*mouse_park_pos == 1) ? MAX_SCREEN_COORD : /* Bottom */
@@ -196,10 +199,14 @@ void switch_to_another_pc(
 
     mouse_report_t hidden_pointer = {.y = mouse_y, .x = MAX_SCREEN_COORD};
 
+    to_pointer_mode(state, &hidden_pointer);
     output_mouse_report(&hidden_pointer, state);
-    set_active_output(state, output_to);
-    state->pointer_x = (direction == LEFT) ? MAX_SCREEN_COORD : MIN_SCREEN_COORD;
-    state->pointer_y = scale_y_coordinate(output->number, 1 - output->number, state);
+    set_active_output(state, to->output);
+
+    /* Windows extra screens only work with relative movement, see switch_virtual_desktop */
+    next->screen_index    = to->index + 1;
+    state->relative_mouse = (next->os == WINDOWS && next->screen_index > 1 && next->pointer_mode != TOUCH);
+    enter_screen(state, direction, pos);
 }
 
 void switch_virtual_desktop_macos(device_t *state, int direction) {
@@ -210,16 +217,20 @@ void switch_virtual_desktop_macos(device_t *state, int direction) {
      * 2. Send relative mouse movement one or two pixels in the direction of movement to get
      *    the cursor onto the next screen
      */
+    bool vertical = (direction == TOP || direction == BOTTOM);
+    int16_t edge  = (direction == LEFT || direction == TOP) ? MIN_SCREEN_COORD : MAX_SCREEN_COORD;
+
     mouse_report_t edge_position = {
-        .x = (direction == LEFT) ? MIN_SCREEN_COORD : MAX_SCREEN_COORD,
-        .y = MAX_SCREEN_COORD / 2,
+        .x = vertical ? MAX_SCREEN_COORD / 2 : edge,
+        .y = vertical ? edge : MAX_SCREEN_COORD / 2,
         .mode = ABSOLUTE,
         .buttons = state->mouse_buttons,
     };
 
-    uint16_t move = (direction == LEFT) ? -MACOS_SWITCH_MOVE_X : MACOS_SWITCH_MOVE_X;
+    int16_t move = (edge == MIN_SCREEN_COORD) ? -MACOS_SWITCH_MOVE_X : MACOS_SWITCH_MOVE_X;
     mouse_report_t move_relative_one = {
-        .x = move,
+        .x = vertical ? 0 : move,
+        .y = vertical ? move : 0,
         .mode = RELATIVE,
         /* Force buttons to 0 for relative movement to avoid duplicating the button 
            press state, which would leave the relative HID mouse permanently stuck 
@@ -235,6 +246,12 @@ void switch_virtual_desktop_macos(device_t *state, int direction) {
 }
 
 void switch_virtual_desktop(device_t *state, output_t *output, int new_index, int direction) {
+    /* The digitizer already covers every screen, the next report simply lands on the new one */
+    if (output->pointer_mode == TOUCH) {
+        output->screen_index = new_index;
+        return;
+    }
+
     switch (output->os) {
         case MACOS:
             switch_virtual_desktop_macos(state, direction);
@@ -253,7 +270,6 @@ void switch_virtual_desktop(device_t *state, output_t *output, int new_index, in
             break;
     }
 
-    state->pointer_x       = (direction == RIGHT) ? MIN_SCREEN_COORD : MAX_SCREEN_COORD;
     output->screen_index = new_index;
 }
 
@@ -264,31 +280,120 @@ void switch_virtual_desktop(device_t *state, output_t *output, int new_index, in
       ||  extra  ||  ||   main  || | ||   main  ||  ||  extra  ||  ||  extra  ||   (main or extra)
        '---------'    '---------'  |  '---------'    '---------'    '---------'
           )___(          )___(     |     )___(          )___(          )___(
+
+   That's the layout pos, screen_count and border describe. Once every screen has its rectangle set,
+   screens can be anywhere, e.g. above or below each other. Either way, where crossing an edge leads
+   is looked up in the transition table built by build_screen_layout.
 */
 void do_screen_switch(device_t *state, int direction) {
     output_t *output = &state->config.output[state->active_output];
+    int pos          = (direction == LEFT || direction == RIGHT) ? state->pointer_y : state->pointer_x;
+    int16_t mapped;
 
     /* No switching allowed if explicitly disabled or in gaming mode */
     if (state->switch_lock || state->gaming_mode)
         return;
 
-    /* We want to jump in the direction of the other computer */
-    if (output->pos != direction) {
-        if (output->screen_index == 1) { /* We are at the border -> switch outputs */
-            /* No switching allowed if mouse button is held. Should only apply to the border! */
-            if (state->mouse_buttons)
-                return;
+    const screen_transition_t *to = screen_transition(state, direction, pos, &mapped);
 
-            switch_to_another_pc(state, output, 1 - state->active_output, direction);
-        }
-        /* If here, this output has multiple desktops and we are not on the main one */
-        else
-            switch_virtual_desktop(state, output, output->screen_index - 1, direction);
+    if (to == NULL)
+        return;
+
+    /* Screen belongs to another computer -> switch outputs */
+    if (to->output != state->active_output) {
+        /* No switching allowed if mouse button is held. Should only apply to the border! */
+        if (state->mouse_buttons)
+            return;
+
+        switch_to_another_pc(state, output, to, direction, mapped);
     }
+    /* If here, this output has multiple desktops and we're moving between them */
+    else {
+        switch_virtual_desktop(state, output, to->index + 1, direction);
+        enter_screen(state, direction, mapped);
+    }
+}
+
+/* ==================================================== *
+ * Scrolling
+ * ==================================================== */
+
+/* Wheel and pan move in 1/MOUSE_SCROLL_RESOLUTION of a detent internally. Turn 'counts' from a wheel
+   with 'resolution' counts per detent into that, what doesn't divide evenly waits in 'remainder'. */
+int32_t scale_scroll(int32_t counts, int32_t resolution, int32_t *remainder) {
+    int32_t total  = counts * MOUSE_SCROLL_RESOLUTION + *remainder;
+    int32_t scaled = total / MAX(resolution, 1);
 
-    /* We want to jump away from the other computer, only possible if there is another screen to jump to */
-    else if (output->screen_index < output->screen_count)
-        switch_virtual_desktop(state, output, output->screen_index + 1, direction);
+    /* More than a report can carry is dropped, not saved up for later */
+    if (scaled < -MOUSE_SCROLL_LIMIT || scaled > MOUSE_SCROLL_LIMIT) {
+        *remainder = 0;
+        return (scaled < 0) ? -MOUSE_SCROLL_LIMIT : MOUSE_SCROLL_LIMIT;
+    }
+
+    *remainder = total - scaled * MAX(resolution, 1);
+    return scaled;
+}
+
+/* A host with the Resolution Multiplier on takes our units as they are. Otherwise it gets whole detents,
+   the rest is kept in 'remainder' until it adds up to one. Turning the other way starts from zero. */
+int16_t scroll_to_host(int32_t amount, bool hires, int16_t *remainder) {
+    if (hires) {
+        *remainder = 0;
+        return amount;
+    }
+
+    if ((amount < 0 && *remainder > 0) || (amount > 0 && *remainder < 0))
+        *remainder = 0;
+
+    int32_t total = amount + *remainder;
+    *remainder    = total % MOUSE_SCROLL_RESOLUTION;
+    return total / MOUSE_SCROLL_RESOLUTION;
+}
+
+/* Set the mouse's Resolution Multipliers to their highest setting. Its reports switch to the finer
+   counts once it confirms, see mouse_hires_enabled. Called until the control pipe takes the request. */
+void mouse_enable_hires(uint8_t dev_addr, uint8_t instance, hid_interface_t *iface) {
+    mouse_t *mouse  = &iface->mouse;
+    uint8_t *report = mouse->feature;
+    uint16_t len    = mouse->feature_len;
+
+    memset(mouse->feature, 0, sizeof(mouse->feature));
+
+    /* With a report ID, it goes first and the fields follow */
+    if (mouse->feature_id) {
+        *report++ = mouse->feature_id;
+        len++;
+    }
+
+    /* The ones for something else than the wheel or pan stay at their lowest */
+    for (int i = 0; i < mouse->num_multipliers; i++)
+        if (mouse->multiplier[i].wheel || mouse->multiplier[i].pan)
+            set_report_value(report, mouse->feature_len, &mouse->multiplier[i].val, mouse->multiplier[i].logical_max);
+
+    if (tuh_hid_set_report(dev_addr, instance, mouse->feature_id, HID_REPORT_TYPE_FEATURE, mouse->feature, len))
+        mouse->hires_requested = false;
+}
+
+/* The mouse took the feature report. Wheel or pan without a multiplier of their own keep whole detents. */
+void mouse_hires_enabled(hid_interface_t *iface, uint8_t report_id, uint16_t len) {
+    mouse_t *mouse = &iface->mouse;
+
+    if (!len || !mouse->num_multipliers || report_id != mouse->feature_id)
+        return;
+
+    mouse->wheel_resolution = 1;
+    mouse->pan_resolution   = 1;
+
+    for (int i = 0; i < mouse->num_multipliers; i++) {
+        if (mouse->multiplier[i].wheel)
+            mouse->wheel_resolution = mouse->multiplier[i].resolution;
+
+        if (mouse->multiplier[i].pan)
+            mouse->pan_resolution = mouse->multiplier[i].resolution;
+    }
+
+    mouse->wheel_rest = 0;
+    mouse->pan_rest   = 0;
 }
 
 static inline bool extract_value(bool uses_id, int32_t *dst, report_val_t *src, uint8_t *raw_report, int len) {
@@ -301,24 +406,29 @@ static inline bool extract_value(bool uses_id, int32_t *dst, report_val_t *src,
 }
 
 void extract_report_values(uint8_t *raw_report, int len, device_t *state, mouse_values_t *values, hid_interface_t *iface) {
+    mouse_t *mouse = &iface->mouse;
+
     /* Interpret values depending on the current protocol used. */
     if (iface->protocol == HID_PROTOCOL_BOOT) {
         hid_mouse_report_t *mouse_report = (hid_mouse_report_t *)raw_report;
 
         values->move_x  = mouse_report->x;
         values->move_y  = mouse_report->y;
-        values->wheel   = mouse_report->wheel;
-        values->pan     = mouse_report->pan;
+        values->wheel   = scale_scroll(mouse_report->wheel, 1, &mouse->wheel_rest);
+        values->pan     = scale_scroll(mouse_report->pan, 1, &mouse->pan_rest);
         values->buttons = mouse_report->buttons;
         return;
     }
-    mouse_t *mouse = &iface->mouse;
     bool uses_id = iface->uses_report_id;
 
     extract_value(uses_id, &values->move_x, &mouse->move_x, raw_report, len);
     extract_value(uses_id, &values->move_y, &mouse->move_y, raw_report, len);
-    extract_value(uses_id, &values->wheel, &mouse->wheel, raw_report, len);
-    extract_value(uses_id, &values->pan, &mouse->pan, raw_report, len);
+
+    if (extract_value(uses_id, &values->wheel, &mouse->wheel, raw_report, len))
+        values->wheel = scale_scroll(values->wheel, mouse->wheel_resolution, &mouse->wheel_rest);
+
+    if (extract_value(uses_id, &values->pan, &mouse->pan, raw_report, len))
+        values->pan = scale_scroll(values->pan, mouse->pan_resolution, &mouse->pan_rest);
 
     if (!extract_value(uses_id, &values->buttons, &mouse->buttons, raw_report, len)) {
         values->buttons = state->mouse_buttons;
@@ -335,6 +445,8 @@ mouse_report_t create_mouse_report(device_t *state, mouse_values_t *values) {
         .mode    = ABSOLUTE,
     };
 
+    to_pointer_mode(state, &mouse_report);
+
     /* Workaround for Windows multiple desktops */
     if (state->relative_mouse || state->gaming_mode) {
         mouse_report.x = values->move_x;
@@ -345,6 +457,142 @@ mouse_report_t create_mouse_report(device_t *state, mouse_values_t *values) {
     return mouse_report;
 }
 
+/* Add a report to the pending one, as long as the sums still fit the report sent to the host */
+static bool merge_mouse_values(mouse_values_t *sum, const mouse_values_t *values) {
+    int32_t x = sum->move_x + values->move_x, y = sum->move_y + values->move_y;
+    int32_t wheel = sum->wheel + values->wheel, pan = sum->pan + values->pan;
+
+    if (sum->buttons != values->buttons)
+        return false;
+
+    if (x < INT16_MIN || x > INT16_MAX || y < INT16_MIN || y > INT16_MAX)
+        return false;
+
+    if (wheel < INT8_MIN || wheel > INT8_MAX || pan < INT8_MIN || pan > INT8_MAX)
+        return false;
+
+    sum->move_x = x;
+    sum->move_y = y;
+    sum->wheel  = wheel;
+    sum->pan    = pan;
+    return true;
+}
+
+/* ==================================================== *
+ * Gaming mode fast path
+ * ==================================================== */
+
+/* Raw movement waiting for the relative endpoint. Filled by core1, sent by core0. */
+typedef struct {
+    critical_section_t lock;
+    mouse_values_t values;
+    bool pending;
+} mouse_fast_t;
+
+static mouse_fast_t fast;
+
+void mouse_fast_init(void) {
+    critical_section_init(&fast.lock);
+}
+
+/* Add to the waiting movement, unless that would change buttons or overflow the report */
+static bool fast_add(const mouse_values_t *values) {
+    bool added = true;
+
+    critical_section_enter_blocking(&fast.lock);
+
+    if (!fast.pending) {
+        fast.values  = *values;
+        fast.pending = true;
+    } else
+        added = merge_mouse_values(&fast.values, values);
+
+    critical_section_exit(&fast.lock);
+    return added;
+}
+
+/* In gaming mode the host gets the raw deltas, the pointer position doesn't matter and switching is off.
+   On the active board they skip acceleration and the queue, unless older reports are still in there.
+   Returns false if the report has to take the normal path. */
+static bool mouse_fast_path(device_t *state, const mouse_values_t *values) {
+    if (!state->gaming_mode || !CURRENT_BOARD_IS_ACTIVE_OUTPUT || !state->tud_connected)
+        return false;
+
+    if (state->mouse_has_pending || !queue_is_empty(&state->mouse_queue))
+        return false;
+
+    if (!fast_add(values))
+        return false;
+
+    state->mouse_buttons = values->buttons;
+    state->last_activity[BOARD_ROLE] = time_us_64();
+    return true;
+}
+
+/* Core0, the waiting movement goes straight to the endpoint. Returns true while there's some, since it's
+   older than anything in the queue. */
+static bool mouse_fast_send(device_t *state) {
+    mouse_values_t values;
+
+    if (!fast.pending)
+        return false;
+
+    if (!tud_hid_n_ready(ITF_NUM_HID_REL_M))
+        return true;
+
+    critical_section_enter_blocking(&fast.lock);
+    values = fast.values;
+    critical_section_exit(&fast.lock);
+
+    if (!tud_mouse_report(RELATIVE, values.buttons, values.move_x, values.move_y, values.wheel, values.pan))
+        return true;
+
+    /* Core1 may have added more in the meantime, only that part is still waiting */
+    critical_section_enter_blocking(&fast.lock);
+    fast.values.move_x -= values.move_x;
+    fast.values.move_y -= values.move_y;
+    fast.values.wheel -= values.wheel;
+    fast.values.pan -= values.pan;
+    fast.pending = fast.values.move_x || fast.values.move_y || fast.values.wheel || fast.values.pan;
+    critical_section_exit(&fast.lock);
+
+    return true;
+}
+
+/* Turn the movement added up so far into one report for the host */
+static void output_pending_mouse(device_t *state) {
+    mouse_values_t values = state->mouse_pending;
+
+    if (!state->mouse_has_pending)
+        return;
+
+    state->mouse_has_pending = false;
+    state->mouse_last_output = time_us_64();
+
+    /* Calculate and update mouse pointer movement. */
+    enum screen_pos_e switch_direction = update_mouse_position(state, &values);
+
+    /* Create the report for the output PC based on the updated values */
+    mouse_report_t report = create_mouse_report(state, &values);
+
+    /* Move the mouse, depending where the output is supposed to go */
+    latency_parsed(state);
+    output_mouse_report(&report, state);
+
+    /* We use the mouse to switch outputs, if switch_direction is LEFT or RIGHT */
+    if (switch_direction != NONE)
+        do_screen_switch(state, switch_direction);
+}
+
+/* Host takes one report per poll. Ours can go once the previous one left the queue, another
+   board's host is assumed to poll just as often. */
+static bool mouse_output_due(device_t *state) {
+    if (CURRENT_BOARD_IS_ACTIVE_OUTPUT)
+        return queue_is_empty(&state->mouse_queue);
+
+    return time_us_64() - state->mouse_last_output >= MOUSE_POLL_US;
+}
+
 void process_mouse_report(uint8_t *raw_report, int len, uint8_t itf, hid_interface_t *iface) {
     mouse_values_t values = {0};
     device_t *state = &global_state;
@@ -362,18 +610,27 @@ void process_mouse_report(uint8_t *raw_report, int len, uint8_t itf, hid_interfa
         return;
     }
 
-    /* Calculate and update mouse pointer movement. */
-    enum screen_pos_e switch_direction = update_mouse_position(state, &values);
+    if (mouse_fast_path(state, &values))
+        return;
 
-    /* Create the report for the output PC based on the updated values */
-    mouse_report_t report = create_mouse_report(state, &values);
+    /* Fast mice report many times per host poll, movement is added up until the host can take it */
+    if (state->mouse_has_pending && merge_mouse_values(&state->mouse_pending, &values))
+        state->stats.mouse_merged++;
+    else {
+        output_pending_mouse(state);
+        state->mouse_pending     = values;
+        state->mouse_has_pending = true;
+    }
 
-    /* Move the mouse, depending where the output is supposed to go */
-    output_mouse_report(&report, state);
+    /* Button changes go out right away, movement before them already went with the old buttons */
+    if (values.buttons != state->mouse_buttons || mouse_output_due(state))
+        output_pending_mouse(state);
+}
 
-    /* We use the mouse to switch outputs, if switch_direction is LEFT or RIGHT */
-    if (switch_direction != NONE)
-        do_screen_switch(state, switch_direction);
+/* Send the added up movement once the host is ready for it */
+void mouse_pending_task(device_t *state) {
+    if (state->mouse_has_pending && mouse_output_due(state))
+        output_pending_mouse(state);
 }
 
 /* ==================================================== *
@@ -387,6 +644,10 @@ void process_mouse_queue_task(device_t *state) {
     if (!state->tud_connected)
         return;
 
+    /* Gaming mode movement waits outside the queue and is older than anything in it */
+    if (mouse_fast_send(state))
+        return;
+
     /* Peek first, if there is anything there... */
     if (!queue_try_peek(&state->mouse_queue, &report))
         return;
@@ -396,7 +657,7 @@ void process_mouse_queue_task(device_t *state) {
         tud_remote_wakeup();
 
     /* If it's not ready, we'll try on the next pass */
-    if (!tud_hid_n_ready(ITF_NUM_HID))
+    if (!tud_hid_n_ready(report.mode == ABSOLUTE ? ITF_NUM_HID : ITF_NUM_HID_REL_M))
         return;
 
     /* Try sending it to the host, if it's successful */
@@ -404,8 +665,12 @@ void process_mouse_queue_task(device_t *state) {
         = tud_mouse_report(report.mode, report.buttons, report.x, report.y, report.wheel, report.pan);
 
     /* ... then we can remove it from the queue */
-    if (succeeded)
+    if (succeeded) {
         queue_try_remove(&state->mouse_queue, &report);
+        latency_removed(LAT_QUEUE_MOUSE);
+        latency_sent(LAT_QUEUE_MOUSE, state);
+        TRACE(TRACE_MOUSE_SENT, queue_get_level_unsafe(&state->mouse_queue), 0);
+    }
 }
 
 void queue_mouse_report(mouse_report_t *report, device_t *state) {
@@ -413,5 +678,8 @@ void queue_mouse_report(mouse_report_t *report, device_t *state) {
     if (!state->tud_connected)
         return;
 
-    queue_try_add(&state->mouse_queue, report);
+    if (queue_add_counted(&state->mouse_queue, report, STATS_MOUSE_QUEUE)) {
+        latency_queued(LAT_QUEUE_MOUSE, &state->mouse_queue, state);
+        TRACE(TRACE_MOUSE_QUEUED, queue_get_level_unsafe(&state->mouse_queue), 0);
+    }
 }
@@ -0,0 +1,208 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+static inline bool in_range(int32_t value, int32_t min, int32_t max) {
+    return value >= min && value <= max;
+}
+
+/* ==================================================== *
+ * Encoding
+ * ==================================================== */
+
+/* What a wheel or pan code in a delta stands for, the top bit of the code is the sign */
+static const int8_t scroll_steps[MOUSE_SCROLL_STEPS] = {
+    0, 1, 2, 3, 4, MOUSE_SCROLL_RESOLUTION, 2 * MOUSE_SCROLL_RESOLUTION, 3 * MOUSE_SCROLL_RESOLUTION,
+};
+
+/* Returns the code for a wheel or pan amount, or -1 if a delta can't carry it */
+static int8_t scroll_code(int8_t amount) {
+    for (int i = 0; i < MOUSE_SCROLL_STEPS; i++)
+        if (scroll_steps[i] == abs(amount))
+            return amount < 0 ? MOUSE_SCROLL_STEPS | i : i;
+
+    return -1;
+}
+
+static int8_t scroll_amount(uint8_t code) {
+    int8_t amount = scroll_steps[code & (MOUSE_SCROLL_STEPS - 1)];
+    return code & MOUSE_SCROLL_STEPS ? -amount : amount;
+}
+
+/* A report can be a delta if the other board knows where we were and the move is small */
+static bool fits_delta(const mouse_link_t *ml, const mouse_report_t *report, uint64_t now) {
+    return ml->synced && now < ml->next_keyframe && report->mode == ABSOLUTE
+           && in_range(report->x - ml->x, MOUSE_DELTA_MIN, MOUSE_DELTA_MAX)
+           && in_range(report->y - ml->y, MOUSE_DELTA_MIN, MOUSE_DELTA_MAX)
+           && scroll_code(report->wheel) >= 0 && scroll_code(report->pan) >= 0;
+}
+
+/* Unused slots repeat the last buttons without moving, the other board skips those */
+static void send_deltas(mouse_link_t *ml, const mouse_link_io_t *io, mouse_delta_t *delta, int count, device_t *state) {
+    for (int i = count; i < MOUSE_DELTA_EVENTS; i++)
+        delta[i] = (mouse_delta_t){.buttons = delta[count - 1].buttons};
+
+    io->send((uint8_t *)delta, MOUSE_DELTA_MSG, ml->output, state);
+    ml->frames++;
+}
+
+/* Send everything held back, in order */
+void mouse_link_flush(mouse_link_t *ml, const mouse_link_io_t *io, uint64_t now, device_t *state) {
+    mouse_delta_t delta[MOUSE_DELTA_EVENTS];
+    int deltas = 0;
+
+    for (int i = 0; i < ml->count; i++) {
+        mouse_report_t *report = &ml->pending[i];
+
+        if (fits_delta(ml, report, now)) {
+            delta[deltas++] = (mouse_delta_t){
+                .buttons = report->buttons,
+                .x       = report->x - ml->x,
+                .y       = report->y - ml->y,
+                .scroll  = scroll_code(report->wheel) << 4 | scroll_code(report->pan),
+            };
+        } else {
+            if (deltas)
+                send_deltas(ml, io, delta, deltas, state);
+
+            deltas = 0;
+            io->send((uint8_t *)report, MOUSE_REPORT_MSG, ml->output, state);
+            ml->frames++;
+
+            /* A relative report moves the pointer by an unknown amount */
+            ml->synced        = (report->mode == ABSOLUTE);
+            ml->next_keyframe = now + MOUSE_KEYFRAME_US;
+        }
+
+        /* The other board takes x and y as its position either way */
+        ml->x = report->x;
+        ml->y = report->y;
+    }
+
+    if (deltas)
+        send_deltas(ml, io, delta, deltas, state);
+
+    ml->count = 0;
+}
+
+/* Fold a report into the one held before it, unless that changes what the other board sees */
+static bool merge_report(mouse_report_t *last, const mouse_report_t *report) {
+    int32_t x = report->x, y = report->y;
+    int32_t wheel = last->wheel + report->wheel, pan = last->pan + report->pan;
+
+    if (last->buttons != report->buttons || last->mode != report->mode)
+        return false;
+
+    if (report->mode == RELATIVE) {
+        x += last->x;
+        y += last->y;
+    }
+
+    if (!in_range(x, INT16_MIN, INT16_MAX) || !in_range(y, INT16_MIN, INT16_MAX)
+        || !in_range(wheel, INT8_MIN, INT8_MAX) || !in_range(pan, INT8_MIN, INT8_MAX))
+        return false;
+
+    last->x     = x;
+    last->y     = y;
+    last->wheel = wheel;
+    last->pan   = pan;
+    return true;
+}
+
+void mouse_link_report(mouse_link_t *ml, const mouse_link_io_t *io, const mouse_report_t *report, uint8_t output,
+                       uint64_t now, device_t *state) {
+    ml->reports++;
+
+    /* Another board doesn't know where the pointer was, start it with a keyframe */
+    if (output != ml->output) {
+        mouse_link_flush(ml, io, now, state);
+        ml->output = output;
+        ml->synced = false;
+    }
+
+    /* Held reports exist only while the link is behind, that's when folding saves frames */
+    if (!ml->count || !merge_report(&ml->pending[ml->count - 1], report)) {
+        if (ml->count == MOUSE_DELTA_EVENTS)
+            mouse_link_flush(ml, io, now, state);
+
+        ml->pending[ml->count++] = *report;
+    }
+
+    if (!io->busy(output, state))
+        mouse_link_flush(ml, io, now, state);
+}
+
+/* ==================================================== *
+ * Decoding
+ * ==================================================== */
+
+/* Turn a MOUSE_DELTA_MSG into absolute reports, starting from x, y. Returns how many there are. */
+uint8_t mouse_delta_decode(const uint8_t *data, int16_t x, int16_t y, mouse_report_t *out) {
+    const mouse_delta_t *delta = (const mouse_delta_t *)data;
+    uint8_t count = 0;
+
+    for (int i = 0; i < MOUSE_DELTA_EVENTS; i++) {
+        bool idle = !delta[i].x && !delta[i].y && !delta[i].scroll;
+
+        if (i > 0 && idle && delta[i].buttons == delta[i - 1].buttons)
+            continue;
+
+        x = MAX(MIN_SCREEN_COORD, MIN(x + delta[i].x, MAX_SCREEN_COORD));
+        y = MAX(MIN_SCREEN_COORD, MIN(y + delta[i].y, MAX_SCREEN_COORD));
+
+        out[count++] = (mouse_report_t){
+            .buttons = delta[i].buttons,
+            .x       = x,
+            .y       = y,
+            .wheel   = scroll_amount(delta[i].scroll >> 4),
+            .pan     = scroll_amount(delta[i].scroll & 0x0F),
+            .mode    = ABSOLUTE,
+        };
+    }
+
+    return count;
+}
+
+/* ==================================================== *
+ * Link
+ * ==================================================== */
+
+static void mouse_link_queue(const uint8_t *data, enum packet_type_e type, uint8_t output, device_t *state) {
+    queue_packet_to(data, type, MOUSE_REPORT_LENGTH, output);
+    latency_queued(LAT_QUEUE_UART, &state->uart_tx_queue, state);
+}
+
+static bool mouse_link_busy(uint8_t output, device_t *state) {
+    return chain_tx_pending(output, state);
+}
+
+static const mouse_link_io_t uart_mouse_link = {
+    .send = &mouse_link_queue,
+    .busy = &mouse_link_busy,
+};
+
+void mouse_link_send(mouse_report_t *report, uint8_t output, device_t *state) {
+    mouse_link_report(&state->mouse_link, &uart_mouse_link, report, output, time_us_64(), state);
+}
+
+/* Mouse reports come from core1. Whatever else it sends has to wait for the ones held back, so
+   input reaches the other board in the order it happened (e.g. a click with a modifier held). */
+void mouse_link_sync(device_t *state) {
+    if (state->mouse_link.count && get_core_num() == 1)
+        mouse_link_flush(&state->mouse_link, &uart_mouse_link, time_us_64(), state);
+}
+
+/* Held reports go out as soon as the link catches up */
+void mouse_link_task(device_t *state) {
+    if (state->mouse_link.count && !mouse_link_busy(state->mouse_link.output, state))
+        mouse_link_flush(&state->mouse_link, &uart_mouse_link, time_us_64(), state);
+}
@@ -0,0 +1,256 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+/* ==================================================== *
+ * Framing
+ * ==================================================== */
+
+/* Cut a message into PASSTHROUGH_MSG frames, returns how many there are. Length is at most PASSTHROUGH_DESC_MAX. */
+uint8_t passthrough_split(uint8_t kind, const uint8_t *data, uint16_t len, uint8_t frames[][PACKET_DATA_LENGTH]) {
+    uint16_t sent = MIN(len, PASS_FIRST_DATA);
+    uint8_t count = 1;
+
+    memset(frames[0], 0, PACKET_DATA_LENGTH);
+    frames[0][0] = kind;
+    frames[0][1] = len & 0xFF;
+    frames[0][2] = len >> 8;
+    memcpy(&frames[0][3], data, sent);
+
+    while (sent < len) {
+        uint16_t chunk = MIN(len - sent, PASS_NEXT_DATA);
+
+        memset(frames[count], 0, PACKET_DATA_LENGTH);
+        frames[count][0] = kind | count;
+        memcpy(&frames[count][1], &data[sent], chunk);
+
+        sent += chunk;
+        count++;
+    }
+
+    return count;
+}
+
+/* Add a frame to the message, true once it's complete. A frame out of order drops what was there. */
+bool passthrough_join(passthrough_rx_t *rx, const uint8_t *frame) {
+    uint8_t index = frame[0] & PASS_FRAME_INDEX;
+    uint8_t kind  = frame[0] & PASS_FRAME_DESCRIPTOR;
+    uint16_t chunk;
+
+    if (index == 0) {
+        uint16_t len = frame[1] | frame[2] << 8;
+
+        if (len > sizeof(rx->data)) {
+            rx->next = 0;
+            return false;
+        }
+
+        *rx   = (passthrough_rx_t){.len = len, .kind = kind};
+        chunk = MIN(len, PASS_FIRST_DATA);
+        memcpy(rx->data, &frame[3], chunk);
+    } else {
+        if (index != rx->next || kind != rx->kind) {
+            rx->next = 0;
+            return false;
+        }
+
+        chunk = MIN(rx->len - rx->received, PASS_NEXT_DATA);
+        memcpy(&rx->data[rx->received], &frame[1], chunk);
+    }
+
+    rx->received += chunk;
+    rx->next = index + 1;
+
+    if (rx->received < rx->len)
+        return false;
+
+    rx->next = 0;
+    return true;
+}
+
+/* ==================================================== *
+ * Mirroring
+ * ==================================================== */
+
+/* Usage page the descriptor starts with, 0 if there's none */
+static uint16_t first_usage_page(const uint8_t *desc, uint16_t len) {
+    for (uint16_t i = 0; i < len;) {
+        uint8_t size = desc[i] & 0x03;
+
+        /* Long items carry their size in the next byte, nothing we're after is one */
+        if (desc[i] == 0xFE) {
+            i += 3 + (i + 1 < len ? desc[i + 1] : 0);
+            continue;
+        }
+
+        if (size == 3)
+            size = 4;
+
+        if ((desc[i] & 0xFC) == (RI_GLOBAL_USAGE_PAGE << 4 | RI_TYPE_GLOBAL << 2) && i + size < len)
+            return size == 1 ? desc[i + 1] : desc[i + 1] | desc[i + 2] << 8;
+
+        i += 1 + size;
+    }
+
+    return 0;
+}
+
+/* Nothing in the interface we handle ourselves, and it's not a vendor channel that only the
+   device maker's software would talk to (and that wouldn't work without output reports anyway) */
+bool passthrough_usable(const hid_interface_t *iface, const uint8_t *desc, uint16_t len) {
+    uint16_t page = first_usage_page(desc, len);
+
+    for (int i = 0; i < MAX_REPORTS; i++)
+        if (iface->report_handler[i] != NULL)
+            return false;
+
+    return len && len <= PASSTHROUGH_DESC_MAX && page && page < HID_USAGE_PAGE_VENDOR;
+}
+
+static void passthrough_send(uint8_t kind, const uint8_t *data, uint16_t len, uint8_t output) {
+    uint8_t frames[PASS_MAX_FRAMES][PACKET_DATA_LENGTH];
+    uint8_t count = passthrough_split(kind, data, len, frames);
+
+    for (int i = 0; i < count; i++)
+        queue_packet_to(frames[i], PASSTHROUGH_MSG, PACKET_DATA_LENGTH, output);
+}
+
+/* Take over a descriptor, our host has to enumerate again to see it */
+static void passthrough_mirror(const uint8_t *desc, uint16_t len, device_t *state) {
+    passthrough_t *pass = &state->passthrough;
+
+    if (len > sizeof(pass->desc) || (len == pass->desc_len && !memcmp(pass->desc, desc, len)))
+        return;
+
+    pass->offered = false;
+    memcpy(pass->desc, desc, len);
+    pass->desc_len       = len;
+    pass->desc_requested = false;
+
+    state->descriptors_changed = true;
+}
+
+/* Called for an interface without a keyboard or mouse protocol. Returns true if its reports are passed through. */
+bool passthrough_mount(uint8_t dev_addr, uint8_t instance, hid_interface_t *iface, const uint8_t *desc, uint16_t len,
+                       device_t *state) {
+    passthrough_t *pass = &state->passthrough;
+
+    /* One mirrored device at a time, the first one plugged in keeps it */
+    if (state->config_mode_active || pass->source_addr || !passthrough_usable(iface, desc, len))
+        return false;
+
+    pass->source_addr     = dev_addr;
+    pass->source_instance = instance;
+
+    passthrough_mirror(desc, len, state);
+    passthrough_send(PASS_FRAME_DESCRIPTOR, desc, len, CHAIN_ALL);
+    return true;
+}
+
+/* The host keeps the interface, it just won't get reports any more */
+void passthrough_umount(uint8_t dev_addr, uint8_t instance, device_t *state) {
+    passthrough_t *pass = &state->passthrough;
+
+    if (pass->source_addr != dev_addr || pass->source_instance != instance)
+        return;
+
+    pass->source_addr = 0;
+    pass->pending_len = 0;
+}
+
+/* ==================================================== *
+ * Reports
+ * ==================================================== */
+
+/* Message is the report ID followed by the report, exactly as the device sent it */
+static void passthrough_deliver(uint8_t *msg, uint16_t len, device_t *state) {
+    /* Queued for an interface the host doesn't have, it would hold up everything behind it */
+    if (!state->passthrough.offered || !state->tud_connected || len < 1)
+        return;
+
+    queue_passthrough_packet(&msg[1], len - 1, msg[0], state);
+}
+
+void process_passthrough_report(uint8_t *raw_report, int length, uint8_t itf, hid_interface_t *iface) {
+    device_t *state = &global_state;
+    passthrough_t *pass = &state->passthrough;
+    uint8_t msg[PASSTHROUGH_REPORT_MAX + 1] = {0};
+
+    /* Without report IDs, a zero goes in front so the message always starts with one */
+    uint8_t offset = iface->uses_report_id ? 0 : 1;
+
+    if (length < 1 || length > PASSTHROUGH_REPORT_MAX)
+        return;
+
+    memcpy(&msg[offset], raw_report, length);
+
+    if (CURRENT_BOARD_IS_ACTIVE_OUTPUT) {
+        passthrough_deliver(msg, length + offset, state);
+        return;
+    }
+
+    /* A report still waiting for the link is an older state, no use sending it now */
+    memcpy(pass->pending, msg, length + offset);
+    pass->pending_len    = length + offset;
+    pass->pending_output = state->active_output;
+
+    passthrough_link_task(state);
+}
+
+/* Called with the data of each PASSTHROUGH_MSG received */
+void passthrough_message(const uint8_t *frame, device_t *state) {
+    passthrough_t *pass = &state->passthrough;
+    passthrough_rx_t *rx = &pass->rx;
+
+    /* Only the board with the device plugged in is sure to have the right descriptor */
+    if (frame[0] & PASS_FRAME_REQUEST) {
+        if (pass->source_addr)
+            passthrough_send(PASS_FRAME_DESCRIPTOR, pass->desc, pass->desc_len, CHAIN_ALL);
+        return;
+    }
+
+    if (!passthrough_join(rx, frame))
+        return;
+
+    if (rx->kind == PASS_FRAME_DESCRIPTOR) {
+        passthrough_mirror(rx->data, rx->len, state);
+        return;
+    }
+
+    /* Booted after the device was plugged in on another board, ask for the descriptor once */
+    if (!pass->desc_len) {
+        uint8_t request[PACKET_DATA_LENGTH] = {PASS_FRAME_REQUEST};
+
+        if (!pass->desc_requested)
+            queue_packet_to(request, PASSTHROUGH_MSG, PACKET_DATA_LENGTH, CHAIN_ALL);
+
+        pass->desc_requested = true;
+        return;
+    }
+
+    passthrough_deliver(rx->data, rx->len, state);
+}
+
+/* ==================================================== *
+ * Tasks
+ * ==================================================== */
+
+/* The report held back goes out as soon as the link catches up */
+void passthrough_link_task(device_t *state) {
+    passthrough_t *pass = &state->passthrough;
+
+    if (!pass->pending_len || chain_tx_pending(pass->pending_output, state))
+        return;
+
+    passthrough_send(0, pass->pending, pass->pending_len, pass->pending_output);
+    pass->pending_len = 0;
+}
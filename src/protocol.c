@@ -10,72 +10,42 @@
  */
 #include "main.h"
 
+/* Field definitions live in webconfig/form.py, api_fields.h is generated from it */
+#define FIELD_MAP_ENTRY(idx, readonly, type, len, member) {idx, readonly, type, len, offsetof(device_t, member)},
+#define FIELD_POSITION(idx, ...) FIELD_POS_##idx,
+#define FIELD_LOOKUP(idx, ...) [idx] = FIELD_POS_##idx + 1,
+
 const field_map_t api_field_map[] = {
 /* Index, Rdonly, Type, Len, Offset in struct */
-    { 0,  true,  UINT8,  1, offsetof(device_t, active_output) },
-    { 1,  true,  INT16,  2, offsetof(device_t, pointer_x) },
-    { 2,  true,  INT16,  2, offsetof(device_t, pointer_y) },
-    { 3,  true,  INT16,  2, offsetof(device_t, mouse_buttons) },
-
-    /* Output A */
-    { 10, false, UINT32, 4, offsetof(device_t, config.output[0].number) },
-    { 11, false, UINT32, 4, offsetof(device_t, config.output[0].screen_count) },
-    { 12, false, INT32,  4, offsetof(device_t, config.output[0].speed_x) },
-    { 13, false, INT32,  4, offsetof(device_t, config.output[0].speed_y) },
-    { 14, false, INT32,  4, offsetof(device_t, config.output[0].border.top) },
-    { 15, false, INT32,  4, offsetof(device_t, config.output[0].border.bottom) },
-    { 16, false, UINT8,  1, offsetof(device_t, config.output[0].os) },
-    { 17, false, UINT8,  1, offsetof(device_t, config.output[0].pos) },
-    { 18, false, UINT8,  1, offsetof(device_t, config.output[0].mouse_park_pos) },
-    { 19, false, UINT8,  1, offsetof(device_t, config.output[0].screensaver.mode) },
-    { 20, false, UINT8,  1, offsetof(device_t, config.output[0].screensaver.only_if_inactive) },
-
-    /* Until we increase the payload size from 8 bytes, clamp to avoid exceeding the field size */
-    { 21, false, UINT64, 7, offsetof(device_t, config.output[0].screensaver.idle_time_us) },
-    { 22, false, UINT64, 7, offsetof(device_t, config.output[0].screensaver.max_time_us) },
-
-    /* Output B */
-    { 40, false, UINT32, 4, offsetof(device_t, config.output[1].number) },
-    { 41, false, UINT32, 4, offsetof(device_t, config.output[1].screen_count) },
-    { 42, false, INT32,  4, offsetof(device_t, config.output[1].speed_x) },
-    { 43, false, INT32,  4, offsetof(device_t, config.output[1].speed_y) },
-    { 44, false, INT32,  4, offsetof(device_t, config.output[1].border.top) },
-    { 45, false, INT32,  4, offsetof(device_t, config.output[1].border.bottom) },
-    { 46, false, UINT8,  1, offsetof(device_t, config.output[1].os) },
-    { 47, false, UINT8,  1, offsetof(device_t, config.output[1].pos) },
-    { 48, false, UINT8,  1, offsetof(device_t, config.output[1].mouse_park_pos) },
-    { 49, false, UINT8,  1, offsetof(device_t, config.output[1].screensaver.mode) },
-    { 50, false, UINT8,  1, offsetof(device_t, config.output[1].screensaver.only_if_inactive) },
-    { 51, false, UINT64, 7, offsetof(device_t, config.output[1].screensaver.idle_time_us) },
-    { 52, false, UINT64, 7, offsetof(device_t, config.output[1].screensaver.max_time_us) },
-
-    /* Common config */
-    { 70, false, UINT32, 4, offsetof(device_t, config.version) },
-    { 71, false, UINT8,  1, offsetof(device_t, config.force_mouse_boot_mode) },
-    { 72, false, UINT8,  1, offsetof(device_t, config.force_kbd_boot_protocol) },
-    { 73, false, UINT8,  1, offsetof(device_t, config.kbd_led_as_indicator) },
-    { 74, false, UINT8,  1, offsetof(device_t, config.hotkey_toggle) },
-    { 75, false, UINT8,  1, offsetof(device_t, config.enable_acceleration) },
-    { 76, false, UINT8,  1, offsetof(device_t, config.enforce_ports) },
-    { 77, false, UINT16, 2, offsetof(device_t, config.jump_threshold) },
-
-    /* Firmware */
-    { 78, true,  UINT16, 2, offsetof(device_t, _running_fw.version) },
-    { 79, true,  UINT32, 4, offsetof(device_t, _running_fw.checksum) },
-
-    { 80, true,  UINT8,  1, offsetof(device_t, keyboard_connected) },
-    { 81, true,  UINT8,  1, offsetof(device_t, switch_lock) },
-    { 82, true,  UINT8,  1, offsetof(device_t, relative_mouse) },
+    API_FIELDS(FIELD_MAP_ENTRY)
+};
+
+/* Position of each field within api_field_map, resolved at compile time */
+enum { API_FIELDS(FIELD_POSITION) API_FIELD_COUNT };
+
+/* Direct lookup from field index to its position + 1, zero means there is no such field */
+static const uint8_t api_field_lookup[API_FIELD_MAX_INDEX + 1] = {
+    API_FIELDS(FIELD_LOOKUP)
 };
 
+/* Version of the API data when each field last changed, and the value it changed to */
+static uint32_t api_version = 0;
+static uint32_t field_version[API_FIELD_COUNT];
+static uint8_t field_shadow[API_FIELD_COUNT][sizeof(uint64_t)];
+
+/* A field has to fit its shadow, which also means one always fits a bulk GET reply. So a full read
+   always moves forward, one page after another, however many fields there are. */
+#define FIELD_WIDTH_CHECK(idx, readonly, type, len, member) \
+    _Static_assert(len <= sizeof(uint64_t), "API field " #idx " is too wide");
+
+API_FIELDS(FIELD_WIDTH_CHECK)
+_Static_assert(2 + sizeof(uint64_t) <= BULK_BUFFER_SIZE - sizeof(bulk_header_t) - 1, "Bulk GET reply can't hold a field");
+
 const field_map_t* get_field_map_entry(uint32_t index) {
-    for (unsigned int i = 0; i < ARRAY_SIZE(api_field_map); i++) {
-        if (api_field_map[i].idx == index) {
-            return &api_field_map[i];
-        }
-    }
+    if (index > API_FIELD_MAX_INDEX || !api_field_lookup[index])
+        return NULL;
 
-    return NULL;
+    return &api_field_map[api_field_lookup[index] - 1];
 }
 
 
@@ -91,6 +61,33 @@ size_t get_field_map_length(void) {
     return ARRAY_SIZE(api_field_map);
 }
 
+/* Compare every field to the value it had on the previous call. Changed ones get tagged with a
+   new version, so clients can ask for just the fields that changed since their last read.
+   This also catches changes made by the firmware itself, e.g. switching outputs. */
+uint32_t update_field_versions(device_t *state) {
+    bool changed = false;
+
+    for (int i = 0; i < API_FIELD_COUNT; i++) {
+        const uint8_t *ptr = ((uint8_t *)state) + api_field_map[i].offset;
+
+        if (!memcmp(field_shadow[i], ptr, api_field_map[i].len))
+            continue;
+
+        memcpy(field_shadow[i], ptr, api_field_map[i].len);
+        field_version[i] = api_version + 1;
+        changed = true;
+    }
+
+    if (changed)
+        api_version++;
+
+    return api_version;
+}
+
+uint32_t get_field_version(const field_map_t *map) {
+    return field_version[map - api_field_map];
+}
+
 void _queue_packet(uint8_t *payload, device_t *state, uint8_t type, uint8_t len, uint8_t id, uint8_t inst) {
     hid_generic_pkt_t generic_packet = {
         .instance = inst,
@@ -100,7 +97,7 @@ void _queue_packet(uint8_t *payload, device_t *state, uint8_t type, uint8_t len,
     };
 
     memcpy(generic_packet.data, payload, len);
-    queue_try_add(&state->hid_queue_out, &generic_packet);
+    queue_add_counted(&state->hid_queue_out, &generic_packet, STATS_HID_QUEUE);
 }
 
 void queue_cfg_packet(uart_packet_t *packet, device_t *state) {
@@ -116,3 +113,11 @@ void queue_cc_packet(uint8_t *payload, device_t *state) {
 void queue_system_packet(uint8_t *payload, device_t *state) {
     _queue_packet(payload, state, 2, SYSTEM_CONTROL_LENGTH, REPORT_ID_SYSTEM, ITF_NUM_HID);
 }
+
+void queue_gamepad_packet(uint8_t *payload, device_t *state) {
+    _queue_packet(payload, state, 4, sizeof(hid_gamepad_report_t), REPORT_ID_GAMEPAD, ITF_NUM_HID_REL_M);
+}
+
+void queue_passthrough_packet(uint8_t *payload, uint8_t len, uint8_t report_id, device_t *state) {
+    _queue_packet(payload, state, 3, len, report_id, ITF_NUM_HID_PASS);
+}
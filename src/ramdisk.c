@@ -12,9 +12,310 @@
 
 #include "main.h"
 
-#define NUMBER_OF_BLOCKS 4096
-#define ACTUAL_NUMBER_OF_BLOCKS 128
-#define BLOCK_SIZE       512
+/*==============================================================================
+ *  Disk Geometry
+ *  The FAT12 volume is never stored anywhere, every sector is generated on read.
+ *  Layout: boot sector | FAT #1 | FAT #2 | root directory | data clusters
+ *==============================================================================*/
+
+#define NUMBER_OF_BLOCKS    4096
+#define BLOCK_SIZE          512
+#define SECTORS_PER_CLUSTER 4
+#define CLUSTER_SIZE        (SECTORS_PER_CLUSTER * BLOCK_SIZE)
+#define RESERVED_SECTORS    1
+#define NUM_FATS            2
+#define SECTORS_PER_FAT     3
+#define ROOT_DIR_ENTRIES    (BLOCK_SIZE / sizeof(fat_dir_entry_t))
+
+#define FAT_START_LBA       RESERVED_SECTORS
+#define ROOT_DIR_LBA        (FAT_START_LBA + NUM_FATS * SECTORS_PER_FAT)
+#define DATA_START_LBA      (ROOT_DIR_LBA + 1)
+#define FIRST_CLUSTER       2
+#define FAT12_EOC           0xfff
+
+/* 2025-01-01, 00:00 */
+#define FAT_TIMESTAMP_DATE  (((2025 - 1980) << 9) | (1 << 5) | 1)
+
+/* config.txt has a "index = value" line per API field. Its space is worked out from the field
+   list: up to 3 digits of index, " = ", the widest value the field's length allows and CRLF. */
+#define VALUE_DIGITS(len)   ((len) == 1 ? 4 : (len) == 2 ? 6 : (len) == 4 ? 11 : 20)
+#define CONFIG_LINE_MAX(idx, readonly, type, len, member) + (3 + 3 + VALUE_DIGITS(len) + 2)
+#define CONFIG_TXT_MAX      (0 API_FIELDS(CONFIG_LINE_MAX) + 1)
+#define VERSION_TXT_MAX     128
+#define STATUS_TXT_MAX      256
+
+typedef const uint8_t *(*file_contents_f)(uint32_t *size);
+typedef uint32_t (*file_render_f)(char *buffer, uint32_t max_size);
+
+typedef struct {
+    char name[11];            // 8.3 name, space padded
+    uint32_t max_size;        // Generated files: space reserved on disk and in the snapshot
+    file_contents_f contents; // Stored files: returns file data and sets its size
+    file_render_f render;     // Generated files: writes the contents, returns their size
+} disk_file_t;
+
+/*==============================================================================
+ *  File Contents
+ *==============================================================================*/
+
+static const uint8_t *config_page_contents(uint32_t *size) {
+    *size = _config_page_end - _config_page_start;
+    return _config_page_start;
+}
+
+static uint32_t version_render(char *buffer, uint32_t max_size) {
+    return snprintf(buffer,
+                    max_size,
+                    "DeskHop v%d.%d\r\nVersion: %u\r\nChecksum: %08lx\r\nBoard: %c\r\n",
+                    VERSION_MAJOR,
+                    VERSION_MINOR,
+                    global_state._running_fw.version,
+                    (unsigned long)global_state._running_fw.checksum,
+                    'A' + BOARD_ROLE);
+}
+
+/* Read an API field as a signed value, regardless of its type and width */
+static int64_t get_field_value(const field_map_t *map) {
+    const uint8_t *ptr = ((const uint8_t *)&global_state) + map->offset;
+    uint64_t raw = 0;
+
+    memcpy(&raw, ptr, map->len);
+
+    switch (map->type) {
+        case INT8:
+            return (int8_t)raw;
+        case INT16:
+            return (int16_t)raw;
+        case INT32:
+            return (int32_t)raw;
+        default:
+            return (int64_t)raw;
+    }
+}
+
+/* Dumps every API field as "index = value", same numbering the web config uses */
+static uint32_t config_render(char *buffer, uint32_t max_size) {
+    uint32_t len = 0;
+
+    for (size_t i = 0; i < get_field_map_length() && len < max_size; i++) {
+        const field_map_t *map = get_field_map_index(i);
+
+        len += snprintf(&buffer[len],
+                        max_size - len,
+                        "%lu = %lld\r\n",
+                        (unsigned long)map->idx,
+                        (long long)get_field_value(map));
+    }
+
+    return len;
+}
+
+static uint32_t status_render(char *buffer, uint32_t max_size) {
+    return snprintf(buffer,
+                    max_size,
+                    "Board: %c\r\nActive output: %c\r\nKeyboard connected: %s\r\n"
+                    "Mouse connected: %s\r\nUptime: %llu s\r\n",
+                    'A' + BOARD_ROLE,
+                    'A' + global_state.active_output,
+                    global_state.keyboard_connected ? "yes" : "no",
+                    global_state.mouse_connected ? "yes" : "no",
+                    (unsigned long long)(time_us_64() / 1000000));
+}
+
+static const disk_file_t disk_files[] = {
+    {"CONFIG  HTM", 0,               config_page_contents, NULL},
+    {"VERSION TXT", VERSION_TXT_MAX, NULL,                 version_render},
+    {"CONFIG  TXT", CONFIG_TXT_MAX,  NULL,                 config_render},
+    {"STATUS  TXT", STATUS_TXT_MAX,  NULL,                 status_render},
+};
+
+/* Generated files are rendered together, once per directory read. That way the sizes in the
+   directory match the data even if values change while the host is reading the files. */
+static char snapshot[VERSION_TXT_MAX + CONFIG_TXT_MAX + STATUS_TXT_MAX];
+static uint32_t snapshot_size[ARRAY_SIZE(disk_files)];
+static bool snapshot_taken = false;
+
+static void take_snapshot(void) {
+    char *buffer = snapshot;
+
+    for (int i = 0; i < ARRAY_SIZE(disk_files); i++) {
+        if (!disk_files[i].render)
+            continue;
+
+        /* snprintf reports what it would have written, never let a size go past the space */
+        uint32_t size    = disk_files[i].render(buffer, disk_files[i].max_size);
+        snapshot_size[i] = MIN(size, disk_files[i].max_size - 1);
+        buffer += disk_files[i].max_size;
+    }
+
+    snapshot_taken = true;
+}
+
+static const uint8_t *get_file_contents(int file_idx, uint32_t *size) {
+    const disk_file_t *file = &disk_files[file_idx];
+
+    if (file->contents)
+        return file->contents(size);
+
+    /* Host went straight for the data, without reading the directory first */
+    if (!snapshot_taken)
+        take_snapshot();
+
+    const char *data = snapshot;
+
+    for (int i = 0; i < file_idx; i++)
+        if (disk_files[i].render)
+            data += disk_files[i].max_size;
+
+    *size = snapshot_size[file_idx];
+    return (const uint8_t *)data;
+}
+
+/*==============================================================================
+ *  Sector Generators
+ *==============================================================================*/
+
+static uint32_t get_file_clusters(const disk_file_t *file) {
+    uint32_t size = file->max_size;
+
+    if (file->contents)
+        file->contents(&size);
+
+    return (size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+}
+
+/* Files are laid out back-to-back, in the order they appear in disk_files[] */
+static uint32_t get_file_start_cluster(int file_idx) {
+    uint32_t cluster = FIRST_CLUSTER;
+
+    for (int i = 0; i < file_idx; i++)
+        cluster += get_file_clusters(&disk_files[i]);
+
+    return cluster;
+}
+
+static void build_boot_sector(uint8_t *sector) {
+    fat_boot_sector_t *bs = (fat_boot_sector_t *)sector;
+
+    *bs = (fat_boot_sector_t){
+        .jump                = {0xeb, 0x3c, 0x90},
+        .oem_name            = "MSWIN4.1",
+        .bytes_per_sector    = BLOCK_SIZE,
+        .sectors_per_cluster = SECTORS_PER_CLUSTER,
+        .reserved_sectors    = RESERVED_SECTORS,
+        .num_fats            = NUM_FATS,
+        .root_dir_entries    = ROOT_DIR_ENTRIES,
+        .total_sectors       = NUMBER_OF_BLOCKS,
+        .media_descriptor    = 0xf8,
+        .sectors_per_fat     = SECTORS_PER_FAT,
+        .sectors_per_track   = 1,
+        .num_heads           = 1,
+        .drive_number        = 0x80,
+        .boot_signature      = 0x29,
+        .volume_id           = 0x00000000,
+        .volume_label        = "DESKHOP    ",
+        .fs_type             = "FAT12   ",
+    };
+
+    sector[510] = 0x55;
+    sector[511] = 0xaa;
+}
+
+/* Each file gets a contiguous chain, so an entry just points to the next cluster or ends it.
+   Generated files always take their reserved space, so their contents needn't be rendered here. */
+static uint16_t get_fat_entry(uint32_t cluster) {
+    if (cluster < FIRST_CLUSTER)
+        return cluster == 0 ? 0xff8 : FAT12_EOC;
+
+    uint32_t start = FIRST_CLUSTER;
+
+    for (int i = 0; i < ARRAY_SIZE(disk_files); i++) {
+        uint32_t end = start + get_file_clusters(&disk_files[i]);
+
+        if (cluster < end)
+            return cluster == end - 1 ? FAT12_EOC : cluster + 1;
+
+        start = end;
+    }
+
+    return 0;
+}
+
+/* FAT12 packs two 12-bit entries into three bytes, so entries straddle sector boundaries */
+static void build_fat_sector(uint8_t *sector, uint32_t fat_sector) {
+    uint32_t first_byte = fat_sector * BLOCK_SIZE;
+    uint32_t cluster    = (first_byte * 2) / 3;
+
+    for (; cluster * 3 / 2 < first_byte + BLOCK_SIZE; cluster++) {
+        uint16_t entry = get_fat_entry(cluster);
+        uint32_t pos   = cluster * 3 / 2;
+        uint8_t bytes[2];
+
+        if (cluster & 1) {
+            bytes[0] = (entry << 4) & 0xf0;
+            bytes[1] = entry >> 4;
+        } else {
+            bytes[0] = entry & 0xff;
+            bytes[1] = (entry >> 8) & 0x0f;
+        }
+
+        for (int i = 0; i < 2; i++, pos++) {
+            if (pos >= first_byte && pos < first_byte + BLOCK_SIZE)
+                sector[pos - first_byte] |= bytes[i];
+        }
+    }
+}
+
+static void build_root_dir(uint8_t *sector) {
+    fat_dir_entry_t *entry = (fat_dir_entry_t *)sector;
+
+    *entry++ = (fat_dir_entry_t){
+        .name        = "DESKHOP    ",
+        .attr        = FAT_ATTR_VOLUME_LABEL,
+        .modify_date = FAT_TIMESTAMP_DATE,
+    };
+
+    take_snapshot();
+
+    for (int i = 0; i < ARRAY_SIZE(disk_files); i++, entry++) {
+        uint32_t size;
+        get_file_contents(i, &size);
+
+        *entry = (fat_dir_entry_t){
+            .attr        = FAT_ATTR_READ_ONLY,
+            .nt_flags    = FAT_NT_LOWERCASE,
+            .create_date = FAT_TIMESTAMP_DATE,
+            .access_date = FAT_TIMESTAMP_DATE,
+            .modify_date = FAT_TIMESTAMP_DATE,
+            .cluster_low = size ? get_file_start_cluster(i) : 0,
+            .size        = size,
+        };
+        memcpy(entry->name, disk_files[i].name, sizeof(entry->name));
+    }
+}
+
+static void read_file_sector(uint8_t *sector, uint32_t data_sector) {
+    uint32_t cluster = FIRST_CLUSTER + data_sector / SECTORS_PER_CLUSTER;
+
+    for (int i = 0; i < ARRAY_SIZE(disk_files); i++) {
+        uint32_t start = get_file_start_cluster(i);
+
+        if (cluster < start || cluster >= start + get_file_clusters(&disk_files[i]))
+            continue;
+
+        uint32_t size;
+        const uint8_t *data = get_file_contents(i, &size);
+        uint32_t offset = (data_sector - (start - FIRST_CLUSTER) * SECTORS_PER_CLUSTER) * BLOCK_SIZE;
+
+        if (offset < size)
+            memcpy(sector, &data[offset], MIN(size - offset, BLOCK_SIZE));
+        return;
+    }
+}
+
+/*==============================================================================
+ *  TinyUSB MSC Callbacks
+ *==============================================================================*/
 
 void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]) {
     strcpy((char *)vendor_id, "DeskHop");
@@ -37,17 +338,27 @@ bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, boo
 
 /* Return the requested data, or -1 if out-of-bounds */
 int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize) {
-    const uint8_t *addr = &ADDR_DISK_IMAGE[lba * BLOCK_SIZE + offset];
+    static uint8_t sector[BLOCK_SIZE];
 
-    if (lba >= NUMBER_OF_BLOCKS)
+    if (lba >= NUMBER_OF_BLOCKS || offset >= BLOCK_SIZE)
         return -1;
 
-    /* We lie about the image size - actually it's 64 kB, not 512 kB, so if we're out of bounds, return zeros */
-    else if (lba >= ACTUAL_NUMBER_OF_BLOCKS)
-        memset(buffer, 0x00, bufsize);
+    memset(sector, 0, sizeof(sector));
+
+    if (lba == 0)
+        build_boot_sector(sector);
+
+    else if (lba < ROOT_DIR_LBA)
+        build_fat_sector(sector, (lba - FAT_START_LBA) % SECTORS_PER_FAT);
+
+    else if (lba == ROOT_DIR_LBA)
+        build_root_dir(sector);
 
     else
-        memcpy(buffer, addr, bufsize);
+        read_file_sector(sector, lba - DATA_START_LBA);
+
+    bufsize = MIN(bufsize, BLOCK_SIZE - offset);
+    memcpy(buffer, &sector[offset], bufsize);
 
     return (int32_t)bufsize;
 }
@@ -57,14 +368,12 @@ bool tud_msc_is_writable_cb(uint8_t lun) {
     return true;
 }
 
-/* Simple firmware write routine, we get 512-byte uf2 blocks with 256 byte payload */
+/* UF2 blocks are only validated and queued here, so the host gets its acknowledgement right away.
+   Erasing and programming happens in process_fw_queue_task, we report busy only if the queue is full. */
 int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize) {
     const uint32_t MAX_BLOCK_NO = (STAGING_IMAGE_SIZE / FLASH_PAGE_SIZE) - 1;
     uf2_t *uf2 = (uf2_t *)&buffer[0];
 
-    bool is_final_block = (uf2->blockNo == MAX_BLOCK_NO);
-    uint32_t flash_addr = (uint32_t)ADDR_FW_RUNNING + uf2->blockNo * FLASH_PAGE_SIZE - XIP_BASE;
-
     if (lba >= NUMBER_OF_BLOCKS)
         return -1;
 
@@ -72,38 +381,98 @@ int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *
     if (uf2->magicStart0 != UF2_MAGIC_START0 || uf2->magicStart1 != UF2_MAGIC_START1 || uf2->magicEnd != UF2_MAGIC_END)
         return (int32_t)bufsize;
 
-    if (uf2->blockNo == 0) {
-        global_state.fw.checksum = 0xffffffff;
+    if (uf2->blockNo > MAX_BLOCK_NO)
+        return (int32_t)bufsize;
+
+    /* Ring is full, tell TinyUSB to retry this block later */
+    if (queue_is_full(&global_state.fw_queue))
+        return 0;
 
-        /* Make sure nobody else touches the flash during this operation, otherwise we get empty pages */
+    /* Make sure nobody else touches the flash during this operation, otherwise we get empty pages */
+    if (uf2->blockNo == 0)
         global_state.fw.upgrade_in_progress = true;
-    }
 
-    /* Update checksum continuously as blocks are being received */
+    fw_page_t page = {.block_no = uf2->blockNo};
+    memcpy(page.data, &buffer[32], FLASH_PAGE_SIZE);
+    queue_try_add(&global_state.fw_queue, &page);
+
+    return (int32_t)bufsize;
+}
+
+/* Erases the next part of the image. Where a whole 64k block is left, it goes in one step,
+   a block erase takes about as long as three sector erases instead of sixteen. */
+static bool erase_fw_ahead(fw_upgrade_state_t *fw) {
+    bool whole_block = fw->erased_until % FLASH_BLOCK_SIZE == 0
+                    && fw->erased_until + FLASH_BLOCK_SIZE <= STAGING_IMAGE_SIZE;
+    uint32_t length  = whole_block ? FLASH_BLOCK_SIZE : FLASH_SECTOR_SIZE;
+
+    if (!erase_flash_range((uint32_t)ADDR_FW_RUNNING - XIP_BASE + fw->erased_until, length))
+        return false;
+
+    fw->erased_until += length;
+    return true;
+}
+
+static bool program_fw_page(uint32_t offset, uint8_t *data) {
+    return program_flash_page((uint32_t)ADDR_FW_RUNNING - XIP_BASE + offset, data);
+}
+
+/* Drains the UF2 page queue. While the host is busy sending the next blocks and the queue is
+   empty, we erase the following sector ahead of time so the pages can be programmed directly. */
+void process_fw_queue_task(device_t *state) {
+    const uint32_t MAX_BLOCK_NO = (STAGING_IMAGE_SIZE / FLASH_PAGE_SIZE) - 1;
     const uint32_t last_block_with_checksum = (STAGING_IMAGE_SIZE - FLASH_SECTOR_SIZE) / FLASH_PAGE_SIZE;
-    for (int i=0; i<FLASH_PAGE_SIZE && uf2->blockNo < last_block_with_checksum; i++)
-        global_state.fw.checksum = crc32_iter(global_state.fw.checksum, buffer[32 + i]);
+    static fw_page_t page;
 
-    write_flash_page(flash_addr, &buffer[32]);
+    if (!state->config_mode_active || !state->fw.upgrade_in_progress)
+        return;
 
-    if (is_final_block) {
-        global_state.fw.checksum = ~global_state.fw.checksum;
+    /* The page stays queued until it's programmed. If core0 didn't get off the flash in time,
+       we come back to it on the next pass. */
+    if (!queue_try_peek(&state->fw_queue, &page)) {
+        /* Nothing to program, use the idle time to erase ahead */
+        if (state->fw.erased_until < STAGING_IMAGE_SIZE && state->fw.erased_until > 0)
+            erase_fw_ahead(&state->fw);
+        return;
+    }
 
-        /* If checksums don't match, overwrite first sector and rely on ROM bootloader for recovery */
-        if (global_state.fw.checksum != calculate_firmware_crc32()) {
-            flash_range_erase((uint32_t)ADDR_FW_RUNNING - XIP_BASE, FLASH_SECTOR_SIZE);
-            reset_usb_boot(1 << PICO_DEFAULT_LED_PIN, 0);
-        }
-        else {
-            global_state.reboot_requested = true;
-        }
+    uint32_t page_offset = page.block_no * FLASH_PAGE_SIZE;
+
+    /* (Re)starting the upload, nothing is erased yet */
+    if (page.block_no == 0) {
+        state->fw.checksum     = CRC32_INIT;
+        state->fw.erased_until = 0;
     }
 
+    /* Page lands in a sector we haven't erased yet */
+    while (page_offset >= state->fw.erased_until)
+        if (!erase_fw_ahead(&state->fw))
+            return;
+
+    if (!program_fw_page(page_offset, page.data))
+        return;
+
+    queue_try_remove(&state->fw_queue, NULL);
+
+    /* Update checksum continuously as pages are being written */
+    if (page.block_no < last_block_with_checksum)
+        state->fw.checksum = crc32_update(state->fw.checksum, page.data, FLASH_PAGE_SIZE);
+
     /* Provide some visual indication that fw is being uploaded */
     toggle_led();
-    watchdog_update();
 
-    return (int32_t)bufsize;
+    if (page.block_no != MAX_BLOCK_NO)
+        return;
+
+    state->fw.checksum = ~state->fw.checksum;
+
+    /* If checksums don't match, overwrite first sector and rely on ROM bootloader for recovery */
+    if (state->fw.checksum != calculate_firmware_crc32()) {
+        reject_firmware_image();
+    }
+    else {
+        state->reboot_requested = true;
+    }
 }
 
 /* This is a super-dumb, rudimentary disk, any other scsi command is simply rejected */
@@ -19,25 +19,25 @@
  * Perform initial UART setup
  * ================================================== */
 
-void serial_init() {
+void serial_init(uart_inst_t *uart, uint tx_pin, uint rx_pin) {
     /* Set up our UART with a default baudrate. */
-    uart_init(SERIAL_UART, SERIAL_BAUDRATE);
+    uart_init(uart, SERIAL_BAUDRATE);
 
     /* Set UART flow control CTS/RTS. We don't have these - turn them off.*/
-    uart_set_hw_flow(SERIAL_UART, false, false);
+    uart_set_hw_flow(uart, false, false);
 
     /* Set our data format */
-    uart_set_format(SERIAL_UART, SERIAL_DATA_BITS, SERIAL_STOP_BITS, SERIAL_PARITY);
+    uart_set_format(uart, SERIAL_DATA_BITS, SERIAL_STOP_BITS, SERIAL_PARITY);
 
     /* Turn of CRLF translation */
-    uart_set_translate_crlf(SERIAL_UART, false);
+    uart_set_translate_crlf(uart, false);
 
     /* We do want FIFO, will help us have fewer interruptions */
-    uart_set_fifo_enabled(SERIAL_UART, true);
+    uart_set_fifo_enabled(uart, true);
 
     /* Set the RX/TX pins, they differ based on the device role (A or B, check schematics) */
-    gpio_set_function(SERIAL_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(SERIAL_RX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(rx_pin, GPIO_FUNC_UART);
 }
 
 /* ================================================== *
@@ -50,7 +50,7 @@ void pio_usb_host_config(device_t *state) {
     config.pin_dp                         = PIO_USB_DP_PIN_DEFAULT;
 
     /* Board B is always report mode, board A is default-boot if configured */
-    if (state->board_role == OUTPUT_B || ENFORCE_KEYBOARD_BOOT_PROTOCOL == 0)
+    if (BOARD_SIDE == OUTPUT_B || ENFORCE_KEYBOARD_BOOT_PROTOCOL == 0)
         tuh_hid_set_default_protocol(HID_PROTOCOL_REPORT);
 
     tuh_configure(BOARD_TUH_RHPORT, TUH_CFGID_RPI_PIO_USB_CONFIGURATION, &config);
@@ -131,10 +131,15 @@ const uint8_t* uart_buffer_pointers[1] = {uart_rxbuf};
 uint8_t uart_rxbuf[DMA_RX_BUFFER_SIZE] __attribute__((aligned(DMA_RX_BUFFER_SIZE))) ;
 uint8_t uart_txbuf[DMA_TX_BUFFER_SIZE] __attribute__((aligned(DMA_TX_BUFFER_SIZE))) ;
 
-static void configure_tx_dma(device_t *state) {
-    state->dma_tx_channel = dma_claim_unused_channel(true);
+/* Chain port to the neighbouring DeskHop works the same way */
+const uint8_t* chain_buffer_pointers[1] = {chain_rxbuf};
+uint8_t chain_rxbuf[DMA_RX_BUFFER_SIZE] __attribute__((aligned(DMA_RX_BUFFER_SIZE))) ;
+uint8_t chain_txbuf[DMA_TX_BUFFER_SIZE] __attribute__((aligned(DMA_TX_BUFFER_SIZE))) ;
 
-    dma_channel_config tx_config = dma_channel_get_default_config(state->dma_tx_channel);
+static void configure_tx_dma(uart_inst_t *uart, uint8_t *txbuf, uint32_t *tx_channel) {
+    *tx_channel = dma_claim_unused_channel(true);
+
+    dma_channel_config tx_config = dma_channel_get_default_config(*tx_channel);
     channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
 
     /* Writing uart (always write the same address, but source addr changes as we read) */
@@ -142,27 +147,28 @@ static void configure_tx_dma(device_t *state) {
     channel_config_set_write_increment(&tx_config, false);
 
     // channel_config_set_ring(&tx_config, false, 4);
-    channel_config_set_dreq(&tx_config, DREQ_UART0_TX);
+    channel_config_set_dreq(&tx_config, uart_get_dreq(uart, true));
 
     /* Configure, but don't start immediately. We'll do this each time the outgoing
        packet is ready and we copy it to the buffer */
     dma_channel_configure(
-        state->dma_tx_channel,
+        *tx_channel,
         &tx_config,
-        &uart0_hw->dr,
-        uart_txbuf,
+        &uart_get_hw(uart)->dr,
+        txbuf,
         0,
         false
     );
 }
 
-static void configure_rx_dma(device_t *state) {
+static void configure_rx_dma(uart_inst_t *uart, uint8_t *rxbuf, const uint8_t **ring_start,
+                             uint32_t *rx_channel, uint32_t *control_channel) {
     /* Find an empty channel, store it for later reference */
-    state->dma_rx_channel = dma_claim_unused_channel(true);
-    state->dma_control_channel = dma_claim_unused_channel(true);
+    *rx_channel = dma_claim_unused_channel(true);
+    *control_channel = dma_claim_unused_channel(true);
 
-    dma_channel_config config = dma_channel_get_default_config(state->dma_rx_channel);
-    dma_channel_config control_config = dma_channel_get_default_config(state->dma_control_channel);
+    dma_channel_config config = dma_channel_get_default_config(*rx_channel);
+    dma_channel_config control_config = dma_channel_get_default_config(*control_channel);
 
     channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
     channel_config_set_transfer_data_size(&control_config, DMA_SIZE_32);
@@ -178,27 +184,42 @@ static void configure_rx_dma(device_t *state) {
     channel_config_set_ring(&config, true, 10);
 
     // The UART signals when data is avaliable
-    channel_config_set_dreq(&config, DREQ_UART0_RX);
+    channel_config_set_dreq(&config, uart_get_dreq(uart, false));
 
-    channel_config_set_chain_to(&config, state->dma_control_channel);
+    channel_config_set_chain_to(&config, *control_channel);
 
     dma_channel_configure(
-        state->dma_rx_channel,
+        *rx_channel,
         &config,
-        uart_rxbuf,
-        &uart0_hw->dr,
+        rxbuf,
+        &uart_get_hw(uart)->dr,
         DMA_RX_BUFFER_SIZE,
         false);
 
     dma_channel_configure(
-        state->dma_control_channel,
+        *control_channel,
         &control_config,
-        &dma_hw->ch[state->dma_rx_channel].al2_write_addr_trig,
-        uart_buffer_pointers,
+        &dma_hw->ch[*rx_channel].al2_write_addr_trig,
+        ring_start,
         1,
         false);
 
-    dma_channel_start(state->dma_control_channel);
+    dma_channel_start(*control_channel);
+}
+
+/* Second UART and its DMA, only on boards with another DeskHop on the chain port */
+void chain_serial_init(device_t *state) {
+    chain_t *chain = &state->chain;
+
+    if (!chain->next_port)
+        return;
+
+    queue_init(&chain->tx_queue, sizeof(uart_packet_t), CHAIN_QUEUE_LENGTH);
+    serial_init(CHAIN_UART, CHAIN_TX_PIN, CHAIN_RX_PIN);
+
+    configure_tx_dma(CHAIN_UART, chain_txbuf, &chain->dma_tx_channel);
+    configure_rx_dma(CHAIN_UART, chain_rxbuf, chain_buffer_pointers, &chain->dma_rx_channel,
+                     &chain->dma_control_channel);
 }
 
 
@@ -211,9 +232,15 @@ void initial_setup(device_t *state) {
     /* PIO USB requires a clock multiple of 12 MHz, setting to 120 MHz */
     set_sys_clock_khz(120000, true);
 
+    /* Prepare the software CRC32 tables, config loading already needs them */
+    crc32_init();
+
     /* Search the persistent storage sector in flash for valid config or use defaults */
     load_config(state);
 
+    /* Macros have their own flash sector, copy them to RAM */
+    load_macros();
+
     /* Init and enable the on-board LED GPIO as output */
     gpio_init(GPIO_LED_PIN);
     gpio_set_dir(GPIO_LED_PIN, GPIO_OUT);
@@ -221,15 +248,28 @@ void initial_setup(device_t *state) {
     /* Check if we should boot in configuration mode or not */
     state->config_mode_active = is_config_mode_active(state);
 
-    /* Detect which board we're running on */
-    state->board_role = board_autoprobe();
+    /* Detect which board we're running on, DeskHops further along the chain drive the later outputs */
+    state->board_role = board_autoprobe() + 2 * state->config.chain_pair;
+
+    if (state->board_role >= NUM_SCREENS)
+        state->board_role = BOARD_SIDE;
+
+    chain_init(&state->chain, BOARD_ROLE, NUM_SCREENS);
+
+    /* Our host gets the pen digitizer if our output is set to use it. Config changes need a reboot anyway. */
+    state->digitizer_active = !state->config_mode_active && state->config.output[BOARD_ROLE].pointer_mode == TOUCH;
 
-    /* Initialize and configure UART */
-    serial_init();
+    /* Initialize and configure UART, the A side manages the link rate */
+    serial_init(SERIAL_UART, SERIAL_TX_PIN, SERIAL_RX_PIN);
+    link_init(&state->link, BOARD_SIDE == OUTPUT_A, time_us_64());
 
     /* Initialize keyboard and mouse queues */
     queue_init(&state->kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
     queue_init(&state->mouse_queue, sizeof(mouse_report_t), MOUSE_QUEUE_LENGTH);
+    mouse_fast_init();
+
+    /* Initialize queue of text to be typed */
+    queue_init(&state->text_queue, sizeof(text_char_t), TEXT_QUEUE_LENGTH);
 
     /* Initialize generic HID packet queue */
     queue_init(&state->hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
@@ -237,6 +277,13 @@ void initial_setup(device_t *state) {
     /* Initialize UART queue */
     queue_init(&state->uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
 
+    /* Initialize UF2 upload queue, only needed in config mode when the disk is exposed */
+    if (state->config_mode_active)
+        queue_init(&state->fw_queue, sizeof(fw_page_t), FW_QUEUE_LENGTH);
+
+    /* Either core may write flash, the other one has to be able to park itself meanwhile */
+    flash_safe_execute_core_init();
+
     /* Setup RP2040 Core 1 */
     multicore_reset_core1();
     multicore_launch_core1(core1_main);
@@ -248,8 +295,10 @@ void initial_setup(device_t *state) {
     pio_usb_host_config(state);
 
     /* Initialize and configure DMA */
-    configure_tx_dma(state);
-    configure_rx_dma(state);
+    configure_tx_dma(SERIAL_UART, uart_txbuf, &state->dma_tx_channel);
+    configure_rx_dma(SERIAL_UART, uart_rxbuf, uart_buffer_pointers, &state->dma_rx_channel,
+                     &state->dma_control_channel);
+    chain_serial_init(state);
 
     /* Load the current firmware info */
     state->_running_fw = _firmware_metadata;
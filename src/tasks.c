@@ -19,6 +19,13 @@ void task_scheduler(device_t *state, task_t *task) {
 
     task->next_run = current_time + task->frequency;
     task->exec(state);
+
+#ifdef DH_TRACE
+    uint32_t duration = time_us_32() - (uint32_t)current_time;
+
+    if (duration >= TRACE_TASK_MIN_US)
+        TRACE(TRACE_TASK, MIN(duration, UINT16_MAX), (uint32_t)task->exec);
+#endif
 }
 
 /* ================================================== *
@@ -48,6 +55,24 @@ void usb_device_task(device_t *state) {
     tud_task();
 }
 
+/* Descriptors are read once at enumeration, the host only sees what we offer now if we go away and come back */
+void usb_reconnect_task(device_t *state) {
+    if (state->reconnect_at) {
+        if (time_us_64() >= state->reconnect_at) {
+            state->reconnect_at = 0;
+            tud_connect();
+        }
+        return;
+    }
+
+    if (!state->descriptors_changed || state->config_mode_active)
+        return;
+
+    state->descriptors_changed = false;
+    tud_disconnect();
+    state->reconnect_at = time_us_64() + USB_RECONNECT_US;
+}
+
 void usb_host_task(device_t *state) {
     if (tuh_inited())
         tuh_task();
@@ -138,6 +163,38 @@ void screensaver_task(device_t *state) {
     last_pointer_move = time_us_32();
 }
 
+/* Once a second, turn the raw counters into rates. The counters are never reset, so wrapping is harmless. */
+void stats_task(device_t *state) {
+    static uint32_t last_time, last_rx, last_reports[STATS_NUM_REPORTS], last_loops[2];
+    stats_t *stats   = &state->stats;
+    uint32_t now     = time_us_32();
+    uint32_t elapsed = now - last_time;
+
+    if (!elapsed)
+        return;
+
+    stats->uart_rx_rate = (uint64_t)(stats->uart_rx_packets - last_rx) * 1000000 / elapsed;
+    last_rx             = stats->uart_rx_packets;
+
+    for (int i = 0; i < STATS_NUM_REPORTS; i++) {
+        stats->host_report_rate[i] = (uint64_t)(stats->host_reports[i] - last_reports[i]) * 1000000 / elapsed;
+        last_reports[i]            = stats->host_reports[i];
+    }
+
+    for (int i = 0; i < 2; i++) {
+        stats->loop_rate[i] = (uint64_t)(stats->loops[i] - last_loops[i]) * 1000000 / elapsed;
+        last_loops[i]       = stats->loops[i];
+    }
+
+    /* Peak levels start over each second, so they show the current load */
+    for (int i = 0; i < STATS_NUM_QUEUES; i++) {
+        stats->queue_peak_level[i] = stats->queue_peak[i];
+        stats->queue_peak[i]       = 0;
+    }
+
+    last_time = now;
+}
+
 /* Periodically emit heartbeat packets */
 void heartbeat_output_task(device_t *state) {
     /* If firmware upgrade is in progress, don't touch flash_cs */
@@ -164,10 +221,11 @@ void heartbeat_output_task(device_t *state) {
         .data16 = {
             [0] = state->_running_fw.version,
             [2] = state->active_output,
+            [3] = state->stats.uart_checksum_errors, // Lets board A include our receive errors in the link health
         },
     };
 
-    queue_try_add(&global_state.uart_tx_queue, &packet);
+    queue_add_counted(&global_state.uart_tx_queue, &packet, STATS_UART_QUEUE);
 }
 
 
@@ -175,6 +233,9 @@ void heartbeat_output_task(device_t *state) {
 void process_hid_queue_task(device_t *state) {
     hid_generic_pkt_t packet;
 
+    /* Queue more of a "read all" request as the queue drains, if there is one */
+    send_read_all_fields(state);
+
     if (!queue_try_peek(&state->hid_queue_out, &packet))
         return;
 
@@ -197,28 +258,34 @@ void firmware_upgrade_task(device_t *state) {
     if (queue_is_full(&state->uart_tx_queue))
         return;
 
-    /* End condition, when reached the process is completed. */
-    if (state->fw.address > STAGING_IMAGE_SIZE) {
+    /* If we're on the last element of the current page, page is done - write it. At address 0,
+       nothing was received yet and the page before it would wrap around to the end of flash. */
+    if (TU_U32_BYTE0(state->fw.address) == 0x00 && state->fw.address) {
+
+        uint32_t page_start_addr = (state->fw.address - 1) & 0xFFFFFF00;
+
+        /* Core1 didn't get off the flash in time, nothing was written. The next byte isn't requested
+           yet, so the page is still in the buffer and we try again on the next pass. */
+        if (!write_flash_page((uint32_t)ADDR_FW_RUNNING + page_start_addr - XIP_BASE, state->page_buffer))
+            return;
+    }
+
+    /* End condition, when reached the process is completed. The other board doesn't answer
+       requests past the image, so this is checked once the last page is written. */
+    if (state->fw.address >= STAGING_IMAGE_SIZE) {
         state->fw.upgrade_in_progress = 0;
         state->fw.checksum = ~state->fw.checksum;
 
         /* Checksum mismatch, we wipe the stage 2 bootloader and rely on ROM recovery */
         if(calculate_firmware_crc32() != state->fw.checksum) {
-            flash_range_erase((uint32_t)ADDR_FW_RUNNING - XIP_BASE, FLASH_SECTOR_SIZE);
-            reset_usb_boot(1 << PICO_DEFAULT_LED_PIN, 0);
+            reject_firmware_image();
         }
 
         else {
             state->_running_fw = _firmware_metadata;
             global_state.reboot_requested = true;
         }
-    }
-
-    /* If we're on the last element of the current page, page is done - write it. */
-    if (TU_U32_BYTE0(state->fw.address) == 0x00) {
-
-        uint32_t page_start_addr = (state->fw.address - 1) & 0xFFFFFF00;
-        write_flash_page((uint32_t)ADDR_FW_RUNNING + page_start_addr - XIP_BASE, state->page_buffer);
+        return;
     }
 
     request_byte(state, state->fw.address);
@@ -227,18 +294,19 @@ void firmware_upgrade_task(device_t *state) {
 void packet_receiver_task(device_t *state) {
     uint32_t current_pointer
         = (uint32_t)DMA_RX_BUFFER_SIZE - dma_channel_hw_addr(state->dma_rx_channel)->transfer_count;
-    uint32_t delta = get_ptr_delta(current_pointer, state);
+    uint32_t delta = get_ptr_delta(current_pointer, state->dma_ptr);
 
     /* If we don't have enough characters for a packet, skip loop and return immediately */
     while (delta >= RAW_PACKET_LENGTH) {
-        if (is_start_of_packet(state)) {
-            fetch_packet(state);
+        if (is_start_of_packet(uart_rxbuf, state->dma_ptr)) {
+            fetch_packet(uart_rxbuf, &state->dma_ptr, &state->in_packet);
             process_packet(&state->in_packet, state);
             return;
         }
 
         /* No packet found, advance to next position and decrement delta */
         state->dma_ptr = NEXT_RING_IDX(state->dma_ptr);
+        state->stats.uart_skipped_bytes++;
         delta--;
     }
 }
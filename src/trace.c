@@ -0,0 +1,88 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+
+#include "main.h"
+
+#ifdef DH_TRACE
+
+trace_ring_t trace_rings[TRACE_NUM_CORES];
+
+/* Drop count already reported for each ring. Only the reader changes it, so the producer never has to. */
+static uint32_t dropped_reported[TRACE_NUM_CORES];
+
+/* Take the oldest record out of the ring. Lost events are reported first, as a record of their own. */
+static bool take_record(uint8_t core, trace_record_t *record) {
+    trace_ring_t *ring = &trace_rings[core];
+    uint32_t dropped   = ring->dropped;
+    uint32_t tail      = ring->tail;
+
+    if (dropped != dropped_reported[core]) {
+        *record = (trace_record_t){time_us_32(), core, TRACE_DROPPED, 0, dropped - dropped_reported[core]};
+        dropped_reported[core] = dropped;
+        return true;
+    }
+
+    if (tail == ring->head)
+        return false;
+
+    __dmb();
+    *record = ring->records[tail & (TRACE_RING_SIZE - 1)];
+    __dmb();
+
+    ring->tail = tail + 1;
+    return true;
+}
+
+/* Copy as many whole records as fit into dst. Cores take turns, so a busy one can't starve the other.
+   dst doesn't have to be aligned, records are copied bytewise. */
+uint16_t read_trace(uint8_t *dst, uint16_t max_len) {
+    static uint8_t core = 0;
+    trace_record_t record;
+    uint16_t length = 0;
+    uint8_t idle    = 0; // Cores in a row that had nothing
+
+    while (idle < TRACE_NUM_CORES && length + sizeof(trace_record_t) <= max_len) {
+        if (take_record(core, &record)) {
+            memcpy(&dst[length], &record, sizeof(trace_record_t));
+            length += sizeof(trace_record_t);
+            idle = 0;
+        } else {
+            idle++;
+        }
+
+        core = (core + 1) % TRACE_NUM_CORES;
+    }
+
+    return length;
+}
+
+#ifdef DH_DEBUG
+/* Send records over CDC, each framed with a preamble and checksum so the decoder can skip debug text.
+   Only what fits in the CDC buffer right now is sent, we never wait for the host. */
+void trace_cdc_task(device_t *state) {
+    uint8_t packet[TRACE_CDC_LENGTH] = {START1, START2};
+
+    if (!tud_cdc_connected())
+        return;
+
+    while (tud_cdc_write_available() >= TRACE_CDC_LENGTH) {
+        if (!read_trace(&packet[START_LENGTH], sizeof(trace_record_t)))
+            break;
+
+        packet[TRACE_CDC_LENGTH - 1] = calc_checksum(&packet[START_LENGTH], sizeof(trace_record_t));
+        tud_cdc_write(packet, TRACE_CDC_LENGTH);
+    }
+
+    tud_cdc_write_flush();
+}
+#endif
+
+#endif
@@ -27,12 +27,20 @@ void write_raw_packet(uint8_t *dst, uart_packet_t *packet) {
     memcpy(dst, &pkt, RAW_PACKET_LENGTH);
 }
 
-/* Schedule packet for sending to the other box */
-void queue_packet(const uint8_t *data, enum packet_type_e packet_type, int length) {
+/* Schedule packet for sending to the board driving 'output', CHAIN_ALL sends it to every other board */
+void queue_packet_to(const uint8_t *data, enum packet_type_e packet_type, int length, uint8_t output) {
     uart_packet_t packet = {.type = packet_type};
     memcpy(packet.data, data, length);
 
-    queue_try_add(&global_state.uart_tx_queue, &packet);
+    if (packet_type != MOUSE_REPORT_MSG && packet_type != MOUSE_DELTA_MSG)
+        mouse_link_sync(&global_state);
+
+    chain_send(&packet, output, &global_state);
+}
+
+/* Schedule packet for sending to the other box */
+void queue_packet(const uint8_t *data, enum packet_type_e packet_type, int length) {
+    queue_packet_to(data, packet_type, length, OTHER_ROLE);
 }
 
 /* Sends just one byte of a certain packet type to the other box. */
@@ -40,6 +48,11 @@ void send_value(const uint8_t value, enum packet_type_e packet_type) {
     queue_packet(&value, packet_type, sizeof(uint8_t));
 }
 
+/* Sends just one byte of a certain packet type to the board driving 'output'. */
+void send_value_to(const uint8_t value, enum packet_type_e packet_type, uint8_t output) {
+    queue_packet_to(&value, packet_type, sizeof(uint8_t), output);
+}
+
 /* Process outgoing config report messages. */
 void process_uart_tx_task(device_t *state) {
     uart_packet_t packet = {0};
@@ -50,8 +63,16 @@ void process_uart_tx_task(device_t *state) {
     if (!queue_try_remove(&state->uart_tx_queue, &packet))
         return;
 
+    /* Heartbeats carry our clock as the transfer starts, the other board uses it to correlate time stamps */
+    if (packet.type == HEARTBEAT_MSG)
+        packet.data16[1] = time_us_32();
+
     write_raw_packet(uart_txbuf, &packet);
     dma_channel_transfer_from_buffer_now(state->dma_tx_channel, uart_txbuf, RAW_PACKET_LENGTH);
+
+    latency_removed(LAT_QUEUE_UART);
+    latency_sent(LAT_QUEUE_UART, state);
+    TRACE(TRACE_UART_TX, packet.type, queue_get_level_unsafe(&state->uart_tx_queue));
 }
 
 /* ================================================== *
@@ -62,6 +83,7 @@ const uart_handler_t uart_handler[] = {
     /* Core functions */
     {.type = KEYBOARD_REPORT_MSG, .handler = handle_keyboard_uart_msg},
     {.type = MOUSE_REPORT_MSG, .handler = handle_mouse_abs_uart_msg},
+    {.type = MOUSE_DELTA_MSG, .handler = handle_mouse_delta_uart_msg},
     {.type = OUTPUT_SELECT_MSG, .handler = handle_output_select_msg},
 
     /* Box control */
@@ -72,6 +94,8 @@ const uart_handler_t uart_handler[] = {
     {.type = FLASH_LED_MSG, .handler = handle_flash_led_msg},
     {.type = GAMING_MODE_MSG, .handler = handle_toggle_gaming_msg},
     {.type = CONSUMER_CONTROL_MSG, .handler = handle_consumer_control_msg},
+    {.type = PASSTHROUGH_MSG, .handler = handle_passthrough_msg},
+    {.type = GAMEPAD_MSG, .handler = handle_gamepad_msg},
     {.type = SCREENSAVER_MSG, .handler = handle_screensaver_msg},
 
     /* Config */
@@ -88,13 +112,27 @@ const uart_handler_t uart_handler[] = {
     {.type = FIRMWARE_UPGRADE_MSG, .handler = handle_fw_upgrade_msg},
 
     {.type = HEARTBEAT_MSG, .handler = handle_heartbeat_msg},
+    {.type = LINK_MSG, .handler = handle_link_msg},
     {.type = PROXY_PACKET_MSG, .handler = handle_proxy_msg},
 };
 
 void process_packet(uart_packet_t *packet, device_t *state) {
-    if (!verify_checksum(packet))
+    if (!verify_checksum(packet)) {
+        state->stats.uart_checksum_errors++;
+        return;
+    }
+
+    state->stats.uart_rx_packets++;
+    route_packet(packet, CHAIN_PORT_PEER, state);
+}
+
+/* Packets for other boards are passed on, the ones for us go to their handler */
+void route_packet(uart_packet_t *packet, uint8_t port, device_t *state) {
+    if (!chain_accept(packet, port, state))
         return;
 
+    TRACE(TRACE_UART_RX, packet->type, 0);
+
     for (int i = 0; i < ARRAY_SIZE(uart_handler); i++) {
         if (uart_handler[i].type == packet->type) {
             uart_handler[i].handler(packet, state);
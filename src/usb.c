@@ -14,6 +14,17 @@
 _Static_assert(MAX_DEVICES <= CFG_TUH_DEVICE_MAX,
                "MAX_DEVICES must not exceed CFG_TUH_DEVICE_MAX");
 
+/* Scrolling state of the mouse endpoint a report is for, NULL if it's something else */
+static host_scroll_t *get_host_scroll(uint8_t instance, uint8_t report_id) {
+    if (instance == ITF_NUM_HID && report_id == REPORT_ID_MOUSE)
+        return &global_state.host_scroll[ABSOLUTE];
+
+    if (instance == ITF_NUM_HID_REL_M && report_id == REPORT_ID_RELMOUSE)
+        return &global_state.host_scroll[RELATIVE];
+
+    return NULL;
+}
+
 /* ================================================== *
  * ===========  TinyUSB Device Callbacks  =========== *
  * ================================================== */
@@ -26,7 +37,14 @@ uint16_t tud_hid_get_report_cb(uint8_t instance,
                                hid_report_type_t report_type,
                                uint8_t *buffer,
                                uint16_t request_len) {
-    return 0;
+    host_scroll_t *scroll = get_host_scroll(instance, report_id);
+
+    /* The only report we can be asked for is the mouse Resolution Multiplier feature */
+    if (scroll == NULL || report_type != HID_REPORT_TYPE_FEATURE || !request_len)
+        return 0;
+
+    buffer[0] = scroll->multiplier;
+    return 1;
 }
 
 /**
@@ -42,6 +60,10 @@ void tud_hid_set_report_cb(uint8_t instance,
                            uint8_t const *buffer,
                            uint16_t bufsize) {
 
+    /* Output and feature reports for a mirrored device don't go anywhere */
+    if (instance == ITF_NUM_HID_PASS && !global_state.config_mode_active)
+        return;
+
     /* We received a report on the config report ID */
     if (instance == ITF_NUM_HID_VENDOR && report_id == REPORT_ID_VENDOR) {
         /* Security - only if config mode is enabled are we allowed to do anything. While the report_id
@@ -62,6 +84,13 @@ void tud_hid_set_report_cb(uint8_t instance,
         process_packet(packet, &global_state);
     }
 
+    /* Host turning the mouse's high resolution scrolling on or off, leftovers in the old units go away */
+    host_scroll_t *scroll = get_host_scroll(instance, report_id);
+    if (scroll != NULL && report_type == HID_REPORT_TYPE_FEATURE && bufsize == 1) {
+        *scroll = (host_scroll_t){.multiplier = buffer[0] & (SCROLL_HIRES_WHEEL | SCROLL_HIRES_PAN)};
+        return;
+    }
+
     /* Only other set report we care about is LED state change, and that's exactly 1 byte long */
     if (report_id != REPORT_ID_KEYBOARD || bufsize != 1 || report_type != HID_REPORT_TYPE_OUTPUT)
         return;
@@ -82,18 +111,77 @@ void tud_hid_set_report_cb(uint8_t instance,
     if (global_state.keyboard_connected && CURRENT_BOARD_IS_ACTIVE_OUTPUT)
         restore_leds(&global_state);
 
-    /* Always send to the other one, so it is aware of the change */
-    send_value(leds, KBD_SET_REPORT_MSG);
+    /* Always send to the others, so they are aware of the change */
+    uint8_t report[2] = {leds, BOARD_ROLE};
+    queue_packet_to(report, KBD_SET_REPORT_MSG, sizeof(report), CHAIN_ALL);
 }
 
 /* Invoked when device is mounted */
 void tud_mount_cb(void) {
     global_state.tud_connected = true;
+
+    /* A new host scrolls in whole detents until it says otherwise */
+    memset(global_state.host_scroll, 0, sizeof(global_state.host_scroll));
+
+    /* ...and knows nothing about the gamepad */
+    memset(&global_state.gamepad.host, 0, sizeof(global_state.gamepad.host));
 }
 
 /* Invoked when device is unmounted */
 void tud_umount_cb(void) {
     global_state.tud_connected = false;
+    global_state.passthrough.offered = false;
+}
+
+/* Bulk config API requests arrive on the vendor interface, possibly spread over several
+   packets. Once a whole request is collected, it's processed and the reply sent right back. */
+void tud_vendor_rx_cb(uint8_t itf) {
+    static uint8_t request[BULK_BUFFER_SIZE];
+    static uint8_t reply[BULK_BUFFER_SIZE];
+    static uint16_t received = 0;
+    bulk_header_t *header = (bulk_header_t *)request;
+
+    while (tud_vendor_available()) {
+        received += tud_vendor_read(&request[received], sizeof(request) - received);
+
+        /* Same rule as the HID API, nothing is accepted outside the config mode */
+        if (!global_state.config_mode_active) {
+            received = 0;
+            continue;
+        }
+
+        /* Drop anything that doesn't start with a preamble, the next request will resync */
+        if (received >= START_LENGTH && (request[0] != START1 || request[1] != START2)) {
+            received = 0;
+            continue;
+        }
+
+        if (received < sizeof(bulk_header_t))
+            continue;
+
+        /* Request can never fit, reply with an error right away */
+        if (header->length > sizeof(request) - sizeof(bulk_header_t)) {
+            bulk_header_t error = {.start = {START1, START2}, .cmd = header->cmd, .status = BULK_ERR_LENGTH};
+            tud_vendor_write(&error, sizeof(error));
+            tud_vendor_write_flush();
+            received = 0;
+            continue;
+        }
+
+        if (received < sizeof(bulk_header_t) + header->length)
+            continue;
+
+        uint16_t length = handle_bulk_api_msg(request, reply, &global_state);
+
+        /* We don't send zero-length packets, so a reply ending exactly on a packet boundary
+           would leave the host waiting for more. Pad it, the header says where it ends. */
+        if (length % CFG_TUD_VENDOR_EPSIZE == 0)
+            reply[length++] = 0;
+
+        tud_vendor_write(reply, length);
+        tud_vendor_write_flush();
+        received = 0;
+    }
 }
 
 #ifdef DH_DEBUG_CDC_FLASH
@@ -121,12 +209,18 @@ void tud_cdc_rx_cb(uint8_t itf) {
 
 void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance) {
     uint8_t itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
+    TRACE(TRACE_HOST_UMOUNT, dev_addr << 8 | instance, itf_protocol);
 
     if (dev_addr > MAX_DEVICES || instance >= MAX_INTERFACES)
         return;
 
     hid_interface_t *iface = &global_state.iface[dev_addr-1][instance];
 
+    if (iface->passthrough)
+        passthrough_umount(dev_addr, instance, &global_state);
+
+    keyboard_umount(dev_addr, instance, &global_state);
+
     switch (itf_protocol) {
         case HID_ITF_PROTOCOL_KEYBOARD:
             global_state.keyboard_connected = false;
@@ -144,6 +238,7 @@ void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance) {
 
 void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_report, uint16_t desc_len) {
     uint8_t itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
+    TRACE(TRACE_HOST_MOUNT, dev_addr << 8 | instance, itf_protocol);
 
     if (dev_addr > MAX_DEVICES || instance >= MAX_INTERFACES)
         return;
@@ -158,7 +253,7 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_re
 
     switch (itf_protocol) {
         case HID_ITF_PROTOCOL_KEYBOARD:
-            if (global_state.config.enforce_ports && BOARD_ROLE == OUTPUT_B)
+            if (global_state.config.enforce_ports && BOARD_SIDE == OUTPUT_B)
                 return;
 
             if (global_state.config.force_kbd_boot_protocol)
@@ -171,7 +266,7 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_re
             break;
 
         case HID_ITF_PROTOCOL_MOUSE:
-            if (global_state.config.enforce_ports && BOARD_ROLE == OUTPUT_A)
+            if (global_state.config.enforce_ports && BOARD_SIDE == OUTPUT_A)
                 return;
 
             if (global_state.config.force_mouse_boot_mode) {
@@ -189,6 +284,8 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_re
             break;
 
         case HID_ITF_PROTOCOL_NONE:
+            /* Nothing in there we understand, the host can have it as it is */
+            iface->passthrough = passthrough_mount(dev_addr, instance, iface, desc_report, desc_len, &global_state);
             break;
     }
 
@@ -198,6 +295,16 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_re
         global_state.mouse_connected = true;
     }
 
+    /* Each keyboard in there keeps its keys in a slot of its own */
+    if (itf_protocol == HID_ITF_PROTOCOL_KEYBOARD || iface->num_keyboards)
+        keyboard_mount(dev_addr, instance, iface, &global_state);
+
+    /* Whichever board the gamepad is on, every host gets offered one */
+    gamepad_mount(iface, &global_state);
+
+    /* The control pipe may still be busy setting the protocol, high resolution scrolling waits a bit */
+    iface->mouse.hires_requested = iface->mouse.num_multipliers && !global_state.config.force_mouse_boot_mode;
+
     /* Flash local led to indicate a device was connected */
     blink_led(&global_state);
 
@@ -211,41 +318,25 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_re
 /* Invoked when received report from device via interrupt endpoint */
 void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *report, uint16_t len) {
     uint8_t const itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
+    latency_received();
+    TRACE(TRACE_HOST_REPORT, dev_addr << 8 | instance, len);
+
+    if (itf_protocol == HID_ITF_PROTOCOL_KEYBOARD)
+        global_state.stats.host_reports[STATS_KBD_REPORTS]++;
+    else if (itf_protocol == HID_ITF_PROTOCOL_MOUSE)
+        global_state.stats.host_reports[STATS_MOUSE_REPORTS]++;
+    else
+        global_state.stats.host_reports[STATS_OTHER_REPORTS]++;
 
     if (dev_addr > MAX_DEVICES || instance >= MAX_INTERFACES)
         return;
 
     hid_interface_t *iface = &global_state.iface[dev_addr-1][instance];
 
-    /* Calculate a device index that distinguishes between different devices
-       while staying within the bounds of MAX_DEVICES.
-
-       Device index assignment:
-       - 0: Primary keyboard (the one set in tuh_hid_mount_cb)
-       - 1: Mouse devices
-       - MAX_DEVICES-2: Secondary keyboards (e.g., wireless keyboard through unified dongle)
-       - (dev_addr-1) % (MAX_DEVICES-1): Other devices
-
-       Note: Slot MAX_DEVICES-1 is reserved for the remote device (used in handle_keyboard_uart_msg) */
-    uint8_t device_idx;
-
-    if (itf_protocol == HID_ITF_PROTOCOL_KEYBOARD) {
-        if (dev_addr == global_state.kbd_dev_addr && instance == global_state.kbd_instance) {
-            /* Primary keyboard */
-            device_idx = 0;
-        } else {
-            /* Secondary keyboard (e.g., wireless keyboard through unified dongle) */
-            device_idx = (MAX_DEVICES - 2);
-        }
-    } else if (itf_protocol == HID_ITF_PROTOCOL_MOUSE) {
-        /* Mouse devices */
-        device_idx = 1;
-    } else {
-        /* Other devices */
-        device_idx = (dev_addr - 1) % (MAX_DEVICES - 1);
+    if (iface->passthrough) {
+        process_passthrough_report((uint8_t *)report, len, instance, iface);
     }
-
-    if (iface->uses_report_id || itf_protocol == HID_ITF_PROTOCOL_NONE) {
+    else if (iface->uses_report_id || itf_protocol == HID_ITF_PROTOCOL_NONE) {
         uint8_t report_id = 0;
 
         if (iface->uses_report_id)
@@ -255,20 +346,31 @@ void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t cons
             process_report_f receiver = iface->report_handler[report_id];
 
             if (receiver != NULL)
-                receiver((uint8_t *)report, len, device_idx, iface);
+                receiver((uint8_t *)report, len, instance, iface);
         }
     }
     else if (itf_protocol == HID_ITF_PROTOCOL_KEYBOARD) {
-        process_keyboard_report((uint8_t *)report, len, device_idx, iface);
+        process_keyboard_report((uint8_t *)report, len, instance, iface);
     }
     else if (itf_protocol == HID_ITF_PROTOCOL_MOUSE) {
-        process_mouse_report((uint8_t *)report, len, device_idx, iface);
+        process_mouse_report((uint8_t *)report, len, instance, iface);
     }
 
+    if (iface->mouse.hires_requested)
+        mouse_enable_hires(dev_addr, instance, iface);
+
     /* Continue requesting reports */
     tuh_hid_receive_report(dev_addr, instance);
 }
 
+/* The mouse answered our Resolution Multiplier request, len is 0 if it refused */
+void tuh_hid_set_report_complete_cb(uint8_t dev_addr, uint8_t idx, uint8_t report_id, uint8_t report_type, uint16_t len) {
+    if (dev_addr > MAX_DEVICES || idx >= MAX_INTERFACES || report_type != HID_REPORT_TYPE_FEATURE)
+        return;
+
+    mouse_hires_enabled(&global_state.iface[dev_addr-1][idx], report_id, len);
+}
+
 /* Set protocol in a callback. This is tied to an interface, not a specific report ID */
 void tuh_hid_set_protocol_complete_cb(uint8_t dev_addr, uint8_t idx, uint8_t protocol) {
     if (dev_addr > MAX_DEVICES || idx >= MAX_INTERFACES)
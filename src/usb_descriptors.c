@@ -18,10 +18,10 @@
 //--------------------------------------------------------------------+
 
                                         // https://github.com/raspberrypi/usb-pid
-tusb_desc_device_t const desc_device_config = DEVICE_DESCRIPTOR(0x2e8a, 0x107c);
+tusb_desc_device_t const desc_device_config = DEVICE_DESCRIPTOR(0x2e8a, 0x107c, 0x0210);
 
                                         // https://pid.codes/1209/C000/
-tusb_desc_device_t const desc_device = DEVICE_DESCRIPTOR(0x1209, 0xc000);
+tusb_desc_device_t const desc_device = DEVICE_DESCRIPTOR(0x1209, 0xc000, 0x0200);
 
 // Invoked when received GET DEVICE DESCRIPTOR
 // Application return pointer to descriptor
@@ -46,6 +46,28 @@ uint8_t const desc_hid_report[] = {TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(RE
 
 uint8_t const desc_hid_report_relmouse[] = {TUD_HID_REPORT_DESC_MOUSEHELP(HID_REPORT_ID(REPORT_ID_RELMOUSE))};
 
+// Offered instead when this output uses the digitizer (pointer_mode TOUCH), see digitizer_active
+uint8_t const desc_hid_report_relmouse_pen[] = {TUD_HID_REPORT_DESC_MOUSEHELP(HID_REPORT_ID(REPORT_ID_RELMOUSE)),
+                                                TUD_HID_REPORT_DESC_DIGITIZER_PEN(HID_REPORT_ID(REPORT_ID_DIGITIZER))};
+
+// Both of the above with a gamepad, once there is one on any of the boards, see gamepad_active
+uint8_t const desc_hid_report_relmouse_gamepad[] = {TUD_HID_REPORT_DESC_MOUSEHELP(HID_REPORT_ID(REPORT_ID_RELMOUSE)),
+                                                    TUD_HID_REPORT_DESC_GAMEPAD(HID_REPORT_ID(REPORT_ID_GAMEPAD))};
+
+uint8_t const desc_hid_report_relmouse_pen_gamepad[] = {TUD_HID_REPORT_DESC_MOUSEHELP(HID_REPORT_ID(REPORT_ID_RELMOUSE)),
+                                                        TUD_HID_REPORT_DESC_DIGITIZER_PEN(HID_REPORT_ID(REPORT_ID_DIGITIZER)),
+                                                        TUD_HID_REPORT_DESC_GAMEPAD(HID_REPORT_ID(REPORT_ID_GAMEPAD))};
+
+uint8_t const *const desc_hid_report_relmouse_variant[] = {
+    desc_hid_report_relmouse,
+    desc_hid_report_relmouse_pen,
+    desc_hid_report_relmouse_gamepad,
+    desc_hid_report_relmouse_pen_gamepad,
+};
+
+/* Which mouse helper interface our host gets, indexes the _variant arrays */
+#define RELMOUSE_VARIANT (global_state.digitizer_active | global_state.gamepad_active << 1)
+
 uint8_t const desc_hid_report_vendor[] = {TUD_HID_REPORT_DESC_VENDOR_CTRL(HID_REPORT_ID(REPORT_ID_VENDOR))};
 
 
@@ -58,26 +80,69 @@ uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance) {
             return desc_hid_report_vendor;
 
     switch(instance) {
+        case ITF_NUM_HID_PASS:
+            return global_state.passthrough.desc;
         case ITF_NUM_HID:
             return desc_hid_report;
         case ITF_NUM_HID_REL_M:
-            return desc_hid_report_relmouse;
+            return desc_hid_report_relmouse_variant[RELMOUSE_VARIANT];
         default:
             return desc_hid_report;
     }
 }
 
-bool tud_mouse_report(uint8_t mode, uint8_t buttons, int16_t x, int16_t y, int8_t wheel, int8_t pan) {
-    mouse_report_t report = {.buttons = buttons, .wheel = wheel, .x = x, .y = y, .mode = mode, .pan = pan};
+/* A pen that's always in range, the left button touches down with the tip and the right one is the barrel switch */
+static bool tud_pen_report(uint8_t buttons, int16_t x, int16_t y) {
+    bool tip = buttons & MOUSE_BUTTON_LEFT;
+
+    touch_report_t report = {
+        .tip_pressure = tip ? 0xFF : 0,
+        .buttons      = PEN_IN_RANGE | (tip ? PEN_TIP : 0) | ((buttons & MOUSE_BUTTON_RIGHT) ? PEN_BARREL : 0),
+        .x            = x,
+        .y            = y,
+    };
+
+    return tud_hid_n_report(ITF_NUM_HID_REL_M, REPORT_ID_DIGITIZER, &report, sizeof(report));
+}
+
+bool tud_mouse_report(uint8_t mode, uint8_t buttons, int16_t x, int16_t y, int16_t wheel, int16_t pan) {
+    /* Pens don't scroll, that goes through the relative mouse. Without the pen (host enumerated
+       before the output was set to use it), the absolute mouse will have to do. */
+    if (mode == TOUCH) {
+        if (global_state.digitizer_active && !wheel && !pan)
+            return tud_pen_report(buttons, x, y);
+
+        mode = global_state.digitizer_active ? RELATIVE : ABSOLUTE;
+
+        if (mode == RELATIVE)
+            buttons = x = y = 0;
+    }
+
+    host_scroll_t *scroll = &global_state.host_scroll[mode == RELATIVE];
+    int16_t wheel_rest = scroll->wheel, pan_rest = scroll->pan;
     uint8_t instance = ITF_NUM_HID;
     uint8_t report_id = REPORT_ID_MOUSE;
 
+    hid_mouse_out_t report = {
+        .buttons = buttons,
+        .x       = x,
+        .y       = y,
+        .wheel   = scroll_to_host(wheel, scroll->multiplier & SCROLL_HIRES_WHEEL, &wheel_rest),
+        .pan     = scroll_to_host(pan, scroll->multiplier & SCROLL_HIRES_PAN, &pan_rest),
+    };
+
     if (mode == RELATIVE) {
         instance = ITF_NUM_HID_REL_M;
         report_id = REPORT_ID_RELMOUSE;
     }
 
-    return tud_hid_n_report(instance, report_id, &report, sizeof(report));
+    if (!tud_hid_n_report(instance, report_id, &report, sizeof(report)))
+        return false;
+
+    /* The leftover scrolling only counts once the report is on its way */
+    scroll->wheel = wheel_rest;
+    scroll->pan   = pan_rest;
+    return true;
 }
 
 
@@ -94,8 +159,10 @@ char const *string_desc_arr[] = {
     "DeskHop Helper",           // 4: Mouse Helper Interface
     "DeskHop Config",           // 5: Vendor Interface
     "DeskHop Disk",             // 6: Disk Interface
+    "DeskHop Bulk Config",      // 7: WebUSB Interface
+    "DeskHop Passthrough",      // 8: Mirrored Device Interface
 #ifdef DH_DEBUG
-    "DeskHop Debug",            // 7: Debug Interface
+    "DeskHop Debug",            // 9: Debug Interface
 #endif
 };
 
@@ -108,6 +175,8 @@ enum {
     STRID_MOUSE,
     STRID_VENDOR,
     STRID_DISK,
+    STRID_BULK,
+    STRID_PASS,
     STRID_DEBUG,
 };
 
@@ -164,28 +233,33 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 #define EPNUM_HID        0x81
 #define EPNUM_HID_REL_M  0x82
 #define EPNUM_HID_VENDOR 0x83
+#define EPNUM_HID_PASS   0x83 // Normal mode only, like the vendor one is config mode only
 
 #define EPNUM_MSC_OUT    0x04
 #define EPNUM_MSC_IN     0x84
 
+#define EPNUM_VENDOR_OUT 0x07
+#define EPNUM_VENDOR_IN  0x87
+
 #ifndef DH_DEBUG
 
 #define ITF_NUM_TOTAL 2
-#define ITF_NUM_TOTAL_CONFIG 4
+#define ITF_NUM_TOTAL_CONFIG 5
 #define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + 2 * TUD_HID_DESC_LEN)
-#define CONFIG_TOTAL_LEN_CFG (TUD_CONFIG_DESC_LEN + 3 * TUD_HID_DESC_LEN + TUD_MSC_DESC_LEN)
+#define CONFIG_TOTAL_LEN_CFG (TUD_CONFIG_DESC_LEN + 3 * TUD_HID_DESC_LEN + TUD_MSC_DESC_LEN + TUD_VENDOR_DESC_LEN)
 
 #else
 /* CDC uses 2 interfaces (control + data). In normal mode, place it right after
-   the 2 HID interfaces (at 2, 3). In config mode, place it after HID_VENDOR (2)
-   and MSC (3), so at 4, 5. */
+   the 2 HID interfaces (at 2, 3). In config mode, place it after HID_VENDOR (2),
+   MSC (3) and VENDOR (4), so at 5, 6. */
 #define ITF_NUM_CDC 2
-#define ITF_NUM_CDC_CONFIG 4
+#define ITF_NUM_CDC_CONFIG 5
 #define ITF_NUM_TOTAL 4
-#define ITF_NUM_TOTAL_CONFIG 6
+#define ITF_NUM_TOTAL_CONFIG 7
 
 #define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + 2 * TUD_HID_DESC_LEN + TUD_CDC_DESC_LEN)
-#define CONFIG_TOTAL_LEN_CFG (TUD_CONFIG_DESC_LEN + 3 * TUD_HID_DESC_LEN + TUD_MSC_DESC_LEN + TUD_CDC_DESC_LEN)
+#define CONFIG_TOTAL_LEN_CFG \
+    (TUD_CONFIG_DESC_LEN + 3 * TUD_HID_DESC_LEN + TUD_MSC_DESC_LEN + TUD_VENDOR_DESC_LEN + TUD_CDC_DESC_LEN)
 
 #define EPNUM_CDC_NOTIF  0x85
 #define EPNUM_CDC_OUT    0x06
@@ -194,31 +268,48 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 #endif
 
 
-uint8_t const desc_configuration[] = {
-    // Config number, interface count, string index, total length, attribute, power in mA
-    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 500),
-
-    // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID,
-                       STRID_PRODUCT,
-                       HID_ITF_PROTOCOL_NONE,
-                       sizeof(desc_hid_report),
-                       EPNUM_HID,
-                       CFG_TUD_HID_EP_BUFSIZE,
-                       1),
-
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID_REL_M,
-                       STRID_MOUSE,
-                       HID_ITF_PROTOCOL_NONE,
-                       sizeof(desc_hid_report_relmouse),
-                       EPNUM_HID_REL_M,
-                       CFG_TUD_HID_EP_BUFSIZE,
-                       1),
 #ifdef DH_DEBUG
-    // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
-    TUD_CDC_DESCRIPTOR(
-        ITF_NUM_CDC, STRID_DEBUG, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE),
+// Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+#define DESC_DEBUG_CDC(itf) \
+    TUD_CDC_DESCRIPTOR(itf, STRID_DEBUG, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE),
+#else
+#define DESC_DEBUG_CDC(itf)
 #endif
+
+/* Normal mode. The mouse helper interface's report descriptor is longer when it has the pen too. */
+#define DESC_CONFIGURATION(relmouse_len) {\
+    /* Config number, interface count, string index, total length, attribute, power in mA */\
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 500),\
+\
+    /* Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval */\
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID,\
+                       STRID_PRODUCT,\
+                       HID_ITF_PROTOCOL_NONE,\
+                       sizeof(desc_hid_report),\
+                       EPNUM_HID,\
+                       CFG_TUD_HID_EP_BUFSIZE,\
+                       1),\
+\
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID_REL_M,\
+                       STRID_MOUSE,\
+                       HID_ITF_PROTOCOL_NONE,\
+                       relmouse_len,\
+                       EPNUM_HID_REL_M,\
+                       CFG_TUD_HID_EP_BUFSIZE,\
+                       1),\
+    DESC_DEBUG_CDC(ITF_NUM_CDC)\
+}
+
+uint8_t const desc_configuration[] = DESC_CONFIGURATION(sizeof(desc_hid_report_relmouse));
+uint8_t const desc_configuration_pen[] = DESC_CONFIGURATION(sizeof(desc_hid_report_relmouse_pen));
+uint8_t const desc_configuration_gamepad[] = DESC_CONFIGURATION(sizeof(desc_hid_report_relmouse_gamepad));
+uint8_t const desc_configuration_pen_gamepad[] = DESC_CONFIGURATION(sizeof(desc_hid_report_relmouse_pen_gamepad));
+
+uint8_t const *const desc_configuration_variant[] = {
+    desc_configuration,
+    desc_configuration_pen,
+    desc_configuration_gamepad,
+    desc_configuration_pen_gamepad,
 };
 
 uint8_t const desc_configuration_config[] = {
@@ -255,6 +346,13 @@ uint8_t const desc_configuration_config[] = {
                        EPNUM_MSC_OUT,
                        EPNUM_MSC_IN,
                        64),
+
+    // Interface number, string index, EP Out & IN address, EP size
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR,
+                          STRID_BULK,
+                          EPNUM_VENDOR_OUT,
+                          EPNUM_VENDOR_IN,
+                          CFG_TUD_VENDOR_EPSIZE),
 #ifdef DH_DEBUG
     // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
     TUD_CDC_DESCRIPTOR(
@@ -262,11 +360,117 @@ uint8_t const desc_configuration_config[] = {
 #endif
 };
 
+/* Normal mode with a mirrored device as the last interface. Its report descriptor length is only
+   known once the device is plugged in, so this one is put together when our host asks for it. */
+static uint8_t desc_configuration_pass[CONFIG_TOTAL_LEN + TUD_HID_DESC_LEN];
+
+static uint8_t const *passthrough_configuration(uint8_t const *normal) {
+    tusb_desc_configuration_t *config = (tusb_desc_configuration_t *)desc_configuration_pass;
+
+    uint8_t const interface[] = {TUD_HID_DESCRIPTOR(ITF_NUM_TOTAL,
+                                                    STRID_PASS,
+                                                    HID_ITF_PROTOCOL_NONE,
+                                                    global_state.passthrough.desc_len,
+                                                    EPNUM_HID_PASS,
+                                                    CFG_TUD_HID_EP_BUFSIZE,
+                                                    1)};
+
+    memcpy(desc_configuration_pass, normal, CONFIG_TOTAL_LEN);
+    memcpy(&desc_configuration_pass[CONFIG_TOTAL_LEN], interface, sizeof(interface));
+
+    config->wTotalLength   = sizeof(desc_configuration_pass);
+    config->bNumInterfaces = ITF_NUM_TOTAL + 1;
+    return desc_configuration_pass;
+}
+
 uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
     (void)index; // for multiple configurations
+    uint8_t const *normal;
 
     if (global_state.config_mode_active)
         return desc_configuration_config;
-    else
-        return desc_configuration;
+
+    /* Reports for the gamepad and the mirrored device can be queued from now on */
+    global_state.gamepad_active      = global_state.gamepad.present;
+    global_state.passthrough.offered = global_state.passthrough.desc_len != 0;
+
+    normal = desc_configuration_variant[RELMOUSE_VARIANT];
+
+    if (global_state.passthrough.offered)
+        return passthrough_configuration(normal);
+
+    return normal;
+}
+
+//--------------------------------------------------------------------+
+// BOS Descriptor (config mode only, advertised through bcdUSB 2.1)
+//--------------------------------------------------------------------+
+
+/* Microsoft OS 2.0 descriptor set, makes Windows bind WinUSB to the bulk config
+   interface without any .inf, so the browser can reach it through WebUSB */
+#define MS_OS_20_DESC_LEN 0xB2
+
+uint8_t const desc_ms_os_20[] = {
+    // Set header: length, type, windows version, total length
+    U16_TO_U8S_LE(0x000A), U16_TO_U8S_LE(MS_OS_20_SET_HEADER_DESCRIPTOR), U32_TO_U8S_LE(0x06030000),
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN),
+
+    // Configuration subset header: length, type, configuration index, reserved, configuration total length
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_CONFIGURATION), 0, 0,
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A),
+
+    // Function subset header: length, type, first interface, reserved, subset length
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION), ITF_NUM_VENDOR, 0,
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08),
+
+    // Compatible ID descriptor: length, type, compatible ID, sub compatible ID
+    U16_TO_U8S_LE(0x0014), U16_TO_U8S_LE(MS_OS_20_FEATURE_COMPATBLE_ID),
+    'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+    // Registry property descriptor: length, type, property data type (REG_MULTI_SZ), property name length
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08 - 0x08 - 0x14), U16_TO_U8S_LE(MS_OS_20_FEATURE_REG_PROPERTY),
+    U16_TO_U8S_LE(0x0007), U16_TO_U8S_LE(0x002A),
+
+    // "DeviceInterfaceGUIDs" in UTF-16, null terminated
+    'D', 0, 'e', 0, 'v', 0, 'i', 0, 'c', 0, 'e', 0, 'I', 0, 'n', 0, 't', 0, 'e', 0, 'r', 0,
+    'f', 0, 'a', 0, 'c', 0, 'e', 0, 'G', 0, 'U', 0, 'I', 0, 'D', 0, 's', 0, 0, 0,
+
+    // Property data length, then "{C38E53BD-D85A-4188-9094-24727562EE73}" in UTF-16, double null terminated
+    U16_TO_U8S_LE(0x0050),
+    '{', 0, 'C', 0, '3', 0, '8', 0, 'E', 0, '5', 0, '3', 0, 'B', 0, 'D', 0, '-', 0, 'D', 0, '8', 0, '5', 0, 'A', 0,
+    '-', 0, '4', 0, '1', 0, '8', 0, '8', 0, '-', 0, '9', 0, '0', 0, '9', 0, '4', 0, '-', 0, '2', 0, '4', 0, '7', 0,
+    '2', 0, '7', 0, '5', 0, '6', 0, '2', 0, 'E', 0, 'E', 0, '7', 0, '3', 0, '}', 0, 0, 0, 0, 0,
+};
+
+TU_VERIFY_STATIC(sizeof(desc_ms_os_20) == MS_OS_20_DESC_LEN, "Incorrect MS OS 2.0 descriptor size");
+
+#define BOS_TOTAL_LEN (TUD_BOS_DESC_LEN + TUD_BOS_WEBUSB_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN)
+
+uint8_t const desc_bos[] = {
+    // Total length, number of device capabilities
+    TUD_BOS_DESCRIPTOR(BOS_TOTAL_LEN, 2),
+
+    // Vendor code, no landing page
+    TUD_BOS_WEBUSB_DESCRIPTOR(VENDOR_REQUEST_WEBUSB, 0),
+
+    // Descriptor set length, vendor code
+    TUD_BOS_MS_OS_20_DESCRIPTOR(MS_OS_20_DESC_LEN, VENDOR_REQUEST_MICROSOFT),
+};
+
+uint8_t const *tud_descriptor_bos_cb(void) {
+    return desc_bos;
+}
+
+/* The only vendor control request we serve is the MS OS 2.0 descriptor set (wIndex 7) */
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request) {
+    if (stage != CONTROL_STAGE_SETUP)
+        return true;
+
+    if (!global_state.config_mode_active)
+        return false;
+
+    if (request->bRequest == VENDOR_REQUEST_MICROSOFT && request->wIndex == 7)
+        return tud_control_xfer(rhport, request, (void *)(uintptr_t)desc_ms_os_20, sizeof(desc_ms_os_20));
+
+    return false;
 }
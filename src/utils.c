@@ -11,6 +11,9 @@
 
 #include "main.h"
 
+_Static_assert(sizeof(config_t) <= FLASH_SECTOR_SIZE,
+               "config_t must fit in its flash sector");
+
 /* ================================================== *
  * ==============  Checksum Functions  ============== *
  * ================================================== */
@@ -30,19 +33,120 @@ bool verify_checksum(const uart_packet_t *packet) {
     return checksum == packet->checksum;
 }
 
-uint32_t crc32_iter(uint32_t crc, const uint8_t byte) {
-    return crc32_lookup_table[(byte ^ crc) & 0xff] ^ (crc >> 8);
+/* ================================================== *
+ * ===============  Runtime Counters  =============== *
+ * ================================================== */
+
+/* Add to a queue, counting a full queue as a drop instead of silently losing the item */
+bool queue_add_counted(queue_t *queue, const void *item, enum stats_queue_e which) {
+    stats_t *stats = &global_state.stats;
+
+    if (!queue_try_add(queue, item)) {
+        stats->queue_drops[which]++;
+        return false;
+    }
+
+    uint16_t level = queue_get_level_unsafe(queue);
+
+    if (level > stats->queue_peak[which])
+        stats->queue_peak[which] = level;
+
+    return true;
 }
 
-/* TODO - use DMA sniffer's built-in CRC32 */
-uint32_t calc_crc32(const uint8_t *s, size_t n) {
-    uint32_t crc = 0xffffffff;
+/* ================================================== *
+ * ===============  CRC32 Functions  ================ *
+ * ================================================== */
+
+/* Tables 1-3 for slicing-by-4, table 0 is the regular crc32_lookup_table */
+static uint32_t crc32_slice_table[3][256];
+
+/* Regions at least this long are handed over to the DMA sniffer */
+#define CRC32_DMA_MIN_LENGTH 1024
+
+void crc32_init(void) {
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = crc32_lookup_table[i];
+
+        for (int slice = 0; slice < 3; slice++) {
+            crc = crc32_lookup_table[crc & 0xff] ^ (crc >> 8);
+            crc32_slice_table[slice][i] = crc;
+        }
+    }
+}
+
+/* Software fallback, processes 4 bytes per iteration instead of 1 */
+static uint32_t crc32_update_sw(uint32_t crc, const uint8_t *data, size_t length) {
+    const uint32_t *table = crc32_lookup_table;
+
+    for (; length >= 4; length -= 4, data += 4) {
+        crc ^= data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+
+        crc = crc32_slice_table[2][crc & 0xff] ^ crc32_slice_table[1][(crc >> 8) & 0xff]
+            ^ crc32_slice_table[0][(crc >> 16) & 0xff] ^ table[crc >> 24];
+    }
+
+    while (length--)
+        crc = table[(*data++ ^ crc) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+#if PICO_ON_DEVICE
+/* Feed word-aligned data through a DMA channel with the sniffer attached. The sniffer
+   in CRC32R mode computes the same reflected CRC32 as zlib, but keeps the accumulator
+   bit-reversed compared to our software state. */
+static uint32_t crc32_update_dma(uint32_t crc, const uint8_t *data, size_t length) {
+    static uint32_t sink;
+    int channel = dma_claim_unused_channel(false);
+
+    /* No free channel? No big deal, do it the slow way. */
+    if (channel < 0)
+        return crc32_update_sw(crc, data, length);
+
+    dma_channel_config config = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_sniff_enable(&config, true);
+
+    dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    dma_sniffer_set_data_accumulator(__rev(crc));
 
-    for(size_t i=0; i < n; i++) {
-        crc = crc32_iter(crc, s[i]);
+    dma_channel_configure(channel, &config, &sink, data, length / sizeof(uint32_t), true);
+    dma_channel_wait_for_finish_blocking(channel);
+
+    crc = __rev(dma_sniffer_get_data_accumulator());
+
+    dma_sniffer_disable();
+    dma_channel_unclaim(channel);
+
+    return crc;
+}
+#endif
+
+/* Takes the running (non-inverted) crc state, returns the updated one. Start with
+   CRC32_INIT and invert the result once everything was fed through. */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t length) {
+#if PICO_ON_DEVICE
+    if (length >= CRC32_DMA_MIN_LENGTH) {
+        /* Unaligned head goes through software, then DMA does the bulk word by word */
+        size_t head = (4 - ((uintptr_t)data & 3)) & 3;
+        crc = crc32_update_sw(crc, data, head);
+        data += head;
+        length -= head;
+
+        size_t bulk = length & ~3u;
+        crc = crc32_update_dma(crc, data, bulk);
+        data += bulk;
+        length -= bulk;
     }
+#endif
+    return crc32_update_sw(crc, data, length);
+}
 
-    return ~crc;
+uint32_t calc_crc32(const uint8_t *s, size_t n) {
+    return ~crc32_update(CRC32_INIT, s, n);
 }
 
 uint32_t calculate_firmware_crc32(void) {
@@ -53,22 +157,63 @@ uint32_t calculate_firmware_crc32(void) {
  * Flash and config functions
  * ================================================== */
 
+/* Erasing or programming stalls XIP for both cores. Our code runs from RAM, but the other core
+   can still be reading flash data (config.htm over MSC, the saved config), so it's parked in a
+   RAM handler with interrupts off until we're done. Returns false if it didn't respond in time. */
+typedef struct {
+    uint32_t offset;
+    size_t erase_len;     // Erased first, if nonzero
+    const uint8_t *data;  // Then programmed, if not NULL
+    size_t program_len;
+} flash_op_t;
+
+static void __no_inline_not_in_flash_func(flash_op_exec)(void *param) {
+    const flash_op_t *op = param;
+
+    if (op->erase_len)
+        flash_range_erase(op->offset, op->erase_len);
+
+    if (op->data)
+        flash_range_program(op->offset, op->data, op->program_len);
+}
+
+static bool flash_op(uint32_t offset, size_t erase_len, const uint8_t *data, size_t program_len) {
+    flash_op_t op = {.offset = offset, .erase_len = erase_len, .data = data, .program_len = program_len};
+
+    if (flash_safe_execute(flash_op_exec, &op, FLASH_SAFE_TIMEOUT_MS) == PICO_OK)
+        return true;
+
+    global_state.stats.flash_errors++;
+    return false;
+}
+
+bool erase_flash_range(uint32_t target_addr, size_t length) {
+    return flash_op(target_addr, length, NULL, 0);
+}
+
+bool program_flash_page(uint32_t target_addr, const uint8_t *buffer) {
+    return flash_op(target_addr, 0, buffer, FLASH_PAGE_SIZE);
+}
+
 void wipe_config(void) {
-    uint32_t ints = save_and_disable_interrupts();
-    flash_range_erase((uint32_t)ADDR_CONFIG - XIP_BASE, FLASH_SECTOR_SIZE);
-    restore_interrupts(ints);
+    erase_flash_range((uint32_t)ADDR_CONFIG - XIP_BASE, FLASH_SECTOR_SIZE);
 }
 
-void write_flash_page(uint32_t target_addr, uint8_t *buffer) {
+/* Uploaded image failed the checksum. Wipe its stage 2 bootloader, so it never boots, and rely on ROM
+   recovery. A failed erase only means the other core was busy, so it's tried again a few times. */
+void reject_firmware_image(void) {
+    for (int i = 0; i < FLASH_WIPE_ATTEMPTS; i++)
+        if (erase_flash_range((uint32_t)ADDR_FW_RUNNING - XIP_BASE, FLASH_SECTOR_SIZE))
+            break;
+
+    reset_usb_boot(1 << PICO_DEFAULT_LED_PIN, 0);
+}
+
+bool write_flash_page(uint32_t target_addr, uint8_t *buffer) {
     /* Start of sector == first 256-byte page in a 4096 byte block */
     bool is_sector_start = (target_addr & 0xf00) == 0;
 
-    uint32_t ints = save_and_disable_interrupts();
-    if (is_sector_start)
-        flash_range_erase(target_addr, FLASH_SECTOR_SIZE);
-
-    flash_range_program(target_addr, buffer, FLASH_PAGE_SIZE);
-    restore_interrupts(ints);
+    return flash_op(target_addr, is_sector_start ? FLASH_SECTOR_SIZE : 0, buffer, FLASH_PAGE_SIZE);
 }
 
 void load_config(device_t *state) {
@@ -93,21 +238,31 @@ void load_config(device_t *state) {
     /* On any condition failing, we fall back to default config */
     if (magic_header_fail || checksum_fail || version_fail)
         memcpy(running_config, &default_config, sizeof(config_t));
+
+    /* Hotkeys and the screen layout depend on config, so they need to be rebuilt */
+    build_keyboard_tables(state);
+    build_screen_layout(state);
 }
 
-void save_config(device_t *state) {
+bool save_config(device_t *state) {
     uint8_t *raw_config = (uint8_t *)&state->config;
 
     /* Calculate and update checksum, size without checksum */
     uint32_t checksum       = calc_crc32(raw_config, sizeof(config_t) - sizeof(uint32_t));
     state->config.checksum = checksum;
 
-    /* Copy the config to buffer and pad the rest with zeros */
-    memcpy(state->page_buffer, raw_config, sizeof(config_t));
-    memset(state->page_buffer + sizeof(config_t), 0, FLASH_PAGE_SIZE - sizeof(config_t));
+    /* Write the new config to flash, page by page. First one erases the sector, the last one is padded with zeros.
+       If a page doesn't go through, the rest would land on flash that may not be erased, so we stop there. */
+    for (uint32_t offset = 0; offset < sizeof(config_t); offset += FLASH_PAGE_SIZE) {
+        uint32_t len = MIN(FLASH_PAGE_SIZE, sizeof(config_t) - offset);
+
+        memset(state->page_buffer, 0, FLASH_PAGE_SIZE);
+        memcpy(state->page_buffer, raw_config + offset, len);
 
-    /* Write the new config to flash */
-    write_flash_page((uint32_t)ADDR_CONFIG - XIP_BASE, state->page_buffer);
+        if (!write_flash_page((uint32_t)ADDR_CONFIG - XIP_BASE + offset, state->page_buffer))
+            return false;
+    }
+    return true;
 }
 
 void reset_config_timer(device_t *state) {
@@ -146,24 +301,24 @@ void request_byte(device_t *state, uint32_t address) {
     };
     state->fw.byte_done = false;
 
-    queue_try_add(&global_state.uart_tx_queue, &packet);
+    queue_add_counted(&global_state.uart_tx_queue, &packet, STATS_UART_QUEUE);
 }
 
 void reboot(void) {
     *((volatile uint32_t*)(PPB_BASE + 0x0ED0C)) = 0x5FA0004;
 }
 
-bool is_start_of_packet(device_t *state) {
-    return (uart_rxbuf[state->dma_ptr] == START1 && uart_rxbuf[NEXT_RING_IDX(state->dma_ptr)] == START2);
+bool is_start_of_packet(const uint8_t *ring, uint32_t ptr) {
+    return (ring[ptr] == START1 && ring[NEXT_RING_IDX(ptr)] == START2);
 }
 
-uint32_t get_ptr_delta(uint32_t current_pointer, device_t *state) {
+uint32_t get_ptr_delta(uint32_t current_pointer, uint32_t ptr) {
     uint32_t delta;
 
-    if (current_pointer >= state->dma_ptr)
-        delta = current_pointer - state->dma_ptr;
+    if (current_pointer >= ptr)
+        delta = current_pointer - ptr;
     else
-        delta = DMA_RX_BUFFER_SIZE - state->dma_ptr + current_pointer;
+        delta = DMA_RX_BUFFER_SIZE - ptr + current_pointer;
 
     /* Clamp to 12 bits since it can never be bigger */
     delta = delta & 0x3FF;
@@ -171,15 +326,15 @@ uint32_t get_ptr_delta(uint32_t current_pointer, device_t *state) {
     return delta;
 }
 
-void fetch_packet(device_t *state) {
-    uint8_t *dst = (uint8_t *)&state->in_packet;
+void fetch_packet(const uint8_t *ring, uint32_t *ptr, uart_packet_t *packet) {
+    uint8_t *dst = (uint8_t *)packet;
 
     for (int i = 0; i < RAW_PACKET_LENGTH; i++) {
         /* Skip the header preamble */
         if (i >= START_LENGTH)
-            dst[i - START_LENGTH] = uart_rxbuf[state->dma_ptr];
+            dst[i - START_LENGTH] = ring[*ptr];
 
-        state->dma_ptr = NEXT_RING_IDX(state->dma_ptr);
+        *ptr = NEXT_RING_IDX(*ptr);
     }
 }
 
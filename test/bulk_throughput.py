@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+#
+# Drives the mocked device with misc/bulk_api.py: full reads, atomic writes, polling for changes,
+# and how long a full read takes over bulk compared to the HID API on a full speed bus.
+# Usage: bulk_throughput.py <mock_device binary> <misc/bulk_api.py> <api_fields.h>
+
+import importlib.util
+import math
+import struct
+import sys
+import time
+
+# Full speed: 1 ms frames, at most 19 bulk packets of 64 bytes in one on an idle bus. A reply can
+# go out in the frame after the request at the earliest.
+FRAME_MS = 1
+PACKET_SIZE = 64
+PACKETS_PER_FRAME = 19
+
+# HID: one SET_REPORT asking for everything, then a 12 byte report per field. They go out from
+# process_hid_queue_task, which runs at 1 kHz, on an endpoint polled every 1 ms.
+HID_MS_PER_FIELD = 1
+
+mock, library, fields_header = sys.argv[1:4]
+
+spec = importlib.util.spec_from_file_location("bulk_api", library)
+bulk_api = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(bulk_api)
+
+failures = 0
+
+
+def check(condition, what):
+    global failures
+    if not condition:
+        print(f"FAIL: {what}")
+        failures += 1
+
+
+def transfer_ms(length):
+    return FRAME_MS * math.ceil(math.ceil(max(length, 1) / PACKET_SIZE) / PACKETS_PER_FRAME)
+
+
+class TimedTransport(bulk_api.PipeTransport):
+    """Adds up what the transfers would take on the bus."""
+
+    def __init__(self, command):
+        super().__init__(command)
+        self.bus_ms = 0
+
+    def transfer(self, request):
+        reply = super().transfer(request)
+        self.bus_ms += transfer_ms(len(request)) + FRAME_MS + transfer_ms(len(reply))
+        return reply
+
+
+fields = bulk_api.load_fields(fields_header)
+transport = TimedTransport([mock])
+client = bulk_api.BulkClient(transport)
+
+# Full read, every field comes back once, at its declared length
+start = time.perf_counter()
+version, values = client.get()
+wall_ms = (time.perf_counter() - start) * 1000
+
+check(set(values) == set(fields), "full read has every field")
+check(all(len(values[idx]) == fields[idx].len for idx in values), "field lengths match api_fields.h")
+check(client.transfers > 1, "full read takes more than one page")
+
+bulk_ms, pages = transport.bus_ms, client.transfers
+hid_ms = FRAME_MS + len(fields) * HID_MS_PER_FIELD
+
+print(f"full read: {len(values)} fields, {pages} transfers, {client.bytes} bytes")
+print(f"  bulk {bulk_ms} ms on the bus ({wall_ms:.1f} ms against the mock), HID {hid_ms} ms")
+check(bulk_ms * 10 <= hid_ms, "bulk reads at least 10x faster than HID")
+
+# Nothing changed, polling returns nothing
+polled, values = client.get(since=version)
+check(values == {} and polled == version, "poll without changes is empty")
+
+# Write a field, read it back, then poll for it
+speed = next(f for f in fields.values() if f.member == "config.output[0].speed_x")
+old = speed.decode(client.get([speed.idx])[1][speed.idx])
+
+client.write({speed.idx: speed.encode(old + 7)})
+check(speed.decode(client.get([speed.idx])[1][speed.idx]) == old + 7, "written value reads back")
+
+polled, values = client.get(since=version)
+check(set(values) == {speed.idx} and polled > version, "poll returns just the written field")
+
+# One bad record and nothing is applied
+readonly = next(f for f in fields.values() if f.readonly)
+try:
+    client.write({speed.idx: speed.encode(old), readonly.idx: bytes(readonly.len)})
+    check(False, "write with a read-only field is rejected")
+except bulk_api.BulkError as error:
+    check(error.status == 4, "rejected as read-only")
+
+check(speed.decode(client.get([speed.idx])[1][speed.idx]) == old + 7, "rejected write changed nothing")
+
+# Unknown field
+try:
+    client.get([255])
+    check(False, "unknown field is rejected")
+except bulk_api.BulkError as error:
+    check(error.status == 3, "rejected as unknown field")
+
+# Write and save, a round trip of the whole writable config
+writable = {idx: value for idx, value in client.get()[1].items() if not fields[idx].readonly}
+payload = list(writable.items())
+for start in range(0, len(payload), 40):
+    client.write(dict(payload[start:start + 40]), save=True)
+
+check(client.get(list(writable))[1] == writable, "whole config written back unchanged")
+
+transport.close()
+print("bulk_throughput:", "failed" if failures else "passed")
+sys.exit(1 if failures else 0)
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+#
+# Compares the firmware CRC32 with binascii, the way misc/crc32.py computes it at build time.
+# Usage: crc32_check.py <test_crc32 binary> <misc/crc32.py>
+
+import binascii
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+
+IMAGE_SIZE = 256 * 1024
+FIRMWARE_VERSION = 1178
+
+test_binary, crc32_script = sys.argv[1], sys.argv[2]
+image = random.Random(26).randbytes(IMAGE_SIZE)
+failures = 0
+
+with tempfile.TemporaryDirectory() as tmp:
+    image_path, metadata_path = f"{tmp}/deskhop.bin", f"{tmp}/deskhop.crc"
+
+    with open(image_path, "wb") as f:
+        f.write(image)
+
+    subprocess.run([sys.executable, crc32_script, image_path, metadata_path, str(FIRMWARE_VERSION)], check=True)
+
+    with open(metadata_path, "rb") as f:
+        magic, version, expected = struct.unpack("<IHI", f.read())
+
+    output = subprocess.run([test_binary, image_path], check=True, capture_output=True, text=True).stdout
+
+for line in output.splitlines():
+    fields = line.split()
+
+    if fields[0] == "firmware":
+        got, want = int(fields[1], 16), expected
+    else:
+        offset, length, got = int(fields[0]), int(fields[1]), int(fields[2], 16)
+        want = binascii.crc32(image[offset:offset + length])
+
+    if got != want:
+        print(f"FAIL {line}: expected {want:08x}")
+        failures += 1
+
+print(f"crc32 vs binascii: {len(output.splitlines())} values, {'FAILED' if failures else 'passed'}")
+sys.exit(1 if failures else 0)
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+#
+# Reads the config mode disk with mtools, the same way an OS would mount it.
+# Usage: fat_mtools.py <test_fat binary>. Exits with 77 (skipped) if mtools isn't installed.
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+SKIP = 77
+
+if not shutil.which("mdir") or not shutil.which("mcopy"):
+    print("mtools not found, skipping")
+    sys.exit(SKIP)
+
+test_binary = sys.argv[1]
+failures = 0
+
+with tempfile.TemporaryDirectory() as tmp:
+    image = os.path.join(tmp, "deskhop.img")
+    subprocess.run([test_binary, image], check=True)
+
+    env = dict(os.environ, MTOOLS_SKIP_CHECK="1")
+    listing = subprocess.run(["mdir", "-i", image, "-b", "::"], check=True, capture_output=True, text=True, env=env).stdout
+    names = sorted(os.path.basename(line).lower() for line in listing.split())
+
+    if names != ["config.htm", "config.txt", "status.txt", "version.txt"]:
+        print(f"FAIL unexpected files: {names}")
+        failures += 1
+
+    for name in names:
+        data = subprocess.run(["mcopy", "-i", image, "-n", f"::{name}", "-"], check=True, capture_output=True, env=env).stdout
+
+        # fsck-style consistency is on mtools, we check what comes out is whole
+        if name.endswith(".txt") and not data.endswith(b"\r\n"):
+            print(f"FAIL {name} is cut off")
+            failures += 1
+
+        if name == "config.txt":
+            fields = [line.split(b" = ") for line in data.split(b"\r\n") if line]
+            if not fields or any(len(f) != 2 or not f[0].isdigit() for f in fields):
+                print("FAIL config.txt lines aren't 'index = value'")
+                failures += 1
+            print(f"config.txt: {len(fields)} fields, {len(data)} bytes")
+
+    check = subprocess.run(["mdir", "-i", image, "::"], capture_output=True, text=True, env=env)
+    if check.returncode:
+        print(f"FAIL mdir: {check.stderr}")
+        failures += 1
+
+print(f"fat via mtools: {'FAILED' if failures else 'passed'}")
+sys.exit(1 if failures else 0)
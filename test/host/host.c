@@ -0,0 +1,321 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+
+/*==============================================================================
+ *  Virtual clock, cores
+ *==============================================================================*/
+
+uint64_t host_time_us = 1000000;
+int host_lockout_depth = 0;
+uint host_core = 0;
+
+uint8_t host_ppb[0x10000];
+
+void sleep_ms(uint32_t ms) {
+    host_time_us += (uint64_t)ms * 1000;
+}
+
+void sleep_us(uint64_t us) {
+    host_time_us += us;
+}
+
+void busy_wait_us(uint64_t us) {
+    host_time_us += us;
+}
+
+void busy_wait_us_32(uint32_t us) {
+    host_time_us += us;
+}
+
+void tight_loop_contents(void) {}
+
+void multicore_launch_core1(void (*entry)(void)) { (void)entry; }
+void multicore_reset_core1(void) {}
+void multicore_lockout_victim_init(void) {}
+
+void multicore_lockout_start_blocking(void) {
+    host_lockout_depth++;
+}
+
+void multicore_lockout_end_blocking(void) {
+    host_lockout_depth--;
+}
+
+bool multicore_lockout_victim_is_initialized(uint core) {
+    (void)core;
+    return true;
+}
+
+/*==============================================================================
+ *  Queue, same semantics as pico/util/queue.c (one slot kept empty)
+ *==============================================================================*/
+
+void queue_init(queue_t *q, uint element_size, uint element_count) {
+    q->data          = calloc(element_count + 1, element_size);
+    q->element_size  = (uint16_t)element_size;
+    q->element_count = (uint16_t)element_count;
+    q->wptr = q->rptr = 0;
+}
+
+void queue_free(queue_t *q) {
+    free(q->data);
+    q->data = NULL;
+}
+
+uint queue_get_level_unsafe(queue_t *q) {
+    int32_t level = (int32_t)q->wptr - (int32_t)q->rptr;
+    return level < 0 ? (uint)(level + q->element_count + 1) : (uint)level;
+}
+
+uint queue_get_level(queue_t *q) {
+    return queue_get_level_unsafe(q);
+}
+
+bool queue_is_empty(queue_t *q) {
+    return queue_get_level(q) == 0;
+}
+
+bool queue_is_full(queue_t *q) {
+    return queue_get_level(q) == q->element_count;
+}
+
+static uint16_t queue_next(queue_t *q, uint16_t ptr) {
+    return ++ptr > q->element_count ? 0 : ptr;
+}
+
+bool queue_try_add(queue_t *q, const void *data) {
+    if (queue_is_full(q))
+        return false;
+
+    memcpy(q->data + q->wptr * q->element_size, data, q->element_size);
+    q->wptr = queue_next(q, q->wptr);
+    return true;
+}
+
+bool queue_try_peek(queue_t *q, void *data) {
+    if (queue_is_empty(q))
+        return false;
+
+    if (data)
+        memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+    return true;
+}
+
+bool queue_try_remove(queue_t *q, void *data) {
+    if (!queue_try_peek(q, data))
+        return false;
+
+    q->rptr = queue_next(q, q->rptr);
+    return true;
+}
+
+void queue_add_blocking(queue_t *q, const void *data) {
+    if (!queue_try_add(q, data))
+        host_fail(__FILE__, __LINE__, "queue_add_blocking on a full queue would hang");
+}
+
+void queue_remove_blocking(queue_t *q, void *data) {
+    if (!queue_try_remove(q, data))
+        host_fail(__FILE__, __LINE__, "queue_remove_blocking on an empty queue would hang");
+}
+
+/*==============================================================================
+ *  Flash, NOR semantics: erase sets bits, programming can only clear them
+ *==============================================================================*/
+
+uint8_t host_flash[HOST_FLASH_SIZE] __attribute__((aligned(FLASH_SECTOR_SIZE)));
+
+host_flash_stats_t host_flash_stats;
+bool host_flash_timing = false;
+void (*host_flash_hook)(bool erase, uint32_t offset, size_t count) = NULL;
+uint32_t host_lockout_victims = 0;
+int host_flash_safe_timeouts = 0;
+
+/* Flash starts out erased */
+__attribute__((constructor)) static void host_flash_init(void) {
+    memset(host_flash, 0xFF, sizeof(host_flash));
+}
+
+void flash_range_erase(uint32_t offset, size_t count) {
+    if (offset % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE || offset + count > HOST_FLASH_SIZE)
+        host_fail(__FILE__, __LINE__, "flash_range_erase misaligned or out of range");
+
+    if (host_flash_hook)
+        host_flash_hook(true, offset, count);
+
+    memset(&host_flash[offset], 0xFF, count);
+    host_flash_stats.erased_sectors += count / FLASH_SECTOR_SIZE;
+
+    if (!host_flash_timing)
+        return;
+
+    for (uint32_t end = offset + count; offset < end;) {
+        bool block = offset % FLASH_BLOCK_SIZE == 0 && end - offset >= FLASH_BLOCK_SIZE;
+
+        host_time_us += block ? HOST_FLASH_BLOCK_ERASE_US : HOST_FLASH_SECTOR_ERASE_US;
+        offset += block ? FLASH_BLOCK_SIZE : FLASH_SECTOR_SIZE;
+    }
+}
+
+void flash_range_program(uint32_t offset, const uint8_t *data, size_t count) {
+    if (offset % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE || offset + count > HOST_FLASH_SIZE)
+        host_fail(__FILE__, __LINE__, "flash_range_program misaligned or out of range");
+
+    if (host_flash_hook)
+        host_flash_hook(false, offset, count);
+
+    for (size_t i = 0; i < count; i++)
+        host_flash[offset + i] &= data[i];
+
+    host_flash_stats.programmed_pages += count / FLASH_PAGE_SIZE;
+
+    if (host_flash_timing)
+        host_time_us += (count / FLASH_PAGE_SIZE) * HOST_FLASH_PAGE_PROGRAM_US;
+}
+
+bool flash_safe_execute_core_init(void) {
+    host_lockout_victims |= 1u << host_core;
+    return true;
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t timeout_ms) {
+    if (!(host_lockout_victims & (1u << (host_core ^ 1))) || host_flash_safe_timeouts > 0) {
+        host_flash_safe_timeouts -= host_flash_safe_timeouts > 0;
+        host_time_us += (uint64_t)timeout_ms * 1000;
+        return PICO_ERROR_TIMEOUT;
+    }
+
+    uint64_t start = host_time_us;
+
+    host_lockout_depth++;
+    func(param);
+    host_lockout_depth--;
+
+    host_flash_stats.safe_calls++;
+    host_flash_stats.longest_lockout_us = MAX(host_flash_stats.longest_lockout_us, host_time_us - start);
+
+    return PICO_OK;
+}
+
+/*==============================================================================
+ *  DMA, UART, GPIO and friends do nothing
+ *==============================================================================*/
+
+static dma_hw_t host_dma;
+static watchdog_hw_t host_watchdog;
+static io_qspi_hw_t host_ioqspi;
+static sio_hw_t host_sio;
+static uart_hw_t host_uart[2];
+
+dma_hw_t *dma_hw           = &host_dma;
+watchdog_hw_t *watchdog_hw = &host_watchdog;
+io_qspi_hw_t *ioqspi_hw    = &host_ioqspi;
+sio_hw_t *sio_hw           = &host_sio;
+
+struct uart_inst {
+    int index;
+};
+
+static uart_inst_t host_uart_inst[2] = {{0}, {1}};
+uart_inst_t *const uart0 = &host_uart_inst[0];
+uart_inst_t *const uart1 = &host_uart_inst[1];
+
+static int host_dma_next;
+
+int dma_claim_unused_channel(bool required) {
+    (void)required;
+    return host_dma_next < 12 ? host_dma_next++ : -1;
+}
+
+void dma_channel_unclaim(uint channel) { (void)channel; }
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    return (dma_channel_config){0};
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { (void)c; (void)size; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) { (void)c; (void)dreq; }
+void channel_config_set_ring(dma_channel_config *c, bool write, uint bits) { (void)c; (void)write; (void)bits; }
+void channel_config_set_chain_to(dma_channel_config *c, uint chain) { (void)c; (void)chain; }
+void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff) { (void)c; (void)sniff; }
+void channel_config_set_irq_quiet(dma_channel_config *c, bool quiet) { (void)c; (void)quiet; }
+
+void dma_channel_configure(uint channel, const dma_channel_config *c, volatile void *write,
+                           const volatile void *read, uint count, bool trigger) {
+    (void)c; (void)trigger;
+    host_dma.ch[channel].write_addr     = (uint32_t)(uintptr_t)write;
+    host_dma.ch[channel].read_addr      = (uint32_t)(uintptr_t)read;
+    host_dma.ch[channel].transfer_count = count;
+}
+
+void dma_channel_start(uint channel) { (void)channel; }
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read, uint32_t count) { (void)channel; (void)read; (void)count; }
+bool dma_channel_is_busy(uint channel) { (void)channel; return false; }
+void dma_channel_wait_for_finish_blocking(uint channel) { (void)channel; }
+void dma_sniffer_enable(uint channel, uint mode, bool force) { (void)channel; (void)mode; (void)force; }
+void dma_sniffer_disable(void) {}
+void dma_sniffer_set_data_accumulator(uint32_t seed) { host_dma.sniff_data = seed; }
+uint32_t dma_sniffer_get_data_accumulator(void) { return host_dma.sniff_data; }
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart) { return &host_uart[uart->index]; }
+uint uart_get_dreq(uart_inst_t *uart, bool tx) { (void)uart; (void)tx; return 0; }
+uint uart_init(uart_inst_t *uart, uint baud) { (void)uart; return baud; }
+uint uart_set_baudrate(uart_inst_t *uart, uint baud) { (void)uart; return baud; }
+void uart_set_format(uart_inst_t *uart, uint data, uint stop, uart_parity_t parity) { (void)uart; (void)data; (void)stop; (void)parity; }
+void uart_set_hw_flow(uart_inst_t *uart, bool cts, bool rts) { (void)uart; (void)cts; (void)rts; }
+void uart_set_fifo_enabled(uart_inst_t *uart, bool enabled) { (void)uart; (void)enabled; }
+void uart_set_translate_crlf(uart_inst_t *uart, bool translate) { (void)uart; (void)translate; }
+
+void gpio_init(uint gpio) { (void)gpio; }
+void gpio_set_function(uint gpio, enum gpio_function fn) { (void)gpio; (void)fn; }
+void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+bool gpio_get(uint gpio) { (void)gpio; return true; }
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_pull_down(uint gpio) { (void)gpio; }
+void gpio_disable_pulls(uint gpio) { (void)gpio; }
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) { (void)delay_ms; (void)pause_on_debug; }
+void watchdog_update(void) {}
+
+void reset_usb_boot(uint32_t gpio_mask, uint32_t disable_mask) { (void)gpio_mask; (void)disable_mask; }
+
+void pico_get_unique_board_id_string(char *id, uint len) {
+    snprintf(id, len, "E660583883944A2B");
+}
+
+void stdio_init_all(void) {}
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) { (void)freq_khz; (void)required; return true; }
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) { (void)num; (void)handler; }
+void irq_set_enabled(uint num, bool enabled) { (void)num; (void)enabled; }
+
+/*==============================================================================
+ *  Test helpers
+ *==============================================================================*/
+
+int host_failures = 0;
+
+void host_fail(const char *file, int line, const char *what) {
+    printf("FAIL %s:%d %s\n", file, line, what);
+    host_failures++;
+}
+
+int host_result(const char *name) {
+    printf("%s: %s\n", name, host_failures ? "FAILED" : "passed");
+    return host_failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include "pico_host.h"
+
+/*==============================================================================
+ *  Test side of the host build: checks, flash simulation knobs, USB capture
+ *==============================================================================*/
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond))                                                                               \
+            host_fail(__FILE__, __LINE__, #cond);                                                  \
+    } while (0)
+
+extern int host_failures;
+
+void host_fail(const char *file, int line, const char *what);
+int host_result(const char *name);
+
+/* Datasheet typicals for the W25Q16JV on the Pico, charged to the virtual clock when enabled.
+   Like the boot ROM, aligned 64k blocks are erased with the block erase command. */
+#define HOST_FLASH_SECTOR_ERASE_US 45000
+#define HOST_FLASH_BLOCK_ERASE_US  150000
+#define HOST_FLASH_PAGE_PROGRAM_US 400
+
+typedef struct {
+    uint32_t erased_sectors;
+    uint32_t programmed_pages;
+    uint32_t safe_calls;        // flash_safe_execute() calls that went through
+    uint64_t longest_lockout_us; // Longest time the other core was kept off flash
+} host_flash_stats_t;
+
+extern host_flash_stats_t host_flash_stats;
+extern bool host_flash_timing;
+
+/* Bit per core that called flash_safe_execute_core_init(). Without the other core in here,
+   flash_safe_execute() times out, like on the device. */
+extern uint32_t host_lockout_victims;
+
+/* The next this many flash_safe_execute() calls time out anyway */
+extern int host_flash_safe_timeouts;
+
+/* Called before every erase or program, so a test can check who is running and who's locked out */
+extern void (*host_flash_hook)(bool erase, uint32_t offset, size_t count);
+
+/*==============================================================================
+ *  USB: what the firmware sends to the PC is recorded, vendor reads come from a buffer
+ *==============================================================================*/
+
+#define HOST_REPORTS_MAX 4096
+#define HOST_VENDOR_MAX  16384
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t instance;
+    uint8_t report_id;
+    uint16_t len;
+    uint8_t data[64];
+} host_report_t;
+
+extern host_report_t host_reports[HOST_REPORTS_MAX];
+extern int host_report_count;
+extern bool host_hid_ready; // What tud_hid_n_ready() answers
+
+/* Called once a HID report is recorded, so a test can act as the other core meanwhile */
+extern void (*host_report_hook)(uint8_t instance);
+
+/* Bytes the firmware wrote to the vendor (bulk) interface, and bytes waiting to be read from it */
+extern uint8_t host_vendor_tx[HOST_VENDOR_MAX];
+extern uint32_t host_vendor_tx_len;
+extern uint8_t host_vendor_rx[HOST_VENDOR_MAX];
+extern uint32_t host_vendor_rx_len;
+
+void host_usb_reset(void);
+
+/* Last SET_REPORT sent to an attached device, and whether its control pipe takes one */
+extern host_report_t host_set_report;
+extern bool host_control_ready;
@@ -0,0 +1,328 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*==============================================================================
+ *  Host stand-in for the bits of the Pico SDK the firmware uses
+ *  The firmware sources are compiled as they are, against these declarations
+ *  instead of the SDK's. Flash is a RAM array, time is a virtual clock the
+ *  test moves forward, the other hardware does nothing. See host.c.
+ *==============================================================================*/
+
+#define __not_in_flash_func(name) name
+#define __no_inline_not_in_flash_func(name) name
+#define __time_critical_func(name) name
+#define __in_flash(group)
+#define __isr
+#define __unused __attribute__((unused))
+#define __packed __attribute__((packed))
+#define __aligned(x) __attribute__((aligned(x)))
+#define __force_inline inline __attribute__((always_inline))
+#define __noinline __attribute__((noinline))
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#define PICO_OK 0
+
+#ifndef MIN
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef unsigned int irq_num_t;
+typedef void (*irq_handler_t)(void);
+
+/*==============================================================================
+ *  Time
+ *==============================================================================*/
+
+extern uint64_t host_time_us;
+
+static inline uint64_t time_us_64(void) {
+    return host_time_us;
+}
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)host_time_us;
+}
+
+static inline absolute_time_t get_absolute_time(void) {
+    return host_time_us;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+void sleep_ms(uint32_t);
+void sleep_us(uint64_t);
+void busy_wait_us(uint64_t);
+void busy_wait_us_32(uint32_t);
+
+/*==============================================================================
+ *  Queue
+ *==============================================================================*/
+
+typedef struct {
+    uint8_t *data;
+    uint16_t wptr;
+    uint16_t rptr;
+    uint16_t element_size;
+    uint16_t element_count;
+} queue_t;
+
+void queue_init(queue_t *, uint, uint);
+void queue_free(queue_t *);
+uint queue_get_level_unsafe(queue_t *);
+uint queue_get_level(queue_t *);
+bool queue_is_empty(queue_t *);
+bool queue_is_full(queue_t *);
+bool queue_try_add(queue_t *, const void *);
+bool queue_try_remove(queue_t *, void *);
+bool queue_try_peek(queue_t *, void *);
+void queue_add_blocking(queue_t *, const void *);
+void queue_remove_blocking(queue_t *, void *);
+
+/*==============================================================================
+ *  Sync, cores
+ *==============================================================================*/
+
+typedef struct critical_section {
+    int unused;
+} critical_section_t;
+
+struct semaphore {
+    int permits;
+};
+
+struct mutex {
+    int owner;
+};
+
+typedef struct semaphore semaphore_t;
+typedef struct mutex mutex_t;
+
+static inline void critical_section_init(critical_section_t *c) { (void)c; }
+static inline void critical_section_deinit(critical_section_t *c) { (void)c; }
+static inline void critical_section_enter_blocking(critical_section_t *c) { (void)c; }
+static inline void critical_section_exit(critical_section_t *c) { (void)c; }
+
+static inline void sem_init(semaphore_t *s, int16_t initial, int16_t max) { (void)max; s->permits = initial; }
+static inline void sem_release(semaphore_t *s) { s->permits++; }
+static inline bool sem_acquire_timeout_ms(semaphore_t *s, uint32_t ms) { (void)ms; return s->permits > 0 && s->permits--; }
+static inline void sem_reset(semaphore_t *s, int16_t permits) { s->permits = permits; }
+static inline void mutex_init(mutex_t *m) { m->owner = 0; }
+static inline bool mutex_enter_timeout_ms(mutex_t *m, uint32_t ms) { (void)m; (void)ms; return true; }
+static inline void mutex_exit(mutex_t *m) { (void)m; }
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+/* Memory barriers only keep the compiler from moving accesses on the host */
+static inline void __dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __dsb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __isb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __sev(void) {}
+static inline void __wfe(void) {}
+static inline void __compiler_memory_barrier(void) { __asm__ volatile("" ::: "memory"); }
+
+extern int host_lockout_depth; // Above 0 while the other core is held off flash
+extern uint host_core;         // Core the code under test pretends to run on
+
+static inline uint get_core_num(void) {
+    return host_core;
+}
+
+void multicore_launch_core1(void (*)(void));
+void multicore_reset_core1(void);
+void multicore_lockout_victim_init(void);
+void multicore_lockout_start_blocking(void);
+void multicore_lockout_end_blocking(void);
+bool multicore_lockout_victim_is_initialized(uint);
+
+/*==============================================================================
+ *  Flash
+ *==============================================================================*/
+
+#define FLASH_PAGE_SIZE   (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define FLASH_BLOCK_SIZE  (1u << 16)
+#define HOST_FLASH_SIZE   (2u * 1024 * 1024)
+
+extern uint8_t host_flash[HOST_FLASH_SIZE];
+
+/* Code does (uint32_t)ADDR_... - XIP_BASE, tests are linked without PIE so flash sits below 4 GB */
+#define XIP_BASE ((uint32_t)(uintptr_t)host_flash)
+
+void flash_range_erase(uint32_t, size_t);
+void flash_range_program(uint32_t, const uint8_t *, size_t);
+int flash_safe_execute(void (*)(void *), void *, uint32_t);
+bool flash_safe_execute_core_init(void);
+
+#define PICO_ERROR_TIMEOUT -1
+
+/*==============================================================================
+ *  DMA
+ *==============================================================================*/
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+
+typedef struct {
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+    volatile uint32_t al1_ctrl;
+    volatile uint32_t al1_read_addr;
+    volatile uint32_t al1_write_addr;
+    volatile uint32_t al1_transfer_count_trig;
+    volatile uint32_t al2_ctrl;
+    volatile uint32_t al2_transfer_count;
+    volatile uint32_t al2_read_addr;
+    volatile uint32_t al2_write_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    dma_channel_hw_t ch[12];
+    volatile uint32_t sniff_ctrl;
+    volatile uint32_t sniff_data;
+} dma_hw_t;
+
+extern dma_hw_t *dma_hw;
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+#define DREQ_FORCE 0x3f
+
+int dma_claim_unused_channel(bool);
+void dma_channel_unclaim(uint);
+dma_channel_config dma_channel_get_default_config(uint);
+void channel_config_set_transfer_data_size(dma_channel_config *, enum dma_channel_transfer_size);
+void channel_config_set_read_increment(dma_channel_config *, bool);
+void channel_config_set_write_increment(dma_channel_config *, bool);
+void channel_config_set_dreq(dma_channel_config *, uint);
+void channel_config_set_ring(dma_channel_config *, bool, uint);
+void channel_config_set_chain_to(dma_channel_config *, uint);
+void channel_config_set_sniff_enable(dma_channel_config *, bool);
+void channel_config_set_irq_quiet(dma_channel_config *, bool);
+void dma_channel_configure(uint, const dma_channel_config *, volatile void *, const volatile void *, uint, bool);
+void dma_channel_start(uint);
+void dma_channel_transfer_from_buffer_now(uint, const volatile void *, uint32_t);
+bool dma_channel_is_busy(uint);
+void dma_channel_wait_for_finish_blocking(uint);
+void dma_sniffer_enable(uint, uint, bool);
+void dma_sniffer_disable(void);
+void dma_sniffer_set_data_accumulator(uint32_t);
+uint32_t dma_sniffer_get_data_accumulator(void);
+
+static inline dma_channel_hw_t *dma_channel_hw_addr(uint channel) {
+    return &dma_hw->ch[channel];
+}
+
+/*==============================================================================
+ *  UART, GPIO, watchdog, misc
+ *==============================================================================*/
+
+typedef struct {
+    volatile uint32_t dr;
+    volatile uint32_t rsr;
+    uint32_t _pad[4];
+    volatile uint32_t fr;
+} uart_hw_t;
+
+typedef struct uart_inst uart_inst_t;
+typedef enum { UART_PARITY_NONE, UART_PARITY_EVEN, UART_PARITY_ODD } uart_parity_t;
+
+extern uart_inst_t *const uart0;
+extern uart_inst_t *const uart1;
+
+#define UART_UARTFR_BUSY_BITS 0x00000008
+
+uart_hw_t *uart_get_hw(uart_inst_t *);
+uint uart_get_dreq(uart_inst_t *, bool);
+uint uart_init(uart_inst_t *, uint);
+uint uart_set_baudrate(uart_inst_t *, uint);
+void uart_set_format(uart_inst_t *, uint, uint, uart_parity_t);
+void uart_set_hw_flow(uart_inst_t *, bool, bool);
+void uart_set_fifo_enabled(uart_inst_t *, bool);
+void uart_set_translate_crlf(uart_inst_t *, bool);
+
+enum gpio_function { GPIO_FUNC_UART = 2, GPIO_FUNC_SIO = 5, GPIO_FUNC_NULL = 0x1f };
+enum gpio_override { GPIO_OVERRIDE_NORMAL = 0, GPIO_OVERRIDE_INVERT, GPIO_OVERRIDE_LOW, GPIO_OVERRIDE_HIGH };
+
+#define GPIO_OUT 1
+#define GPIO_IN  0
+
+void gpio_init(uint);
+void gpio_set_function(uint, enum gpio_function);
+void gpio_set_dir(uint, bool);
+void gpio_put(uint, bool);
+bool gpio_get(uint);
+void gpio_pull_up(uint);
+void gpio_pull_down(uint);
+void gpio_disable_pulls(uint);
+
+typedef struct {
+    volatile uint32_t ctrl;
+    volatile uint32_t load;
+    volatile uint32_t reason;
+    volatile uint32_t scratch[8];
+} watchdog_hw_t;
+
+extern watchdog_hw_t *watchdog_hw;
+
+void watchdog_enable(uint32_t, bool);
+void watchdog_update(void);
+
+typedef struct {
+    struct {
+        volatile uint32_t status;
+        volatile uint32_t ctrl;
+    } io[6];
+} io_qspi_hw_t;
+
+typedef struct {
+    volatile uint32_t gpio_hi_in;
+} sio_hw_t;
+
+extern io_qspi_hw_t *ioqspi_hw;
+extern sio_hw_t *sio_hw;
+
+#define IO_QSPI_GPIO_QSPI_SS_CTRL_OEOVER_LSB  12
+#define IO_QSPI_GPIO_QSPI_SS_CTRL_OEOVER_BITS 0x00003000
+
+static inline void hw_write_masked(volatile uint32_t *addr, uint32_t values, uint32_t mask) {
+    *addr = (*addr & ~mask) | (values & mask);
+}
+
+#define PICO_DEFAULT_LED_PIN            25
+#define PICO_UNIQUE_BOARD_ID_SIZE_BYTES 8
+
+/* Writes to the system control registers (reboot) land in this array */
+extern uint8_t host_ppb[0x10000];
+#define PPB_BASE ((uintptr_t)host_ppb)
+
+void reset_usb_boot(uint32_t, uint32_t);
+void pico_get_unique_board_id_string(char *, uint);
+void stdio_init_all(void);
+bool set_sys_clock_khz(uint32_t, bool);
+void tight_loop_contents(void);
+void irq_set_exclusive_handler(uint, irq_handler_t);
+void irq_set_enabled(uint, bool);
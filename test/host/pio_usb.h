@@ -0,0 +1,20 @@
+#pragma once
+#include "pico_host.h"
+
+/* Only what setup.c needs to describe the host port */
+typedef struct {
+    uint8_t pin_dp;
+    uint8_t pio_tx_num;
+    uint8_t sm_tx;
+    uint8_t tx_ch;
+    uint8_t pio_rx_num;
+    uint8_t sm_rx;
+    uint8_t sm_eop;
+    void *alarm_pool;
+    int8_t debug_pin_rx;
+    int8_t debug_pin_eop;
+    bool skip_alarm_pool;
+    int pinout;
+} pio_usb_configuration_t;
+
+#define PIO_USB_DEFAULT_CONFIG {0}
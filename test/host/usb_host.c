@@ -0,0 +1,159 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include "tusb.h"
+
+#include "host.h"
+
+/*==============================================================================
+ *  TinyUSB device side
+ *==============================================================================*/
+
+host_report_t host_reports[HOST_REPORTS_MAX];
+int host_report_count = 0;
+bool host_hid_ready = true;
+void (*host_report_hook)(uint8_t instance) = NULL;
+
+uint8_t host_vendor_tx[HOST_VENDOR_MAX];
+uint32_t host_vendor_tx_len = 0;
+uint8_t host_vendor_rx[HOST_VENDOR_MAX];
+uint32_t host_vendor_rx_len = 0;
+
+void host_usb_reset(void) {
+    host_report_count  = 0;
+    host_hid_ready     = true;
+    host_vendor_tx_len = 0;
+    host_vendor_rx_len = 0;
+}
+
+bool tud_init(uint8_t rhport) { (void)rhport; return true; }
+void tud_task_ext(uint32_t timeout_ms, bool in_isr) { (void)timeout_ms; (void)in_isr; }
+bool tud_mounted(void) { return true; }
+bool tud_suspended(void) { return false; }
+bool tud_remote_wakeup(void) { return true; }
+bool tud_disconnect(void) { return true; }
+bool tud_connect(void) { return true; }
+
+bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const *request, void *buffer, uint16_t len) {
+    (void)rhport; (void)request; (void)buffer; (void)len;
+    return true;
+}
+
+bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier) {
+    (void)lun; (void)sense_key; (void)add_sense_code; (void)add_sense_qualifier;
+    return true;
+}
+
+bool tud_hid_n_ready(uint8_t instance) {
+    (void)instance;
+    return host_hid_ready;
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len) {
+    if (host_report_count >= HOST_REPORTS_MAX || len > sizeof(host_reports[0].data))
+        return false;
+
+    host_report_t *r = &host_reports[host_report_count++];
+    *r = (host_report_t){.time_us = host_time_us, .instance = instance, .report_id = report_id, .len = len};
+    memcpy(r->data, report, len);
+
+    if (host_report_hook)
+        host_report_hook(instance);
+
+    return true;
+}
+
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, uint8_t keycode[6]) {
+    hid_keyboard_report_t report = {.modifier = modifier};
+
+    if (keycode)
+        memcpy(report.keycode, keycode, sizeof(report.keycode));
+
+    return tud_hid_n_report(instance, report_id, &report, sizeof(report));
+}
+
+uint32_t tud_vendor_n_available(uint8_t itf) {
+    (void)itf;
+    return host_vendor_rx_len;
+}
+
+uint32_t tud_vendor_n_read(uint8_t itf, void *buffer, uint32_t bufsize) {
+    (void)itf;
+    uint32_t n = MIN(bufsize, host_vendor_rx_len);
+
+    memcpy(buffer, host_vendor_rx, n);
+    memmove(host_vendor_rx, host_vendor_rx + n, host_vendor_rx_len - n);
+    host_vendor_rx_len -= n;
+    return n;
+}
+
+uint32_t tud_vendor_n_write(uint8_t itf, void const *buffer, uint32_t bufsize) {
+    (void)itf;
+    uint32_t n = MIN(bufsize, HOST_VENDOR_MAX - host_vendor_tx_len);
+
+    memcpy(host_vendor_tx + host_vendor_tx_len, buffer, n);
+    host_vendor_tx_len += n;
+    return n;
+}
+
+uint32_t tud_vendor_n_write_flush(uint8_t itf) {
+    (void)itf;
+    return 0;
+}
+
+/*==============================================================================
+ *  TinyUSB host side, no devices are ever attached. What the firmware sends one is recorded.
+ *==============================================================================*/
+
+bool tuh_init(uint8_t rhport) { (void)rhport; return true; }
+bool tuh_inited(void) { return true; }
+void tuh_task_ext(uint32_t timeout_ms, bool in_isr) { (void)timeout_ms; (void)in_isr; }
+
+bool tuh_configure(uint8_t rhport, uint32_t cfg_id, const void *cfg_param) {
+    (void)rhport; (void)cfg_id; (void)cfg_param;
+    return true;
+}
+
+uint8_t tuh_hid_interface_protocol(uint8_t dev_addr, uint8_t idx) {
+    (void)dev_addr; (void)idx;
+    return HID_ITF_PROTOCOL_NONE;
+}
+
+uint8_t tuh_hid_get_protocol(uint8_t dev_addr, uint8_t idx) {
+    (void)dev_addr; (void)idx;
+    return HID_PROTOCOL_REPORT;
+}
+
+void tuh_hid_set_default_protocol(uint8_t protocol) { (void)protocol; }
+
+bool tuh_hid_set_protocol(uint8_t dev_addr, uint8_t idx, uint8_t protocol) {
+    (void)dev_addr; (void)idx; (void)protocol;
+    return true;
+}
+
+bool tuh_hid_receive_report(uint8_t dev_addr, uint8_t idx) {
+    (void)dev_addr; (void)idx;
+    return true;
+}
+
+host_report_t host_set_report;
+bool host_control_ready = true;
+
+bool tuh_hid_set_report(uint8_t dev_addr, uint8_t idx, uint8_t report_id, uint8_t report_type, void *report,
+                        uint16_t len) {
+    (void)dev_addr; (void)report_type;
+
+    if (!host_control_ready || len > sizeof(host_set_report.data))
+        return false;
+
+    host_set_report = (host_report_t){.time_us = host_time_us, .instance = idx, .report_id = report_id, .len = len};
+    memcpy(host_set_report.data, report, len);
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Mocked device for host tools, misc/bulk_api.py talks to it over a pipe
+ *  Stands in for the vendor interface of a board in config mode. Each transfer
+ *  is framed as [length (2 bytes, little-endian), data], requests come in on
+ *  stdin and go to tud_vendor_rx_cb, replies go out on stdout.
+ *==============================================================================*/
+
+static bool read_exact(void *buffer, size_t len) {
+    return fread(buffer, 1, len, stdin) == len;
+}
+
+static void write_frame(const uint8_t *data, uint16_t len) {
+    uint8_t frame_len[2] = {len & 0xff, len >> 8};
+
+    fwrite(frame_len, 1, sizeof(frame_len), stdout);
+    fwrite(data, 1, len, stdout);
+    fflush(stdout);
+}
+
+int main(void) {
+    uint8_t frame_len[2];
+
+    load_config(&global_state);
+    global_state.config_mode_active = true;
+
+    queue_init(&global_state.hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
+    queue_init(&global_state.text_queue, sizeof(text_char_t), TEXT_QUEUE_LENGTH);
+
+    /* Saving the config writes flash, the other core has to be one that can be held off */
+    host_core = 1;
+    flash_safe_execute_core_init();
+    host_core = 0;
+    flash_safe_execute_core_init();
+
+    while (read_exact(frame_len, sizeof(frame_len))) {
+        host_vendor_rx_len = frame_len[0] | (frame_len[1] << 8);
+
+        if (host_vendor_rx_len > HOST_VENDOR_MAX || !read_exact(host_vendor_rx, host_vendor_rx_len))
+            return 1;
+
+        host_vendor_tx_len = 0;
+        tud_vendor_rx_cb(0);
+
+        /* Partial requests wait for the rest, like on the bus, there's just no reply yet */
+        write_frame(host_vendor_tx, host_vendor_tx_len);
+    }
+
+    return 0;
+}
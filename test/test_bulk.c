@@ -0,0 +1,262 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Reading the config, over the bulk interface and over HID
+ *  Bulk requests go through tud_vendor_rx_cb like they would from the web config.
+ *  A full read doesn't fit one reply, so it has to come in pages. Over HID, the
+ *  "read all" request must never have more queued than hid_queue_out can hold.
+ *  Saving must stop at the first flash write that didn't go through and say so.
+ *  Macro commands take their offset from arg, version stays the data version.
+ *==============================================================================*/
+
+static uint8_t reply[BULK_BUFFER_SIZE];
+
+/* Send a request, return the reply length (0 if there was none) */
+static uint32_t bulk_request_arg(uint8_t cmd, uint32_t version, uint16_t offset, uint32_t arg, const uint8_t *payload,
+                                 uint16_t len) {
+    bulk_header_t header = {
+        .start = {START1, START2}, .cmd = cmd, .length = len, .version = version, .offset = offset, .arg = arg};
+
+    host_vendor_tx_len = 0;
+    memcpy(host_vendor_rx, &header, sizeof(header));
+    memcpy(host_vendor_rx + sizeof(header), payload, len);
+    host_vendor_rx_len = sizeof(header) + len;
+
+    tud_vendor_rx_cb(0);
+
+    CHECK(host_vendor_rx_len == 0);
+    CHECK(host_vendor_tx_len <= sizeof(reply));
+    memcpy(reply, host_vendor_tx, MIN(host_vendor_tx_len, sizeof(reply)));
+    return host_vendor_tx_len;
+}
+
+static uint32_t bulk_request(uint8_t cmd, uint32_t version, uint16_t offset, const uint8_t *payload, uint16_t len) {
+    return bulk_request_arg(cmd, version, offset, 0, payload, len);
+}
+
+/* Read pages until the reply says there are none left, like script.js does. Counts how often
+   each field came back and returns the version of the first page. */
+static uint32_t bulk_get(uint32_t since, const uint8_t *list, uint16_t list_len, int seen[256], int *pages) {
+    uint16_t offset = 0;
+    uint32_t version = 0;
+
+    memset(seen, 0, 256 * sizeof(int));
+    *pages = 0;
+
+    do {
+        uint32_t len = bulk_request(BULK_GET_CMD, since, offset, list, list_len);
+        bulk_header_t *header = (bulk_header_t *)reply;
+
+        CHECK(len >= sizeof(bulk_header_t) && header->cmd == BULK_GET_CMD && header->status == BULK_OK);
+        CHECK(sizeof(bulk_header_t) + header->length <= len);
+
+        for (uint32_t pos = sizeof(bulk_header_t); pos < sizeof(bulk_header_t) + header->length;) {
+            const field_map_t *map = get_field_map_entry(reply[pos]);
+
+            CHECK(map != NULL && reply[pos + 1] == map->len);
+            if (map == NULL)
+                break;
+
+            CHECK(!memcmp(&reply[pos + 2], (uint8_t *)&global_state + map->offset, map->len));
+            seen[map->idx]++;
+            pos += 2 + map->len;
+        }
+
+        if (!(*pages)++)
+            version = header->version;
+
+        /* Each page has to move forward, or the client would loop forever */
+        CHECK(header->offset == 0 || header->offset > offset);
+        offset = header->offset;
+    } while (offset && *pages < 100);
+
+    return version;
+}
+
+static void check_full_read(void) {
+    static int seen[256];
+    uint8_t list[256];
+    int pages;
+
+    /* Everything, empty list */
+    uint32_t version = bulk_get(0, NULL, 0, seen, &pages);
+
+    for (size_t i = 0; i < get_field_map_length(); i++) {
+        list[i] = get_field_map_index(i)->idx;
+        CHECK(seen[list[i]] == 1);
+    }
+
+    CHECK(pages > 1 && version != 0);
+    printf("full read: %zu fields in %d pages\n", get_field_map_length(), pages);
+
+    /* Same, with each field asked for by index */
+    bulk_get(0, list, get_field_map_length(), seen, &pages);
+
+    for (size_t i = 0; i < get_field_map_length(); i++)
+        CHECK(seen[list[i]] == 1);
+
+    CHECK(pages > 1);
+
+    /* Nothing changed, nothing comes back */
+    bulk_get(version, NULL, 0, seen, &pages);
+    CHECK(pages == 1 && ((bulk_header_t *)reply)->length == 0);
+
+    /* Starting past the end is an empty reply, not an error */
+    bulk_request(BULK_GET_CMD, 0, 0xffff, NULL, 0);
+    CHECK(((bulk_header_t *)reply)->status == BULK_OK && ((bulk_header_t *)reply)->length == 0);
+    CHECK(((bulk_header_t *)reply)->offset == 0);
+}
+
+/* The status panel polls with the version it got, only changed counters come back. A field that
+   changes while the later pages are read must come back with the next poll. */
+static void check_polling(void) {
+    static int seen[256];
+    int pages;
+
+    uint32_t version = bulk_get(0, NULL, 0, seen, &pages);
+
+    global_state.stats.queue_drops[STATS_KBD_QUEUE] += 1000;
+    global_state.stats.queue_drops[STATS_HID_QUEUE]++;
+
+    uint32_t polled = bulk_get(version, NULL, 0, seen, &pages);
+    bulk_header_t *header = (bulk_header_t *)reply;
+
+    CHECK(pages == 1 && polled > version);
+    CHECK(header->length == 2 * (2 + sizeof(uint32_t)));
+
+    /* First page read, then the first field on it changes, then the rest is read */
+    const field_map_t *first = get_field_map_index(0);
+
+    bulk_request(BULK_GET_CMD, 0, 0, NULL, 0);
+    version = header->version;
+    uint16_t offset = header->offset;
+    CHECK(offset != 0);
+
+    global_state.active_output ^= 1;
+
+    while (offset) {
+        bulk_request(BULK_GET_CMD, 0, offset, NULL, 0);
+        offset = header->offset;
+    }
+
+    bulk_get(version, NULL, 0, seen, &pages);
+    CHECK(seen[first->idx] == 1 && header->length == 2 + first->len);
+    global_state.active_output ^= 1;
+}
+
+/* The web config asks for all fields over HID, then reads them as they come */
+static void check_hid_read_all(void) {
+    uart_packet_t request = {.type = GET_ALL_VALS_MSG};
+    int seen[256] = {0};
+    uint32_t max_level = 0;
+
+    host_usb_reset();
+    global_state.stats.queue_drops[STATS_HID_QUEUE] = 0;
+
+    handle_api_read_all_msg(&request, &global_state);
+
+    /* The host isn't reading for a while, the queue fills up only so far */
+    host_hid_ready = false;
+    for (int i = 0; i < 50; i++) {
+        process_hid_queue_task(&global_state);
+        max_level = MAX(max_level, queue_get_level(&global_state.hid_queue_out));
+    }
+
+    CHECK(max_level <= HID_QUEUE_LENGTH / 2);
+
+    /* Now a report per task run goes out */
+    host_hid_ready = true;
+    for (int i = 0; i < 1000 && (global_state.read_all_left || !queue_is_empty(&global_state.hid_queue_out)); i++) {
+        process_hid_queue_task(&global_state);
+        max_level = MAX(max_level, queue_get_level(&global_state.hid_queue_out));
+    }
+
+    CHECK(global_state.stats.queue_drops[STATS_HID_QUEUE] == 0);
+    CHECK(host_report_count == (int)get_field_map_length());
+
+    for (int i = 0; i < host_report_count; i++) {
+        CHECK(host_reports[i].data[2] == GET_VAL_MSG);
+        seen[host_reports[i].data[3]]++;
+    }
+
+    for (size_t i = 0; i < get_field_map_length(); i++)
+        CHECK(seen[get_field_map_index(i)->idx] == 1);
+
+    printf("HID read all: %d reports, at most %u queued\n", host_report_count, max_level);
+}
+
+static void check_macro_offset(void) {
+    bulk_header_t *header = (bulk_header_t *)reply;
+    const uint8_t data[]  = {0x11, 0x22, 0x33, 0x44};
+
+    /* A version that isn't an offset must not move the write */
+    CHECK(bulk_request_arg(BULK_MACRO_WRITE_CMD, 7, 0, 100, data, sizeof(data)) == sizeof(bulk_header_t));
+    CHECK(header->status == BULK_OK);
+
+    CHECK(bulk_request_arg(BULK_MACRO_READ_CMD, 0, 0, 100, NULL, 0) > sizeof(bulk_header_t) + sizeof(data));
+    CHECK(header->status == BULK_OK && memcmp(reply + sizeof(bulk_header_t), data, sizeof(data)) == 0);
+
+    CHECK(bulk_request_arg(BULK_MACRO_READ_CMD, 100, 0, 0, NULL, 0) > sizeof(bulk_header_t));
+    CHECK(memcmp(reply + sizeof(bulk_header_t), data, sizeof(data)) != 0);
+
+    /* Past the end */
+    CHECK(bulk_request_arg(BULK_MACRO_WRITE_CMD, 0, 0, sizeof(macro_storage_t), data, sizeof(data)) == sizeof(bulk_header_t));
+    CHECK(header->status == BULK_ERR_LENGTH);
+}
+
+static void check_save_failure(void) {
+    bulk_header_t *header = (bulk_header_t *)reply;
+
+    /* Both cores registered as lockout victims, as setup and core1_main do */
+    host_core = 1;
+    flash_safe_execute_core_init();
+    host_core = 0;
+    flash_safe_execute_core_init();
+
+    /* Core1 doesn't get off the flash in time, so the first page (which erases) fails */
+    uint32_t pages = host_flash_stats.programmed_pages;
+    host_flash_safe_timeouts = 1;
+
+    CHECK(bulk_request(BULK_WRITE_SAVE_CMD, 0, 0, NULL, 0) == sizeof(bulk_header_t));
+    CHECK(header->status == BULK_ERR_FLASH);
+    CHECK(host_flash_stats.programmed_pages == pages);
+    CHECK(global_state.stats.flash_errors == 1);
+
+    host_flash_safe_timeouts = 1;
+    CHECK(bulk_request(BULK_MACRO_SAVE_CMD, 0, 0, NULL, 0) == sizeof(bulk_header_t));
+    CHECK(header->status == BULK_ERR_FLASH);
+    CHECK(host_flash_stats.programmed_pages == pages);
+    CHECK(global_state.stats.flash_errors == 2);
+
+    /* Next try goes through */
+    CHECK(bulk_request(BULK_WRITE_SAVE_CMD, 0, 0, NULL, 0) == sizeof(bulk_header_t));
+    CHECK(header->status == BULK_OK);
+    CHECK(memcmp(ADDR_CONFIG, &global_state.config, sizeof(config_t)) == 0);
+}
+
+int main(void) {
+    load_config(&global_state);
+    global_state.config_mode_active = true;
+    queue_init(&global_state.hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
+    host_usb_reset();
+
+    check_full_read();
+    check_polling();
+    check_hid_read_all();
+    check_macro_offset();
+    check_save_failure();
+    return host_result("bulk");
+}
@@ -0,0 +1,317 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Board chain
+ *  Four boards, A-B (peer) B-C (chain port) C-D (peer), each with its own
+ *  routing table and queues, going through chain_send and chain_accept.
+ *  Wires take a frame's time at the serial rate, core0 sends one frame per
+ *  pass and port, core1 takes one per pass and port, both loops with some
+ *  jitter. Every packet has to arrive exactly where it was sent, and the
+ *  latency of each hop is reported.
+ *==============================================================================*/
+
+#define BOARDS      4
+#define MAX_PACKETS 100000
+#define FRAME_US    (RAW_PACKET_LENGTH * 10 * 1e6 / SERIAL_BAUDRATE) // 8N1
+#define STEP_US     0.5
+#define PENDING     512 // Frames waiting in a queue or on a wire, per board and port
+
+typedef struct {
+    uart_packet_t packet;
+    double queued; // When it went into the sender's queue
+    double arrive; // When it's all in the receiver's ring
+} frame_t;
+
+/* Times the packets in a queue or on a wire got there, in order */
+typedef struct {
+    frame_t frame[PENDING];
+    int head, tail;
+} fifo_t;
+
+typedef struct {
+    double sum, max;
+    long count;
+} latency_stat_t;
+
+static device_t boards[BOARDS];
+static fifo_t queued[BOARDS][CHAIN_NUM_PORTS]; // Queue timestamps, next to the real queues
+static fifo_t wire[BOARDS][CHAIN_NUM_PORTS];   // Frames on the way out of a board's port
+static double next_core0[BOARDS], next_core1[BOARDS], now;
+
+/* Each packet has its number in data32[0] */
+static struct {
+    double origin;
+    uint8_t src, dst, received[BOARDS];
+} packets[MAX_PACKETS];
+static int packet_count;
+
+static latency_stat_t hop[BOARDS][BOARDS], end_to_end[BOARDS][BOARDS];
+static long delivered, misdelivered, addressed_to_neighbour;
+
+static unsigned seed = 42;
+
+static double jitter(double lo, double hi) {
+    seed = seed * 1103515245 + 12345;
+    return lo + (hi - lo) * ((seed >> 8) & 0xFFFF) / 65536.0;
+}
+
+static void fifo_push(fifo_t *fifo, frame_t frame) {
+    fifo->frame[fifo->tail] = frame;
+    fifo->tail              = (fifo->tail + 1) % PENDING;
+}
+
+static frame_t *fifo_peek(fifo_t *fifo) {
+    return fifo->head == fifo->tail ? NULL : &fifo->frame[fifo->head];
+}
+
+static void fifo_pop(fifo_t *fifo) {
+    fifo->head = (fifo->head + 1) % PENDING;
+}
+
+static void add_latency(latency_stat_t *stat, double us) {
+    stat->sum += us;
+    stat->max = MAX(stat->max, us);
+    stat->count++;
+}
+
+static queue_t *port_queue(int board, int port) {
+    return port == CHAIN_PORT_PEER ? &boards[board].uart_tx_queue : &boards[board].chain.tx_queue;
+}
+
+static uint32_t queue_level(int board, int port) {
+    return queue_get_level(port_queue(board, port));
+}
+
+/* Whatever chain_send or chain_accept put in the board's queues was queued now */
+static void note_queued(int board, const uint32_t *before) {
+    for (int port = 0; port < CHAIN_NUM_PORTS; port++)
+        for (uint32_t n = before[port]; n < queue_level(board, port); n++)
+            fifo_push(&queued[board][port], (frame_t){.queued = now});
+}
+
+/* A board sends a packet, like queue_packet_to does */
+static void originate(int board, uint8_t type, uint8_t dst) {
+    uart_packet_t packet = {.type = type};
+    uint32_t before[CHAIN_NUM_PORTS] = {queue_level(board, 0), queue_level(board, 1)};
+
+    if (packet_count == MAX_PACKETS)
+        return;
+
+    packet.data32[0]        = packet_count;
+    packets[packet_count++] = (typeof(packets[0])){.origin = now, .src = board, .dst = dst};
+
+    chain_send(&packet, dst, &boards[board]);
+    note_queued(board, before);
+}
+
+/* core0: the DMA sends a frame per port whenever the wire is free */
+static void core0_pass(int board) {
+    for (int port = 0; port < CHAIN_NUM_PORTS; port++) {
+        fifo_t *out    = &wire[board][port];
+        frame_t *last  = out->head == out->tail ? NULL : &out->frame[(out->tail + PENDING - 1) % PENDING];
+        frame_t *frame = fifo_peek(&queued[board][port]);
+
+        if ((last && last->arrive > now) || !frame)
+            continue;
+
+        CHECK(queue_try_remove(port_queue(board, port), &frame->packet));
+        frame->arrive = now + FRAME_US;
+
+        fifo_push(out, *frame);
+        fifo_pop(&queued[board][port]);
+    }
+}
+
+/* core1: the receiver tasks of both ports take one frame per pass */
+static void core1_pass(int board) {
+    chain_t *chain = &boards[board].chain;
+
+    for (int port = 0; port < CHAIN_NUM_PORTS; port++) {
+        if (port == CHAIN_PORT_NEXT && !chain->next_port)
+            continue;
+
+        /* Peer port talks to the peer port on the other end, chain port to the chain port */
+        int from       = chain_neighbour(chain, port);
+        frame_t *frame = fifo_peek(&wire[from][port]);
+
+        if (!frame || frame->arrive > now)
+            continue;
+
+        uart_packet_t packet = frame->packet;
+        uint32_t before[CHAIN_NUM_PORTS] = {queue_level(board, 0), queue_level(board, 1)};
+        int id = packet.data32[0];
+
+        add_latency(&hop[from][board], now - frame->queued);
+        fifo_pop(&wire[from][port]);
+
+        /* Sent straight to the board on the other end, must go without an address */
+        if (packets[id].src == from && packets[id].dst == board && PACKET_DST(packet.type) != PACKET_DST_PEER)
+            addressed_to_neighbour++;
+
+        if (chain_accept(&packet, port, &boards[board])) {
+            bool wanted = packets[id].dst == CHAIN_ALL ? board != packets[id].src : board == packets[id].dst;
+
+            misdelivered += !wanted || packets[id].received[board]++;
+            delivered++;
+            add_latency(&end_to_end[packets[id].src][board], now - packets[id].origin);
+        }
+
+        note_queued(board, before);
+    }
+}
+
+static void run_loops(void) {
+    for (int board = 0; board < BOARDS; board++) {
+        if (now >= next_core0[board]) {
+            core0_pass(board);
+            next_core0[board] = now + jitter(2, 10);
+        }
+
+        if (now >= next_core1[board]) {
+            core1_pass(board);
+            next_core1[board] = now + jitter(3, 25);
+        }
+    }
+}
+
+static void print_latency(const char *title, latency_stat_t stats[BOARDS][BOARDS]) {
+    printf("  %s\n", title);
+
+    for (int from = 0; from < BOARDS; from++)
+        for (int to = 0; to < BOARDS; to++)
+            if (stats[from][to].count)
+                printf("    %c -> %c %7ld packets, %6.1f us average, %6.1f us max\n", 'A' + from, 'A' + to,
+                       stats[from][to].count, stats[from][to].sum / stats[from][to].count, stats[from][to].max);
+}
+
+static void setup(void) {
+    memset(packets, 0, sizeof(packets));
+    memset(hop, 0, sizeof(hop));
+    memset(end_to_end, 0, sizeof(end_to_end));
+    memset(queued, 0, sizeof(queued));
+    memset(wire, 0, sizeof(wire));
+    packet_count = delivered = misdelivered = addressed_to_neighbour = 0;
+
+    for (int board = 0; board < BOARDS; board++) {
+        queue_free(&boards[board].uart_tx_queue);
+        queue_free(&boards[board].chain.tx_queue);
+        memset(&boards[board].chain, 0, sizeof(chain_t));
+
+        queue_init(&boards[board].uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+        queue_init(&boards[board].chain.tx_queue, sizeof(uart_packet_t), CHAIN_QUEUE_LENGTH);
+        chain_init(&boards[board].chain, board, BOARDS);
+        next_core0[board] = next_core1[board] = 0;
+    }
+}
+
+/* Mouse from one board to another, keys to the next board and now and then a broadcast from anyone */
+static void check_traffic(const char *name, int src, int dst, double mouse_hz, double seconds) {
+    double next_mouse = 0, next_keys = 0, next_broadcast = 0;
+    long missing = 0;
+
+    setup();
+
+    for (now = 0; now < seconds * 1e6; now += STEP_US) {
+        if (now >= next_mouse) {
+            originate(src, MOUSE_REPORT_MSG, dst);
+            next_mouse += 1e6 / mouse_hz;
+        }
+
+        if (now >= next_keys) {
+            originate(src, KEYBOARD_REPORT_MSG, (src + 1) % BOARDS);
+            next_keys += 1e6 / 100;
+        }
+
+        if (now >= next_broadcast) {
+            originate((int)jitter(0, BOARDS), SYNC_BORDERS_MSG, CHAIN_ALL);
+            next_broadcast += 1e6 / 10;
+        }
+
+        run_loops();
+    }
+
+    /* Let everything still on its way arrive */
+    for (double end = now + 100000; now < end; now += STEP_US)
+        run_loops();
+
+    for (int id = 0; id < packet_count; id++)
+        for (int board = 0; board < BOARDS; board++)
+            if ((packets[id].dst == CHAIN_ALL ? board != packets[id].src : board == packets[id].dst)
+                && !packets[id].received[board])
+                missing++;
+
+    printf("%s: %c -> %c mouse at %.0f Hz, %d packets, %ld delivered, %u forwarded by B, %u by C\n", name, 'A' + src,
+           'A' + dst, mouse_hz, packet_count, delivered, boards[1].chain.forwarded, boards[2].chain.forwarded);
+    print_latency("per hop, queued on the sender until handled or passed on by the receiver", hop);
+    print_latency("end to end", end_to_end);
+
+    CHECK(packet_count < MAX_PACKETS);
+    CHECK(missing == 0 && misdelivered == 0 && addressed_to_neighbour == 0);
+
+    /* Passing on adds a frame time and a loop pass, nothing builds up */
+    for (int from = 0; from < BOARDS; from++)
+        for (int to = 0; to < BOARDS; to++)
+            CHECK(hop[from][to].max < 4 * FRAME_US + 50);
+}
+
+/* Every board reaches every other one, each hop gets closer, neighbours get no address */
+static void check_routes(void) {
+    for (int board = 0; board < BOARDS; board++) {
+        chain_t chain;
+
+        chain_init(&chain, board, BOARDS);
+        CHECK(chain.next_port == (board == 1 || board == 2));
+
+        for (int dst = 0; dst < BOARDS; dst++) {
+            uint8_t port = chain.route[dst];
+
+            if (dst == board) {
+                CHECK(port == CHAIN_LOCAL);
+                continue;
+            }
+
+            CHECK(port != CHAIN_LOCAL);
+            CHECK(abs(dst - chain_neighbour(&chain, port)) < abs(dst - board));
+            CHECK((chain_neighbour(&chain, port) == dst) == (chain_dst_field(&chain, port, dst) == PACKET_DST_PEER));
+        }
+    }
+}
+
+/* A pair of boards sends the same packets as it always did, nothing is passed on */
+static void check_pair(void) {
+    for (int board = 0; board < 2; board++) {
+        chain_t chain;
+
+        chain_init(&chain, board, 2);
+        CHECK(!chain.next_port);
+        CHECK(chain_dst_field(&chain, CHAIN_PORT_PEER, board ^ 1) == PACKET_DST_PEER);
+        CHECK(chain_dst_field(&chain, CHAIN_PORT_PEER, CHAIN_ALL) == PACKET_DST_PEER);
+        CHECK(chain_is_local(&chain, PACKET_DST_PEER));
+        CHECK(chain_forward_port(&chain, PACKET_DST_PEER, CHAIN_PORT_PEER) == CHAIN_LOCAL);
+    }
+}
+
+int main(void) {
+    check_routes();
+    check_pair();
+
+    check_traffic("1 kHz mouse", 0, 3, 1000, 2);
+    check_traffic("8 kHz mouse", 0, 3, 8000, 2);
+    check_traffic("reverse", 3, 0, 1000, 2);
+
+    return host_result("chain");
+}
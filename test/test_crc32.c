@@ -0,0 +1,88 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  CRC32, slicing-by-4 and the incremental API
+ *  Without arguments, checks known values. With an image file, loads it where the
+ *  running firmware lives and prints CRCs for crc32_check.py to compare with binascii.
+ *==============================================================================*/
+
+/* Plain bitwise reflected CRC32, the definition everything else has to agree with */
+static uint32_t crc32_reference(const uint8_t *data, size_t length) {
+    uint32_t crc = CRC32_INIT;
+
+    while (length--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+static void check_known_values(void) {
+    static uint8_t buffer[4096 + 8];
+
+    CHECK(calc_crc32((const uint8_t *)"123456789", 9) == 0xCBF43926);
+    CHECK(calc_crc32(buffer, 0) == 0);
+
+    for (size_t i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (uint8_t)(i * 2654435761u >> 13);
+
+    /* Every alignment and tail length the 4-byte loop can see */
+    for (size_t offset = 0; offset < 4; offset++)
+        for (size_t length = 0; length < 64; length++)
+            CHECK(calc_crc32(buffer + offset, length) == crc32_reference(buffer + offset, length));
+
+    CHECK(calc_crc32(buffer + 1, 4096) == crc32_reference(buffer + 1, 4096));
+
+    /* Fed in pieces, the same as in one go */
+    for (size_t split = 0; split <= 300; split += 7) {
+        uint32_t crc = crc32_update(CRC32_INIT, buffer + 3, split);
+        crc          = crc32_update(crc, buffer + 3 + split, 1000 - split);
+        CHECK(~crc == crc32_reference(buffer + 3, 1000));
+    }
+}
+
+static int print_image_crcs(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 1;
+
+    size_t length = fread((uint8_t *)ADDR_FW_RUNNING, 1, STAGING_IMAGE_SIZE, f);
+    fclose(f);
+
+    if (length != STAGING_IMAGE_SIZE)
+        return 1;
+
+    /* What the firmware checks against the metadata misc/crc32.py writes */
+    printf("firmware %08x\n", calculate_firmware_crc32());
+
+    for (uint32_t offset = 0; offset < 8; offset++)
+        for (uint32_t slice = 0; slice < 2100; slice = slice * 3 + 1)
+            printf("%u %u %08x\n", offset, slice, calc_crc32(ADDR_FW_RUNNING + offset, slice));
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    crc32_init();
+
+    if (argc > 1)
+        return print_image_crcs(argv[1]);
+
+    check_known_values();
+    return host_result("crc32");
+}
@@ -0,0 +1,205 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Pen digitizer on a 2-screen macOS output
+ *  desktop_position places each screen within the whole desktop, and
+ *  tud_mouse_report turns TOUCH reports into pen reports. A 1 kHz mouse then
+ *  crosses from the first screen to the second with a host polling once per
+ *  ms, through the real switching code. Timed from the crossing report until
+ *  the host has a report that puts the pointer on the new screen, with the
+ *  absolute mouse and its macOS workaround, then with the pen.
+ *==============================================================================*/
+
+#define MOVE_X 100 // Per mouse report
+
+static hid_interface_t iface = {.protocol = HID_PROTOCOL_BOOT};
+
+static output_t *output(void) {
+    return &global_state.config.output[BOARD_ROLE];
+}
+
+static void setup_output(uint8_t pointer_mode) {
+    for (int out = 0; out < NUM_SCREENS; out++) {
+        global_state.config.output[out].pos          = out == BOARD_ROLE ? RIGHT : LEFT;
+        global_state.config.output[out].screen_count = 1;
+    }
+
+    output()->screen_count = 2;
+    output()->screen_index = 1;
+    output()->os           = MACOS;
+    output()->pointer_mode = pointer_mode;
+    output()->speed_x      = 1;
+    output()->speed_y      = 1;
+
+    global_state.digitizer_active = (pointer_mode == TOUCH);
+    global_state.active_output    = BOARD_ROLE;
+    global_state.relative_mouse   = false;
+    build_screen_layout(&global_state);
+}
+
+/* Screen 1 takes the left half of the desktop, screen 2 the right one */
+static void check_desktop_position(void) {
+    int16_t x = MAX_SCREEN_COORD, y = 100;
+
+    /* Before the layout is compiled, there's just the one screen */
+    desktop_position(&global_state, &x, &y);
+    CHECK(x == MAX_SCREEN_COORD && y == 100);
+
+    setup_output(TOUCH);
+    int16_t half = MAX_SCREEN_COORD / 2;
+
+    x = MIN_SCREEN_COORD, y = MAX_SCREEN_COORD;
+    desktop_position(&global_state, &x, &y);
+    CHECK(x == MIN_SCREEN_COORD && y == MAX_SCREEN_COORD);
+
+    x = MAX_SCREEN_COORD, y = 100;
+    desktop_position(&global_state, &x, &y);
+    CHECK(x == half && y == 100);
+
+    output()->screen_index = 2;
+    x = MIN_SCREEN_COORD;
+    desktop_position(&global_state, &x, &y);
+    CHECK(x == half);
+
+    x = MAX_SCREEN_COORD;
+    desktop_position(&global_state, &x, &y);
+    CHECK(x == MAX_SCREEN_COORD - 1);
+
+    /* Not set yet counts as the first screen */
+    output()->screen_index = 0;
+    x = MAX_SCREEN_COORD;
+    desktop_position(&global_state, &x, &y);
+    CHECK(x == half);
+}
+
+static touch_report_t *pen_report(int n) {
+    return (touch_report_t *)host_reports[n].data;
+}
+
+static hid_mouse_out_t *mouse_report(int n) {
+    return (hid_mouse_out_t *)host_reports[n].data;
+}
+
+static void check_touch_report(void) {
+    host_usb_reset();
+    global_state.digitizer_active = true;
+
+    /* Pen reports, left button is the tip and right one the barrel */
+    CHECK(tud_mouse_report(TOUCH, MOUSE_BUTTON_LEFT | MOUSE_BUTTON_RIGHT, 1000, 2000, 0, 0));
+    CHECK(host_reports[0].instance == ITF_NUM_HID_REL_M && host_reports[0].report_id == REPORT_ID_DIGITIZER);
+    CHECK(pen_report(0)->buttons == (PEN_IN_RANGE | PEN_TIP | PEN_BARREL) && pen_report(0)->tip_pressure == 0xFF);
+    CHECK(pen_report(0)->x == 1000 && pen_report(0)->y == 2000);
+
+    CHECK(tud_mouse_report(TOUCH, 0, 1000, 2000, 0, 0));
+    CHECK(pen_report(1)->buttons == PEN_IN_RANGE && pen_report(1)->tip_pressure == 0);
+
+    /* Pens don't scroll, the relative mouse does it without moving or clicking */
+    CHECK(tud_mouse_report(TOUCH, MOUSE_BUTTON_LEFT, 1000, 2000, MOUSE_SCROLL_RESOLUTION, 0));
+    CHECK(host_reports[2].instance == ITF_NUM_HID_REL_M && host_reports[2].report_id == REPORT_ID_RELMOUSE);
+    CHECK(mouse_report(2)->buttons == 0 && mouse_report(2)->x == 0 && mouse_report(2)->y == 0);
+    CHECK(mouse_report(2)->wheel == 1);
+
+    /* Host enumerated without the pen, the absolute mouse does it all */
+    global_state.digitizer_active = false;
+    CHECK(tud_mouse_report(TOUCH, MOUSE_BUTTON_LEFT, 1000, 2000, MOUSE_SCROLL_RESOLUTION, 0));
+    CHECK(host_reports[3].instance == ITF_NUM_HID && host_reports[3].report_id == REPORT_ID_MOUSE);
+    CHECK(mouse_report(3)->buttons == MOUSE_BUTTON_LEFT && mouse_report(3)->x == 1000 && mouse_report(3)->wheel == 1);
+}
+
+/* Where the host has the pointer after report n, for the screen it's on */
+static bool on_second_screen(int n, int after) {
+    if (host_reports[n].report_id == REPORT_ID_DIGITIZER)
+        return pen_report(n)->x > MAX_SCREEN_COORD / 2;
+
+    /* macOS takes absolute reports for the main screen, the relative nudges are what get it across.
+       After those, the first absolute report is on the new screen. */
+    return n > after && host_reports[n].report_id == REPORT_ID_MOUSE;
+}
+
+static void cross(uint8_t pointer_mode, const char *name) {
+    hid_mouse_report_t move = {.x = MOVE_X};
+    uint64_t crossed = 0;
+    int crossing_report = -1, last_nudge = -1, nudges = 0;
+
+    /* Whatever is left from before goes out first */
+    while (!queue_is_empty(&global_state.mouse_queue))
+        process_mouse_queue_task(&global_state);
+
+    setup_output(pointer_mode);
+    host_usb_reset();
+    global_state.pointer_x = MAX_SCREEN_COORD - 3 * MOVE_X;
+    global_state.pointer_y = MAX_SCREEN_COORD / 2;
+
+    for (int ms = 0; ms < 30; ms++) {
+        process_mouse_report((uint8_t *)&move, sizeof(move), 0, &iface);
+
+        if (!crossed && output()->screen_index == 2) {
+            crossed         = host_time_us;
+            crossing_report = host_report_count;
+        }
+
+        /* Host polls at the end of each ms */
+        host_time_us += 1000;
+        process_mouse_queue_task(&global_state);
+        mouse_pending_task(&global_state);
+    }
+
+    CHECK(crossed && output()->screen_index == 2);
+
+    for (int n = crossing_report; n < host_report_count; n++)
+        if (host_reports[n].report_id == REPORT_ID_RELMOUSE) {
+            last_nudge = n;
+            nudges++;
+        }
+
+    for (int n = crossing_report; n < host_report_count; n++) {
+        if (!on_second_screen(n, last_nudge))
+            continue;
+
+        /* Reports that don't carry the mouse's own movement, the absolute mouse's are the edge and nudges */
+        int extra = nudges ? 1 + nudges : 0;
+
+        printf("%-15s %d extra reports per switch, %llu ms (%d reports) to the new screen\n", name, extra,
+               (unsigned long long)(host_reports[n].time_us - crossed) / 1000, n - crossing_report + 1);
+
+        if (pointer_mode == TOUCH)
+            CHECK(extra == 0 && n - crossing_report + 1 <= 2);
+        else
+            CHECK(nudges > 0 && last_nudge - crossing_report == 1 + nudges); // Crossing report, edge, nudges
+
+        return;
+    }
+
+    CHECK(!"pointer never got to the new screen");
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.mouse_queue, sizeof(mouse_report_t), MOUSE_QUEUE_LENGTH);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+
+    global_state.tud_connected = true;
+    global_state.active_output = BOARD_ROLE;
+    global_state.config.enable_acceleration = false;
+
+    check_desktop_position();
+    check_touch_report();
+
+    cross(ABSOLUTE, "absolute mouse:");
+    cross(TOUCH, "pen digitizer:");
+    return host_result("desktop");
+}
@@ -0,0 +1,232 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Config mode FAT12 volume
+ *  Reads the disk through tud_msc_read10_cb and walks it like a host would: boot sector,
+ *  FAT chains, root directory, file data. With a path argument, the whole disk is written
+ *  there instead, so fat_mtools.py can check it with mtools.
+ *==============================================================================*/
+
+#define SECTOR 512
+
+static uint8_t disk[4096 * SECTOR];
+
+typedef struct {
+    fat_boot_sector_t bs;
+    uint32_t fat_lba, root_lba, data_lba, cluster_size;
+} volume_t;
+
+static void read_sector(uint32_t lba, uint8_t *buffer) {
+    /* Two halves, TinyUSB may ask for a sector in parts */
+    CHECK(tud_msc_read10_cb(0, lba, 0, buffer, SECTOR / 2) == SECTOR / 2);
+    CHECK(tud_msc_read10_cb(0, lba, SECTOR / 2, buffer + SECTOR / 2, SECTOR / 2) == SECTOR / 2);
+}
+
+static uint16_t fat12_entry(const uint8_t *fat, uint32_t cluster) {
+    uint16_t pair = fat[cluster * 3 / 2] | (fat[cluster * 3 / 2 + 1] << 8);
+    return cluster & 1 ? pair >> 4 : pair & 0xfff;
+}
+
+static volume_t mount(void) {
+    volume_t v;
+    uint32_t sectors;
+    uint16_t size;
+
+    read_sector(0, disk);
+    memcpy(&v.bs, disk, sizeof(v.bs));
+
+    CHECK(disk[510] == 0x55 && disk[511] == 0xaa);
+    CHECK(v.bs.bytes_per_sector == SECTOR);
+
+    tud_msc_capacity_cb(0, &sectors, &size);
+    CHECK(v.bs.total_sectors == sectors && size == SECTOR);
+
+    v.fat_lba      = v.bs.reserved_sectors;
+    v.root_lba     = v.fat_lba + v.bs.num_fats * v.bs.sectors_per_fat;
+    v.data_lba     = v.root_lba + v.bs.root_dir_entries * sizeof(fat_dir_entry_t) / SECTOR;
+    v.cluster_size = v.bs.sectors_per_cluster * SECTOR;
+
+    for (uint32_t lba = v.fat_lba; lba < v.root_lba; lba++)
+        read_sector(lba, &disk[lba * SECTOR]);
+
+    /* Both FAT copies agree */
+    uint32_t fat_bytes = v.bs.sectors_per_fat * SECTOR;
+    CHECK(memcmp(&disk[v.fat_lba * SECTOR], &disk[(v.fat_lba + v.bs.sectors_per_fat) * SECTOR], fat_bytes) == 0);
+
+    return v;
+}
+
+static fat_dir_entry_t *read_root(volume_t *v) {
+    read_sector(v->root_lba, &disk[v->root_lba * SECTOR]);
+    return (fat_dir_entry_t *)&disk[v->root_lba * SECTOR];
+}
+
+static fat_dir_entry_t *find(fat_dir_entry_t *root, const char *name) {
+    for (int i = 0; i < 16 && root[i].name[0]; i++)
+        if (!memcmp(root[i].name, name, 11))
+            return &root[i];
+    return NULL;
+}
+
+/* Follows the cluster chain and returns the file, the chain must be exactly as long as the size needs */
+static uint32_t read_file(volume_t *v, const fat_dir_entry_t *entry, uint8_t *out, uint32_t max) {
+    const uint8_t *fat = &disk[v->fat_lba * SECTOR];
+    uint32_t cluster   = entry->cluster_low;
+    uint32_t read      = 0;
+    uint32_t clusters  = 0;
+
+    if (!entry->size) {
+        CHECK(cluster == 0);
+        return 0;
+    }
+
+    while (cluster >= 2 && cluster < 0xff8) {
+        for (uint32_t s = 0; s < v->bs.sectors_per_cluster; s++) {
+            uint8_t sector[SECTOR];
+            read_sector(v->data_lba + (cluster - 2) * v->bs.sectors_per_cluster + s, sector);
+
+            uint32_t n = MIN(SECTOR, entry->size > read ? entry->size - read : 0);
+            if (read + n <= max)
+                memcpy(&out[read], sector, n);
+            read += n;
+        }
+        clusters++;
+        cluster = fat12_entry(fat, cluster);
+    }
+
+    CHECK(cluster == 0xfff);
+    CHECK(clusters >= (entry->size + v->cluster_size - 1) / v->cluster_size);
+    return read;
+}
+
+static int count_lines(const char *text, uint32_t len) {
+    int lines = 0;
+
+    for (uint32_t i = 0; i + 1 < len; i++)
+        if (text[i] == '\r' && text[i + 1] == '\n')
+            lines++;
+    return lines;
+}
+
+/* Every field set to the value that prints widest, e.g. -128 or 4294967295 */
+static void set_widest_values(void) {
+    for (size_t i = 0; i < get_field_map_length(); i++) {
+        const field_map_t *map = get_field_map_index(i);
+        uint8_t *ptr = (uint8_t *)&global_state + map->offset;
+        bool is_signed = map->type == INT8 || map->type == INT16 || map->type == INT32 || map->len == 8;
+
+        memset(ptr, is_signed ? 0 : 0xFF, map->len);
+        if (is_signed)
+            ptr[map->len - 1] = 0x80;
+    }
+}
+
+static void check_volume(void) {
+    static uint8_t file[256 * 1024];
+    volume_t v = mount();
+    fat_dir_entry_t *root = read_root(&v);
+
+    /* config.htm comes straight from flash */
+    fat_dir_entry_t *htm = find(root, "CONFIG  HTM");
+    CHECK(htm && htm->size == (uint32_t)(_config_page_end - _config_page_start));
+    if (htm)
+        CHECK(read_file(&v, htm, file, sizeof(file)) == htm->size && !memcmp(file, _config_page_start, htm->size));
+
+    /* config.txt has every field, none cut off */
+    fat_dir_entry_t *txt = find(root, "CONFIG  TXT");
+    CHECK(txt != NULL);
+    if (txt) {
+        uint32_t len = read_file(&v, txt, file, sizeof(file));
+        CHECK(len == txt->size);
+        CHECK(count_lines((char *)file, len) == (int)get_field_map_length());
+        CHECK(len >= 2 && file[len - 2] == '\r' && file[len - 1] == '\n');
+
+        /* Each line is "index = value" and the value matches the config */
+        const field_map_t *map = get_field_map_entry(12);
+        char expect[32];
+        snprintf(expect, sizeof(expect), "\r\n12 = %ld\r\n", (long)global_state.config.output[0].speed_x);
+        file[len] = 0;
+        CHECK(map && strstr((char *)file, expect));
+    }
+
+    printf("config.txt: %u bytes, %zu fields\n", txt ? txt->size : 0, get_field_map_length());
+
+    /* Worst case, well over a cluster, still has to fit the space reserved for it */
+    device_t saved = global_state;
+    set_widest_values();
+
+    txt = find(read_root(&v), "CONFIG  TXT");
+    uint32_t len = read_file(&v, txt, file, sizeof(file));
+    global_state = saved;
+
+    CHECK(len == txt->size && len > v.cluster_size);
+    CHECK(count_lines((char *)file, len) == (int)get_field_map_length());
+    CHECK(file[len - 2] == '\r' && file[len - 1] == '\n');
+
+    printf("config.txt, every field at its widest: %u bytes\n", len);
+}
+
+/* status.txt changes length as uptime gains a digit. The directory and the data must come
+   from the same rendering, no matter how long the host takes between the two. */
+static void check_snapshot(void) {
+    static uint8_t file[4096];
+    volume_t v = mount();
+
+    host_time_us = 9 * 1000000ull;
+    fat_dir_entry_t status = *find(read_root(&v), "STATUS  TXT");
+
+    host_time_us = 10 * 1000000ull;
+    global_state.keyboard_connected = true;
+
+    uint32_t len = read_file(&v, &status, file, sizeof(file));
+    file[len] = 0;
+    CHECK(len == status.size);
+    CHECK(strstr((char *)file, "Uptime: 9 s\r\n") != NULL);
+    CHECK(strstr((char *)file, "Keyboard connected: no\r\n") != NULL);
+
+    /* The next directory read picks up the new values */
+    status = *find(read_root(&v), "STATUS  TXT");
+    len    = read_file(&v, &status, file, sizeof(file));
+    file[len] = 0;
+    CHECK(status.size == len);
+    CHECK(strstr((char *)file, "Uptime: 10 s\r\n") != NULL);
+    CHECK(strstr((char *)file, "Keyboard connected: yes\r\n") != NULL);
+}
+
+static int dump(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return 1;
+
+    for (uint32_t lba = 0; lba < sizeof(disk) / SECTOR; lba++)
+        read_sector(lba, &disk[lba * SECTOR]);
+
+    fwrite(disk, 1, sizeof(disk), f);
+    fclose(f);
+    return host_failures;
+}
+
+int main(int argc, char **argv) {
+    load_config(&global_state);
+    global_state.config_mode_active = true;
+
+    if (argc > 1)
+        return dump(argv[1]);
+
+    check_volume();
+    check_snapshot();
+    return host_result("fat");
+}
@@ -0,0 +1,210 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  UF2 upload over the config mode disk, with flash timings
+ *  A whole image is written through tud_msc_write10_cb, core1 runs process_fw_queue_task
+ *  in between. Every erase and program has to happen with core0 held off flash, and while
+ *  it's held off, core0 can't serve USB either, so bus and flash time add up.
+ *==============================================================================*/
+
+/* One 512 byte SCSI WRITE(10) at full speed, including the command and status transport */
+#define USB_BLOCK_US 600
+
+static uint8_t image[STAGING_IMAGE_SIZE];
+static uint8_t uf2_block[512];
+static int unprotected_writes;
+
+static void check_lockout(bool erase, uint32_t offset, size_t count) {
+    if (host_lockout_depth <= 0)
+        unprotected_writes++;
+}
+
+static void make_uf2_block(uint32_t block_no) {
+    uf2_t *uf2 = (uf2_t *)uf2_block;
+
+    *uf2 = (uf2_t){
+        .magicStart0 = UF2_MAGIC_START0,
+        .magicStart1 = UF2_MAGIC_START1,
+        .targetAddr  = 0x10000000 + block_no * FLASH_PAGE_SIZE,
+        .payloadSize = FLASH_PAGE_SIZE,
+        .blockNo     = block_no,
+        .numBlocks   = STAGING_PAGES_CNT,
+        .magicEnd    = UF2_MAGIC_END,
+    };
+    memcpy(uf2->data, &image[block_no * FLASH_PAGE_SIZE], FLASH_PAGE_SIZE);
+}
+
+/* Core1 gets the flash whenever it has something to do, core0 (and USB) waits */
+static void run_core1(void) {
+    host_core = 1;
+    for (int pass = 0; pass < 64; pass++)
+        process_fw_queue_task(&global_state);
+    host_core = 0;
+}
+
+/* What tud_msc_write10_cb used to do, inline: erase at sector start, then program */
+static uint64_t upload_inline(void) {
+    uint64_t start = host_time_us;
+
+    for (uint32_t block = 0; block < STAGING_PAGES_CNT; block++) {
+        uint32_t offset = (uint32_t)ADDR_FW_RUNNING - XIP_BASE + block * FLASH_PAGE_SIZE;
+        host_time_us += USB_BLOCK_US;
+
+        if (offset % FLASH_SECTOR_SIZE == 0)
+            flash_range_erase(offset, FLASH_SECTOR_SIZE);
+
+        flash_range_program(offset, &image[block * FLASH_PAGE_SIZE], FLASH_PAGE_SIZE);
+    }
+
+    return host_time_us - start;
+}
+
+static uint64_t upload_queued(void) {
+    uint64_t start = host_time_us;
+    uint32_t busy  = 0;
+
+    for (uint32_t block = 0; block < STAGING_PAGES_CNT; block++) {
+        make_uf2_block(block);
+        host_time_us += USB_BLOCK_US;
+
+        /* Queue full, TinyUSB retries the same block once core1 made room */
+        while (tud_msc_write10_cb(0, 100 + block, 0, uf2_block, sizeof(uf2_block)) == 0) {
+            busy++;
+            run_core1();
+        }
+
+        run_core1();
+    }
+
+    run_core1();
+    CHECK(busy == 0);
+    return host_time_us - start;
+}
+
+/* Upgrade from the other board, one word per UART round trip, with image[] as the other board's
+   firmware. Every fail_every-th page write times out once. Returns how many writes failed. */
+static int upgrade_over_uart(uint32_t fail_every) {
+    uart_packet_t packet;
+    uint32_t failed_at = 0;
+    int failures       = 0;
+
+    global_state.fw = (fw_upgrade_state_t){.upgrade_in_progress = true, .byte_done = true, .checksum = CRC32_INIT};
+    global_state.reboot_requested = false;
+
+    while (global_state.fw.upgrade_in_progress) {
+        uint32_t address = global_state.fw.address;
+        bool page_due    = address && address % FLASH_PAGE_SIZE == 0 && global_state.fw.byte_done;
+
+        if (page_due && (address / FLASH_PAGE_SIZE) % fail_every == 0 && failed_at != address) {
+            host_flash_safe_timeouts = 1;
+            failed_at                = address;
+            failures++;
+
+            /* Page stays in the buffer, nothing gets requested until it's written */
+            firmware_upgrade_task(&global_state);
+            CHECK(global_state.fw.byte_done && global_state.fw.upgrade_in_progress);
+            CHECK(queue_is_empty(&global_state.uart_tx_queue));
+        }
+
+        firmware_upgrade_task(&global_state);
+
+        /* What the other board does with REQUEST_BYTE_MSG */
+        while (queue_try_remove(&global_state.uart_tx_queue, &packet)) {
+            CHECK(packet.type == REQUEST_BYTE_MSG);
+
+            if (packet.data32[0] >= STAGING_IMAGE_SIZE)
+                continue;
+
+            memcpy(&packet.data32[1], &image[packet.data32[0]], sizeof(uint32_t));
+            handle_response_byte_msg(&packet, &global_state);
+        }
+    }
+
+    return failures;
+}
+
+int main(void) {
+    srand(27);
+    for (size_t i = 0; i < sizeof(image); i++)
+        image[i] = (uint8_t)rand();
+
+    crc32_init();
+    global_state.config_mode_active = true;
+    queue_init(&global_state.fw_queue, sizeof(fw_page_t), FW_QUEUE_LENGTH);
+
+    /* Both cores registered as lockout victims, as setup and core1_main do */
+    host_core = 1;
+    flash_safe_execute_core_init();
+    host_core = 0;
+    flash_safe_execute_core_init();
+
+    host_flash_timing = true;
+    host_flash_hook   = check_lockout;
+
+    uint64_t before = upload_inline();
+    memset((uint8_t *)ADDR_FW_RUNNING, 0, STAGING_IMAGE_SIZE); // Programming can't set bits, so this must be erased again
+
+    unprotected_writes = 0;
+    host_flash_stats   = (host_flash_stats_t){0};
+    uint64_t after     = upload_queued();
+
+    CHECK(unprotected_writes == 0);
+    CHECK(memcmp(ADDR_FW_RUNNING, image, sizeof(image)) == 0);
+    CHECK(global_state.reboot_requested);
+    CHECK(after < before);
+
+    printf("256k image: inline %.2f s, queued %.2f s, %u erased sectors, core0 held off flash at most %.0f ms\n",
+           before / 1e6, after / 1e6, host_flash_stats.erased_sectors, host_flash_stats.longest_lockout_us / 1e3);
+
+    /* Core0 didn't get off the flash in time, the page must stay queued and be written on the next pass */
+    global_state.reboot_requested = false;
+    make_uf2_block(0);
+    CHECK(tud_msc_write10_cb(0, 100, 0, uf2_block, sizeof(uf2_block)) == sizeof(uf2_block));
+
+    host_core                = 1;
+    host_flash_safe_timeouts = 1;
+    process_fw_queue_task(&global_state);
+    CHECK(queue_get_level(&global_state.fw_queue) == 1);
+    process_fw_queue_task(&global_state);
+    process_fw_queue_task(&global_state);
+    CHECK(queue_is_empty(&global_state.fw_queue));
+    CHECK(memcmp(ADDR_FW_RUNNING, image, FLASH_PAGE_SIZE) == 0);
+
+    /* Same image from the other board over UART, with page writes timing out along the way. A dropped
+       page would fail the checksum and wipe stage 2, each one has to be retried instead. */
+    host_core = 0;
+    host_flash_timing = false;
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    memset((uint8_t *)ADDR_FW_RUNNING, 0, STAGING_IMAGE_SIZE);
+
+    CHECK(upgrade_over_uart(37) > 0);
+    CHECK(global_state.reboot_requested);
+    CHECK(memcmp(ADDR_FW_RUNNING, image, sizeof(image)) == 0);
+
+    /* Image failed the checksum: stage 2 is wiped even if core1 keeps the flash busy for a while */
+    host_flash_safe_timeouts = FLASH_WIPE_ATTEMPTS - 1;
+    reject_firmware_image();
+    CHECK(host_flash_safe_timeouts == 0);
+    CHECK(((uint8_t *)ADDR_FW_RUNNING)[0] == 0xFF && ((uint8_t *)ADDR_FW_RUNNING)[FLASH_SECTOR_SIZE - 1] == 0xFF);
+
+    /* Without core0 registered as a victim, nothing gets written */
+    host_core            = 1;
+    host_lockout_victims = 1u << 1;
+    CHECK(!write_flash_page((uint32_t)ADDR_CONFIG - XIP_BASE, uf2_block));
+
+    return host_result("fw_upload");
+}
@@ -0,0 +1,308 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Gamepads
+ *  A DS4-style gamepad and a flight stick are mounted through tuh_hid_mount_cb
+ *  and parsed into field plans. Their reports are decoded into the standard
+ *  gamepad report, which goes to our host or, as changed fields only, to the
+ *  other board. A minute of play polled at 1 kHz has to reach the host of
+ *  either board exactly, the link load and decode time are reported.
+ *==============================================================================*/
+
+#define TRACE_LENGTH 60000 // One minute at 1 kHz
+
+extern uint64_t host_time_us;
+
+/* DS4-style: X, Y, Z, Rz bytes, a 0..7 hat, 14 buttons, 6 vendor bits, Rx, Ry, then vendor bytes */
+static const uint8_t ds4_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,                   // Generic Desktop, Gamepad, ID 1
+    0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35,                   //   X, Y, Z, Rz
+    0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x81, 0x02, //   0 - 255, 4 bytes
+    0x09, 0x39, 0x15, 0x00, 0x25, 0x07, 0x35, 0x00, 0x46, 0x3B, 0x01, //   Hat, 0 - 7
+    0x65, 0x14, 0x75, 0x04, 0x95, 0x01, 0x81, 0x42, 0x65, 0x00,       //   with a null state
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x0E, 0x15, 0x00, 0x25, 0x01,       //   14 buttons
+    0x75, 0x01, 0x95, 0x0E, 0x81, 0x02,                               //
+    0x06, 0x00, 0xFF, 0x09, 0x20, 0x75, 0x06, 0x95, 0x01, 0x15, 0x00, //   Vendor counter
+    0x25, 0x7F, 0x81, 0x02,                                           //
+    0x05, 0x01, 0x09, 0x33, 0x09, 0x34, 0x15, 0x00, 0x26, 0xFF, 0x00, //   Rx, Ry (triggers)
+    0x75, 0x08, 0x95, 0x02, 0x81, 0x02,                               //
+    0x06, 0x00, 0xFF, 0x09, 0x21, 0x95, 0x36, 0x81, 0x02,             //   Vendor bytes
+    0xC0,
+};
+
+/* Flight stick: signed 16 bit X and Y, a throttle, a 1..8 hat and 12 buttons, no report IDs */
+static const uint8_t stick_desc[] = {
+    0x05, 0x01, 0x09, 0x04, 0xA1, 0x01,                               // Generic Desktop, Joystick
+    0x09, 0x30, 0x09, 0x31, 0x16, 0x00, 0x80, 0x26, 0xFF, 0x7F,       //   X, Y
+    0x75, 0x10, 0x95, 0x02, 0x81, 0x02,                               //
+    0x09, 0x32, 0x15, 0x00, 0x25, 0xFF, 0x75, 0x08, 0x95, 0x01, 0x81, //   Throttle (Z), 0 - 255 in one byte
+    0x02,                                                             //
+    0x09, 0x39, 0x15, 0x01, 0x25, 0x08, 0x75, 0x04, 0x95, 0x01, 0x81, //   Hat, 1 - 8
+    0x42,                                                             //
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x15, 0x00, 0x25, 0x01,       //   12 buttons
+    0x75, 0x01, 0x95, 0x0C, 0x81, 0x02,                               //
+    0xC0,
+};
+
+static uint8_t trace[TRACE_LENGTH][64];
+static device_t peer; // Board on the other end of the link, driving the other output
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void ds4_report(uint8_t *report, int x, int y, int z, int rz, int hat, uint16_t buttons, int rx, int ry) {
+    memset(report, 0, 64);
+
+    report[0] = 1;
+    report[1] = x;
+    report[2] = y;
+    report[3] = z;
+    report[4] = rz;
+    report[5] = (hat & 0x0F) | (buttons & 0x0F) << 4;
+    report[6] = buttons >> 4;
+    report[7] = (buttons >> 12) & 0x03;
+    report[8] = rx;
+    report[9] = ry;
+}
+
+/* Sticks going round, triggers, the hat and a button now and then, and a vendor counter that changes always */
+static void record_play(void) {
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        double t = n / 1000.0;
+
+        ds4_report(trace[n], 128 + 100 * sin(t * 2), 128 + 100 * cos(t * 2), 128 + 60 * sin(t * 0.7) + (n & 1),
+                   128 - 60 * cos(t * 0.7), (n / 400) % 9, (n / 250) % 7 == 0 ? 1 << ((n / 250) % 14) : 0,
+                   (n / 3000) % 2 ? 255 : 0, 0);
+        trace[n][10] = n;
+    }
+}
+
+/* Newest gamepad report the host of this board got, if any */
+static bool take_reports(device_t *state, hid_gamepad_report_t *report) {
+    bool got = false;
+
+    while (!queue_is_empty(&state->hid_queue_out)) {
+        host_report_count = 0;
+        process_hid_queue_task(state);
+
+        if (!host_report_count)
+            continue;
+
+        CHECK(host_reports[0].instance == ITF_NUM_HID_REL_M && host_reports[0].report_id == REPORT_ID_GAMEPAD);
+        CHECK(host_reports[0].len == sizeof(hid_gamepad_report_t));
+
+        memcpy(report, host_reports[0].data, sizeof(*report));
+        got = true;
+    }
+
+    return got;
+}
+
+/* Link frames reach the other board as they'd arrive there, returns how many */
+static int deliver_to_peer(void) {
+    uart_packet_t packet;
+    int frames = 0;
+
+    while (queue_try_remove(&global_state.uart_tx_queue, &packet)) {
+        if (PACKET_TYPE(packet.type) != GAMEPAD_MSG)
+            continue;
+
+        gamepad_message(packet.data, &peer);
+        frames++;
+    }
+
+    return frames;
+}
+
+/* Both descriptors turn into plans, every board hears there's a gamepad */
+static void check_mount(void) {
+    tuh_hid_mount_cb(1, 0, ds4_desc, sizeof(ds4_desc));
+    tuh_hid_mount_cb(2, 0, stick_desc, sizeof(stick_desc));
+
+    hid_interface_t *ds4 = &global_state.iface[0][0], *stick = &global_state.iface[1][0];
+
+    /* X Y Z Rz hat buttons Rx Ry, the vendor fields left out */
+    CHECK(ds4->gamepad.is_found && ds4->gamepad.num_fields == 8 && ds4->uses_report_id);
+    CHECK(stick->gamepad.is_found && stick->gamepad.num_fields == 5 && !stick->uses_report_id);
+    CHECK(!ds4->passthrough && !stick->passthrough);
+
+    CHECK(global_state.gamepad.present && global_state.descriptors_changed);
+    CHECK(deliver_to_peer() == 2);
+    CHECK(peer.gamepad.present && peer.descriptors_changed);
+
+    /* Both hosts enumerated again and have the gamepad */
+    global_state.gamepad_active = peer.gamepad_active = true;
+    global_state.descriptors_changed = peer.descriptors_changed = false;
+}
+
+static void check_decode(void) {
+    gamepad_t *ds4 = &global_state.iface[0][0].gamepad, *stick = &global_state.iface[1][0].gamepad;
+    uint8_t report[64];
+
+    /* Ends of each axis, hat to the right, first and last button */
+    ds4_report(report, 0, 255, 128, 64, 2, 0x2001, 255, 0);
+    CHECK(gamepad_decode(ds4, &report[1], 63, 1));
+    CHECK(ds4->state.x == -127 && ds4->state.y == 127 && ds4->state.z == 0 && ds4->state.rz == -64);
+    CHECK(ds4->state.rx == 127 && ds4->state.ry == -127);
+    CHECK(ds4->state.hat == GAMEPAD_HAT_RIGHT && ds4->state.buttons == 0x2001);
+
+    /* Same again is no change, nor is another report ID, the hat's null state is centered */
+    CHECK(!gamepad_decode(ds4, &report[1], 63, 1));
+    CHECK(!gamepad_decode(ds4, &report[1], 63, 2));
+    ds4_report(report, 0, 255, 128, 64, 8, 0x2001, 255, 0);
+    CHECK(gamepad_decode(ds4, &report[1], 63, 1) && ds4->state.hat == GAMEPAD_HAT_CENTERED);
+
+    /* A report too short for the triggers leaves them alone */
+    ds4_report(report, 0, 255, 128, 64, 8, 0x2001, 0, 255);
+    CHECK(!gamepad_decode(ds4, &report[1], 7, 1) && ds4->state.rx == 127);
+
+    /* Stick at X min and Y max, full throttle, hat up */
+    uint8_t raw[7] = {0x00, 0x80, 0xFF, 0x7F, 0xFF, 0x51, 0x0A};
+    CHECK(gamepad_decode(stick, raw, sizeof(raw), 0));
+    CHECK(stick->state.x == -127 && stick->state.y == 127 && stick->state.z == 127);
+    CHECK(stick->state.hat == GAMEPAD_HAT_UP && stick->state.buttons == 0xA5);
+
+    /* Centered, hat in its null state */
+    memset(raw, 0, 4);
+    raw[5] = 0;
+    CHECK(gamepad_decode(stick, raw, sizeof(raw), 0));
+    CHECK(stick->state.x == 0 && stick->state.y == 0 && stick->state.hat == GAMEPAD_HAT_CENTERED);
+}
+
+/* Changed fields only, the whole state in two frames, and it all comes out the same on the other end */
+static void check_deltas(void) {
+    uint8_t frames[GAMEPAD_MAX_FRAMES][PACKET_DATA_LENGTH];
+    hid_gamepad_report_t from = {0}, to = {0}, received = {0};
+
+    CHECK(gamepad_delta_encode(&from, &to, false, frames) == 0);
+
+    to = (hid_gamepad_report_t){.x = 5, .y = -7, .z = 1, .rz = 2, .rx = 3, .ry = 4, .hat = 5, .buttons = 0x80000001};
+    CHECK(gamepad_delta_encode(&from, &to, true, frames) == 2);
+
+    gamepad_delta_apply(&received, frames[0]);
+    gamepad_delta_apply(&received, frames[1]);
+    CHECK(!memcmp(&received, &to, sizeof(to)));
+
+    from = to;
+    to.x = 9;
+    CHECK(gamepad_delta_encode(&from, &to, false, frames) == 1 && frames[0][0] == 1 << GAMEPAD_X);
+
+    gamepad_delta_apply(&received, frames[0]);
+    CHECK(!memcmp(&received, &to, sizeof(to)));
+}
+
+/* A minute of play for our host, then a minute for the other board's */
+static void check_play(void) {
+    hid_gamepad_report_t *state = &global_state.iface[0][0].gamepad.state, got, released = {0};
+    long changes = 0, remote_changes = 0, frames = 0, exact = 0;
+    double decode_ns = 0;
+
+    record_play();
+    global_state.active_output = BOARD_ROLE;
+
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        double start = now_ns();
+
+        tuh_hid_report_received_cb(1, 0, trace[n], 64);
+        decode_ns += now_ns() - start;
+        host_time_us += 1000;
+
+        if (take_reports(&global_state, &got)) {
+            changes++;
+            exact += !memcmp(&got, state, sizeof(got));
+        }
+    }
+
+    /* Switching over, our host is left with nothing pressed */
+    global_state.active_output = OTHER_ROLE;
+    gamepad_link_task(&global_state);
+    tuh_hid_report_received_cb(1, 0, trace[0], 64);
+
+    CHECK(take_reports(&global_state, &got) && !memcmp(&got, &released, sizeof(got)));
+    deliver_to_peer();
+    take_reports(&peer, &got);
+
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        tuh_hid_report_received_cb(1, 0, trace[n], 64);
+        host_time_us += 1000;
+
+        int sent = deliver_to_peer();
+
+        if (take_reports(&peer, &got)) {
+            changes++;
+            remote_changes++;
+            frames += sent;
+            exact += !memcmp(&got, state, sizeof(got));
+        }
+    }
+
+    printf("%d reports, %ld state changes, %ld byte exact, %.2f link frames per change (2 for the whole state), "
+           "%.0f frames/s, %.0f ns per report\n",
+           2 * TRACE_LENGTH, changes, exact, (double)frames / remote_changes, frames / (TRACE_LENGTH / 1000.0),
+           decode_ns / TRACE_LENGTH);
+
+    CHECK(changes > TRACE_LENGTH && exact == changes);
+    CHECK(2 * frames < 3 * remote_changes);
+}
+
+/* Changes made while the link is busy go out together once it's free */
+static void check_busy_link(void) {
+    uart_packet_t blocker = {0};
+    hid_gamepad_report_t got;
+    uint8_t report[64];
+
+    global_state.active_output = OTHER_ROLE;
+    queue_try_add(&global_state.uart_tx_queue, &blocker);
+
+    for (int n = 0; n < 10; n++) {
+        ds4_report(report, 10 * n, 0, 0, 0, 8, 1 << n, 0, 0);
+        tuh_hid_report_received_cb(1, 0, report, 64);
+    }
+
+    CHECK(deliver_to_peer() == 0);
+    gamepad_link_task(&global_state);
+
+    /* Ten reports, one update with what they changed together */
+    int frames = deliver_to_peer();
+    CHECK(frames > 0 && frames <= GAMEPAD_MAX_FRAMES);
+
+    CHECK(take_reports(&peer, &got) && !memcmp(&got, &global_state.iface[0][0].gamepad.state, sizeof(got)));
+    CHECK(got.buttons == 1 << 9);
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    queue_init(&global_state.hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
+    queue_init(&peer.hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+
+    global_state.tud_connected = peer.tud_connected = true;
+    host_hid_ready             = true;
+
+    check_mount();
+    check_decode();
+    check_deltas();
+    check_play();
+    check_busy_link();
+
+    return host_result("gamepad");
+}
@@ -0,0 +1,282 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Hotkey matcher
+ *  With user hotkeys added, a report must match what it matched with the
+ *  built-in ones alone, or else the first user hotkey it holds. The tables are
+ *  rebuilt on one thread while another keeps matching, like core0 and core1.
+ *  Built with MAX_USER_HOTKEYS raised to 48, 61 hotkeys with the built-in ones.
+ *==============================================================================*/
+
+#define REPORTS 4096
+
+static hid_keyboard_report_t reports[REPORTS];
+static const hotkey_combo_t *builtin_match[REPORTS];
+
+/* Keys the random reports and hotkeys are made of, few enough that they overlap */
+static uint8_t random_key(void) {
+    return HID_KEY_A + rand() % 40;
+}
+
+static void random_reports(void) {
+    for (int i = 0; i < REPORTS; i++) {
+        reports[i] = (hid_keyboard_report_t){.modifier = rand() % 4 ? 0 : rand() & 0xff};
+
+        for (int k = rand() % 4; k > 0; k--)
+            reports[i].keycode[k - 1] = random_key();
+    }
+}
+
+static void random_user_hotkeys(void) {
+    for (int n = 0; n < MAX_USER_HOTKEYS; n++) {
+        user_hotkey_t *hotkey = &global_state.config.user_hotkeys[n];
+
+        *hotkey = (user_hotkey_t){
+            .modifier = rand() % 2 ? 1u << (rand() % 8) : 0,
+            .keys     = {random_key(), rand() % 2 ? random_key() : 0},
+            .action   = n % 2 ? HOTKEY_ACTION_MACRO + n % MAX_MACROS : 1 + rand() % MAX_HOTKEY_ACTION,
+        };
+    }
+}
+
+/* First user hotkey the report holds, by going through all of them */
+static const user_hotkey_t *first_user_match(const hid_keyboard_report_t *report) {
+    for (int n = 0; n < MAX_USER_HOTKEYS; n++) {
+        const user_hotkey_t *hotkey = &global_state.config.user_hotkeys[n];
+
+        if ((report->modifier & hotkey->modifier) != hotkey->modifier)
+            continue;
+
+        if (key_in_report(hotkey->keys[0], report) && (!hotkey->keys[1] || key_in_report(hotkey->keys[1], report)))
+            return hotkey;
+    }
+
+    return NULL;
+}
+
+static void check_equivalence(void) {
+    static hotkey_combo_t builtin_copy[REPORTS];
+    int builtin_hits = 0, user_hits = 0;
+
+    srand(32);
+    random_reports();
+
+    /* Built-in hotkeys alone */
+    memset(global_state.config.user_hotkeys, 0, sizeof(global_state.config.user_hotkeys));
+    build_keyboard_tables(&global_state);
+
+    for (int i = 0; i < REPORTS; i++) {
+        builtin_match[i] = check_all_hotkeys(&reports[i], &global_state);
+        if (builtin_match[i])
+            builtin_copy[i] = *builtin_match[i];
+    }
+
+    for (int round = 0; round < 20; round++) {
+        random_user_hotkeys();
+        build_keyboard_tables(&global_state);
+
+        for (int i = 0; i < REPORTS; i++) {
+            const hotkey_combo_t *match = check_all_hotkeys(&reports[i], &global_state);
+            const user_hotkey_t *user   = first_user_match(&reports[i]);
+
+            /* Built-in ones come first */
+            if (builtin_match[i]) {
+                CHECK(match && !memcmp(match, &builtin_copy[i], sizeof(hotkey_combo_t)));
+                builtin_hits++;
+                continue;
+            }
+
+            CHECK((match == NULL) == (user == NULL));
+            if (!match || !user)
+                continue;
+
+            CHECK(match->modifier == user->modifier && match->keys[0] == user->keys[0]);
+            CHECK(user->action >= HOTKEY_ACTION_MACRO ? match->macro == user->action - HOTKEY_ACTION_MACRO + 1
+                                                      : match->action_handler != NULL && !match->macro);
+            user_hits++;
+        }
+    }
+
+    printf("matcher: %d built-in and %d user hotkey matches as expected\n", builtin_hits, user_hits);
+}
+
+/*==============================================================================
+ *  Rebuilding while the other core matches
+ *==============================================================================*/
+
+static volatile bool stop;
+static volatile uint32_t checks;
+static int torn;
+
+#define KEY_IN_A HID_KEY_F13
+#define KEY_IN_B HID_KEY_F14
+
+/* Config A has user hotkey 0 on KEY_IN_A, config B on KEY_IN_B. Any match has to be all A or all B. */
+static void use_config(bool a) {
+    global_state.config.user_hotkeys[0] = (user_hotkey_t){
+        .modifier = KEYBOARD_MODIFIER_LEFTGUI,
+        .keys     = {a ? KEY_IN_A : KEY_IN_B},
+        .action   = a ? HOTKEY_ACTION_MOUSE_ZOOM : HOTKEY_ACTION_SWITCH_LOCK,
+    };
+}
+
+static void *matching_core(void *arg) {
+    hid_keyboard_report_t report = {.modifier = KEYBOARD_MODIFIER_LEFTGUI};
+
+    while (!stop) {
+        report.keycode[0] = checks & 1 ? KEY_IN_A : KEY_IN_B;
+        const hotkey_combo_t *match = check_all_hotkeys(&report, &global_state);
+
+        if (match && (match->keys[0] != report.keycode[0] || match->modifier != KEYBOARD_MODIFIER_LEFTGUI))
+            torn++;
+
+        checks = checks + 1;
+    }
+
+    return NULL;
+}
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Up to 20000 rebuilds or half a second, on a single CPU the threads only take turns now and then */
+static void check_concurrent_rebuild(void) {
+    pthread_t core1;
+    struct timespec start;
+    int rebuilds = 0;
+
+    memset(global_state.config.user_hotkeys, 0, sizeof(global_state.config.user_hotkeys));
+    use_config(true);
+    build_keyboard_tables(&global_state);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&core1, NULL, matching_core, NULL);
+
+    for (int i = 0; i < 20000 && seconds_since(&start) < 0.5; i++, rebuilds++) {
+        uint32_t seen = checks;
+
+        use_config(i & 1);
+        build_keyboard_tables(&global_state);
+
+        /* Config changes come far apart, the other side is done with its report by the next one */
+        while (checks - seen < 2)
+            sched_yield();
+    }
+
+    stop = true;
+    pthread_join(core1, NULL);
+
+    CHECK(torn == 0);
+    printf("%d rebuilds during %u matches, %d torn\n", rebuilds, checks, torn);
+}
+
+/*==============================================================================
+ *  Cost per report, everything configured, against the linear walk the
+ *  matcher replaced: every hotkey in priority order until one matches
+ *==============================================================================*/
+
+static hotkey_combo_t linear[64];
+static int linear_count;
+
+static void build_linear(void) {
+    linear_count = 0;
+    CHECK(builtin_hotkey_count + MAX_USER_HOTKEYS <= ARRAY_SIZE(linear));
+
+    for (int n = 0; n < builtin_hotkey_count; n++)
+        linear[linear_count++] = hotkeys[n];
+
+    for (int n = 0; n < MAX_USER_HOTKEYS; n++) {
+        const user_hotkey_t *user = &global_state.config.user_hotkeys[n];
+        hotkey_combo_t *hotkey    = &linear[linear_count++];
+
+        *hotkey = (hotkey_combo_t){.modifier = user->modifier};
+        for (int k = 0; k < ARRAY_SIZE(user->keys); k++)
+            if (user->keys[k])
+                hotkey->keys[hotkey->key_count++] = user->keys[k];
+    }
+}
+
+static const hotkey_combo_t *check_linear(const hid_keyboard_report_t *report) {
+    for (int n = 0; n < linear_count; n++)
+        if (check_specific_hotkey(&linear[n], report))
+            return &linear[n];
+
+    return NULL;
+}
+
+static bool same_hotkey(const hotkey_combo_t *a, const hotkey_combo_t *b) {
+    if (!a || !b)
+        return a == b;
+
+    return a->modifier == b->modifier && a->key_count == b->key_count && !memcmp(a->keys, b->keys, a->key_count);
+}
+
+static double ns_per_report(const struct timespec *start, const struct timespec *end, int iterations) {
+    return ((end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec)) / iterations / REPORTS;
+}
+
+static void benchmark(void) {
+    const int iterations = 500;
+    volatile uintptr_t sink = 0;
+    struct timespec start, end;
+    int matches = 0;
+
+    srand(132);
+    random_user_hotkeys();
+    build_keyboard_tables(&global_state);
+    build_linear();
+
+    CHECK(linear_count >= 50);
+
+    for (int i = 0; i < REPORTS; i++) {
+        const hotkey_combo_t *match = check_all_hotkeys(&reports[i], &global_state);
+
+        CHECK(same_hotkey(match, check_linear(&reports[i])));
+        matches += match != NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++)
+        for (int i = 0; i < REPORTS; i++)
+            sink += (uintptr_t)check_linear(&reports[i]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double before = ns_per_report(&start, &end, iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++)
+        for (int i = 0; i < REPORTS; i++)
+            sink += (uintptr_t)check_all_hotkeys(&reports[i], &global_state);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double after = ns_per_report(&start, &end, iterations);
+
+    printf("%d hotkeys, %d of %d reports match: linear walk %.1f ns, matcher %.1f ns per report\n", linear_count,
+           matches, REPORTS, before, after);
+}
+
+int main(void) {
+    load_config(&global_state);
+
+    check_equivalence();
+    check_concurrent_rebuild();
+    benchmark();
+    return host_result("hotkeys");
+}
@@ -0,0 +1,210 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Merging the keyboards into one report
+ *  combine_kbd_states against the merge it replaced, which went through each
+ *  keyboard's report and added the keys not in the result yet. Up to 6 keys
+ *  held, both must give the same keys and modifiers. With more, the keys the
+ *  host already has must stay, so it never sees a release that didn't happen.
+ *==============================================================================*/
+
+#define SOURCES (MAX_KBD_SLOTS + 1) // Local keyboards, then the remote one
+
+static hid_keyboard_report_t reports[SOURCES];
+
+/* The previous merge, as it was */
+static void add_keys(hid_keyboard_report_t *dest, const hid_keyboard_report_t *src) {
+    for (uint8_t i = 0; i < KEYS_IN_USB_REPORT; i++) {
+        uint8_t key = src->keycode[i];
+
+        if (key == 0 || key_in_report(key, dest))
+            continue;
+
+        uint8_t *empty_slot = memchr(dest->keycode, 0, KEYS_IN_USB_REPORT);
+        if (empty_slot)
+            *empty_slot = key;
+    }
+}
+
+static void reference_merge(int keyboards, hid_keyboard_report_t *combined) {
+    memset(combined, 0, sizeof(*combined));
+
+    for (int i = 0; i < keyboards; i++) {
+        combined->modifier |= reports[i].modifier;
+        add_keys(combined, &reports[i]);
+    }
+
+    combined->modifier |= reports[MAX_KBD_SLOTS].modifier;
+    add_keys(combined, &reports[MAX_KBD_SLOTS]);
+}
+
+static void set_report(int source, const hid_keyboard_report_t *report) {
+    reports[source] = *report;
+
+    if (source == MAX_KBD_SLOTS)
+        update_remote_kbd_state(&global_state, &reports[source]);
+    else
+        update_kbd_state(&global_state, &reports[source], source);
+}
+
+static void use_keyboards(int keyboards) {
+    static const hid_keyboard_report_t released = {0};
+
+    for (int i = 0; i < SOURCES; i++)
+        set_report(i, &released);
+
+    memset(global_state.combined_keys, 0, sizeof(global_state.combined_keys));
+    global_state.kbd_slots_used = (1u << keyboards) - 1;
+}
+
+static int held_keys(int keyboards, uint8_t held[256]) {
+    int count = 0;
+
+    memset(held, 0, 256);
+    for (int i = 0; i < SOURCES; i++) {
+        if (i >= keyboards && i != MAX_KBD_SLOTS)
+            continue;
+
+        for (int k = 0; k < KEYS_IN_USB_REPORT; k++)
+            if (reports[i].keycode[k] && !held[reports[i].keycode[k]]++)
+                count++;
+    }
+
+    return count;
+}
+
+static bool same_keys(const hid_keyboard_report_t *a, const hid_keyboard_report_t *b) {
+    for (int k = 0; k < KEYS_IN_USB_REPORT; k++)
+        if (key_in_report(a->keycode[k], b) != true || key_in_report(b->keycode[k], a) != true)
+            return false;
+
+    return true;
+}
+
+/* Random presses and releases on random keyboards, from a small set of keys so they overlap */
+static void check_random(void) {
+    hid_keyboard_report_t combined, previous = {0}, expected;
+    uint8_t held[256];
+    int compared = 0, overflows = 0;
+
+    srand(31);
+
+    for (int run = 0; run < 2000; run++) {
+        int keyboards = 1 + rand() % 4;
+        use_keyboards(keyboards);
+        memset(&previous, 0, sizeof(previous));
+
+        for (int step = 0; step < 50; step++) {
+            int source = rand() % (keyboards + 1);
+            hid_keyboard_report_t report = reports[source == keyboards ? MAX_KBD_SLOTS : source];
+            int k = rand() % KEYS_IN_USB_REPORT;
+
+            report.keycode[k] = report.keycode[k] ? 0 : HID_KEY_A + rand() % 12;
+            report.modifier ^= rand() % 4 ? 0 : 1u << (rand() % 8);
+            set_report(source == keyboards ? MAX_KBD_SLOTS : source, &report);
+
+            combine_kbd_states(&global_state, &combined);
+            reference_merge(keyboards, &expected);
+            CHECK(combined.modifier == expected.modifier);
+
+            if (held_keys(keyboards, held) <= KEYS_IN_USB_REPORT) {
+                CHECK(same_keys(&combined, &expected));
+                compared++;
+            } else {
+                /* Full report of held keys, with every one still held from the last report */
+                for (int i = 0; i < KEYS_IN_USB_REPORT; i++) {
+                    CHECK(combined.keycode[i] && held[combined.keycode[i]]);
+                    CHECK(!previous.keycode[i] || !held[previous.keycode[i]] || key_in_report(previous.keycode[i], &combined));
+                }
+                overflows++;
+            }
+
+            previous = combined;
+        }
+    }
+
+    printf("random merges: %d equal to the previous merge, %d with more than 6 keys held\n", compared, overflows);
+}
+
+/* Six keys held on one keyboard, a seventh (lower usage) on another */
+static void check_rollover(void) {
+    hid_keyboard_report_t combined;
+    hid_keyboard_report_t six = {.keycode = {HID_KEY_Z, HID_KEY_Y, HID_KEY_X, HID_KEY_W, HID_KEY_V, HID_KEY_U}};
+    hid_keyboard_report_t seventh = {.keycode = {HID_KEY_A}};
+
+    use_keyboards(2);
+    set_report(0, &six);
+    combine_kbd_states(&global_state, &combined);
+
+    set_report(1, &seventh);
+    combine_kbd_states(&global_state, &combined);
+    CHECK(same_keys(&combined, &six));
+
+    /* One of the six released, the waiting key gets in */
+    six.keycode[0] = 0;
+    set_report(0, &six);
+    combine_kbd_states(&global_state, &combined);
+    CHECK(key_in_report(HID_KEY_A, &combined) && !key_in_report(HID_KEY_Z, &combined));
+    CHECK(key_in_report(HID_KEY_U, &combined));
+}
+
+static double elapsed_ns(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+/* Host timings only show how the cost grows with keyboards, not what it is on the RP2040 */
+static void benchmark(void) {
+    const int iterations = 200000;
+    hid_keyboard_report_t combined;
+    volatile uint8_t sink = 0;
+
+    for (int keyboards = 1; keyboards <= MAX_KBD_SLOTS; keyboards *= 2) {
+        struct timespec start;
+
+        use_keyboards(keyboards);
+        for (int i = 0; i < keyboards; i++) {
+            hid_keyboard_report_t report = {.modifier = 1u << (i % 8), .keycode = {HID_KEY_A + i, HID_KEY_B + i}};
+            set_report(i, &report);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < iterations; i++) {
+            reference_merge(keyboards, &combined);
+            sink += combined.keycode[i % KEYS_IN_USB_REPORT];
+        }
+        double before = elapsed_ns(&start) / iterations;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < iterations; i++) {
+            combine_kbd_states(&global_state, &combined);
+            sink += combined.keycode[i % KEYS_IN_USB_REPORT];
+        }
+        double after = elapsed_ns(&start) / iterations;
+
+        printf("%2d keyboards: previous merge %6.1f ns, bitmap merge %6.1f ns\n", keyboards, before, after);
+    }
+}
+
+int main(void) {
+    check_random();
+    check_rollover();
+    benchmark();
+    return host_result("kbd_merge");
+}
@@ -0,0 +1,151 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Keyboard queue
+ *  Typing on one keyboard while a second one keeps sending idle reports, with
+ *  a host that stops taking reports every now and then. Whatever is dropped
+ *  or skipped, the host must see every press (with the modifiers it had) and
+ *  every release that it would have seen with each report delivered.
+ *==============================================================================*/
+
+#define TRACE_LENGTH 20000
+#define MAX_EDGES    (TRACE_LENGTH * 2)
+
+static hid_interface_t typing = {.protocol = HID_PROTOCOL_BOOT, .num_keyboards = 1};
+static hid_interface_t idle   = {.protocol = HID_PROTOCOL_BOOT, .num_keyboards = 1};
+
+typedef struct {
+    uint16_t presses[MAX_EDGES]; // Key << 8 | modifier, for each key press
+    int press_count;
+    int release_count;
+    hid_keyboard_report_t current;
+} host_view_t;
+
+static hid_keyboard_report_t trace[TRACE_LENGTH];
+
+/* Keys going down and up as the host sees them */
+static void host_receive(host_view_t *host, const hid_keyboard_report_t *report) {
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++) {
+        uint8_t key = report->keycode[i];
+
+        if (key && !key_in_report(key, &host->current))
+            host->presses[host->press_count++] = key << 8 | report->modifier;
+
+        if (host->current.keycode[i] && !key_in_report(host->current.keycode[i], report))
+            host->release_count++;
+    }
+
+    host->current = *report;
+}
+
+/* Rolling typing, up to 6 keys held at once, shift now and then, repeated reports in between */
+static void record_trace(void) {
+    hid_keyboard_report_t report = {0};
+    int held = 0;
+
+    srand(36);
+
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        int action = rand() % 4;
+
+        if (action == 0 && held < KEYS_IN_USB_REPORT) {
+            uint8_t key = HID_KEY_A + rand() % 36;
+
+            if (!key_in_report(key, &report))
+                report.keycode[held++] = key;
+        } else if (action == 1 && held) {
+            int i = rand() % held;
+            report.keycode[i]      = report.keycode[--held];
+            report.keycode[held] = 0;
+        } else if (action == 2)
+            report.modifier ^= KEYBOARD_MODIFIER_LEFTSHIFT;
+
+        trace[n] = report;
+    }
+}
+
+static void send_raw(hid_interface_t *iface, const hid_keyboard_report_t *report) {
+    uint8_t raw[KBD_REPORT_LENGTH] = {report->modifier, 0};
+
+    memcpy(&raw[2], report->keycode, KEYS_IN_USB_REPORT);
+    process_keyboard_report(raw, sizeof(raw), 0, iface);
+}
+
+static void check_trace(void) {
+    static host_view_t expected, seen;
+    static const hid_keyboard_report_t released = {0};
+    uint32_t max_level = 0;
+
+    record_trace();
+
+    for (int n = 0; n < TRACE_LENGTH; n++)
+        host_receive(&expected, &trace[n]);
+
+    /* Each tick (1 ms) the typing keyboard and the idle one send a report, the kbd task runs twice */
+    for (int tick = 0; tick < TRACE_LENGTH + 200; tick++) {
+        if (tick < TRACE_LENGTH) {
+            send_raw(&typing, &trace[tick]);
+            send_raw(&idle, &released);
+        }
+
+        max_level = MAX(max_level, queue_get_level(&global_state.kbd_queue));
+
+        /* The host takes a report per tick, but stops polling for 40 ms out of every 100 */
+        host_hid_ready = tick % 100 < 60 || tick >= TRACE_LENGTH;
+
+        for (int pass = 0; pass < 2; pass++) {
+            host_report_count = 0;
+            process_kbd_queue_task(&global_state);
+
+            if (host_report_count) {
+                host_receive(&seen, (const hid_keyboard_report_t *)host_reports[0].data);
+                host_hid_ready = false;
+            }
+        }
+    }
+
+    CHECK(seen.press_count == expected.press_count);
+    CHECK(!memcmp(seen.presses, expected.presses, expected.press_count * sizeof(uint16_t)));
+    CHECK(seen.release_count == expected.release_count);
+
+    /* Ends up with the same keys held, the order of keys in a report doesn't matter */
+    CHECK(seen.current.modifier == expected.current.modifier);
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++)
+        CHECK(key_in_report(expected.current.keycode[i], &seen.current));
+
+    CHECK(global_state.stats.kbd_duplicates > 0 && global_state.stats.kbd_coalesced > 0);
+    CHECK(global_state.stats.queue_drops[STATS_KBD_QUEUE] == 0);
+
+    printf("%d reports typed, %u duplicates dropped, %u coalesced, %d presses and %d releases seen, "
+           "at most %u queued\n",
+           TRACE_LENGTH, global_state.stats.kbd_duplicates, global_state.stats.kbd_coalesced, seen.press_count,
+           seen.release_count, max_level);
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
+    global_state.tud_connected = true;
+    global_state.active_output = BOARD_ROLE;
+
+    keyboard_mount(1, 0, &typing, &global_state);
+    keyboard_mount(2, 0, &idle, &global_state);
+
+    check_trace();
+
+    return host_result("kbd_queue");
+}
@@ -0,0 +1,306 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Keyboard slots
+ *  Four keyboards behind a hub and a composite one with two report IDs are
+ *  mounted through tuh_hid_mount_cb, typed on through
+ *  tuh_hid_report_received_cb and unplugged through tuh_hid_umount_cb. Each
+ *  keyboard keeps its keys in a slot of its own, so what the host sees is
+ *  always what all of them hold together. The old fixed slot rules are run
+ *  next to it for comparison, and combining is timed per number of keyboards.
+ *==============================================================================*/
+
+#define HUB_KEYBOARDS 4
+#define RANDOM_REPORTS 200000
+
+/* Boot keyboard layout: modifiers, a reserved byte and 6 keys, no report IDs */
+static const uint8_t keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,                   // Generic Desktop, Keyboard
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, //   Modifiers
+    0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,             //
+    0x75, 0x08, 0x95, 0x01, 0x81, 0x01,                   //   Reserved
+    0x19, 0x00, 0x29, 0x65, 0x15, 0x00, 0x25, 0x65,       //   6 keys
+    0x75, 0x08, 0x95, 0x06, 0x81, 0x00,                   //
+    0xC0,
+};
+
+/* Composite: the same layout as report 1, and a second keyboard as report 2 */
+static const uint8_t composite_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,       // Generic Desktop, Keyboard, ID 1
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, //   Modifiers
+    0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,             //
+    0x75, 0x08, 0x95, 0x01, 0x81, 0x01,                   //   Reserved
+    0x19, 0x00, 0x29, 0x65, 0x15, 0x00, 0x25, 0x65,       //   6 keys
+    0x75, 0x08, 0x95, 0x06, 0x81, 0x00,                   //
+    0xC0,                                                 //
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x02,       // Generic Desktop, Keyboard, ID 2
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, //   Modifiers
+    0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,             //
+    0x75, 0x08, 0x95, 0x01, 0x81, 0x01,                   //   Reserved
+    0x19, 0x00, 0x29, 0x65, 0x15, 0x00, 0x25, 0x65,       //   6 keys
+    0x75, 0x08, 0x95, 0x06, 0x81, 0x00,                   //
+    0xC0,
+};
+
+static hid_keyboard_report_t host; // What the host holds now
+static int host_updates;
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static hid_keyboard_report_t keys(uint8_t modifier, uint8_t first, uint8_t second) {
+    return (hid_keyboard_report_t){.modifier = modifier, .keycode = {first, second}};
+}
+
+/* Everything the host was sent by now */
+static void host_poll(void) {
+    while (!queue_is_empty(&global_state.kbd_queue)) {
+        host_report_count = 0;
+        process_kbd_queue_task(&global_state);
+
+        if (host_report_count) {
+            memcpy(&host, host_reports[0].data, sizeof(host));
+            host_updates++;
+        }
+    }
+}
+
+static void type(uint8_t dev_addr, uint8_t instance, uint8_t report_id, hid_keyboard_report_t report) {
+    uint8_t raw[KBD_REPORT_LENGTH + 1] = {report_id};
+    int offset = report_id ? 1 : 0;
+
+    raw[offset] = report.modifier;
+    memcpy(&raw[offset + 2], report.keycode, KEYS_IN_USB_REPORT);
+
+    tuh_hid_report_received_cb(dev_addr, instance, raw, KBD_REPORT_LENGTH + offset);
+    host_poll();
+}
+
+static void unplug(uint8_t dev_addr, uint8_t instance) {
+    tuh_hid_umount_cb(dev_addr, instance);
+    host_poll();
+}
+
+static keyboard_t *keyboard_of(uint8_t dev_addr, uint8_t instance, int index) {
+    return &global_state.iface[dev_addr - 1][instance].keyboards[index];
+}
+
+/* Four keyboards behind a hub, typing at the same time */
+static void check_hub(void) {
+    for (int addr = 1; addr <= HUB_KEYBOARDS; addr++) {
+        tuh_hid_mount_cb(addr, 0, keyboard_desc, sizeof(keyboard_desc));
+        CHECK(keyboard_of(addr, 0, 0)->slot == addr - 1);
+    }
+
+    CHECK(global_state.kbd_slots_used == 0x0F);
+
+    type(1, 0, 0, keys(0, HID_KEY_A, 0));
+    type(2, 0, 0, keys(0, HID_KEY_B, 0));
+    type(3, 0, 0, keys(KEYBOARD_MODIFIER_LEFTSHIFT, HID_KEY_C, 0));
+    type(4, 0, 0, keys(0, HID_KEY_D, 0));
+
+    CHECK(key_in_report(HID_KEY_A, &host) && key_in_report(HID_KEY_B, &host));
+    CHECK(key_in_report(HID_KEY_C, &host) && key_in_report(HID_KEY_D, &host));
+    CHECK(host.modifier == KEYBOARD_MODIFIER_LEFTSHIFT);
+
+    /* One of the secondary keyboards letting go doesn't take another one's keys along */
+    type(2, 0, 0, keys(0, 0, 0));
+    CHECK(!key_in_report(HID_KEY_B, &host) && key_in_report(HID_KEY_C, &host) && key_in_report(HID_KEY_D, &host));
+    type(4, 0, 0, keys(0, 0, 0));
+    CHECK(key_in_report(HID_KEY_C, &host) && !key_in_report(HID_KEY_D, &host));
+
+    /* Unplugged while holding a key, the host sees it released */
+    int updates = host_updates;
+
+    unplug(3, 0);
+    CHECK(host_updates == updates + 1 && !key_in_report(HID_KEY_C, &host) && !host.modifier);
+    CHECK(key_in_report(HID_KEY_A, &host) && global_state.kbd_slots_used == 0x0B);
+
+    /* One holding nothing has nothing to tell */
+    updates = host_updates;
+    unplug(4, 0);
+    CHECK(host_updates == updates && global_state.kbd_slots_used == 0x03);
+}
+
+/* One interface, two keyboards by report ID, a slot for each */
+static void check_composite(void) {
+    tuh_hid_mount_cb(3, 1, composite_desc, sizeof(composite_desc));
+
+    CHECK(global_state.iface[2][1].num_keyboards == 2);
+    CHECK(keyboard_of(3, 1, 0)->slot == 2 && keyboard_of(3, 1, 1)->slot == 3);
+    CHECK(global_state.kbd_slots[3].dev_addr == 3 && global_state.kbd_slots[3].instance == 1);
+    CHECK(global_state.kbd_slots[3].report_id == 2);
+
+    type(3, 1, 2, keys(0, HID_KEY_Z, 0));
+    type(3, 1, 1, keys(0, HID_KEY_Y, 0));
+    CHECK(key_in_report(HID_KEY_Z, &host) && key_in_report(HID_KEY_Y, &host) && key_in_report(HID_KEY_A, &host));
+
+    type(3, 1, 1, keys(0, 0, 0));
+    CHECK(key_in_report(HID_KEY_Z, &host) && !key_in_report(HID_KEY_Y, &host));
+
+    unplug(3, 1);
+    CHECK(!key_in_report(HID_KEY_Z, &host) && global_state.kbd_slots_used == 0x03);
+}
+
+/* With every slot taken, one more keyboard is left out and can't touch anyone else's keys */
+static void check_full(void) {
+    for (int k = 0; k < MAX_KBD_SLOTS - 2; k++)
+        tuh_hid_mount_cb(2 + k / (MAX_INTERFACES - 1), 1 + k % (MAX_INTERFACES - 1), keyboard_desc,
+                         sizeof(keyboard_desc));
+
+    CHECK(global_state.kbd_slots_used == 0xFFFF);
+
+    tuh_hid_mount_cb(4, 5, keyboard_desc, sizeof(keyboard_desc));
+    CHECK(keyboard_of(4, 5, 0)->slot == KBD_SLOT_NONE);
+
+    type(4, 5, 0, keys(0, HID_KEY_Q, 0));
+    CHECK(!key_in_report(HID_KEY_Q, &host) && key_in_report(HID_KEY_A, &host));
+
+    unplug(4, 5);
+    CHECK(global_state.kbd_slots_used == 0xFFFF);
+
+    /* Back to the first two */
+    for (int k = 0; k < MAX_KBD_SLOTS - 2; k++)
+        unplug(2 + k / (MAX_INTERFACES - 1), 1 + k % (MAX_INTERFACES - 1));
+
+    CHECK(global_state.kbd_slots_used == 0x03);
+}
+
+/* The old rules: slot 0 for the first device, MAX_DEVICES-2 for every other keyboard */
+static kbd_state_t old_slots[MAX_DEVICES];
+
+static void old_rules(uint8_t dev_addr, const hid_keyboard_report_t *report, hid_keyboard_report_t *combined) {
+    kbd_state_t *slot = &old_slots[dev_addr == 1 ? 0 : MAX_DEVICES - 2];
+    int count         = 0;
+
+    memset(slot, 0, sizeof(*slot));
+    memset(combined, 0, sizeof(*combined));
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++)
+        if (report->keycode[i])
+            slot->keys[report->keycode[i] >> 5] |= 1u << (report->keycode[i] & 31);
+
+    for (int s = 0; s < MAX_DEVICES; s++)
+        for (int w = 0; w < KBD_BITMAP_WORDS; w++)
+            for (uint32_t bits = old_slots[s].keys[w]; bits && count < KEYS_IN_USB_REPORT; bits &= bits - 1)
+                combined->keycode[count++] = w << 5 | __builtin_ctz(bits);
+}
+
+/* Has every key the keyboards hold, and nothing else */
+static bool holds(const hid_keyboard_report_t *report, const hid_keyboard_report_t *held) {
+    int count = 0;
+
+    for (int k = 1; k <= HUB_KEYBOARDS; k++) {
+        if (!held[k].keycode[0])
+            continue;
+
+        if (!key_in_report(held[k].keycode[0], report))
+            return false;
+
+        count++;
+    }
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++)
+        count -= report->keycode[i] != 0;
+
+    return count == 0;
+}
+
+/* Random typing on the four hub keyboards, a key each at most */
+static void check_random(void) {
+    hid_keyboard_report_t held[HUB_KEYBOARDS + 1] = {0}, old;
+    long wrong = 0, wrong_old = 0;
+    uint32_t seed = 50;
+
+    for (int addr = 3; addr <= HUB_KEYBOARDS; addr++)
+        tuh_hid_mount_cb(addr, 0, keyboard_desc, sizeof(keyboard_desc));
+
+    type(1, 0, 0, keys(0, 0, 0));
+
+    for (long n = 0; n < RANDOM_REPORTS; n++) {
+        seed     = seed * 1664525 + 1013904223;
+        int addr = 1 + (seed >> 28) % HUB_KEYBOARDS;
+
+        held[addr] = (seed >> 20) & 3 ? keys(0, HID_KEY_A + 4 * (addr - 1) + ((seed >> 8) & 3), 0) : keys(0, 0, 0);
+
+        type(addr, 0, 0, held[addr]);
+        old_rules(addr, &held[addr], &old);
+
+        wrong += !holds(&host, held);
+        wrong_old += !holds(&old, held);
+    }
+
+    printf("%d keyboards, %d reports: wrong host state after %ld with slots, %ld with the old rules\n", HUB_KEYBOARDS,
+           RANDOM_REPORTS, wrong, wrong_old);
+
+    CHECK(wrong == 0 && wrong_old > 0);
+}
+
+/* Combining only walks the slots in use */
+static void bench_combine(void) {
+    device_t *state = &global_state;
+    kbd_slot_t saved[MAX_KBD_SLOTS];
+    uint16_t saved_used = state->kbd_slots_used;
+
+    memcpy(saved, state->kbd_slots, sizeof(saved));
+
+    for (int count = 1; count <= MAX_KBD_SLOTS; count *= 2) {
+        hid_keyboard_report_t combined;
+        volatile uint8_t sink = 0;
+
+        memset(state->kbd_slots, 0, sizeof(state->kbd_slots));
+        state->kbd_slots_used = count == 16 ? 0xFFFF : (1u << count) - 1;
+
+        for (int s = 0; s < count; s++)
+            update_kbd_state(state, &(hid_keyboard_report_t){.keycode = {HID_KEY_A + s}}, s);
+
+        double start = now_ns();
+
+        for (int i = 0; i < 1000000; i++) {
+            state->kbd_slots[0].state.modifier = i;
+            combine_kbd_states(state, &combined);
+            sink += combined.keycode[0];
+        }
+
+        printf("combining %2d keyboards: %.1f ns\n", count, (now_ns() - start) / 1e6);
+    }
+
+    memcpy(state->kbd_slots, saved, sizeof(saved));
+    state->kbd_slots_used = saved_used;
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+
+    global_state.tud_connected = true;
+    global_state.active_output = BOARD_ROLE;
+    host_hid_ready             = true;
+
+    check_hub();
+    check_composite();
+    check_full();
+    check_random();
+    bench_combine();
+
+    return host_result("kbd_slots");
+}
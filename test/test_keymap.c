@@ -0,0 +1,109 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Per-output keymaps
+ *  Boot keyboard reports go through process_keyboard_report and come out of the
+ *  keyboard queue, remapped with the table of the output they're going to.
+ *==============================================================================*/
+
+static hid_interface_t iface = {.protocol = HID_PROTOCOL_BOOT, .num_keyboards = 1};
+
+static hid_keyboard_report_t type(uint8_t modifier, uint8_t key) {
+    uint8_t raw[KBD_REPORT_LENGTH] = {modifier, 0, key};
+    hid_keyboard_report_t sent = {0};
+
+    process_keyboard_report(raw, sizeof(raw), 0, &iface);
+    CHECK(queue_try_remove(&global_state.kbd_queue, &sent));
+
+    /* Release, so the next one isn't a duplicate */
+    memset(raw, 0, sizeof(raw));
+    process_keyboard_report(raw, sizeof(raw), 0, &iface);
+    queue_try_remove(&global_state.kbd_queue, &(hid_keyboard_report_t){0});
+
+    return sent;
+}
+
+static void use_output(uint8_t output) {
+    global_state.active_output = output;
+    global_state.board_role    = output;
+}
+
+static void check_remaps(void) {
+    keymap_t *linux_map = &global_state.config.output[OUTPUT_A].keymap;
+    keymap_t *mac_map   = &global_state.config.output[OUTPUT_B].keymap;
+    hid_keyboard_report_t sent;
+
+    /* Caps Lock is Ctrl on A, Cmd and Ctrl swap places on B */
+    linux_map->remap[0] = (key_remap_t){.from = HID_KEY_CAPS_LOCK, .to = HID_KEY_CONTROL_LEFT};
+    linux_map->remap[1] = (key_remap_t){.from = HID_KEY_F13, .to = HID_KEY_ESCAPE};
+    mac_map->modifier_map[0] = 3 + 1; // Left Ctrl -> Left GUI
+    mac_map->modifier_map[3] = 0 + 1; // Left GUI -> Left Ctrl
+    build_keyboard_tables(&global_state);
+
+    use_output(OUTPUT_A);
+    sent = type(0, HID_KEY_CAPS_LOCK);
+    CHECK(sent.modifier == KEYBOARD_MODIFIER_LEFTCTRL && sent.keycode[0] == 0);
+
+    sent = type(KEYBOARD_MODIFIER_LEFTGUI, HID_KEY_F13);
+    CHECK(sent.modifier == KEYBOARD_MODIFIER_LEFTGUI && sent.keycode[0] == HID_KEY_ESCAPE);
+
+    use_output(OUTPUT_B);
+    sent = type(KEYBOARD_MODIFIER_LEFTCTRL, HID_KEY_C);
+    CHECK(sent.modifier == KEYBOARD_MODIFIER_LEFTGUI && sent.keycode[0] == HID_KEY_C);
+
+    sent = type(KEYBOARD_MODIFIER_LEFTGUI | KEYBOARD_MODIFIER_LEFTSHIFT, HID_KEY_CAPS_LOCK);
+    CHECK(sent.modifier == (KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT));
+    CHECK(sent.keycode[0] == HID_KEY_CAPS_LOCK);
+}
+
+/* Remapping is a table lookup per key, so it costs the same however many remaps there are */
+static double ns_per_report(int remaps) {
+    const int reports = 200000;
+    uint8_t raw[KBD_REPORT_LENGTH] = {0};
+    struct timespec start, end;
+
+    memset(&global_state.config.output[OUTPUT_A].keymap, 0, sizeof(keymap_t));
+    for (int n = 0; n < remaps; n++)
+        global_state.config.output[OUTPUT_A].keymap.remap[n] = (key_remap_t){HID_KEY_A + n, HID_KEY_Z - n};
+
+    build_keyboard_tables(&global_state);
+    use_output(OUTPUT_A);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < reports; i++) {
+        raw[2] = i & 1 ? HID_KEY_A + i % 8 : 0;
+        process_keyboard_report(raw, sizeof(raw), 0, &iface);
+        queue_try_remove(&global_state.kbd_queue, &(hid_keyboard_report_t){0});
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / reports;
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
+    global_state.tud_connected = true;
+    keyboard_mount(1, 0, &iface, &global_state);
+
+    check_remaps();
+
+    double identity = ns_per_report(0), remapped = ns_per_report(MAX_KEY_REMAPS);
+    printf("process_keyboard_report: %.1f ns without remaps, %.1f ns with %d\n", identity, remapped, MAX_KEY_REMAPS);
+
+    return host_result("keymap");
+}
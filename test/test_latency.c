@@ -0,0 +1,225 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Latency bookkeeping, on the virtual clock
+ *  A keyboard report is followed from the device to the host through the real
+ *  keyboard path, with reports queued ahead of it. For the other board, the
+ *  heartbeat gives the clock offset, the report's time stamp then has to come
+ *  out as the time it spent on the link, also where the stamp wraps around.
+ *==============================================================================*/
+
+/* The other board's clock runs this far ahead of ours */
+#define PEER_CLOCK_AHEAD 12345
+
+static hid_interface_t keyboard = {.protocol = HID_PROTOCOL_BOOT, .num_keyboards = 1};
+
+static uint32_t hop_samples(enum latency_hop_e hop) {
+    uint32_t sum = 0;
+
+    for (int n = 0; n < LAT_NUM_BUCKETS; n++)
+        sum += global_state.latency.hist[hop][n];
+
+    return sum;
+}
+
+static bool sampled_once(enum latency_hop_e hop, uint32_t us) {
+    return hop_samples(hop) == 1 && global_state.latency.hist[hop][latency_bucket(us)] == 1;
+}
+
+static void reset_histograms(void) {
+    memset(global_state.latency.hist, 0, sizeof(global_state.latency.hist));
+}
+
+static hid_keyboard_report_t key_report(uint8_t key) {
+    return (hid_keyboard_report_t){.keycode = {key}};
+}
+
+/* A report from our keyboard, as tuh_hid_report_received_cb hands it over, parsed parse_us later */
+static void device_report(uint8_t key, uint32_t parse_us) {
+    uint8_t raw[KBD_REPORT_LENGTH] = {0, 0, key};
+
+    latency_received();
+    host_time_us += parse_us;
+    process_keyboard_report(raw, sizeof(raw), 0, &keyboard);
+}
+
+/* Host polls once a millisecond, returns when it got a report holding the key */
+static uint64_t host_polls_until(uint8_t key) {
+    for (int poll = 0; poll < 100; poll++) {
+        host_time_us += 1000;
+        host_report_count = 0;
+        process_kbd_queue_task(&global_state);
+
+        if (host_report_count && key_in_report(key, (hid_keyboard_report_t *)host_reports[0].data))
+            return host_time_us;
+
+        /* Not out yet, so nothing may be recorded for it */
+        CHECK(hop_samples(LAT_HOP_DEVICE) == 0 && hop_samples(LAT_HOP_TOTAL) == 0);
+    }
+
+    CHECK(!"report never reached the host");
+    return 0;
+}
+
+static void check_buckets(void) {
+    CHECK(latency_bucket(0) == 0 && latency_bucket(63) == 0);
+    CHECK(latency_bucket(64) == 1 && latency_bucket(127) == 1);
+    CHECK(latency_bucket(128) == 2 && latency_bucket(4095) == 6);
+    CHECK(latency_bucket(4096) == 7 && latency_bucket(UINT32_MAX) == LAT_NUM_BUCKETS - 1);
+}
+
+/* Three reports queued ahead of the one followed, the host takes one per poll */
+static void check_local(void) {
+    reset_histograms();
+    host_hid_ready = true;
+
+    for (uint8_t key = HID_KEY_A; key <= HID_KEY_C; key++) {
+        hid_keyboard_report_t report = key_report(key);
+        queue_kbd_report(&report, &global_state);
+    }
+
+    uint64_t received = host_time_us;
+    device_report(HID_KEY_D, 150);
+    CHECK(sampled_once(LAT_HOP_PARSE, 150));
+    CHECK(sampled_once(LAT_HOP_ENQUEUE, 0));
+
+    uint64_t sent = host_polls_until(HID_KEY_D);
+    CHECK(sampled_once(LAT_HOP_DEVICE, sent - received - 150));
+    CHECK(sampled_once(LAT_HOP_TOTAL, sent - received));
+
+    printf("local: received -> host %.1f ms with 3 reports ahead\n", (sent - received) / 1e3);
+}
+
+/* A queued probe is only replaced once it's been lost for LAT_PROBE_TIMEOUT */
+static void check_timeout(void) {
+    reset_histograms();
+    host_hid_ready = false;
+
+    device_report(HID_KEY_F, 0);
+    host_time_us += 1000;
+    device_report(HID_KEY_G, 0);
+    CHECK(hop_samples(LAT_HOP_PARSE) == 1);
+
+    host_time_us += LAT_PROBE_TIMEOUT;
+    uint64_t received = host_time_us;
+    device_report(HID_KEY_H, 0);
+    CHECK(hop_samples(LAT_HOP_PARSE) == 2);
+
+    host_hid_ready = true;
+    uint64_t sent  = host_polls_until(HID_KEY_H);
+    CHECK(sampled_once(LAT_HOP_TOTAL, sent - received));
+}
+
+/* Reports for the other board carry when we got them, in 64 us steps */
+static void check_tag(void) {
+    uart_packet_t packet;
+
+    reset_histograms();
+    global_state.active_output = OTHER_ROLE;
+
+    host_time_us = (host_time_us / LAT_STAMP_RANGE + 1) * LAT_STAMP_RANGE + 17 * 64 + 5;
+    device_report(HID_KEY_I, 0);
+
+    CHECK(queue_try_peek(&global_state.uart_tx_queue, &packet));
+    CHECK(packet.type == KEYBOARD_REPORT_MSG && packet.data[1] == 17);
+
+    host_time_us += 40;
+    process_uart_tx_task(&global_state);
+    CHECK(sampled_once(LAT_HOP_UART_TX, 40));
+
+    global_state.active_output = BOARD_ROLE;
+}
+
+/* Heartbeat from the other board, its transfer started at `ours` on our clock */
+static void peer_heartbeat(uint32_t ours) {
+    uart_packet_t packet = {.type = HEARTBEAT_MSG};
+
+    packet.data16[0] = global_state._running_fw.version;
+    packet.data16[1] = ours + PEER_CLOCK_AHEAD;
+
+    host_time_us = ours + LAT_UART_WIRE_US(global_state.link.baud);
+    handle_heartbeat_msg(&packet, &global_state);
+}
+
+/* Keyboard report the other board received at `ours` (our clock), here `link_us` later */
+static void peer_report(uint32_t ours, uint32_t link_us, uint8_t key) {
+    uart_packet_t packet = {.type = KEYBOARD_REPORT_MSG};
+    hid_keyboard_report_t report = key_report(key);
+    uint8_t tag = (uint32_t)(ours + PEER_CLOCK_AHEAD) >> LAT_STAMP_SHIFT;
+
+    report.reserved = tag ? tag : 1;
+    memcpy(packet.data, &report, sizeof(report));
+
+    host_time_us = ours + link_us;
+    handle_keyboard_uart_msg(&packet, &global_state);
+}
+
+static void check_remote(void) {
+    const uint32_t link_us = 700;
+    uint32_t base          = (host_time_us / 65536 + 16) * 65536;
+
+    reset_histograms();
+    global_state.link.baud = SERIAL_BAUDRATE;
+
+    /* Unknown offset, nothing to measure yet */
+    peer_report(base - 200000, link_us, HID_KEY_J);
+    CHECK(hop_samples(LAT_HOP_LINK) == 0);
+    host_polls_until(HID_KEY_J);
+
+    peer_heartbeat(base - 100000);
+    CHECK(global_state.latency.clock_synced);
+    CHECK(global_state.latency.clock_offset == (uint16_t)-PEER_CLOCK_AHEAD);
+
+    /* Somewhere in the middle, right before the 16 ms stamp wraps and right before the other board's
+       16 bit clock does. The stamp is the start of a 64 us step, the middle of it is taken. */
+    const uint32_t received[] = {
+        base + 3000,
+        base + 65536 + 5 * LAT_STAMP_RANGE - PEER_CLOCK_AHEAD - 100,
+        base + 3 * 65536 - PEER_CLOCK_AHEAD - 100,
+    };
+
+    for (int n = 0; n < ARRAY_SIZE(received); n++) {
+        reset_histograms();
+        peer_heartbeat(received[n] - 10000);
+
+        peer_report(received[n], link_us, HID_KEY_K + n);
+        CHECK(sampled_once(LAT_HOP_LINK, link_us));
+
+        /* Followed to our host, starting from when the other board got it */
+        uint64_t sent = host_polls_until(HID_KEY_K + n);
+        CHECK(sampled_once(LAT_HOP_TOTAL, sent - received[n]));
+        CHECK(hop_samples(LAT_HOP_ENQUEUE) == 0);
+    }
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+    global_state.tud_connected = true;
+    global_state.active_output = BOARD_ROLE;
+    host_time_us               = 1000000;
+
+    keyboard_mount(1, 0, &keyboard, &global_state);
+
+    check_buckets();
+    check_local();
+    check_timeout();
+    check_tag();
+    check_remote();
+    return host_result("latency");
+}
@@ -0,0 +1,323 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Screen layout
+ *  Layouts are compiled into a transition table and looked up on every edge
+ *  crossing. Without a layout configured, the table must do what pos,
+ *  screen_count and border always did. With one, every edge must lead to the
+ *  neighbour touching it, at the same place in layout coordinates.
+ *==============================================================================*/
+
+typedef struct {
+    int x, y, w, h;
+} rect_t;
+
+static int random_between(int lo, int hi) {
+    return lo + rand() % (hi - lo + 1);
+}
+
+static enum screen_pos_e opposite(enum screen_pos_e edge) {
+    return edge == LEFT ? RIGHT : edge == RIGHT ? LEFT : edge == TOP ? BOTTOM : TOP;
+}
+
+/* Vertical mapping between outputs before the layout, from the old scale_y_coordinate */
+static int legacy_scale_y(const output_t *from, const output_t *to, int y) {
+    int size_to = to->border.bottom - to->border.top, size_from = from->border.bottom - from->border.top;
+
+    if (size_from == size_to)
+        return y;
+
+    if (size_from > size_to)
+        return to->border.top + (size_to * y) / MAX_SCREEN_COORD;
+
+    if (y < from->border.top)
+        return MIN_SCREEN_COORD;
+
+    if (y > from->border.bottom)
+        return MAX_SCREEN_COORD;
+
+    return ((y - from->border.top) * MAX_SCREEN_COORD) / size_from;
+}
+
+/* Random pos, screen_count and border, switching must go where the old do_screen_switch went */
+static void check_legacy(void) {
+    static screen_layout_t layout;
+    output_t outputs[NUM_SCREENS];
+
+    for (int iter = 0; iter < 2000; iter++) {
+        int a_right = rand() % 2;
+
+        memset(outputs, 0, sizeof(outputs));
+
+        for (int out = 0; out < NUM_SCREENS; out++) {
+            outputs[out].number       = out;
+            outputs[out].screen_count = random_between(1, MAX_OUTPUT_SCREENS);
+            outputs[out].pos          = (out == 0) == a_right ? RIGHT : LEFT;
+            outputs[out].border       = (border_size_t){MIN_SCREEN_COORD, MAX_SCREEN_COORD};
+        }
+
+        /* One of them bigger, with the band the other one maps to */
+        if (rand() % 3) {
+            int big = rand() % 2, top = random_between(0, 20000);
+            outputs[big].border = (border_size_t){top, random_between(top + 2000, MAX_SCREEN_COORD)};
+        }
+
+        compile_screen_layout(&layout, outputs);
+
+        for (int out = 0; out < NUM_SCREENS; out++) {
+            for (int i = 0; i < outputs[out].screen_count; i++) {
+                for (enum screen_pos_e edge = LEFT; edge <= BOTTOM; edge++) {
+                    int pos = random_between(MIN_SCREEN_COORD, MAX_SCREEN_COORD), expected_pos = pos;
+                    int expected_out = -1, expected_index = -1;
+                    int16_t mapped = -1;
+
+                    if (edge == MIDDLE)
+                        continue;
+
+                    const screen_transition_t *to = find_screen_transition(&layout, out, i, edge, pos, &mapped);
+
+                    /* Away from the other output walks through our own screens, towards it the main one
+                       goes over, top and bottom lead nowhere */
+                    if (edge == TOP || edge == BOTTOM)
+                        ;
+                    else if (outputs[out].pos != edge) {
+                        expected_out   = i == 0 ? 1 - out : out;
+                        expected_index = i == 0 ? 0 : i - 1;
+
+                        if (i == 0)
+                            expected_pos = legacy_scale_y(&outputs[out], &outputs[1 - out], pos);
+                    } else if (i + 1 < outputs[out].screen_count) {
+                        expected_out   = out;
+                        expected_index = i + 1;
+                    }
+
+                    if (expected_out < 0) {
+                        CHECK(to == NULL);
+                        continue;
+                    }
+
+                    CHECK(to != NULL);
+                    if (!to)
+                        continue;
+
+                    CHECK(to->output == expected_out && to->index == expected_index);
+                    CHECK(abs(mapped - expected_pos) <= 2);
+                }
+            }
+        }
+    }
+}
+
+static bool overlaps(rect_t a, rect_t b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/* Each new screen is put on a random edge of one already placed, at a random offset along it */
+static int place_screens(rect_t *rects, int count) {
+    int placed = 1;
+
+    rects[0] = (rect_t){random_between(-2000, 2000), random_between(-2000, 2000), random_between(800, 4000),
+                        random_between(600, 3000)};
+
+    for (int tries = 0; placed < count && tries < 1000; tries++) {
+        rect_t next = {0, 0, random_between(800, 4000), random_between(600, 3000)};
+        rect_t from = rects[rand() % placed];
+        bool free = true;
+
+        switch (rand() % 4) {
+            case 0:
+                next.x = from.x - next.w;
+                next.y = from.y + random_between(-next.h + 1, from.h - 1);
+                break;
+            case 1:
+                next.x = from.x + from.w;
+                next.y = from.y + random_between(-next.h + 1, from.h - 1);
+                break;
+            case 2:
+                next.y = from.y - next.h;
+                next.x = from.x + random_between(-next.w + 1, from.w - 1);
+                break;
+            default:
+                next.y = from.y + from.h;
+                next.x = from.x + random_between(-next.w + 1, from.w - 1);
+                break;
+        }
+
+        for (int k = 0; k < placed; k++)
+            free &= !overlaps(next, rects[k]);
+
+        if (free)
+            rects[placed++] = next;
+    }
+
+    return placed;
+}
+
+static bool touching(rect_t from, rect_t to, enum screen_pos_e edge) {
+    return edge == LEFT    ? to.x + to.w == from.x
+           : edge == RIGHT ? from.x + from.w == to.x
+           : edge == TOP   ? to.y + to.h == from.y
+                           : from.y + from.h == to.y;
+}
+
+/* Random layouts, checked against a brute force search for the neighbour, and the way back */
+static void check_random(void) {
+    static screen_layout_t layout;
+    output_t outputs[NUM_SCREENS];
+    rect_t rects[MAX_LAYOUT_SCREENS];
+    int id[MAX_LAYOUT_SCREENS], covered = 0, gaps = 0, none = 0;
+
+    for (int iter = 0; iter < 3000; iter++) {
+        int counts[NUM_SCREENS], total = 0, k = 0;
+
+        for (int out = 0; out < NUM_SCREENS; out++)
+            total += counts[out] = random_between(1, MAX_OUTPUT_SCREENS);
+
+        int count = place_screens(rects, total);
+
+        if (count < total)
+            continue;
+
+        memset(outputs, 0, sizeof(outputs));
+
+        for (int out = 0; out < NUM_SCREENS; out++) {
+            outputs[out].screen_count = counts[out];
+
+            for (int i = 0; i < counts[out]; i++, k++) {
+                outputs[out].layout[i] = (screen_rect_t){rects[k].x, rects[k].y, rects[k].w, rects[k].h};
+                id[k]                  = out * MAX_OUTPUT_SCREENS + i;
+            }
+        }
+
+        compile_screen_layout(&layout, outputs);
+
+        for (int s = 0; s < count; s++) {
+            for (enum screen_pos_e edge = LEFT; edge <= BOTTOM; edge++) {
+                bool vertical = edge == TOP || edge == BOTTOM;
+                int start = vertical ? rects[s].x : rects[s].y, len = vertical ? rects[s].w : rects[s].h;
+
+                if (edge == MIDDLE)
+                    continue;
+
+                for (int sample = 0; sample < 8; sample++) {
+                    int pos = random_between(MIN_SCREEN_COORD, MAX_SCREEN_COORD), best = -1;
+                    double at = start + (double)pos * len / MAX_SCREEN_COORD, best_distance = 1e18;
+                    bool inside = false, near_corner = false;
+                    int16_t mapped = -1, returned = -1;
+
+                    const screen_transition_t *to = find_screen_transition(
+                        &layout, id[s] / MAX_OUTPUT_SCREENS, id[s] % MAX_OUTPUT_SCREENS, edge, pos, &mapped);
+
+                    /* The neighbour on this edge that contains the position, or else the closest one */
+                    for (int q = 0; q < count; q++) {
+                        int q_start = vertical ? rects[q].x : rects[q].y, q_len = vertical ? rects[q].w : rects[q].h;
+                        double distance = at < q_start ? q_start - at : at > q_start + q_len ? at - q_start - q_len : 0;
+
+                        if (q == s || !touching(rects[s], rects[q], edge)
+                            || MIN(start + len, q_start + q_len) <= MAX(start, q_start))
+                            continue;
+
+                        if (fabs(at - q_start) < 3 || fabs(at - q_start - q_len) < 3)
+                            near_corner = true;
+
+                        if (distance < best_distance) {
+                            best_distance = distance;
+                            best          = q;
+                            inside        = distance == 0;
+                        }
+                    }
+
+                    if (best < 0) {
+                        none++;
+                        CHECK(to == NULL);
+                        continue;
+                    }
+
+                    CHECK(to != NULL);
+
+                    /* A part of the edge with nobody behind it goes to the closest screen, ties either way */
+                    if (!to || near_corner || !inside) {
+                        gaps += !inside;
+                        continue;
+                    }
+
+                    covered++;
+
+                    int b_start = vertical ? rects[best].x : rects[best].y, b_len = vertical ? rects[best].w : rects[best].h;
+                    int expected = (at - b_start) * MAX_SCREEN_COORD / b_len;
+
+                    CHECK(to->output * MAX_OUTPUT_SCREENS + to->index == id[best]);
+                    CHECK(abs(mapped - expected) <= 40);
+
+                    /* Crossing back over the opposite edge lands where it came from */
+                    const screen_transition_t *back =
+                        find_screen_transition(&layout, to->output, to->index, opposite(edge), mapped, &returned);
+
+                    CHECK(back && back->output * MAX_OUTPUT_SCREENS + back->index == id[s]);
+                    CHECK(back && abs(returned - pos) <= 40 * (1 + len / b_len + b_len / len));
+                }
+            }
+        }
+    }
+
+    printf("random layouts: %d samples on a neighbour, %d in a gap, %d with no neighbour\n", covered, gaps, none);
+}
+
+/* A config change compiles into the other copy, a lookup in progress keeps seeing the old layout */
+static void check_rebuild(void) {
+    output_t *b = &global_state.config.output[OUTPUT_B];
+    int16_t mapped;
+
+    /* A and B side by side, any other outputs further right, out of the way */
+    for (int out = 0; out < NUM_SCREENS; out++) {
+        output_t *output = &global_state.config.output[out];
+
+        output->screen_count = output->screen_index = 1;
+        output->layout[0]    = (screen_rect_t){out * 1920 + (out > OUTPUT_B) * 1920, 0, 1920, 1080};
+    }
+
+    global_state.active_output = OUTPUT_A;
+    build_screen_layout(&global_state);
+
+    const screen_transition_t *before = screen_transition(&global_state, RIGHT, 1000, &mapped);
+    screen_transition_t seen          = *before;
+
+    CHECK(before->output == OUTPUT_B && screen_transition(&global_state, BOTTOM, 1000, NULL) == NULL);
+
+    /* B moves under A and gets twice as big */
+    b->layout[0] = (screen_rect_t){0, 1080, 3840, 2160};
+    build_screen_layout(&global_state);
+
+    CHECK(!memcmp(before, &seen, sizeof(seen)));
+    CHECK(screen_transition(&global_state, RIGHT, 1000, NULL) == NULL);
+    CHECK(screen_transition(&global_state, BOTTOM, 1000, &mapped)->output == OUTPUT_B && abs(mapped - 500) <= 1);
+}
+
+int main(void) {
+    srand(41);
+    load_config(&global_state);
+
+    /* The old switching only knew a pair of outputs */
+    if (NUM_SCREENS == 2)
+        check_legacy();
+
+    check_random();
+    check_rebuild();
+
+    return host_result("layout");
+}
@@ -0,0 +1,314 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Link rate negotiation
+ *  Two boards, each with its own link manager, over a virtual UART that flips
+ *  bits at a rate set per baud rate. Both send mouse traffic and heartbeats
+ *  like the firmware does. Frames sent at a rate the receiver isn't at come
+ *  out as garbage, most of them fail the checksum.
+ *==============================================================================*/
+
+#define FRAME_BITS   (RAW_PACKET_LENGTH * 10) // 8N1
+#define TX_QUEUE_LEN 256
+#define STEP_US      5
+
+typedef struct {
+    uint8_t preamble[START_LENGTH];
+    uart_packet_t packet;
+} __attribute__((packed)) frame_t;
+
+typedef struct {
+    device_t dev;
+    uint32_t baud;
+    frame_t queue[TX_QUEUE_LEN];
+    int head, tail;
+    bool busy;             // A frame is on the wire ...
+    frame_t sending;       // ... this one ...
+    uint32_t sending_baud; // ... at this rate ...
+    uint64_t done_at;      // ... until then
+    bool ignores_link;     // Older firmware, doesn't know LINK_MSG
+    int drop_commits;      // This many LINK_COMMITs we send get lost
+} board_t;
+
+static board_t boards[2];
+static double bit_error_rate[LINK_NUM_RATES];
+static const double mismatch_error_rate = 0.5; // Garbage that looks like a frame, but fails the checksum
+
+static double random_unit(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static board_t *board_of(device_t *state) {
+    return state == &boards[0].dev ? &boards[0] : &boards[1];
+}
+
+static void send_frame(board_t *board, uint8_t type, const void *data, int len) {
+    frame_t frame = {.preamble = {START1, START2}, .packet = {.type = type}};
+
+    if ((board->tail + 1) % TX_QUEUE_LEN == board->head)
+        return;
+
+    memcpy(frame.packet.data, data, len);
+    frame.packet.checksum = calc_checksum(frame.packet.data, PACKET_DATA_LENGTH);
+
+    board->queue[board->tail] = frame;
+    board->tail               = (board->tail + 1) % TX_QUEUE_LEN;
+}
+
+static void sim_send(const link_msg_t *msg, device_t *state) {
+    board_t *board = board_of(state);
+
+    if (msg->op == LINK_COMMIT && board->drop_commits > 0) {
+        board->drop_commits--;
+        return;
+    }
+
+    send_frame(board, LINK_MSG, msg, sizeof(link_msg_t));
+}
+
+static void sim_set_rate(uint32_t baud, device_t *state) {
+    board_of(state)->baud = baud;
+}
+
+static bool sim_tx_idle(device_t *state) {
+    board_t *board = board_of(state);
+    return board->head == board->tail && !board->busy;
+}
+
+static void sim_settled(device_t *state) {
+}
+
+static const link_io_t sim_link = {
+    .send     = &sim_send,
+    .set_rate = &sim_set_rate,
+    .tx_idle  = &sim_tx_idle,
+    .settled  = &sim_settled,
+};
+
+static double error_rate_at(uint32_t baud) {
+    for (int i = 0; i < LINK_NUM_RATES; i++)
+        if (link_rates[i] == baud)
+            return bit_error_rate[i];
+
+    return 0;
+}
+
+/* Same checks as the receiver in uart.c, a hit in the preamble makes it skip the frame */
+static void receive(board_t *rx, frame_t frame, uint32_t baud) {
+    uint8_t *bytes = (uint8_t *)&frame;
+    double ber     = error_rate_at(baud);
+
+    if (baud != rx->baud) {
+        if (random_unit() < mismatch_error_rate)
+            rx->dev.stats.uart_checksum_errors++;
+        return;
+    }
+
+    for (int bit = 0; ber > 0 && bit < sizeof(frame) * 8; bit++)
+        if (random_unit() < ber)
+            bytes[bit / 8] ^= 1 << (bit % 8);
+
+    if (frame.preamble[0] != START1 || frame.preamble[1] != START2)
+        return;
+
+    if (!verify_checksum(&frame.packet)) {
+        rx->dev.stats.uart_checksum_errors++;
+        return;
+    }
+
+    rx->dev.stats.uart_rx_packets++;
+
+    if (frame.packet.type == LINK_MSG && !rx->ignores_link)
+        link_received(&rx->dev.link, (const link_msg_t *)frame.packet.data);
+    else if (frame.packet.type == HEARTBEAT_MSG)
+        link_heartbeat(&rx->dev.link, frame.packet.data16[3]);
+}
+
+static void power_up(int index, uint64_t now) {
+    board_t *board    = &boards[index];
+    bool ignores_link = board->ignores_link;
+
+    memset(board, 0, sizeof(board_t));
+    board->ignores_link = ignores_link;
+    board->baud         = link_rates[LINK_DEFAULT_RUNG];
+    link_init(&board->dev.link, index == 0, now);
+}
+
+static void setup(const double *error_rates, bool b_ignores_link) {
+    memcpy(bit_error_rate, error_rates, sizeof(bit_error_rate));
+    boards[1].ignores_link = b_ignores_link;
+    power_up(0, 0);
+    power_up(1, 0);
+}
+
+typedef struct {
+    uint64_t mismatch_us;                 // Time the boards spent at different rates
+    uint64_t time_at_rung[LINK_NUM_RATES]; // Time board A spent on each rung
+} result_t;
+
+/* Mouse traffic every 2 ms and a heartbeat every second from both, link_task at 1 kHz */
+static result_t run(uint64_t *now, uint64_t duration_us, int64_t reboot_b_at) {
+    result_t result = {0};
+
+    for (uint64_t end = *now + duration_us; *now < end; *now += STEP_US) {
+        uint64_t t = *now;
+
+        if (t == reboot_b_at)
+            power_up(1, t);
+
+        for (int i = 0; i < 2; i++) {
+            board_t *board = &boards[i], *other = &boards[!i];
+
+            if (t % 2000 == 0)
+                send_frame(board, MOUSE_REPORT_MSG, &t, sizeof(uint64_t));
+
+            if (t % 1000000 == i * 500000) {
+                uint16_t heartbeat[4] = {[3] = board->dev.stats.uart_checksum_errors};
+                send_frame(board, HEARTBEAT_MSG, heartbeat, sizeof(heartbeat));
+            }
+
+            if (board->busy && t >= board->done_at) {
+                board->busy = false;
+                receive(other, board->sending, board->sending_baud);
+            }
+
+            if (!board->busy && board->head != board->tail) {
+                board->sending      = board->queue[board->head];
+                board->head         = (board->head + 1) % TX_QUEUE_LEN;
+                board->busy         = true;
+                board->sending_baud = board->baud;
+                board->done_at      = t + (uint64_t)ceil(FRAME_BITS * 1e6 / board->baud);
+            }
+
+            if (t % 1000 == 0)
+                link_step(&board->dev.link, &sim_link, t, &board->dev);
+        }
+
+        if (boards[0].baud != boards[1].baud)
+            result.mismatch_us += STEP_US;
+
+        result.time_at_rung[boards[0].dev.link.rung] += STEP_US;
+    }
+
+    return result;
+}
+
+static void print_result(const char *name, const result_t *result) {
+    link_t *a = &boards[0].dev.link, *b = &boards[1].dev.link;
+
+    printf("%-12s A at %7u baud, B at %7u, changes %u/%u, rollbacks %u/%u, mismatched %.3f s, s per rung:", name,
+           boards[0].baud, boards[1].baud, a->rate_changes, b->rate_changes, a->rollbacks, b->rollbacks,
+           result->mismatch_us / 1e6);
+
+    for (int i = 0; i < LINK_NUM_RATES; i++)
+        printf(" %.0f", result->time_at_rung[i] / 1e6);
+
+    printf("\n");
+}
+
+/* Clean link, steps up to the top rung and stays there */
+static void check_clean(void) {
+    uint64_t now = 0;
+
+    setup((double[LINK_NUM_RATES]){0}, false);
+    result_t result = run(&now, 120000000, -1);
+    print_result("clean", &result);
+
+    CHECK(boards[0].dev.link.rung == LINK_NUM_RATES - 1 && boards[1].dev.link.rung == LINK_NUM_RATES - 1);
+    CHECK(boards[0].dev.link.rollbacks == 0);
+    CHECK(result.mismatch_us < 50000);
+}
+
+/* Marginal isolator, the default rate loses a frame now and then, the top one is unusable */
+static void check_marginal(void) {
+    uint64_t now = 0;
+
+    setup((double[LINK_NUM_RATES]){0, 0, 0, 0, 2e-4, 1e-2}, false);
+    result_t result = run(&now, 600000000, -1);
+    print_result("marginal", &result);
+
+    CHECK(boards[0].dev.link.rung == 3 && boards[1].dev.link.rung == 3);
+    CHECK(result.time_at_rung[3] > 500000000);
+    CHECK(result.time_at_rung[LINK_NUM_RATES - 1] == 0);
+    CHECK(result.mismatch_us < 1000000);
+}
+
+/* Bad link, two steps down */
+static void check_bad(void) {
+    uint64_t now = 0;
+
+    setup((double[LINK_NUM_RATES]){0, 0, 0, 1e-3, 5e-3, 2e-2}, false);
+    result_t result = run(&now, 120000000, -1);
+    print_result("bad", &result);
+
+    CHECK(boards[0].dev.link.rung == 2 && boards[1].dev.link.rung == 2);
+}
+
+/* B reboots at the top rung, both fall back to the default */
+static void check_reboot(void) {
+    uint64_t now = 0;
+
+    setup((double[LINK_NUM_RATES]){0}, false);
+    run(&now, 60000000, -1);
+    CHECK(boards[0].dev.link.rung == LINK_NUM_RATES - 1);
+
+    result_t result = run(&now, 10000000, 61000000);
+    print_result("reboot", &result);
+
+    CHECK(boards[0].dev.link.rung == LINK_DEFAULT_RUNG && boards[1].dev.link.rung == LINK_DEFAULT_RUNG);
+    CHECK(result.mismatch_us < 5000000);
+}
+
+/* Every commit lost, B goes back and A stays, the dead link timeout brings them together again */
+static void check_lost_commit(void) {
+    uint64_t now = 0;
+
+    setup((double[LINK_NUM_RATES]){0}, false);
+    boards[0].drop_commits = LINK_COMMIT_REPEAT;
+
+    result_t result = run(&now, 40000000, -1);
+    print_result("lost commit", &result);
+
+    CHECK(boards[0].baud == boards[1].baud);
+    CHECK(result.mismatch_us > 0 && result.mismatch_us < 5000000);
+}
+
+/* Older firmware on B never answers, A stays at the default and asks less and less often */
+static void check_old_peer(void) {
+    uint64_t now = 0;
+
+    setup((double[LINK_NUM_RATES]){0}, true);
+    result_t result = run(&now, 300000000, -1);
+    print_result("old peer", &result);
+
+    CHECK(boards[0].baud == SERIAL_BAUDRATE && result.mismatch_us == 0);
+    CHECK(boards[0].dev.link.step_up_windows > LINK_STEP_UP_WINDOWS);
+}
+
+int main(void) {
+    srand(40);
+
+    check_clean();
+    check_marginal();
+    check_bad();
+    check_reboot();
+    check_lost_commit();
+    check_old_peer();
+
+    return host_result("link");
+}
@@ -0,0 +1,212 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Macro playback
+ *  Macros are uploaded like the host does, started as from a hotkey and run by
+ *  process_macro_task on the virtual clock. Their keys are a source of their
+ *  own, merged with what's held on the keyboards.
+ *==============================================================================*/
+
+extern uint64_t host_time_us;
+
+static hid_interface_t iface = {.protocol = HID_PROTOCOL_BOOT, .num_keyboards = 1};
+
+/* One macro in slot 0, starting at the first step */
+static void upload(const macro_step_t *steps, int count) {
+    uint16_t start[MAX_MACROS];
+
+    memset(start, 0xFF, sizeof(start));
+    start[0] = 0;
+
+    CHECK(write_macro_storage(0, (const uint8_t *)start, sizeof(start)));
+    CHECK(write_macro_storage(sizeof(start), (const uint8_t *)steps, count * sizeof(macro_step_t)));
+}
+
+static void press(uint8_t modifier, uint8_t key) {
+    uint8_t raw[KBD_REPORT_LENGTH] = {modifier, 0, key};
+    process_keyboard_report(raw, sizeof(raw), 0, &iface);
+}
+
+/* Run the task for this long, a millisecond at a time like the main loop */
+static void run_ms(int ms) {
+    for (int i = 0; i < ms; i++) {
+        process_macro_task(&global_state);
+        host_time_us += 1000;
+    }
+}
+
+static bool next_report(hid_keyboard_report_t *report) {
+    return queue_try_remove(&global_state.kbd_queue, report);
+}
+
+static void drain(void) {
+    hid_keyboard_report_t report;
+    while (next_report(&report))
+        ;
+}
+
+/* Keys held on the keyboard stay pressed while the macro types */
+static void check_merged_with_keyboard(void) {
+    const macro_step_t steps[] = {
+        {.type = MACRO_KEY_DOWN, .arg = HID_KEY_B},
+        {.type = MACRO_DELAY, .x = 20},
+        {.type = MACRO_KEY_UP, .arg = HID_KEY_B},
+        {.type = MACRO_END},
+    };
+    hid_keyboard_report_t report;
+
+    upload(steps, 4);
+    press(KEYBOARD_MODIFIER_LEFTSHIFT, HID_KEY_A);
+    drain();
+
+    start_macro(0, &global_state);
+    run_ms(1);
+
+    CHECK(next_report(&report));
+    CHECK(report.modifier == KEYBOARD_MODIFIER_LEFTSHIFT);
+    CHECK(key_in_report(HID_KEY_A, &report) && key_in_report(HID_KEY_B, &report));
+
+    /* The delay is on the virtual clock, nothing happens before it's over */
+    run_ms(10);
+    CHECK(!next_report(&report));
+
+    /* A released on the keyboard meanwhile, B is still held by the macro */
+    press(KEYBOARD_MODIFIER_LEFTSHIFT, 0);
+    CHECK(next_report(&report));
+    CHECK(!key_in_report(HID_KEY_A, &report) && key_in_report(HID_KEY_B, &report));
+
+    run_ms(20);
+    CHECK(next_report(&report));
+    CHECK(report.modifier == KEYBOARD_MODIFIER_LEFTSHIFT && report.keycode[0] == 0);
+
+    /* Nothing left held at the end, the macro doesn't send anything more */
+    CHECK(!next_report(&report));
+    press(0, 0);
+    drain();
+}
+
+/* A key the macro presses that's already held doesn't get released under the user's finger */
+static void check_shared_key(void) {
+    const macro_step_t steps[] = {
+        {.type = MACRO_KEY_DOWN, .arg = HID_KEY_CONTROL_LEFT},
+        {.type = MACRO_KEY_DOWN, .arg = HID_KEY_C},
+        {.type = MACRO_KEY_UP, .arg = HID_KEY_C},
+        {.type = MACRO_KEY_UP, .arg = HID_KEY_CONTROL_LEFT},
+        {.type = MACRO_END},
+    };
+    hid_keyboard_report_t report, last = {0};
+
+    upload(steps, 5);
+    press(KEYBOARD_MODIFIER_LEFTCTRL, 0);
+    drain();
+
+    start_macro(0, &global_state);
+    run_ms(5);
+
+    while (next_report(&report)) {
+        CHECK(report.modifier & KEYBOARD_MODIFIER_LEFTCTRL);
+        last = report;
+    }
+
+    CHECK(last.modifier == KEYBOARD_MODIFIER_LEFTCTRL && last.keycode[0] == 0);
+    press(0, 0);
+    drain();
+}
+
+/* Steps for the other output go over the link with just the macro's keys */
+static void check_other_output(void) {
+    const macro_step_t steps[] = {
+        {.type = MACRO_OUTPUT, .arg = OTHER_ROLE},
+        {.type = MACRO_KEY_DOWN, .arg = HID_KEY_X},
+        {.type = MACRO_KEY_UP, .arg = HID_KEY_X},
+        {.type = MACRO_END},
+    };
+    hid_keyboard_report_t report;
+    uart_packet_t packet;
+    int sent = 0;
+
+    upload(steps, 4);
+    press(0, HID_KEY_A);
+    drain();
+
+    start_macro(0, &global_state);
+    run_ms(5);
+
+    while (queue_try_remove(&global_state.uart_tx_queue, &packet)) {
+        if (PACKET_TYPE(packet.type) != KEYBOARD_REPORT_MSG)
+            continue;
+
+        memcpy(&report, packet.data, sizeof(report));
+        CHECK(!key_in_report(HID_KEY_A, &report));
+        CHECK(report.keycode[0] == (sent == 0 ? HID_KEY_X : 0));
+        sent++;
+    }
+
+    CHECK(sent == 2);
+    CHECK(!next_report(&report));
+    press(0, 0);
+    drain();
+}
+
+/* A long macro never takes more than MACRO_QUEUE_LIMIT slots, live keys always find room */
+static void check_queue_footprint(void) {
+    static macro_step_t steps[200];
+    hid_keyboard_report_t report;
+    int reports = 0;
+
+    for (int i = 0; i < 199; i++)
+        steps[i] = (macro_step_t){.type = i & 1 ? MACRO_KEY_UP : MACRO_KEY_DOWN, .arg = HID_KEY_A + i / 2 % 26};
+    steps[199] = (macro_step_t){.type = MACRO_END};
+
+    upload(steps, 200);
+    start_macro(0, &global_state);
+
+    for (int pass = 0; pass < 1000; pass++) {
+        run_ms(1);
+        CHECK(queue_get_level(&global_state.kbd_queue) <= MACRO_QUEUE_LIMIT);
+
+        /* The host takes a report now and then */
+        if (pass % 3 == 0 && next_report(&report))
+            reports++;
+    }
+
+    while (next_report(&report))
+        reports++;
+
+    CHECK(reports == 200);
+    printf("long macro: %d reports, never more than %d queued\n", reports, MACRO_QUEUE_LIMIT);
+}
+
+int main(void) {
+    load_config(&global_state);
+    load_macros();
+    queue_init(&global_state.kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
+    queue_init(&global_state.mouse_queue, sizeof(mouse_report_t), MOUSE_QUEUE_LENGTH);
+    queue_init(&global_state.text_queue, sizeof(text_char_t), TEXT_QUEUE_LENGTH);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+
+    global_state.tud_connected = true;
+    global_state.active_output = BOARD_ROLE;
+    keyboard_mount(1, 0, &iface, &global_state);
+
+    check_merged_with_keyboard();
+    check_shared_key();
+    check_other_output();
+    check_queue_footprint();
+
+    return host_result("macro");
+}
@@ -0,0 +1,229 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Fast mice
+ *  A boot protocol mouse reporting at up to 8 kHz into process_mouse_report,
+ *  with a host polling every millisecond. Reports are merged until the host
+ *  can take one, so the queue stays short, while every click and all of the
+ *  movement and scrolling still get there. Time spent per input report is
+ *  compared with a host polling as fast as the mouse, where each report
+ *  takes the full path. In gaming mode the same mouse takes the fast path,
+ *  compared with the normal one by the time a wheel detent takes to get to
+ *  the host.
+ *==============================================================================*/
+
+#define SECONDS 10
+
+extern uint64_t host_time_us;
+
+static hid_interface_t iface = {.protocol = HID_PROTOCOL_BOOT};
+
+typedef struct {
+    int64_t x, y, wheel; // Movement and scrolling the host got
+    int clicks;          // Button presses the host saw
+    uint8_t buttons;
+    long reports;
+
+    uint64_t detent_us[SECONDS * 20]; // When each wheel detent was sent
+    uint64_t latency_sum, latency_max; // Until the host got it
+} host_view_t;
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void host_receive(host_view_t *host, const hid_mouse_out_t *report) {
+    for (int detent = host->wheel; detent < host->wheel + report->wheel; detent++) {
+        uint64_t latency = host_time_us - host->detent_us[detent];
+        host->latency_sum += latency;
+        host->latency_max = MAX(host->latency_max, latency);
+    }
+
+    host->x += report->x;
+    host->y += report->y;
+    host->wheel += report->wheel;
+    host->clicks += (report->buttons & MOUSE_BUTTON_LEFT) && !(host->buttons & MOUSE_BUTTON_LEFT);
+    host->buttons = report->buttons;
+    host->reports++;
+}
+
+/* Steady sweeps back and forth, a click every 100 ms and a wheel detent every 50 ms */
+static hid_mouse_report_t input_report(int n, int rate) {
+    int sign = (n / (rate / 2)) % 2 ? -1 : 1;
+
+    return (hid_mouse_report_t){
+        .buttons = n % (rate / 10) < rate / 50 ? MOUSE_BUTTON_LEFT : 0,
+        .x       = sign * (n % 3 ? 2 : 1),
+        .y       = n & 1 ? 1 : -1,
+        .wheel   = n % (rate / 20) == 0,
+    };
+}
+
+static void run(int rate, int host_hz) {
+    const int reports = rate * SECONDS, per_poll = rate / host_hz;
+    int64_t sent_x = 0, sent_y = 0, sent_wheel = 0;
+    int sent_clicks = 0, max_level = 0;
+    uint8_t buttons = 0;
+    static host_view_t host;
+    double core1_ns = 0;
+    uint32_t merged = global_state.stats.mouse_merged;
+
+    memset(&host, 0, sizeof(host));
+
+    for (int n = 0; n < reports; n++) {
+        hid_mouse_report_t report = input_report(n, rate);
+        double start = now_ns();
+
+        process_mouse_report((uint8_t *)&report, sizeof(report), 0, &iface);
+        core1_ns += now_ns() - start;
+
+        if (report.wheel)
+            host.detent_us[sent_wheel] = host_time_us;
+
+        sent_x += report.x;
+        sent_y += report.y;
+        sent_wheel += report.wheel;
+        sent_clicks += (report.buttons & MOUSE_BUTTON_LEFT) && !(buttons & MOUSE_BUTTON_LEFT);
+        buttons = report.buttons;
+
+        host_time_us += 1000000 / rate;
+        max_level = MAX(max_level, queue_get_level(&global_state.mouse_queue));
+
+        /* Host takes a report, then the core1 loop hands it what's been added up since */
+        if ((n + 1) % per_poll == 0) {
+            host_hid_ready    = true;
+            host_report_count = 0;
+            process_mouse_queue_task(&global_state);
+            host_hid_ready = false;
+
+            if (host_report_count)
+                host_receive(&host, (const hid_mouse_out_t *)host_reports[0].data);
+
+            start = now_ns();
+            mouse_pending_task(&global_state);
+            core1_ns += now_ns() - start;
+        }
+    }
+
+    /* Whatever is still waiting */
+    for (int poll = 0; poll < 10; poll++) {
+        host_hid_ready    = true;
+        host_report_count = 0;
+        process_mouse_queue_task(&global_state);
+        mouse_pending_task(&global_state);
+
+        if (host_report_count)
+            host_receive(&host, (const hid_mouse_out_t *)host_reports[0].data);
+    }
+
+    printf("%d Hz mouse, %4d Hz host%s: %6.1f ns per input report, %6ld reports to the host, %6u merged, "
+           "at most %d queued, detents %4.0f us mean %4llu us max\n",
+           rate, host_hz, global_state.gaming_mode ? " (gaming)" : "", core1_ns / reports, host.reports,
+           global_state.stats.mouse_merged - merged, max_level, (double)host.latency_sum / sent_wheel,
+           (unsigned long long)host.latency_max);
+
+    CHECK(host.x == sent_x && host.y == sent_y && host.wheel == sent_wheel);
+    CHECK(host.clicks == sent_clicks && host.buttons == buttons);
+    CHECK(global_state.stats.queue_drops[STATS_MOUSE_QUEUE] == 0);
+
+    /* One report in flight, and a click that doesn't wait for it. One per poll and a few more for the clicks. */
+    CHECK(max_level <= 2);
+    CHECK(host.reports <= reports / per_poll + 2 * sent_clicks + 10);
+
+    /* On the fast path the host gets a detent on its next poll */
+    if (global_state.gaming_mode)
+        CHECK(host.latency_max <= 1000000 / host_hz);
+}
+
+static hid_mouse_out_t *host_report(int n) {
+    return (hid_mouse_out_t *)host_reports[n].data;
+}
+
+static void mouse_input(int8_t x, uint8_t buttons) {
+    hid_mouse_report_t report = {.buttons = buttons, .x = x};
+    process_mouse_report((uint8_t *)&report, sizeof(report), 0, &iface);
+}
+
+/* Core1 moves on and presses a button while core0 sends the first move */
+static void core1_meanwhile(uint8_t instance) {
+    host_report_hook = NULL;
+    mouse_input(7, 0);
+    mouse_input(1, MOUSE_BUTTON_LEFT);
+    mouse_input(2, MOUSE_BUTTON_LEFT);
+}
+
+/* What's left on the fast path goes before the click that had to take the queue */
+static void check_fast_order(void) {
+    global_state.gaming_mode = true;
+    host_report_count        = 0;
+    host_hid_ready           = true;
+
+    mouse_input(5, 0);
+    host_report_hook = &core1_meanwhile;
+
+    for (int poll = 0; poll < 10; poll++) {
+        process_mouse_queue_task(&global_state);
+        mouse_pending_task(&global_state);
+    }
+
+    CHECK(host_report_count == 4);
+    CHECK(host_report(0)->x == 5 && host_report(0)->buttons == 0);
+    CHECK(host_report(1)->x == 7 && host_report(1)->buttons == 0);
+    CHECK(host_report(2)->x == 1 && host_report(2)->buttons == MOUSE_BUTTON_LEFT);
+    CHECK(host_report(3)->x == 2 && host_report(3)->buttons == MOUSE_BUTTON_LEFT);
+
+    /* Button released with the queue empty again, the fast path takes over */
+    mouse_input(3, 0);
+    CHECK(queue_is_empty(&global_state.mouse_queue) && !global_state.mouse_has_pending);
+    process_mouse_queue_task(&global_state);
+    CHECK(host_report_count == 5 && host_report(4)->x == 3 && host_report(4)->buttons == 0);
+
+    global_state.gaming_mode = false;
+}
+
+int main(void) {
+    load_config(&global_state);
+    queue_init(&global_state.mouse_queue, sizeof(mouse_report_t), MOUSE_QUEUE_LENGTH);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+
+    global_state.tud_connected  = true;
+    global_state.active_output  = BOARD_ROLE;
+    global_state.relative_mouse = true; // Host gets the movement itself, so it can be added up
+    global_state.switch_lock    = true;
+    global_state.config.enable_acceleration = false;
+
+    /* Every report takes the full path, then the host polls once per millisecond */
+    run(8000, 8000);
+
+    for (int rate = 1000; rate <= 8000; rate *= 2)
+        run(rate, 1000);
+
+    /* Gaming mode, fast path */
+    mouse_fast_init();
+    global_state.gaming_mode = true;
+
+    for (int rate = 1000; rate <= 8000; rate *= 8)
+        run(rate, 1000);
+
+    global_state.gaming_mode = false;
+    check_fast_order();
+
+    return host_result("mouse");
+}
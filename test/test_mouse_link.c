@@ -0,0 +1,274 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Mouse link
+ *  mouse_link.c is driven through a link that takes LAT_UART_WIRE_US per
+ *  frame, the other end decodes what arrives the way the handlers do. A
+ *  1 kHz and an 8 kHz mouse move, click and scroll at the default rate and
+ *  at 115200 baud, the link has to keep up with its bandwidth and deliver
+ *  every click and all of the movement. Compared with sending each report
+ *  as an absolute one, as it was before.
+ *==============================================================================*/
+
+#define SECONDS    2
+#define SLOW_BAUD  115200
+#define START_X    16000
+#define START_Y    16000
+
+/* A link that sends one frame at a time, and the board on its other end */
+static struct {
+    uint64_t now;        // Simulated time (us)
+    uint64_t busy_until; // When the last frame queued is out
+    uint32_t wire_us;    // Time one frame takes
+    int frames;
+    int keyframes;
+    uint64_t last_keyframe;
+    uint64_t keyframe_gap; // Longest time without a keyframe
+
+    mouse_report_t last; // What the other board did with the latest report
+    int64_t wheel, pan;
+    int clicks, reports;
+    uint8_t type;        // Type of the latest frame
+} link;
+
+static mouse_link_t ml;
+
+static void receive(const mouse_report_t *report) {
+    link.clicks += (report->buttons & MOUSE_BUTTON_LEFT) && !(link.last.buttons & MOUSE_BUTTON_LEFT);
+    link.wheel += report->wheel;
+    link.pan += report->pan;
+    link.last = *report;
+    link.reports++;
+}
+
+static void fake_send(const uint8_t *data, enum packet_type_e type, uint8_t output, device_t *state) {
+    link.busy_until = MAX(link.busy_until, link.now) + link.wire_us;
+    link.type       = type;
+    link.frames++;
+
+    if (type == MOUSE_REPORT_MSG) {
+        link.keyframe_gap  = MAX(link.keyframe_gap, link.now - link.last_keyframe);
+        link.last_keyframe = link.now;
+        link.keyframes++;
+        receive((const mouse_report_t *)data);
+        return;
+    }
+
+    mouse_report_t reports[MOUSE_DELTA_EVENTS];
+    uint8_t count = mouse_delta_decode(data, link.last.x, link.last.y, reports);
+
+    for (int i = 0; i < count; i++)
+        receive(&reports[i]);
+}
+
+static bool fake_busy(uint8_t output, device_t *state) {
+    return link.busy_until > link.now;
+}
+
+static const mouse_link_io_t fake_io = {.send = &fake_send, .busy = &fake_busy};
+
+static void reset_link(uint32_t baud) {
+    memset(&link, 0, sizeof(link));
+    memset(&ml, 0, sizeof(ml));
+    link.wire_us = LAT_UART_WIRE_US(baud);
+    ml.output    = OTHER_ROLE;
+}
+
+static mouse_report_t report_at(int16_t x, int16_t y, int8_t wheel, int8_t pan, uint8_t buttons) {
+    return (mouse_report_t){.buttons = buttons, .x = x, .y = y, .wheel = wheel, .pan = pan, .mode = ABSOLUTE};
+}
+
+static void send(const mouse_report_t *report) {
+    mouse_link_report(&ml, &fake_io, report, OTHER_ROLE, link.now, &global_state);
+}
+
+/* Every scroll amount comes out as it went in, the common ones in a delta */
+static void check_scroll_codes(void) {
+    for (int amount = INT8_MIN; amount <= INT8_MAX; amount++) {
+        int size    = abs(amount);
+        bool common = size <= 4 || size == MOUSE_SCROLL_RESOLUTION || size == 2 * MOUSE_SCROLL_RESOLUTION
+                      || size == 3 * MOUSE_SCROLL_RESOLUTION;
+
+        for (int axis = 0; axis < 2; axis++) {
+            reset_link(SERIAL_BAUDRATE);
+
+            mouse_report_t start = report_at(START_X, START_Y, 0, 0, 0);
+            send(&start);
+            CHECK(link.type == MOUSE_REPORT_MSG);
+
+            mouse_report_t report = report_at(START_X + 1, START_Y, axis ? 0 : amount, axis ? amount : 0, 0);
+            link.now += 1000;
+            send(&report);
+
+            CHECK(link.type == (common ? MOUSE_DELTA_MSG : MOUSE_REPORT_MSG));
+            CHECK(link.wheel == report.wheel && link.pan == report.pan && link.last.x == START_X + 1);
+        }
+    }
+}
+
+/* While the link is busy, reports with the same buttons are folded, a button change starts the next one */
+static void check_folding(void) {
+    reset_link(SLOW_BAUD);
+
+    mouse_report_t report = report_at(START_X, START_Y, 0, 0, 0);
+    send(&report);
+    CHECK(link.frames == 1 && ml.count == 0);
+
+    for (int n = 1; n <= 5; n++) {
+        report = report_at(START_X + 10 * n, START_Y - n, MOUSE_SCROLL_RESOLUTION, 0, 0);
+        link.now += 100;
+        send(&report);
+    }
+    CHECK(link.frames == 1 && ml.count == 1 && ml.pending[0].wheel == 5 * MOUSE_SCROLL_RESOLUTION);
+
+    report = report_at(START_X + 60, START_Y - 6, 0, -1, MOUSE_BUTTON_LEFT);
+    send(&report);
+    CHECK(link.frames == 1 && ml.count == 2);
+
+    /* A third button state doesn't fit, what's held goes out first */
+    report = report_at(START_X + 70, START_Y - 7, 0, 0, 0);
+    send(&report);
+    CHECK(link.frames == 3 && ml.count == 1);
+
+    /* 40 doesn't fit a delta, the held report was sent as a keyframe */
+    CHECK(link.keyframes == 2 && link.wheel == 5 * MOUSE_SCROLL_RESOLUTION && link.pan == -1);
+    CHECK(link.clicks == 1 && link.last.x == START_X + 60);
+
+    link.now = link.busy_until;
+    mouse_link_flush(&ml, &fake_io, link.now, &global_state);
+    CHECK(link.frames == 4 && link.type == MOUSE_DELTA_MSG && link.last.x == START_X + 70 && link.last.buttons == 0);
+
+    /* Held reports for one output go out before switching to another */
+    report = report_at(START_X, START_Y, 0, 0, 0);
+    send(&report);
+    CHECK(ml.count == 1);
+    mouse_link_report(&ml, &fake_io, &report, BOARD_ROLE, link.now, &global_state);
+    CHECK(link.frames == 5 && ml.output == BOARD_ROLE && !ml.synced);
+}
+
+/* Sweeps back and forth, a click every 100 ms, a wheel detent every 50 ms and a pan detent every 200 ms */
+static mouse_report_t input_report(int n, int rate, int16_t *x, int16_t *y) {
+    int per_ms = rate / 1000;
+    int sign   = (n / (rate / 4)) % 2 ? -1 : 1;
+
+    *x += sign * (n % per_ms == 0 ? 40 : 0);
+    *y += n % per_ms == 0 ? (n / per_ms) % 7 - 3 : 0;
+
+    return report_at(*x, *y, n % (rate / 20) == 0 ? MOUSE_SCROLL_RESOLUTION : 0,
+                     n % (rate / 5) == 0 ? -MOUSE_SCROLL_RESOLUTION : 0,
+                     n % (rate / 10) < rate / 50 ? MOUSE_BUTTON_LEFT : 0);
+}
+
+static uint64_t received[8000 * SECONDS], latency_max;
+static int64_t latency_sum;
+static int delivered;
+
+/* Reports up to `upto` are out once the link is done with the last frame */
+static void deliver(int upto) {
+    for (; delivered < upto; delivered++) {
+        uint64_t latency = link.busy_until - received[delivered];
+        latency_sum += latency;
+        latency_max = MAX(latency_max, latency);
+    }
+}
+
+static void run(int rate, uint32_t baud) {
+    const int reports = rate * SECONDS;
+    int16_t x = START_X, y = START_Y;
+    int64_t sent_wheel = 0, sent_pan = 0;
+    int sent_clicks = 0;
+    uint8_t buttons = 0;
+
+    /* Before, every report was its own absolute frame, in the UART queue until its turn */
+    uint64_t before_busy = 0, before_max = 0, before_sum = 0;
+    int before_drops = 0;
+
+    reset_link(baud);
+    latency_max = latency_sum = delivered = 0;
+
+    for (int n = 0; n < reports; n++) {
+        uint64_t now = (uint64_t)n * 1000000 / rate;
+
+        /* mouse_link_task, as soon as the link has caught up */
+        if (ml.count && link.busy_until <= now) {
+            link.now = link.busy_until;
+            mouse_link_flush(&ml, &fake_io, link.now, &global_state);
+            deliver(n);
+        }
+
+        link.now    = now;
+        received[n] = now;
+
+        mouse_report_t report = input_report(n, rate, &x, &y);
+        send(&report);
+
+        sent_wheel += report.wheel;
+        sent_pan += report.pan;
+        sent_clicks += (report.buttons & MOUSE_BUTTON_LEFT) && !(buttons & MOUSE_BUTTON_LEFT);
+        buttons = report.buttons;
+
+        /* With nothing held back, every report so far is on its way */
+        if (!ml.count)
+            deliver(n + 1);
+
+        if ((before_busy > now ? before_busy - now : 0) >= (uint64_t)UART_QUEUE_LENGTH * link.wire_us) {
+            before_drops++;
+        } else {
+            before_busy = MAX(before_busy, now) + link.wire_us;
+            before_max  = MAX(before_max, before_busy - now);
+            before_sum += before_busy - now;
+        }
+    }
+
+    link.now = MAX(link.now, link.busy_until);
+    mouse_link_flush(&ml, &fake_io, link.now, &global_state);
+    deliver(reports);
+    link.keyframe_gap = MAX(link.keyframe_gap, link.now - link.last_keyframe);
+
+    printf("%d Hz mouse, %7u baud: %5d frames (%6.0f B/s), %3d keyframes, latency %5.0f us mean, %5llu us max\n",
+           rate, baud, link.frames, (double)link.frames * RAW_PACKET_LENGTH / SECONDS, link.keyframes,
+           (double)latency_sum / delivered, (unsigned long long)latency_max);
+    printf("%27s before: %5d frames (%6.0f B/s), %5d dropped,  latency %5.0f us mean, %5llu us max\n", "",
+           reports - before_drops, (double)(reports - before_drops) * RAW_PACKET_LENGTH / SECONDS, before_drops,
+           (double)before_sum / (reports - before_drops), (unsigned long long)before_max);
+
+    /* All of it got there */
+    CHECK(link.last.x == x && link.last.y == y && link.last.buttons == buttons);
+    CHECK(link.wheel == sent_wheel && link.pan == sent_pan && link.clicks == sent_clicks);
+
+    /* No more than the link carries (plus what was left at the end), scrolling and clicks need no keyframes */
+    CHECK(link.frames <= (uint64_t)SECONDS * 1000000 / link.wire_us + 2);
+    CHECK(link.keyframes <= SECONDS * 1000000 / MOUSE_KEYFRAME_US + 2);
+    CHECK(link.keyframe_gap <= MOUSE_KEYFRAME_US + 1000000 / rate + 2 * link.wire_us);
+
+    /* A report waits for at most the frame on the wire and the one before it */
+    CHECK(delivered == reports);
+    CHECK(latency_max <= 3 * link.wire_us + 1000000 / rate);
+}
+
+int main(void) {
+    load_config(&global_state);
+
+    check_scroll_codes();
+    check_folding();
+
+    for (int rate = 1000; rate <= 8000; rate *= 8) {
+        run(rate, SERIAL_BAUDRATE);
+        run(rate, SLOW_BAUD);
+    }
+
+    return host_result("mouse_link");
+}
@@ -0,0 +1,286 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Pass-through
+ *  Devices we don't parse are mounted through tuh_hid_mount_cb and their
+ *  reports come in through tuh_hid_report_received_cb. What our host gets,
+ *  and what the host of the other board gets over the link, has to be the
+ *  device's report byte for byte.
+ *==============================================================================*/
+
+#define TRACE_LENGTH 3000
+
+/* Rudder pedals, a rudder axis and two toe brakes, 10 bits each in 16, no report IDs */
+static const uint8_t pedals_desc[] = {
+    0x05, 0x02, 0x09, 0x01, 0xA1, 0x01,             // Simulation Controls, Flight Simulation Device
+    0x09, 0xBA, 0x09, 0xC5, 0x09, 0xC5,             //   Rudder, Brake, Brake
+    0x15, 0x00, 0x26, 0xFF, 0x03, 0x75, 0x10, 0x95, //   0 - 1023 in 16 bits,
+    0x03, 0x81, 0x02,                               //   3 of them
+    0xC0,
+};
+
+/* 3D mouse: translation (1), rotation (2), buttons (3) and a 63 byte status report (4) */
+static const uint8_t mouse_3d_desc[] = {
+    0x05, 0x01, 0x09, 0x08, 0xA1, 0x01,                         // Generic Desktop, Multi-axis Controller
+    0x85, 0x01, 0x16, 0x00, 0x80, 0x26, 0xFF, 0x7F, 0x09, 0x30, //   X, Y, Z
+    0x09, 0x31, 0x09, 0x32, 0x75, 0x10, 0x95, 0x03, 0x81, 0x06, //
+    0x85, 0x02, 0x09, 0x33, 0x09, 0x34, 0x09, 0x35, 0x75, 0x10, //   Rx, Ry, Rz
+    0x95, 0x03, 0x81, 0x06,                                     //
+    0x85, 0x03, 0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, //   16 buttons
+    0x25, 0x01, 0x75, 0x01, 0x95, 0x10, 0x81, 0x02,             //
+    0x85, 0x04, 0x06, 0x00, 0xFF, 0x09, 0x01, 0x15, 0x00, 0x26, //   Status bytes
+    0xFF, 0x00, 0x75, 0x08, 0x95, 0x3F, 0x81, 0x02,             //
+    0xC0,
+};
+
+/* Gamepad, handled by gamepad.c, never passed through */
+static const uint8_t gamepad_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x02,
+    0x09, 0x30, 0x09, 0x31, 0x81, 0x02, 0x05, 0x09, 0x19, 0x01, 0x29, 0x08, 0x25, 0x01, 0x75,
+    0x01, 0x95, 0x08, 0x81, 0x02, 0xC0,
+};
+
+typedef struct {
+    uint8_t data[PASSTHROUGH_REPORT_MAX];
+    int len;
+} recorded_t;
+
+static recorded_t trace[TRACE_LENGTH];
+static device_t peer; // Board on the other end of the link, driving the other output
+
+/* Pedals pumped slowly, the rudder swinging back and forth */
+static void record_pedals(void) {
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        uint16_t rudder = 512 + (n % 400 < 200 ? n % 200 : 200 - n % 200) * 2;
+        uint16_t left = n % 700 < 350 ? n % 350 * 2 : 0, right = 1023 - left;
+        uint16_t values[3] = {rudder, left, right};
+
+        memcpy(trace[n].data, values, sizeof(values));
+        trace[n].len = sizeof(values);
+    }
+}
+
+/* Mostly movement, some buttons, a status report now and then */
+static void record_mouse_3d(void) {
+    int16_t axes[6] = {0};
+
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        uint8_t *report = trace[n].data;
+        int kind        = n % 50 == 49 ? 4 : n % 10 == 9 ? 3 : 1 + n % 2;
+
+        report[0] = kind;
+
+        if (kind == 1 || kind == 2) {
+            for (int i = 0; i < 3; i++)
+                axes[(kind - 1) * 3 + i] += rand() % 64 - 32;
+
+            memcpy(&report[1], &axes[(kind - 1) * 3], 6);
+            trace[n].len = 7;
+        } else if (kind == 3) {
+            report[1]    = rand();
+            report[2]    = rand();
+            trace[n].len = 3;
+        } else {
+            for (int i = 1; i < 64; i++)
+                report[i] = rand();
+            trace[n].len = 64;
+        }
+    }
+}
+
+/* Host got the report exactly as it was recorded, on the pass-through interface */
+static bool host_got(const recorded_t *recorded, bool uses_report_id) {
+    host_report_t *report = &host_reports[0];
+    int offset            = uses_report_id ? 1 : 0;
+
+    if (host_report_count != 1 || report->instance != ITF_NUM_HID_PASS)
+        return false;
+
+    if (report->report_id != (uses_report_id ? recorded->data[0] : 0))
+        return false;
+
+    return report->len == recorded->len - offset && !memcmp(report->data, &recorded->data[offset], report->len);
+}
+
+static void take_report(device_t *state) {
+    host_report_count = 0;
+    process_hid_queue_task(state);
+}
+
+/* Frames for the link are handed to the other board as they'd arrive. The other board has no link of its
+   own here, the ones it sends back (descriptor requests) go through ours. */
+static int requests;
+
+static int deliver_to_peer(void) {
+    uart_packet_t packet;
+    int frames = 0;
+
+    while (queue_try_remove(&global_state.uart_tx_queue, &packet)) {
+        if (PACKET_TYPE(packet.type) != PASSTHROUGH_MSG)
+            continue;
+
+        if (packet.data[0] & PASS_FRAME_REQUEST) {
+            passthrough_message(packet.data, &global_state);
+            requests++;
+            continue;
+        }
+
+        passthrough_message(packet.data, &peer);
+        frames++;
+    }
+
+    return frames;
+}
+
+/* Reports for our own host, then for the other board's */
+static void check_trace(uint8_t dev_addr, bool uses_report_id) {
+    int exact = 0, frames = 0;
+
+    global_state.active_output = BOARD_ROLE;
+
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        tuh_hid_report_received_cb(dev_addr, 0, trace[n].data, trace[n].len);
+        take_report(&global_state);
+        exact += host_got(&trace[n], uses_report_id);
+    }
+
+    /* Link idle, otherwise the first report would wait for it */
+    deliver_to_peer();
+    global_state.active_output = OTHER_ROLE;
+
+    for (int n = 0; n < TRACE_LENGTH; n++) {
+        tuh_hid_report_received_cb(dev_addr, 0, trace[n].data, trace[n].len);
+        frames += deliver_to_peer();
+        take_report(&peer);
+        exact += host_got(&trace[n], uses_report_id);
+    }
+
+    printf("%-10s %d reports, %d byte exact, %.1f link frames per report\n", uses_report_id ? "3D mouse" : "pedals",
+           2 * TRACE_LENGTH, exact, (double)frames / TRACE_LENGTH);
+
+    CHECK(exact == 2 * TRACE_LENGTH);
+}
+
+/* Our host enumerated again and has the interface */
+static void offered(device_t *state) {
+    CHECK(state->descriptors_changed);
+    state->passthrough.offered = true;
+    state->descriptors_changed = false;
+}
+
+static void check_mirroring(void) {
+    passthrough_t *pass = &global_state.passthrough;
+
+    /* First usable device gets mirrored, here and on the other board */
+    tuh_hid_mount_cb(1, 0, pedals_desc, sizeof(pedals_desc));
+    deliver_to_peer();
+
+    CHECK(global_state.iface[0][0].passthrough);
+    CHECK(pass->desc_len == sizeof(pedals_desc) && !memcmp(pass->desc, pedals_desc, sizeof(pedals_desc)));
+    CHECK(peer.passthrough.desc_len == sizeof(pedals_desc));
+    CHECK(!memcmp(peer.passthrough.desc, pedals_desc, sizeof(pedals_desc)));
+
+    offered(&global_state);
+    offered(&peer);
+
+    /* A gamepad is ours to handle, a second device waits for the first one to go */
+    tuh_hid_mount_cb(2, 0, gamepad_desc, sizeof(gamepad_desc));
+    tuh_hid_mount_cb(3, 0, mouse_3d_desc, sizeof(mouse_3d_desc));
+
+    CHECK(!global_state.iface[1][0].passthrough && global_state.iface[1][0].gamepad.is_found);
+    CHECK(!global_state.iface[2][0].passthrough);
+    CHECK(pass->desc_len == sizeof(pedals_desc) && !memcmp(pass->desc, pedals_desc, sizeof(pedals_desc)));
+
+    /* Offering the gamepad, nothing to do with us */
+    global_state.descriptors_changed = false;
+}
+
+/* A report waiting for a busy link is replaced by the newer one */
+static void check_busy_link(void) {
+    uart_packet_t blocker = {0};
+
+    global_state.active_output = OTHER_ROLE;
+    queue_try_add(&global_state.uart_tx_queue, &blocker);
+
+    for (int n = 0; n < 3; n++)
+        tuh_hid_report_received_cb(1, 0, trace[n].data, trace[n].len);
+
+    CHECK(deliver_to_peer() == 0);
+    passthrough_link_task(&global_state);
+    deliver_to_peer();
+
+    take_report(&peer);
+    CHECK(host_got(&trace[2], false));
+    take_report(&peer);
+    CHECK(host_report_count == 0);
+}
+
+/* A board that booted late asks for the descriptor once, the board with the device sends it */
+static void check_late_board(void) {
+    passthrough_t saved = peer.passthrough;
+
+    memset(&peer.passthrough, 0, sizeof(passthrough_t));
+    peer.descriptors_changed   = false;
+    global_state.active_output = OTHER_ROLE;
+    requests                   = 0;
+
+    for (int n = 0; n < 5; n++) {
+        tuh_hid_report_received_cb(1, 0, trace[n].data, trace[n].len);
+        deliver_to_peer();
+        passthrough_link_task(&global_state);
+        deliver_to_peer();
+    }
+
+    CHECK(requests == 1);
+    CHECK(peer.passthrough.desc_len == saved.desc_len && !memcmp(peer.passthrough.desc, saved.desc, saved.desc_len));
+    offered(&peer);
+}
+
+int main(void) {
+    srand(48);
+
+    load_config(&global_state);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    queue_init(&global_state.hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
+    queue_init(&peer.hid_queue_out, sizeof(hid_generic_pkt_t), HID_QUEUE_LENGTH);
+    chain_init(&global_state.chain, BOARD_ROLE, NUM_SCREENS);
+
+    global_state.tud_connected = peer.tud_connected = true;
+    host_hid_ready             = true;
+
+    check_mirroring();
+
+    record_pedals();
+    check_trace(1, false);
+    check_busy_link();
+    check_late_board();
+
+    /* Pedals unplugged, the 3D mouse plugged in again takes over */
+    tuh_hid_umount_cb(1, 0);
+    tuh_hid_umount_cb(3, 0);
+    tuh_hid_mount_cb(3, 0, mouse_3d_desc, sizeof(mouse_3d_desc));
+    deliver_to_peer();
+
+    CHECK(global_state.iface[2][0].passthrough);
+    offered(&global_state);
+    offered(&peer);
+
+    record_mouse_3d();
+    check_trace(3, true);
+
+    return host_result("passthrough");
+}
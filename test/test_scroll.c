@@ -0,0 +1,295 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  High resolution scrolling
+ *  Mice with Resolution Multipliers are parsed, switched to their finest
+ *  setting and their counts scaled to 1/MOUSE_SCROLL_RESOLUTION of a detent.
+ *  Each multiplier only applies to the wheel or pan in its collection. On the
+ *  way out, a host that turned our multiplier on gets those units, any other
+ *  one whole detents.
+ *==============================================================================*/
+
+#define MOUSE_ID 2
+
+/* Wheel with its own multiplier (16 counts per detent), another multiplier that isn't for
+   anything we know and a pan that has none */
+static const uint8_t wheel_only_desc[] = {
+    HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),
+    HID_USAGE(HID_USAGE_DESKTOP_MOUSE),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+      HID_REPORT_ID(MOUSE_ID)
+      HID_USAGE(HID_USAGE_DESKTOP_POINTER),
+      HID_COLLECTION(HID_COLLECTION_PHYSICAL),
+        HID_USAGE_PAGE(HID_USAGE_PAGE_BUTTON),
+        HID_USAGE_MIN(1),
+        HID_USAGE_MAX(3),
+        HID_LOGICAL_MIN(0),
+        HID_LOGICAL_MAX(1),
+        HID_REPORT_COUNT(3),
+        HID_REPORT_SIZE(1),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+        HID_REPORT_COUNT(1),
+        HID_REPORT_SIZE(5),
+        HID_INPUT(HID_CONSTANT),
+
+        HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),
+        HID_USAGE(HID_USAGE_DESKTOP_X),
+        HID_USAGE(HID_USAGE_DESKTOP_Y),
+        HID_LOGICAL_MIN(0x81),
+        HID_LOGICAL_MAX(0x7F),
+        HID_REPORT_SIZE(8),
+        HID_REPORT_COUNT(2),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE),
+
+        HID_COLLECTION(HID_COLLECTION_LOGICAL),
+          HID_USAGE(HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER),
+          HID_LOGICAL_MIN(0),
+          HID_LOGICAL_MAX(1),
+          HID_PHYSICAL_MIN(1),
+          HID_PHYSICAL_MAX(16),
+          HID_REPORT_COUNT(1),
+          HID_REPORT_SIZE(2),
+          HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+          HID_PHYSICAL_MIN(0),
+          HID_PHYSICAL_MAX(0),
+
+          HID_USAGE(HID_USAGE_DESKTOP_WHEEL),
+          HID_LOGICAL_MIN(0x81),
+          HID_LOGICAL_MAX(0x7F),
+          HID_REPORT_SIZE(8),
+          HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE),
+        HID_COLLECTION_END,
+
+        HID_COLLECTION(HID_COLLECTION_LOGICAL),
+          HID_USAGE(HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER),
+          HID_LOGICAL_MIN(0),
+          HID_LOGICAL_MAX(1),
+          HID_PHYSICAL_MIN(1),
+          HID_PHYSICAL_MAX(4),
+          HID_REPORT_SIZE(2),
+          HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+          HID_PHYSICAL_MIN(0),
+          HID_PHYSICAL_MAX(0),
+        HID_COLLECTION_END,
+
+        HID_USAGE_PAGE(HID_USAGE_PAGE_CONSUMER),
+        HID_USAGE_N(HID_USAGE_CONSUMER_AC_PAN, 2),
+        HID_LOGICAL_MIN(0x81),
+        HID_LOGICAL_MAX(0x7F),
+        HID_REPORT_SIZE(8),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE),
+      HID_COLLECTION_END,
+    HID_COLLECTION_END,
+};
+
+/* One multiplier right in the mouse collection, for the wheel and pan inside */
+static const uint8_t shared_desc[] = {
+    HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),
+    HID_USAGE(HID_USAGE_DESKTOP_MOUSE),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+      HID_USAGE(HID_USAGE_DESKTOP_RESOLUTION_MULTIPLIER),
+      HID_LOGICAL_MIN(0),
+      HID_LOGICAL_MAX(3),
+      HID_PHYSICAL_MIN(1),
+      HID_PHYSICAL_MAX(8),
+      HID_REPORT_COUNT(1),
+      HID_REPORT_SIZE(8),
+      HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+      HID_PHYSICAL_MIN(0),
+      HID_PHYSICAL_MAX(0),
+
+      HID_USAGE(HID_USAGE_DESKTOP_POINTER),
+      HID_COLLECTION(HID_COLLECTION_PHYSICAL),
+        HID_USAGE(HID_USAGE_DESKTOP_WHEEL),
+        HID_LOGICAL_MIN(0x81),
+        HID_LOGICAL_MAX(0x7F),
+        HID_REPORT_SIZE(8),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE),
+        HID_USAGE_PAGE(HID_USAGE_PAGE_CONSUMER),
+        HID_USAGE_N(HID_USAGE_CONSUMER_AC_PAN, 2),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE),
+      HID_COLLECTION_END,
+    HID_COLLECTION_END,
+};
+
+/* What our relative mouse tells the host, one multiplier for each */
+static const uint8_t own_desc[] = {TUD_HID_REPORT_DESC_MOUSEHELP(HID_REPORT_ID(REPORT_ID_RELMOUSE))};
+
+static hid_interface_t iface;
+
+static void parse(const uint8_t *desc, int len) {
+    memset(&iface, 0, sizeof(iface));
+    iface.protocol = HID_PROTOCOL_REPORT;
+    parse_report_descriptor(&iface, desc, len);
+}
+
+static void check_scale_scroll(void) {
+    int32_t rest = 0;
+
+    /* A plain wheel, a count is a detent */
+    CHECK(scale_scroll(1, 1, &rest) == MOUSE_SCROLL_RESOLUTION && rest == 0);
+    CHECK(scale_scroll(-2, 0, &rest) == -2 * MOUSE_SCROLL_RESOLUTION && rest == 0);
+
+    /* 120 counts per detent, the part that's not a whole unit waits */
+    CHECK(scale_scroll(7, 120, &rest) == 0 && rest == 56);
+    CHECK(scale_scroll(7, 120, &rest) == 0 && rest == 112);
+    CHECK(scale_scroll(7, 120, &rest) == 1 && rest == 48);
+    CHECK(scale_scroll(-6, 120, &rest) == 0 && rest == 0);
+
+    /* More than a report carries is cut off and not saved up */
+    CHECK(scale_scroll(100, 1, &rest) == MOUSE_SCROLL_LIMIT && rest == 0);
+    CHECK(scale_scroll(-100, 1, &rest) == -MOUSE_SCROLL_LIMIT && rest == 0);
+}
+
+static void check_scroll_to_host(void) {
+    int16_t rest = 5;
+
+    CHECK(scroll_to_host(3, true, &rest) == 3 && rest == 0);
+
+    /* Whole detents only, the rest adds up */
+    CHECK(scroll_to_host(3, false, &rest) == 0 && rest == 3);
+    CHECK(scroll_to_host(3, false, &rest) == 0 && rest == 6);
+    CHECK(scroll_to_host(3, false, &rest) == 1 && rest == 1);
+    CHECK(scroll_to_host(2 * MOUSE_SCROLL_RESOLUTION, false, &rest) == 2 && rest == 1);
+
+    /* Turning the other way starts from zero */
+    CHECK(scroll_to_host(-2, false, &rest) == 0 && rest == -2);
+    CHECK(scroll_to_host(-7, false, &rest) == -1 && rest == -1);
+    CHECK(scroll_to_host(0, false, &rest) == 0 && rest == -1);
+}
+
+/* How many multipliers were found and what the first one applies to */
+static void check_parsed(int multipliers, bool wheel0, bool pan0) {
+    mouse_t *mouse = &iface.mouse;
+
+    CHECK(mouse->num_multipliers == multipliers);
+    CHECK(mouse->multiplier[0].wheel == wheel0 && mouse->multiplier[0].pan == pan0);
+    CHECK(mouse->wheel.size && mouse->pan.size);
+}
+
+/* Pan without a multiplier of its own keeps whole detents, the other multiplier stays off */
+static void check_wheel_only(void) {
+    mouse_t *mouse = &iface.mouse;
+
+    parse(wheel_only_desc, sizeof(wheel_only_desc));
+    check_parsed(2, true, false);
+    CHECK(!mouse->multiplier[1].wheel && !mouse->multiplier[1].pan);
+    CHECK(mouse->feature_id == MOUSE_ID && mouse->feature_len == 1);
+
+    /* Control pipe busy, it's tried again later */
+    mouse->hires_requested = true;
+    host_control_ready     = false;
+    mouse_enable_hires(1, 0, &iface);
+    CHECK(mouse->hires_requested);
+
+    host_control_ready = true;
+    mouse_enable_hires(1, 0, &iface);
+    CHECK(!mouse->hires_requested);
+    CHECK(host_set_report.report_id == MOUSE_ID && host_set_report.len == 2);
+    CHECK(host_set_report.data[0] == MOUSE_ID && host_set_report.data[1] == 0x01);
+
+    /* Not confirmed yet, or for another report */
+    mouse_hires_enabled(&iface, MOUSE_ID, 0);
+    mouse_hires_enabled(&iface, MOUSE_ID + 1, 2);
+    CHECK(mouse->wheel_resolution == 0 && mouse->pan_resolution == 0);
+
+    mouse_hires_enabled(&iface, MOUSE_ID, 2);
+    CHECK(mouse->wheel_resolution == 16 && mouse->pan_resolution == 1);
+
+    /* 8 counts are half a detent on the wheel, one is a whole detent on pan */
+    uint8_t raw[] = {MOUSE_ID, 0, 0, 0, 8, 1};
+    mouse_values_t values = {0};
+    extract_report_values(raw, sizeof(raw), &global_state, &values, &iface);
+    CHECK(values.wheel == MOUSE_SCROLL_RESOLUTION / 2 && values.pan == MOUSE_SCROLL_RESOLUTION);
+}
+
+static void check_shared(void) {
+    mouse_t *mouse = &iface.mouse;
+
+    parse(shared_desc, sizeof(shared_desc));
+    check_parsed(1, true, true);
+
+    mouse_enable_hires(1, 0, &iface);
+    CHECK(host_set_report.report_id == 0 && host_set_report.len == 1 && host_set_report.data[0] == 3);
+
+    mouse_hires_enabled(&iface, 0, 1);
+    CHECK(mouse->wheel_resolution == 8 && mouse->pan_resolution == 8);
+}
+
+static void check_own(void) {
+    mouse_t *mouse = &iface.mouse;
+
+    parse(own_desc, sizeof(own_desc));
+    check_parsed(2, true, false);
+    CHECK(!mouse->multiplier[1].wheel && mouse->multiplier[1].pan);
+
+    mouse_hires_enabled(&iface, REPORT_ID_RELMOUSE, 1);
+    CHECK(mouse->wheel_resolution == MOUSE_SCROLL_RESOLUTION && mouse->pan_resolution == MOUSE_SCROLL_RESOLUTION);
+}
+
+static hid_mouse_out_t *host_report(int n) {
+    return (hid_mouse_out_t *)host_reports[n].data;
+}
+
+/* The host sets and reads our multiplier, reports follow what it set */
+static void check_feature_callbacks(void) {
+    uint8_t feature = 0xF0 | SCROLL_HIRES_WHEEL, buffer[4] = {0};
+
+    host_usb_reset();
+
+    /* Nothing to get or set except the mouse feature */
+    CHECK(!tud_hid_get_report_cb(ITF_NUM_HID_REL_M, REPORT_ID_RELMOUSE, HID_REPORT_TYPE_INPUT, buffer, 1));
+    CHECK(!tud_hid_get_report_cb(ITF_NUM_HID_REL_M, REPORT_ID_MOUSE, HID_REPORT_TYPE_FEATURE, buffer, 1));
+
+    tud_hid_set_report_cb(ITF_NUM_HID_REL_M, REPORT_ID_RELMOUSE, HID_REPORT_TYPE_FEATURE, &feature, 1);
+    CHECK(tud_hid_get_report_cb(ITF_NUM_HID_REL_M, REPORT_ID_RELMOUSE, HID_REPORT_TYPE_FEATURE, buffer, 1) == 1);
+    CHECK(buffer[0] == SCROLL_HIRES_WHEEL);
+    CHECK(tud_hid_get_report_cb(ITF_NUM_HID, REPORT_ID_MOUSE, HID_REPORT_TYPE_FEATURE, buffer, 1) == 1);
+    CHECK(buffer[0] == 0);
+
+    /* Fine wheel, whole detents of pan */
+    CHECK(tud_mouse_report(RELATIVE, 0, 0, 0, 3, 5));
+    CHECK(tud_mouse_report(RELATIVE, 0, 0, 0, 3, 5));
+    CHECK(host_report(0)->wheel == 3 && host_report(0)->pan == 0);
+    CHECK(host_report(1)->wheel == 3 && host_report(1)->pan == 1);
+    CHECK(global_state.host_scroll[RELATIVE].pan == 2);
+
+    /* The absolute mouse has its own setting */
+    CHECK(tud_mouse_report(ABSOLUTE, 0, 0, 0, 3, 0));
+    CHECK(host_report(2)->wheel == 0 && global_state.host_scroll[ABSOLUTE].wheel == 3);
+
+    /* A new setting drops what's left in the old units, a wrong length is ignored */
+    feature = SCROLL_HIRES_WHEEL | SCROLL_HIRES_PAN;
+    tud_hid_set_report_cb(ITF_NUM_HID_REL_M, REPORT_ID_RELMOUSE, HID_REPORT_TYPE_FEATURE, &feature, 2);
+    CHECK(global_state.host_scroll[RELATIVE].pan == 2);
+    tud_hid_set_report_cb(ITF_NUM_HID_REL_M, REPORT_ID_RELMOUSE, HID_REPORT_TYPE_FEATURE, &feature, 1);
+    CHECK(global_state.host_scroll[RELATIVE].pan == 0);
+
+    CHECK(tud_mouse_report(RELATIVE, 0, 0, 0, 3, 5));
+    CHECK(host_report(3)->wheel == 3 && host_report(3)->pan == 5);
+}
+
+int main(void) {
+    load_config(&global_state);
+
+    check_scale_scroll();
+    check_scroll_to_host();
+    check_wheel_only();
+    check_shared();
+    check_own();
+    check_feature_callbacks();
+    return host_result("scroll");
+}
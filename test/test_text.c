@@ -0,0 +1,252 @@
+/*
+ * This file is part of DeskHop (https://github.com/hrvach/deskhop).
+ * Copyright (c) 2025 Hrvoje Cavrak
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * See the file LICENSE for the full license text.
+ */
+#include <stdio.h>
+
+#include "main.h"
+#include "host.h"
+
+/*==============================================================================
+ *  Text injection
+ *  Text goes in with type_text and comes out of process_kbd_queue_task, with
+ *  the host taking a report every millisecond. The reports are decoded back
+ *  into text the way each OS would, and must give the text that went in.
+ *==============================================================================*/
+
+#define MAX_CHARS 4096
+
+extern uint64_t host_time_us;
+
+typedef struct {
+    uint32_t text[MAX_CHARS]; // Code points typed so far
+    int len;
+    hid_keyboard_report_t prev;
+    uint8_t os;
+    bool unicode;  // Linux, Ctrl+Shift+U seen, hex digits follow
+    bool alt_code; // Windows, keypad digits typed with Alt held
+    uint8_t dead;  // macOS, accent key pressed with Option, waiting for the letter
+    uint32_t code;
+} decoder_t;
+
+static char ascii_char(uint8_t key, bool shift) {
+    for (int ch = 0; ch < 128; ch++) {
+        const keystroke_t *stroke = &us_ascii_keystrokes[ch];
+
+        if (ch != '\r' && stroke->key == key && !!(stroke->modifier & KEYBOARD_MODIFIER_LEFTSHIFT) == shift)
+            return ch;
+    }
+
+    return 0;
+}
+
+static int keypad_digit(uint8_t key) {
+    if (key == HID_KEY_KEYPAD_0)
+        return 0;
+
+    return key >= HID_KEY_KEYPAD_1 && key <= HID_KEY_KEYPAD_9 ? key - HID_KEY_KEYPAD_1 + 1 : -1;
+}
+
+/* Letters with an accent on macOS: the Option key, then the letter */
+static uint32_t macos_compose(uint8_t dead, char letter) {
+    static const struct {
+        uint8_t key;
+        const char *letters;
+        uint8_t codes[6];
+    } accents[] = {
+        {HID_KEY_GRAVE, "aeiou", {0xE0, 0xE8, 0xEC, 0xF2, 0xF9}},
+        {HID_KEY_E, "aeiouy", {0xE1, 0xE9, 0xED, 0xF3, 0xFA, 0xFD}},
+        {HID_KEY_I, "aeiou", {0xE2, 0xEA, 0xEE, 0xF4, 0xFB}},
+        {HID_KEY_N, "ano", {0xE3, 0xF1, 0xF5}},
+        {HID_KEY_U, "aeiouy", {0xE4, 0xEB, 0xEF, 0xF6, 0xFC, 0xFF}},
+    };
+    bool upper = letter >= 'A' && letter <= 'Z';
+
+    for (int i = 0; i < ARRAY_SIZE(accents); i++) {
+        const char *found = accents[i].key == dead ? strchr(accents[i].letters, upper ? letter + 32 : letter) : NULL;
+
+        if (found && *found)
+            return accents[i].codes[found - accents[i].letters] - (upper ? 0x20 : 0);
+    }
+
+    return 0;
+}
+
+/* Option + key on macOS, either a whole character or an accent */
+static uint32_t macos_option(uint8_t key, bool shift) {
+    static const uint8_t keys[]  = {HID_KEY_S, HID_KEY_A, HID_KEY_APOSTROPHE, HID_KEY_C, HID_KEY_O};
+    static const uint8_t codes[] = {0xDF, 0xE5, 0xE6, 0xE7, 0xF8};
+
+    for (int i = 0; i < ARRAY_SIZE(keys); i++)
+        if (keys[i] == key)
+            return codes[i] - (shift ? 0x20 : 0);
+
+    return 0;
+}
+
+static void decode_key(decoder_t *dec, uint8_t key, uint8_t modifier) {
+    bool shift = modifier & KEYBOARD_MODIFIER_LEFTSHIFT, alt = modifier & KEYBOARD_MODIFIER_LEFTALT;
+    char ch    = ascii_char(key, shift);
+
+    if (dec->os == LINUX && (modifier & KEYBOARD_MODIFIER_LEFTCTRL) && shift && key == HID_KEY_U) {
+        dec->unicode = true;
+        dec->code    = 0;
+        return;
+    }
+
+    if (dec->unicode) {
+        if (ch == ' ') {
+            dec->text[dec->len++] = dec->code;
+            dec->unicode          = false;
+        } else
+            dec->code = dec->code * 16 + (ch <= '9' ? ch - '0' : ch - 'a' + 10);
+        return;
+    }
+
+    if (dec->os == WINDOWS && alt && keypad_digit(key) >= 0) {
+        dec->code     = dec->alt_code ? dec->code * 10 + keypad_digit(key) : 0;
+        dec->alt_code = true;
+        return;
+    }
+
+    if (dec->os == MACOS && alt) {
+        if (macos_option(key, shift))
+            dec->text[dec->len++] = macos_option(key, shift);
+        else
+            dec->dead = key;
+        return;
+    }
+
+    if (dec->dead) {
+        dec->text[dec->len++] = macos_compose(dec->dead, ch);
+        dec->dead             = 0;
+        return;
+    }
+
+    if (ch)
+        dec->text[dec->len++] = ch;
+}
+
+/* What the host makes of a report, every key pressed since the last one is a keystroke */
+static void decode(decoder_t *dec, const hid_keyboard_report_t *report) {
+    /* Windows enters the Alt code once Alt is let go */
+    if (dec->alt_code && !(report->modifier & KEYBOARD_MODIFIER_LEFTALT)) {
+        dec->text[dec->len++] = dec->code;
+        dec->alt_code         = false;
+    }
+
+    for (int i = 0; i < KEYS_IN_USB_REPORT; i++)
+        if (report->keycode[i] && !key_in_report(report->keycode[i], &dec->prev) && dec->len < MAX_CHARS)
+            decode_key(dec, report->keycode[i], report->modifier);
+
+    dec->prev = *report;
+}
+
+static int utf8_to_codepoints(const char *text, uint32_t *out) {
+    int len = 0;
+
+    for (const uint8_t *p = (const uint8_t *)text; *p;) {
+        int extra    = *p >= 0xF0 ? 3 : *p >= 0xE0 ? 2 : *p >= 0xC0 ? 1 : 0;
+        uint32_t cp  = *p++ & (0x7F >> extra);
+
+        while (extra--)
+            cp = (cp << 6) | (*p++ & 0x3F);
+
+        out[len++] = cp;
+    }
+
+    return len;
+}
+
+/* Characters the OS has a way of typing, the rest is left out */
+static bool typeable(uint32_t cp, uint8_t os) {
+    if (cp == '\r' || cp == 0x01)
+        return false;
+
+    if (cp < 0x80 || os == LINUX)
+        return true;
+
+    return (os == WINDOWS || os == MACOS) && cp >= 0xC0 && cp <= 0xFF && cp != 0xD7 && cp != 0xF7 && cp != 0xD0
+           && cp != 0xF0 && cp != 0xDE && cp != 0xFE;
+}
+
+static const char *os_name(uint8_t os) {
+    return os == LINUX ? "linux" : os == MACOS ? "macos" : os == WINDOWS ? "windows" : "android";
+}
+
+/* Type the text on our output, the host polls every 1 ms, the tasks run at 2 kHz like on the board */
+static void check_typing(const char *text, uint8_t os) {
+    static uint32_t expected[MAX_CHARS];
+    static decoder_t dec;
+    int typed = 0, reports = 0;
+    uint64_t start = host_time_us;
+
+    memset(&dec, 0, sizeof(dec));
+    dec.os = os;
+    global_state.config.output[BOARD_ROLE].os = os;
+
+    CHECK(type_text((const uint8_t *)text, strlen(text), NUM_SCREENS, &global_state));
+
+    for (int tick = 0; tick < 200000; tick++) {
+        host_hid_ready = tick % 2 == 0;
+        host_report_count = 0;
+
+        process_text_task(&global_state);
+        process_kbd_queue_task(&global_state);
+        host_time_us += 500;
+
+        for (int i = 0; i < host_report_count; i++, reports++)
+            decode(&dec, (const hid_keyboard_report_t *)host_reports[i].data);
+
+        if (queue_is_empty(&global_state.text_queue) && queue_is_empty(&global_state.kbd_queue) && tick > 10
+            && !dec.prev.modifier && !dec.prev.keycode[0])
+            break;
+    }
+
+    int len = utf8_to_codepoints(text, expected);
+    for (int i = 0; i < len; i++)
+        if (typeable(expected[i], os))
+            expected[typed++] = expected[i];
+
+    CHECK(dec.len == typed && !memcmp(dec.text, expected, typed * sizeof(uint32_t)));
+    CHECK(!dec.prev.modifier && !dec.prev.keycode[0]);
+
+    double seconds = (host_time_us - start) / 1e6;
+    printf("%-8s %4d characters, %5d reports, %.3f s, %.0f characters/s\n", os_name(os), dec.len, reports, seconds,
+           dec.len / seconds);
+}
+
+int main(void) {
+    static char key[1000];
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char latin[] = "Grüße aus Zürich, café crème, naïve Ñandú, Øresund, Ça va? ÿ ý Æ — ok\r\n\x01";
+    unsigned seed = 35;
+
+    load_config(&global_state);
+    queue_init(&global_state.kbd_queue, sizeof(hid_keyboard_report_t), KBD_QUEUE_LENGTH);
+    queue_init(&global_state.text_queue, sizeof(text_char_t), TEXT_QUEUE_LENGTH);
+    queue_init(&global_state.uart_tx_queue, sizeof(uart_packet_t), UART_QUEUE_LENGTH);
+    global_state.tud_connected = true;
+    global_state.active_output = BOARD_ROLE;
+
+    /* Something like an SSH public key, long runs of random base64 with repeats */
+    int n = sprintf(key, "ssh-ed25519 ");
+    for (int i = 0; i < 900; i++) {
+        seed = seed * 1103515245 + 12345;
+        key[n++] = base64[(seed >> 16) % 64];
+    }
+    sprintf(key + n, " ops@console\n");
+
+    check_typing(key, LINUX);
+
+    for (uint8_t os = LINUX; os <= ANDROID; os++)
+        check_typing(latin, os);
+
+    return host_result("text");
+}
@@ -2,6 +2,8 @@
 
 from dataclasses import dataclass, field
 
+# This is the single source of the config API fields. Besides the web form, render.py uses it to
+# generate the firmware field table (src/include/api_fields.h). Fields without a member are UI only.
 @dataclass
 class FormField:
     offset: int
@@ -10,6 +12,8 @@ class FormField:
     values: dict[int, str] = field(default_factory=dict)
     data_type: str = "int32"
     elem: str | None = None
+    member: str | None = None   # device_t member, {out} / {n} are replaced by the output / hotkey index
+    readonly: bool = False
 
 SHORTCUTS = {
     0x73: "None",
@@ -21,40 +25,172 @@ SHORTCUTS = {
     0x53: "Num Lock",
     }
 
+# enum stats_queue_e
+STATS_QUEUES = ["KBD", "Mouse", "UART", "HID"]
+
 STATUS_ = [
-    FormField(78, "Running FW version", None, {}, "uint16", elem="fw_version"),
-    FormField(79, "Running FW checksum", None, {}, "uint32", elem="hex_info"),
+    FormField(78, "Running FW version", None, {}, "uint16", elem="fw_version", member="_running_fw.version", readonly=True),
+    FormField(79, "Running FW checksum", None, {}, "uint32", elem="hex_info", member="_running_fw.checksum", readonly=True),
+
+    FormField(1006, "Counters", elem="label"),
+    FormField(96, "Core0 Loops/s", None, {}, "uint32", "counter", member="stats.loop_rate[0]", readonly=True),
+    FormField(97, "Core1 Loops/s", None, {}, "uint32", "counter", member="stats.loop_rate[1]", readonly=True),
+    FormField(98, "KBD Reports/s", None, {}, "uint32", "counter", member="stats.host_report_rate[0]", readonly=True),
+    FormField(99, "Mouse Reports/s", None, {}, "uint32", "counter", member="stats.host_report_rate[1]", readonly=True),
+    FormField(242, "Other HID Reports/s", None, {}, "uint32", "counter", member="stats.host_report_rate[2]", readonly=True),
+    FormField(95, "UART RX Packets/s", None, {}, "uint32", "counter", member="stats.uart_rx_rate", readonly=True),
+    FormField(93, "UART Checksum Errors", None, {}, "uint32", "counter", member="stats.uart_checksum_errors", readonly=True),
+    FormField(94, "UART Bytes Skipped", None, {}, "uint32", "counter", member="stats.uart_skipped_bytes", readonly=True),
+    FormField(243, "UART Baud Rate", None, {}, "uint32", "counter", member="link.baud", readonly=True),
+    FormField(244, "UART Rate Changes", None, {}, "uint32", "counter", member="link.rate_changes", readonly=True),
+    FormField(245, "UART Rate Rollbacks", None, {}, "uint32", "counter", member="link.rollbacks", readonly=True),
+    FormField(247, "Chain Packets Forwarded", None, {}, "uint32", "counter", member="chain.forwarded", readonly=True),
+    FormField(248, "Chain RX Packets", None, {}, "uint32", "counter", member="chain.rx_packets", readonly=True),
+    FormField(249, "Chain Checksum Errors", None, {}, "uint32", "counter", member="chain.checksum_errors", readonly=True),
+    FormField(250, "Mouse Reports To Link", None, {}, "uint32", "counter", member="mouse_link.reports", readonly=True),
+    FormField(251, "Mouse Link Frames", None, {}, "uint32", "counter", member="mouse_link.frames", readonly=True),
+    FormField(83, "KBD Duplicates Dropped", None, {}, "uint32", "counter", member="stats.kbd_duplicates", readonly=True),
+    FormField(84, "KBD Reports Coalesced", None, {}, "uint32", "counter", member="stats.kbd_coalesced", readonly=True),
+    FormField(252, "Mouse Reports Merged", None, {}, "uint32", "counter", member="stats.mouse_merged", readonly=True),
+    FormField(253, "Flash Errors", None, {}, "uint32", "counter", member="stats.flash_errors", readonly=True),
+] + [
+    FormField(85 + n, f"{name} Queue Drops", None, {}, "uint32", "counter", member=f"stats.queue_drops[{n}]", readonly=True)
+    for n, name in enumerate(STATS_QUEUES)
+] + [
+    FormField(89 + n, f"{name} Queue Peak", None, {}, "uint16", "counter", member=f"stats.queue_peak_level[{n}]", readonly=True)
+    for n, name in enumerate(STATS_QUEUES)
 ]
 
 CONFIG_ = [
     FormField(1001, "Mouse", elem="label"),
-    FormField(71, "Force Mouse Boot Mode", None, {}, "uint8", "checkbox"),
-    FormField(75, "Enable Acceleration", None, {}, "uint8", "checkbox"),
-    FormField(77, "Jump Threshold", 0, {"min": 0, "max": 3000}, "uint16", "range"),
+    FormField(71, "Force Mouse Boot Mode", None, {}, "uint8", "checkbox", member="config.force_mouse_boot_mode"),
+    FormField(75, "Enable Acceleration", None, {}, "uint8", "checkbox", member="config.enable_acceleration"),
+    FormField(77, "Jump Threshold", 0, {"min": 0, "max": 3000}, "uint16", "range", member="config.jump_threshold"),
 
     FormField(1002, "Keyboard", elem="label"),
-    FormField(72, "Force KBD Boot Protocol", None, {}, "uint8", "checkbox"),
-    FormField(73, "KBD LED as Indicator", None, {}, "uint8", "checkbox"),
+    FormField(72, "Force KBD Boot Protocol", None, {}, "uint8", "checkbox", member="config.force_kbd_boot_protocol"),
+    FormField(73, "KBD LED as Indicator", None, {}, "uint8", "checkbox", member="config.kbd_led_as_indicator"),
 
-    FormField(76, "Enforce Ports", None, {}, "uint8", "checkbox"),
+    FormField(76, "Enforce Ports", None, {}, "uint8", "checkbox", member="config.enforce_ports"),
+
+    FormField(1008, "Chain", elem="label"),
+    FormField(246, "Chain Position", 0, {0: "Outputs A/B", 1: "Outputs C/D"}, "uint8", member="config.chain_pair"),
 ]
 
 OUTPUT_ = [
-    FormField(1, "Screen Count", 1, {1: "1", 2: "2", 3: "3"}, "uint32"),
-    FormField(2, "Speed X", 16, {"min": 1, "max": 100}, "int32", "range"),
-    FormField(3, "Speed Y", 16, {"min": 1, "max": 100}, "int32", "range"),
-    FormField(4, "Border Top", None, {}, "int32"),
-    FormField(5, "Border Bottom", None, {}, "int32"),
-    FormField(6, "Operating System", 1, {1: "Linux", 2: "MacOS", 3: "Windows", 4: "Android", 255: "Other"}, "uint8"),
-    FormField(7, "Screen Position", 1, {1: "Left", 2: "Right"}, "uint8"),
-    FormField(8, "Cursor Park Position", 0, {0: "Top", 1: "Bottom", 3: "Previous"}, "uint8"),
+    FormField(1, "Screen Count", 1, {1: "1", 2: "2", 3: "3"}, "uint32", member="config.output[{out}].screen_count"),
+    FormField(2, "Speed X", 16, {"min": 1, "max": 100}, "int32", "range", member="config.output[{out}].speed_x"),
+    FormField(3, "Speed Y", 16, {"min": 1, "max": 100}, "int32", "range", member="config.output[{out}].speed_y"),
+    FormField(4, "Border Top", None, {}, "int32", member="config.output[{out}].border.top"),
+    FormField(5, "Border Bottom", None, {}, "int32", member="config.output[{out}].border.bottom"),
+    FormField(6, "Operating System", 1, {1: "Linux", 2: "MacOS", 3: "Windows", 4: "Android", 255: "Other"}, "uint8",
+              member="config.output[{out}].os"),
+    FormField(7, "Screen Position", 1, {1: "Left", 2: "Right"}, "uint8", member="config.output[{out}].pos"),
+    FormField(8, "Cursor Park Position", 0, {0: "Top", 1: "Bottom", 3: "Previous"}, "uint8",
+              member="config.output[{out}].mouse_park_pos"),
+    FormField(25, "Pointer Type", 0, {0: "Absolute Mouse", 2: "Pen Digitizer"}, "uint8",
+              member="config.output[{out}].pointer_mode"),
     FormField(1003, "Screensaver", elem="label"),
-    FormField(9, "Mode", 0, {0: "Disabled", 1: "Pong", 2: "Jitter"}, "uint8"),
-    FormField(10, "Only If Inactive", None, {}, "uint8", "checkbox"),
-    FormField(11, "Idle Time (μs)", None, {}, "uint64"),
-    FormField(12, "Max Time (μs)", None, {}, "uint64"),
+    FormField(9, "Mode", 0, {0: "Disabled", 1: "Pong", 2: "Jitter"}, "uint8", member="config.output[{out}].screensaver.mode"),
+    FormField(10, "Only If Inactive", None, {}, "uint8", "checkbox", member="config.output[{out}].screensaver.only_if_inactive"),
+    FormField(11, "Idle Time (μs)", None, {}, "uint64", member="config.output[{out}].screensaver.idle_time_us"),
+    FormField(12, "Max Time (μs)", None, {}, "uint64", member="config.output[{out}].screensaver.max_time_us"),
+]
+
+# Screen rectangles, in any unit (e.g. pixels) as long as both outputs use the same one. Screens with touching
+# edges are neighbours, also above or below. Used once every screen in use has a size, until then the layout
+# follows Screen Position, Screen Count and Border.
+MAX_OUTPUT_SCREENS = 3
+SCREEN_RECT = {"X": "x", "Y": "y", "Width": "w", "Height": "h"}
+
+OUTPUT_ += [FormField(1007, "Screen Layout", elem="label")] + [
+    FormField(13 + len(SCREEN_RECT) * n + i, f"Screen {n + 1} {name}", None, {}, "int16",
+              member=f"config.output[{{out}}].layout[{n}].{member}")
+    for n in range(MAX_OUTPUT_SCREENS) for i, (name, member) in enumerate(SCREEN_RECT.items())
+]
+
+HOTKEY_ACTIONS = {
+    0: "None",
+    1: "Output Toggle",
+    2: "Switch Lock",
+    3: "Screen Lock",
+    4: "Gaming Mode",
+    5: "Mouse Zoom",
+    6: "Screensaver Pong",
+    7: "Screensaver Jitter",
+    8: "Screensaver Off",
+    9: "Record Screen Border",
+    10: "Config Mode",
+    11: "Wipe Config",
+    12: "FW Upgrade A",
+    13: "FW Upgrade B",
+} | {32 + n: f"Macro {n + 1}" for n in range(16)}
+
+# User defined hotkeys, keys are HID usage codes and modifier is the HID modifier bitmask
+USER_HOTKEY_ = [
+    FormField(0, "Modifier Mask", None, {}, "uint8", member="config.user_hotkeys[{n}].modifier"),
+    FormField(1, "Key 1", None, {}, "uint8", member="config.user_hotkeys[{n}].keys[0]"),
+    FormField(2, "Key 2", None, {}, "uint8", member="config.user_hotkeys[{n}].keys[1]"),
+    FormField(3, "Action", 0, HOTKEY_ACTIONS, "uint8", member="config.user_hotkeys[{n}].action"),
+]
+
+MODIFIERS = ["Left Ctrl", "Left Shift", "Left Alt", "Left GUI", "Right Ctrl", "Right Shift", "Right Alt", "Right GUI"]
+MODIFIER_TARGETS = {0: "Unchanged"} | {bit + 1: name for bit, name in enumerate(MODIFIERS)}
+MAX_KEY_REMAPS = 8
+
+# Per output key remapping, keys are HID usage codes. Remapping a key to 224-231 turns it into a modifier.
+KEYMAP_ = [FormField(1005, "Key Remap", elem="label")] + [
+    FormField(bit, name, 0, MODIFIER_TARGETS, "uint8", member=f"config.output[{{out}}].keymap.modifier_map[{bit}]")
+    for bit, name in enumerate(MODIFIERS)
+] + [
+    FormField(8 + 2 * n + i, f"Remap {n + 1} {side}", None, {}, "uint8", member=f"config.output[{{out}}].keymap.remap[{n}].{side.lower()}")
+    for n in range(MAX_KEY_REMAPS) for i, side in enumerate(["From", "To"])
+]
+
+# Input latency histograms, one row of buckets per hop. Bucket n counts samples below 64 us << n.
+LATENCY_HOPS = ["Parse", "Enqueue", "UART TX", "Link", "Device", "Total"]
+LATENCY_BUCKETS = ["< 64 µs", "< 128 µs", "< 256 µs", "< 512 µs", "< 1 ms", "< 2 ms", "< 4 ms", "≥ 4 ms"]
+
+LATENCY_ = [
+    FormField(hop * len(LATENCY_BUCKETS) + b, f"{name} {bucket}", None, {}, "uint32",
+              member=f"latency.hist[{hop}][{b}]", readonly=True)
+    for hop, name in enumerate(LATENCY_HOPS) for b, bucket in enumerate(LATENCY_BUCKETS)
+]
+
+# Fields exposed through the API, but not shown in the form
+OUTPUT_API_ONLY_ = [
+    FormField(0, "Number", data_type="uint32", member="config.output[{out}].number"),
+]
+
+API_ONLY_ = [
+    FormField(0, "Active Output", data_type="uint8", member="active_output", readonly=True),
+    FormField(1, "Pointer X", data_type="int16", member="pointer_x", readonly=True),
+    FormField(2, "Pointer Y", data_type="int16", member="pointer_y", readonly=True),
+    FormField(3, "Mouse Buttons", data_type="int16", member="mouse_buttons", readonly=True),
+    FormField(70, "Config Version", data_type="uint32", member="config.version"),
+    FormField(74, "Hotkey Toggle", data_type="uint8", member="config.hotkey_toggle"),
+    FormField(80, "Keyboard Connected", data_type="uint8", member="keyboard_connected", readonly=True),
+    FormField(81, "Switch Lock", data_type="uint8", member="switch_lock", readonly=True),
+    FormField(82, "Relative Mouse", data_type="uint8", member="relative_mouse", readonly=True),
 ]
 
+OUTPUT_BASE = {0: 10, 1: 40}
+KEYMAP_BASE = {0: 140, 1: 170}
+HOTKEY_BASE = 100
+LATENCY_BASE = 194
+MAX_USER_HOTKEYS = 8
+
+# Firmware type_e name and length for each form data type
+C_TYPES = {
+    "uint8": ("UINT8", 1),
+    "uint16": ("UINT16", 2),
+    "uint32": ("UINT32", 4),
+    "uint64": ("UINT64", 8),
+    "int8": ("INT8", 1),
+    "int16": ("INT16", 2),
+    "int32": ("INT32", 4),
+}
+
 def generate_output(base, data):
     output = [
         {
@@ -69,14 +205,50 @@ def generate_output(base, data):
     ]
     return output
 
-def output_A(base=10):
-    return generate_output(base, data=OUTPUT_)
+def output_A(base=OUTPUT_BASE[0]):
+    return generate_output(base, data=OUTPUT_) + generate_output(KEYMAP_BASE[0], data=KEYMAP_)
 
-def output_B(base=40):
-    return generate_output(base, data=OUTPUT_)
+def output_B(base=OUTPUT_BASE[1]):
+    return generate_output(base, data=OUTPUT_) + generate_output(KEYMAP_BASE[1], data=KEYMAP_)
 
 def output_status():
     return generate_output(0, data=STATUS_)
 
 def output_config():
     return generate_output(0, data=CONFIG_)
+
+def output_hotkeys():
+    return [generate_output(HOTKEY_BASE + n * len(USER_HOTKEY_), data=USER_HOTKEY_) for n in range(MAX_USER_HOTKEYS)]
+
+def output_latency():
+    fields = generate_output(LATENCY_BASE, data=LATENCY_)
+    row = len(LATENCY_BUCKETS)
+    return [{"name": name, "buckets": fields[n * row:(n + 1) * row]} for n, name in enumerate(LATENCY_HOPS)]
+
+def api_field(key, field, out=None, n=None):
+    c_type, length = C_TYPES[field.data_type]
+    return {
+        "key": key,
+        "readonly": field.readonly,
+        "type": c_type,
+        "len": length,
+        "member": field.member.format(out=out, n=n),
+    }
+
+def api_fields():
+    fields = [api_field(f.offset, f) for f in STATUS_ + CONFIG_ + API_ONLY_ if f.member]
+
+    for out, base in OUTPUT_BASE.items():
+        fields += [api_field(base + f.offset, f, out) for f in OUTPUT_ + OUTPUT_API_ONLY_ if f.member]
+        fields += [api_field(KEYMAP_BASE[out] + f.offset, f, out) for f in KEYMAP_ if f.member]
+
+    for n in range(MAX_USER_HOTKEYS):
+        fields += [api_field(HOTKEY_BASE + n * len(USER_HOTKEY_) + f.offset, f, n=n) for f in USER_HOTKEY_]
+
+    fields += [api_field(LATENCY_BASE + f.offset, f) for f in LATENCY_]
+
+    keys = [f["key"] for f in fields]
+    assert len(keys) == len(set(keys)), "Duplicate API field index"
+
+    return sorted(fields, key=lambda f: f["key"])
+
@@ -1,8 +1,8 @@
 #!/usr/bin/python3
 
 # Takes a HTML file, outputs a minified and compressed version that self-decompresses when loaded.
-# This way, the device config page can be fitted in a small 64 kB "flash" partition and distributed
-# with the main binary.
+# This way, the device config page takes little flash and is distributed with the main binary.
+# Also generates the firmware API field table from the same field definitions (form.py).
 
 from jinja2 import Environment, FileSystemLoader
 from form import *
@@ -15,6 +15,8 @@ INPUT_FILENAME = "main.html"
 PACKER_FILENAME = "packer.j2"
 OUTPUT_FILENAME = "config.htm"
 OUTPUT_UNPACKED = "config-unpacked.htm"
+API_FIELDS_FILENAME = "api_fields.h.j2"
+OUTPUT_API_FIELDS = "../src/include/api_fields.h"
 
 def render(filename, *args, **kwargs):
     env = Environment(loader=FileSystemLoader(TEMPLATE_PATH))
@@ -45,6 +47,9 @@ if __name__ == "__main__":
         screen_B=output_B(),
         status=output_status(),
         config=output_config(),
+        hotkeys=output_hotkeys(),
+        latency=output_latency(),
+        latency_buckets=LATENCY_BUCKETS,
     )
 
     # Compress file and encode to base64
@@ -58,4 +63,7 @@ if __name__ == "__main__":
     write_file(self_extracting_webpage)
 
     # Write unpacked webpage
-    write_file(webpage, OUTPUT_UNPACKED)
\ No newline at end of file
+    write_file(webpage, OUTPUT_UNPACKED)
+
+    # Firmware API field table comes from the same field definitions as the form
+    write_file(render(API_FIELDS_FILENAME, fields=api_fields()) + "\n", OUTPUT_API_FIELDS)
\ No newline at end of file
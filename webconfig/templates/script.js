@@ -1,6 +1,13 @@
 const mgmtReportId = 6;
 var device;
 
+/* WebUSB bulk interface, reads all values in a single transfer */
+const bulk = { iface: 4, endpoint: 7, bufferSize: 512, getCmd: 1, headerLength: 16, pollInterval: 1000 };
+var usbDevice;
+var usbDeclined = false;
+var bulkVersion = 0;
+var bulkPending = Promise.resolve();
+
 const packetType = {
   keyboardReportMsg: 1, mouseReportMsg: 2, outputSelectMsg: 3, firmwareUpgradeMsg: 4, switchLockMsg: 7,
   syncBordersMsg: 8, flashLedMsg: 9, wipeConfigMsg: 10, readConfigMsg: 16, writeConfigMsg: 17, saveConfigMsg: 18,
@@ -124,27 +131,26 @@ function setValue(element, value) {
 }
 
 
-function updateElement(key, event) {
-  var dataOffset = 4;
+function updateElement(key, view, dataOffset) {
   var element = document.querySelector(`[data-key="${key}"]`);
 
   if (!element)
     return;
 
   const methods = {
-    "uint32": event.data.getUint32,
-    "uint64": event.data.getUint32, /* Yes, I know. :-| */
-    "int32": event.data.getInt32,
-    "uint16": event.data.getUint16,
-    "uint8": event.data.getUint8,
-    "int16": event.data.getInt16,
-    "int8": event.data.getInt8
+    "uint32": view.getUint32,
+    "uint64": view.getUint32, /* Yes, I know. :-| */
+    "int32": view.getInt32,
+    "uint16": view.getUint16,
+    "uint8": view.getUint8,
+    "int16": view.getInt16,
+    "int8": view.getInt8
   };
 
   dataType = element.getAttribute('data-type');
 
   if (dataType in methods) {
-    var value = methods[dataType].call(event.data, dataOffset, true);
+    var value = methods[dataType].call(view, dataOffset, true);
     setValue(element, value);
 
     if (element.hasAttribute('data-hex'))
@@ -159,10 +165,97 @@ function updateElement(key, event) {
   }
 }
 
+async function bulkConnect() {
+  if (usbDevice && usbDevice.opened)
+    return true;
+
+  if (!("usb" in navigator) || usbDeclined)
+    return false;
+
+  try {
+    const filter = { vendorId: 0x2e8a, productId: 0x107c, classCode: 0xff };
+    var devices = await navigator.usb.getDevices();
+
+    usbDevice = devices.find(d => d.vendorId == filter.vendorId && d.productId == filter.productId);
+
+    /* Asking for permission needs a user gesture, if there is none we just use HID this time */
+    if (!usbDevice)
+      usbDevice = await navigator.usb.requestDevice({ filters: [filter] });
+
+    await usbDevice.open();
+    await usbDevice.claimInterface(bulk.iface);
+    return true;
+  } catch (error) {
+    if (error.name === 'NotFoundError')
+      usbDeclined = true;
+
+    usbDevice = undefined;
+    return false;
+  }
+}
+
+/* Request is [0xaa, 0x55, cmd, status, length (2 bytes), version (4 bytes), offset (2 bytes), arg (4 bytes)]
+   and an empty field list (= all). Reply has the same header, followed by [key, length, value] records. Whatever
+   didn't fit comes in the next page, the reply's offset says where it starts (0 = this was the last one). */
+async function bulkGet(since) {
+  var request = new DataView(new ArrayBuffer(bulk.headerLength));
+  var version;
+  var offset = 0;
+
+  request.setUint16(0, 0x55aa, true);
+  request.setUint8(2, bulk.getCmd);
+  request.setUint32(6, since, true);
+
+  do {
+    request.setUint16(10, offset, true);
+
+    await usbDevice.transferOut(bulk.endpoint, request.buffer);
+    var reply = (await usbDevice.transferIn(bulk.endpoint, bulk.bufferSize)).data;
+
+    if (reply.byteLength < bulk.headerLength || reply.getUint8(3) != 0)
+      return false;
+
+    const end = bulk.headerLength + reply.getUint16(4, true);
+
+    for (let pos = bulk.headerLength; pos + 2 <= end && pos + 2 <= reply.byteLength;) {
+      const key = reply.getUint8(pos);
+      const length = reply.getUint8(pos + 1);
+
+      updateElement(key, reply, pos + 2);
+      pos += 2 + length;
+    }
+
+    /* Poll from the first page's version, so fields changing while the rest is read come again */
+    if (version === undefined)
+      version = reply.getUint32(6, true);
+
+    offset = reply.getUint16(10, true);
+  } while (offset);
+
+  bulkVersion = version;
+  return true;
+}
+
+/* Transfers on the bulk endpoint must not overlap, so they are chained one after another */
+function bulkReadHandler(since = 0) {
+  bulkPending = bulkPending.catch(() => false).then(() => bulkGet(since));
+  return bulkPending;
+}
+
+/* Keep the page up to date, only fields that changed since the last read are transferred */
+setInterval(async () => {
+  if (usbDevice && usbDevice.opened && bulkVersion)
+    await bulkReadHandler(bulkVersion).catch(() => false);
+}, bulk.pollInterval);
+
 async function readHandler() {
   if (!device || !device.opened)
     await connectHandler();
 
+  /* Bulk interface gets everything in one go, otherwise ask for each value over HID */
+  if (await bulkConnect() && await bulkReadHandler().catch(() => false))
+    return;
+
   await sendReport(packetType.getValAllMsg);
 }
 
@@ -170,7 +263,7 @@ async function handleInputReport(event) {
   var data = new Uint8Array(event.data.buffer);
   var key = data[3];
 
-  updateElement(key, event);
+  updateElement(key, event.data, 4);
 }
 
 async function rebootHandler() {